@@ -0,0 +1,177 @@
+#include "acousticanalyzer.hpp"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include "fingerprinter.hpp"
+#include "similarityindex.hpp"
+
+namespace {
+/* Skipped files go by quickly, don't flood the GUI with progress for each of them. */
+constexpr qint64 progressStep = 64;
+}
+
+AcousticAnalyzer::AcousticAnalyzer(QObject *parent)
+    : QObject {parent}
+    , m_threadCount {qMax(1, QThread::idealThreadCount() - 1)}
+    , m_index {nullptr}
+    , m_open {false}
+    , m_total {0}
+    , m_done {0}
+    , m_analyzed {0}
+    , m_failed {0}
+    , m_cancelled {false}
+{
+}
+
+AcousticAnalyzer::~AcousticAnalyzer()
+{
+    m_cancelled = true;
+    m_job.wait();
+}
+
+void AcousticAnalyzer::setThreadCount(int count)
+{
+    m_threadCount = qMax(1, count);
+}
+
+int AcousticAnalyzer::threadCount() const
+{
+    return m_threadCount;
+}
+
+void AcousticAnalyzer::setIndex(SimilarityIndex *index)
+{
+    m_index = index;
+}
+
+bool AcousticAnalyzer::isRunning() const
+{
+    return m_job.isRunning();
+}
+
+void AcousticAnalyzer::start(const QStringList &files)
+{
+    Q_ASSERT_X(m_index != nullptr, "An index must be set before analyzing.", Q_FUNC_INFO);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_open) {
+            m_queue.insert(m_queue.end(), files.cbegin(), files.cend());
+            m_total += files.size();
+            return;
+        }
+    }
+
+    /* A run that just closed its queue may still be on its way out. */
+    m_job.wait();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.assign(files.cbegin(), files.cend());
+        m_open = true;
+    }
+
+    m_total = files.size();
+    m_done = 0;
+    m_analyzed = 0;
+    m_failed = 0;
+    m_cancelled = false;
+
+    m_job.start([this] () {
+        QElapsedTimer timer;
+        timer.start();
+
+        for (;;) {
+            BackgroundJob::runParallel(m_threadCount, [this] (int) { work(); }, QThread::LowPriority);
+
+            /* Something may have been prioritized after the workers found the queue empty. */
+            QMutexLocker locker(&m_mutex);
+            if (m_cancelled)
+                m_queue.clear();
+
+            if (m_queue.empty()) {
+                m_open = false;
+                break;
+            }
+        }
+
+        qInfo().noquote() << tr("Analyzed %1 files in %2 s, %3 couldn't be decoded and %4 were up to date.")
+                                 .arg(m_analyzed.load())
+                                 .arg(timer.elapsed() / 1'000)
+                                 .arg(m_failed.load())
+                                 .arg(m_done - m_analyzed - m_failed);
+
+        emit finished(m_analyzed, m_failed);
+    }, QThread::LowPriority);
+}
+
+void AcousticAnalyzer::prioritize(const QString &path)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_open) {
+            m_queue.push_front(path);
+            ++m_total;
+            return;
+        }
+    }
+
+    start({path});
+}
+
+void AcousticAnalyzer::cancel()
+{
+    m_cancelled = true;
+}
+
+bool AcousticAnalyzer::wasCancelled() const
+{
+    return m_cancelled;
+}
+
+bool AcousticAnalyzer::next(QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_queue.empty())
+        return false;
+
+    path = std::move(m_queue.front());
+    m_queue.pop_front();
+    return true;
+}
+
+void AcousticAnalyzer::work()
+{
+    QString path;
+    while (not m_cancelled and next(path)) {
+        const QFileInfo info(path);
+        const auto size = info.size();
+        const auto modified = info.lastModified().toMSecsSinceEpoch();
+        bool decoded {};
+
+        if (info.isFile() and not m_index->contains(path, size, modified)) {
+            AcousticFingerprint fingerprint;
+            if (Fingerprinter::compute(path, fingerprint, &m_cancelled)) {
+                ++m_analyzed;
+            } else if (m_cancelled) {
+                /* Stopped halfway, that says nothing about the file. */
+                break;
+            } else {
+                /* Kept empty so it isn't decoded again until it changes. */
+                fingerprint = {};
+                ++m_failed;
+            }
+
+            m_index->insert(path, size, modified, fingerprint);
+            decoded = true;
+        }
+
+        const auto done = ++m_done;
+        if (decoded or done % progressStep == 0 or done == m_total)
+            emit progress(done, m_total);
+    }
+}
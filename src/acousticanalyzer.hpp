@@ -0,0 +1,62 @@
+#ifndef ACOUSTICANALYZER_HPP
+#define ACOUSTICANALYZER_HPP
+
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+#include <deque>
+
+#include "backgroundjob.hpp"
+
+class SimilarityIndex;
+
+/* Fingerprints files with Fingerprinter and puts them in a SimilarityIndex. Decoding keeps
+ * a core busy unlike reading tags, so there's a thread per core but one, left for playback.
+ * Files the index already has, unchanged, are skipped. */
+class AcousticAnalyzer : public QObject
+{
+    Q_OBJECT
+
+    void work();
+    bool next(QString &path);
+
+public:
+    explicit AcousticAnalyzer(QObject *parent = nullptr);
+    ~AcousticAnalyzer();
+    void setThreadCount(int count);
+    int threadCount() const;
+    void setIndex(SimilarityIndex *index);
+    bool isRunning() const;
+    /* Analyzes files in the background, finished() is emitted when done.
+     * While running they're queued after those still waiting. */
+    void start(const QStringList &files);
+    /* Analyzes path before anything else, starting if nothing is running. */
+    void prioritize(const QString &path);
+    /* Workers stop after the file they're decoding, finished() is still emitted.
+     * Fingerprints taken so far stay in the index. Safe to call from any thread. */
+    void cancel();
+    bool wasCancelled() const;
+
+signals:
+    void progress(qint64 files, qint64 total);
+    /* analyzed got a fingerprint, failed couldn't be decoded. Skipped files count in neither. */
+    void finished(qint64 analyzed, qint64 failed);
+
+private:
+    int m_threadCount;
+    SimilarityIndex *m_index;
+    BackgroundJob m_job;
+    mutable QMutex m_mutex;
+    std::deque<QString> m_queue;
+    /* Whether workers still take files from m_queue, prioritize() starts a new run otherwise. */
+    bool m_open;
+    std::atomic<qint64> m_total;
+    std::atomic<qint64> m_done;
+    std::atomic<qint64> m_analyzed;
+    std::atomic<qint64> m_failed;
+    std::atomic<bool> m_cancelled;
+};
+
+#endif // ACOUSTICANALYZER_HPP
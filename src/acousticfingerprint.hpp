@@ -0,0 +1,32 @@
+#ifndef ACOUSTICFINGERPRINT_HPP
+#define ACOUSTICFINGERPRINT_HPP
+
+#include <QDataStream>
+#include <QList>
+
+/* How a recording sounds, in a few hundred bytes. See Fingerprinter. */
+struct AcousticFingerprint
+{
+    /* Mean, spread and movement of every pitch class' energy over the excerpt.
+     * Tracks that sound alike have profiles pointing the same way. */
+    QList<float> profile;
+    /* One per chroma frame of the first minute or so. Encodings of the same recording
+     * share nearly all of their bits, different recordings about half of them. */
+    QList<quint16> codes;
+    qint64 duration {}; /* Milliseconds */
+
+    /* Files that couldn't be decoded get an empty one, so they aren't tried over and over. */
+    bool isValid() const { return not profile.isEmpty(); }
+};
+
+inline QDataStream &operator<<(QDataStream &stream, const AcousticFingerprint &fingerprint)
+{
+    return stream << fingerprint.profile << fingerprint.codes << fingerprint.duration;
+}
+
+inline QDataStream &operator>>(QDataStream &stream, AcousticFingerprint &fingerprint)
+{
+    return stream >> fingerprint.profile >> fingerprint.codes >> fingerprint.duration;
+}
+
+#endif // ACOUSTICFINGERPRINT_HPP
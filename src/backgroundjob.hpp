@@ -0,0 +1,62 @@
+#ifndef BACKGROUNDJOB_HPP
+#define BACKGROUNDJOB_HPP
+
+#include <QList>
+#include <QThread>
+#include <utility>
+
+/* The thread an object does its work on in the background, one job at a time: starting
+ * another waits for the last to end. Owners stop theirs their own way and wait() for it
+ * in their destructor, before anything the job uses goes away. */
+class BackgroundJob
+{
+public:
+    BackgroundJob() = default;
+    ~BackgroundJob() { wait(); }
+
+    BackgroundJob(const BackgroundJob &) = delete;
+    BackgroundJob &operator=(const BackgroundJob &) = delete;
+
+    template <typename Function>
+    void start(Function &&function, QThread::Priority priority = QThread::InheritPriority)
+    {
+        wait();
+        m_thread = QThread::create(std::forward<Function>(function));
+        m_thread->start(priority);
+    }
+
+    bool isRunning() const { return m_thread and m_thread->isRunning(); }
+
+    void wait()
+    {
+        if (m_thread) {
+            m_thread->wait();
+            delete m_thread;
+            m_thread = nullptr;
+        }
+    }
+
+    /* Calls work(i) for every i below count, each on a thread of its own and 0 on the
+     * calling one. Returns once they're all done. */
+    template <typename Work>
+    static void runParallel(int count, const Work &work, QThread::Priority priority = QThread::InheritPriority)
+    {
+        QList<QThread *> threads;
+        for (int i = 1; i < count; ++i) {
+            threads << QThread::create(work, i);
+            threads.last()->start(priority);
+        }
+
+        work(0);
+
+        for (auto *thread : std::as_const(threads)) {
+            thread->wait();
+            delete thread;
+        }
+    }
+
+private:
+    QThread *m_thread {nullptr};
+};
+
+#endif // BACKGROUNDJOB_HPP
@@ -0,0 +1,283 @@
+#include "duplicatefinder.hpp"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <algorithm>
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+#endif
+
+namespace {
+constexpr auto algorithm = QCryptographicHash::Blake2b_256;
+/* Read from both ends, that's where tags live and where copies of different songs that
+ * happen to have the same size differ first. */
+constexpr qint64 partialBlockSize = 16 * 1024;
+constexpr qint64 readSize = 1024 * 1024;
+/* Don't flood the GUI with progress updates. */
+constexpr qint64 progressStep = 8 * 1024 * 1024;
+/* Hashing is cheap, reading isn't: a few reads in flight keep an SSD busy, more than
+ * that only make a spinning disk seek back and forth. */
+constexpr int maximumThreads = 4;
+} // namespace
+
+DuplicateFinder::DuplicateFinder(QObject *parent)
+    : QObject {parent}
+    , m_threadCount {qBound(1, QThread::idealThreadCount(), maximumThreads)}
+    , m_cancelled {false}
+    , m_hashedBytes {0}
+    , m_totalBytes {0}
+{
+}
+
+DuplicateFinder::~DuplicateFinder()
+{
+    m_cancelled = true;
+    m_job.wait();
+}
+
+void DuplicateFinder::setThreadCount(int count)
+{
+    m_threadCount = qMax(1, count);
+}
+
+int DuplicateFinder::threadCount() const
+{
+    return m_threadCount;
+}
+
+bool DuplicateFinder::isRunning() const
+{
+    return m_job.isRunning();
+}
+
+void DuplicateFinder::start(const QStringList &files, const QHash<QString, qint64> &sizes)
+{
+    Q_ASSERT_X(not isRunning(), "Only one search at a time is allowed.", Q_FUNC_INFO);
+
+    m_job.wait();
+
+    m_cancelled = false;
+    m_job.start([this, files, sizes] () {
+        emit finished(find(files, sizes));
+    }, QThread::LowPriority);
+}
+
+void DuplicateFinder::cancel()
+{
+    m_cancelled = true;
+}
+
+bool DuplicateFinder::wasCancelled() const
+{
+    return m_cancelled;
+}
+
+QList<QStringList> DuplicateFinder::find(const QStringList &files, const QHash<QString, qint64> &sizes)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    /* By size first, it's known for most files and it rules out nearly all of them. */
+    QHash<qint64, QList<Candidate>> bySize;
+    QSet<QString> seen;
+    seen.reserve(files.size());
+
+    for (qsizetype i = 0; i < files.size() and not m_cancelled; ++i) {
+        const auto &path = files[i];
+        if (seen.contains(path))
+            continue;
+        seen.insert(path);
+
+        auto size = sizes.value(path, -1);
+        if (size < 0) {
+            QFileInfo info(path);
+            if (not info.isFile())
+                continue;
+            size = info.size();
+        }
+
+        /* Empty files are all alike, but they aren't music either. */
+        if (size > 0)
+            bySize[size].append({path, size, i, {}});
+    }
+
+    QList<QList<Candidate>> groups;
+    for (auto it = bySize.cbegin(); it != bySize.cend(); ++it)
+        if (it->size() > 1)
+            groups << *it;
+    bySize.clear();
+
+    /* Then by their first and last blocks. */
+    QList<Candidate *> candidates;
+    for (auto &group : groups)
+        for (auto &candidate : group)
+            candidates << &candidate;
+
+    forEach(candidates.size(), [this, &candidates] (qsizetype i) {
+        candidates[i]->hash = partialHash(candidates[i]->path, candidates[i]->size);
+    });
+    const auto partiallyHashed = candidates.size();
+    groups = regroup(groups);
+
+    /* Files no bigger than both blocks were hashed whole already, read the rest in full. */
+    candidates.clear();
+    m_totalBytes = 0;
+    m_hashedBytes = 0;
+    for (auto &group : groups) {
+        if (group.first().size <= 2 * partialBlockSize)
+            continue;
+
+        for (auto &candidate : group) {
+            candidates << &candidate;
+            m_totalBytes += candidate.size;
+        }
+    }
+
+    /* Biggest first so no thread is left reading a huge file on its own at the end. */
+    std::sort(candidates.begin(), candidates.end(), [] (const Candidate *first, const Candidate *second) {
+        return first->size > second->size;
+    });
+
+    emit progress(0, m_totalBytes);
+    forEach(candidates.size(), [this, &candidates] (qsizetype i) {
+        candidates[i]->hash = fullHash(candidates[i]->path);
+    });
+    groups = regroup(groups);
+
+    if (m_cancelled) {
+        qInfo().noquote() << tr("Duplicate search cancelled after %1 ms.").arg(timer.elapsed());
+        return {};
+    }
+
+    /* Keep the order files were given in, within and across groups. */
+    for (auto &group : groups) {
+        std::sort(group.begin(), group.end(), [] (const Candidate &first, const Candidate &second) {
+            return first.index < second.index;
+        });
+    }
+
+    std::sort(groups.begin(), groups.end(), [] (const QList<Candidate> &first, const QList<Candidate> &second) {
+        return first.first().index < second.first().index;
+    });
+
+    QList<QStringList> duplicates;
+    duplicates.reserve(groups.size());
+    for (const auto &group : std::as_const(groups)) {
+        QStringList paths;
+        for (const auto &candidate : group)
+            paths << candidate.path;
+        duplicates << paths;
+    }
+
+    qInfo().noquote() << tr("Found %1 groups of identical files among %2 files in %3 ms. "
+                            "%4 files were partially hashed and %5 hashed in full (%6 MiB).")
+                             .arg(duplicates.size())
+                             .arg(seen.size())
+                             .arg(timer.elapsed())
+                             .arg(partiallyHashed)
+                             .arg(candidates.size())
+                             .arg(m_totalBytes / (1024 * 1024));
+
+    return duplicates;
+}
+
+void DuplicateFinder::forEach(qsizetype count, const std::function<void (qsizetype)> &function) const
+{
+    std::atomic<qsizetype> next {0};
+    auto work = [this, count, &next, &function] () {
+        for (auto i = next++; i < count and not m_cancelled; i = next++)
+            function(i);
+    };
+
+    const auto threadCount = static_cast<int>(qMin<qsizetype>(m_threadCount, count));
+    BackgroundJob::runParallel(threadCount, [&work] (int) { work(); }, QThread::LowPriority);
+}
+
+QList<QList<DuplicateFinder::Candidate>> DuplicateFinder::regroup(const QList<QList<Candidate>> &groups) const
+{
+    QList<QList<Candidate>> regrouped;
+
+    for (const auto &group : groups) {
+        QHash<QByteArray, QList<Candidate>> byHash;
+        for (const auto &candidate : group) {
+            /* Couldn't be read, it can't be told apart from anything. */
+            if (not candidate.hash.isEmpty())
+                byHash[candidate.hash].append(candidate);
+        }
+
+        for (auto it = byHash.cbegin(); it != byHash.cend(); ++it)
+            if (it->size() > 1)
+                regrouped << *it;
+    }
+
+    return regrouped;
+}
+
+QByteArray DuplicateFinder::partialHash(const QString &path, qint64 size) const
+{
+    QFile file(path);
+    if (not file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return {};
+
+    QCryptographicHash hash(algorithm);
+    if (size <= 2 * partialBlockSize) {
+        hash.addData(file.readAll());
+    } else {
+        hash.addData(file.read(partialBlockSize));
+        if (not file.seek(size - partialBlockSize))
+            return {};
+        hash.addData(file.read(partialBlockSize));
+    }
+
+    if (file.error() != QFileDevice::NoError)
+        return {};
+
+    return hash.result();
+}
+
+QByteArray DuplicateFinder::fullHash(const QString &path)
+{
+    QFile file(path);
+    if (not file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return {};
+
+#ifdef Q_OS_LINUX
+    /* Lets the kernel read ahead aggressively, we won't ever seek back. */
+    ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    QCryptographicHash hash(algorithm);
+    QByteArray buffer(readSize, Qt::Uninitialized);
+    bool ok {true};
+
+    while (not m_cancelled) {
+        const auto length = file.read(buffer.data(), buffer.size());
+        if (length < 0) {
+            ok = false;
+            break;
+        }
+
+        if (length == 0)
+            break;
+
+        hash.addData(QByteArrayView(buffer.constData(), length));
+
+        const auto before = m_hashedBytes.fetch_add(length);
+        if (before / progressStep != (before + length) / progressStep)
+            emit progress(before + length, m_totalBytes);
+    }
+
+#ifdef Q_OS_LINUX
+    /* Whatever the user is listening to matters more than files we read just once. */
+    ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+
+    if (not ok or m_cancelled)
+        return {};
+
+    return hash.result();
+}
@@ -0,0 +1,63 @@
+#ifndef DUPLICATEFINDER_HPP
+#define DUPLICATEFINDER_HPP
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+#include <functional>
+
+#include "backgroundjob.hpp"
+
+/* Finds byte identical files. Most files are ruled out by their size alone, files
+ * sharing a size are told apart by hashing their first and last blocks and only those
+ * still alike are hashed in full, several at a time and read front to back. */
+class DuplicateFinder : public QObject
+{
+    Q_OBJECT
+
+    struct Candidate
+    {
+        QString path;
+        qint64 size;
+        /* Where it was in the list given to start(), groups keep that order. */
+        qsizetype index;
+        QByteArray hash;
+    };
+
+    QList<QStringList> find(const QStringList &files, const QHash<QString, qint64> &sizes);
+    void forEach(qsizetype count, const std::function<void (qsizetype)> &function) const;
+    QList<QList<Candidate>> regroup(const QList<QList<Candidate>> &groups) const;
+    QByteArray partialHash(const QString &path, qint64 size) const;
+    QByteArray fullHash(const QString &path);
+
+public:
+    explicit DuplicateFinder(QObject *parent = nullptr);
+    ~DuplicateFinder();
+    void setThreadCount(int count);
+    int threadCount() const;
+    bool isRunning() const;
+    /* Looks for copies among files in the background. sizes may hold those already
+     * known, e.g. by Library, the rest are stat'ed. finished() is emitted when done. */
+    void start(const QStringList &files, const QHash<QString, qint64> &sizes = {});
+    /* finished() is still emitted, with no groups. Safe to call from any thread. */
+    void cancel();
+    bool wasCancelled() const;
+
+signals:
+    /* Bytes read so far out of those that have to be hashed in full. */
+    void progress(qint64 bytes, qint64 total);
+    /* Every group holds two or more files with the same contents. */
+    void finished(const QList<QStringList> &groups);
+
+private:
+    int m_threadCount;
+    BackgroundJob m_job;
+    std::atomic<bool> m_cancelled;
+    std::atomic<qint64> m_hashedBytes;
+    qint64 m_totalBytes;
+};
+
+#endif // DUPLICATEFINDER_HPP
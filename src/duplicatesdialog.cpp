@@ -0,0 +1,150 @@
+#include "duplicatesdialog.hpp"
+#include "ui_duplicatesdialog.h"
+
+#include <QFileInfo>
+#include <QLocale>
+
+DuplicatesDialog::DuplicatesDialog(const QList<QStringList> &groups,
+                                   const Playlist &playlist,
+                                   const QString &keep,
+                                   KIND kind,
+                                   QWidget *parent)
+    : QDialog(parent)
+    , m_ui(new Ui::DuplicatesDialog)
+    , m_playlist {playlist}
+    , m_keep {keep}
+    , m_kind {kind}
+{
+    m_ui->setupUi(this);
+    if (m_kind == KIND::SAME_RECORDING)
+        setWindowTitle(tr("Same Recordings"));
+
+    m_removeButton = m_ui->buttonBox->addButton(tr("Remove from playlist"), QDialogButtonBox::AcceptRole);
+    m_removeButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::EditDelete));
+
+    configureTree();
+    populate(groups);
+
+    connect(m_ui->treeWidget, &QTreeWidget::itemChanged, this, &DuplicatesDialog::onItemChanged);
+    connect(m_ui->buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(m_ui->buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+DuplicatesDialog::~DuplicatesDialog()
+{
+    delete m_ui;
+}
+
+QStringList DuplicatesDialog::checkedFiles() const
+{
+    QStringList files;
+    for (int i = 0; i < m_ui->treeWidget->topLevelItemCount(); ++i) {
+        const auto *group = m_ui->treeWidget->topLevelItem(i);
+        for (int j = 0; j < group->childCount(); ++j) {
+            const auto *item = group->child(j);
+            if (item->checkState(0) == Qt::Checked)
+                files << item->data(0, Qt::UserRole).toString();
+        }
+    }
+
+    return files;
+}
+
+void DuplicatesDialog::onItemChanged(QTreeWidgetItem *item, int column)
+{
+    if (column != 0 or item->parent() == nullptr)
+        return;
+
+    updateRemoveButton();
+}
+
+void DuplicatesDialog::updateRemoveButton()
+{
+    const auto checked = checkedFiles().size();
+    m_removeButton->setEnabled(checked > 0);
+    m_removeButton->setText(tr("Remove %n from playlist", nullptr, static_cast<int>(checked)));
+}
+
+void DuplicatesDialog::configureTree()
+{
+    m_ui->treeWidget->setColumnCount(2);
+    m_ui->treeWidget->setHeaderLabels({tr("File"), tr("Size")});
+    m_ui->treeWidget->setSelectionMode(QAbstractItemView::NoSelection);
+    m_ui->treeWidget->setEditTriggers(QTreeWidget::NoEditTriggers);
+    m_ui->treeWidget->setUniformRowHeights(true);
+}
+
+void DuplicatesDialog::populate(const QList<QStringList> &groups)
+{
+    const QLocale locale;
+    QList<QTreeWidgetItem *> items;
+    items.reserve(groups.size());
+
+    for (const auto &paths : groups) {
+        const auto count = static_cast<int>(paths.size());
+        auto *group = new QTreeWidgetItem(QStringList {
+            m_kind == KIND::IDENTICAL
+                ? tr("%n identical files", nullptr, count)
+                : tr("%n copies of the same recording", nullptr, count)
+        });
+
+        /* Identical files, one of them tells the size of all. */
+        if (m_kind == KIND::IDENTICAL)
+            group->setText(1, locale.formattedDataSize(QFileInfo(paths.first()).size()));
+
+        /* Leave one copy in the playlist: the one to keep if it's here, the first one otherwise. */
+        QString kept;
+        if (paths.contains(m_keep) and m_playlist.contains(m_keep)) {
+            kept = m_keep;
+        } else {
+            for (const auto &path : paths) {
+                if (m_playlist.contains(path)) {
+                    kept = path;
+                    break;
+                }
+            }
+        }
+
+        for (const auto &path : paths) {
+            auto *item = new QTreeWidgetItem(group, {path});
+            item->setData(0, Qt::UserRole, path);
+            /* Re-encodes differ in size, that's how the user tells the better copy. */
+            if (m_kind == KIND::SAME_RECORDING)
+                item->setText(1, locale.formattedDataSize(QFileInfo(path).size()));
+
+            if (not m_playlist.contains(path)) {
+                item->setFlags(item->flags() & ~Qt::ItemIsEnabled);
+                item->setToolTip(0, tr("Not in the current playlist."));
+            } else if (path == kept) {
+                item->setCheckState(0, Qt::Unchecked);
+                item->setToolTip(0, tr("This copy is kept."));
+            } else {
+                item->setCheckState(0, Qt::Checked);
+            }
+        }
+
+        items << group;
+    }
+
+    m_ui->treeWidget->addTopLevelItems(items);
+    m_ui->treeWidget->expandAll();
+    m_ui->treeWidget->resizeColumnToContents(1);
+
+    const auto count = static_cast<int>(groups.size());
+    QString found;
+    if (m_kind == KIND::IDENTICAL)
+        found = groups.isEmpty()
+                    ? tr("No identical files were found.")
+                    : tr("Found %n groups of identical files.", nullptr, count);
+    else
+        found = groups.isEmpty()
+                    ? tr("No recording was found more than once.")
+                    : tr("Found %n recordings stored more than once.", nullptr, count);
+
+    if (not groups.isEmpty())
+        found += ' ' + tr("Checked copies will be removed from the current playlist, files on disk aren't touched.");
+
+    m_ui->label->setText(found);
+
+    updateRemoveButton();
+}
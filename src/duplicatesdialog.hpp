@@ -0,0 +1,53 @@
+#ifndef DUPLICATESDIALOG_HPP
+#define DUPLICATESDIALOG_HPP
+
+#include <QDialog>
+#include <QPushButton>
+#include <QStringList>
+#include <QTreeWidgetItem>
+
+#include "playlist.hpp"
+
+namespace Ui {
+class DuplicatesDialog;
+}
+
+/* Lists groups of identical files, or of files holding the same recording. Copies in the current playlist can be checked
+ * and removed from it all at once, the others are shown just so the user knows. */
+class DuplicatesDialog : public QDialog
+{
+    Q_OBJECT
+
+    void configureTree();
+    void populate(const QList<QStringList> &groups);
+    void updateRemoveButton();
+
+public:
+    enum class KIND {
+        /* Byte for byte, see DuplicateFinder. */
+        IDENTICAL = 0,
+        /* Sound the same but may be encoded differently, see SimilarityIndex. */
+        SAME_RECORDING
+    };
+
+    /* keep is the copy to leave unchecked when it's in a group, e.g. the one playing. */
+    explicit DuplicatesDialog(const QList<QStringList> &groups,
+                              const Playlist &playlist,
+                              const QString &keep = {},
+                              KIND kind = KIND::IDENTICAL,
+                              QWidget *parent = nullptr);
+    ~DuplicatesDialog();
+    QStringList checkedFiles() const;
+
+private slots:
+    void onItemChanged(QTreeWidgetItem *item, int column);
+
+private:
+    Ui::DuplicatesDialog *m_ui;
+    Playlist m_playlist;
+    QString m_keep;
+    KIND m_kind;
+    QPushButton *m_removeButton;
+};
+
+#endif // DUPLICATESDIALOG_HPP
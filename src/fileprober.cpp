@@ -0,0 +1,386 @@
+#include "fileprober.hpp"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <cstring>
+
+#include "mediaformats.hpp"
+#include "mpegaudio.hpp"
+
+namespace {
+constexpr int deliveryInterval = 100;
+/* Probing is a few small reads per file, the more of them in flight the closer
+ * the disk gets to its bandwidth. */
+constexpr int maximumThreads = 16;
+/* How much of the beginning, past any ID3v2 tag, is searched for the first frames. */
+constexpr qint64 headSize = 16 * 1024;
+/* An Ogg page is at most 65307 bytes long, so the last one always starts in here. */
+constexpr qint64 tailSize = 64 * 1024 + 1024;
+/* Chunks, boxes or metadata blocks walked before giving the file the benefit of the doubt. */
+constexpr int maximumBlocks = 1024;
+
+/* Length of the ADTS frame whose header is at data, 0 if it isn't one. */
+qint64 adtsFrameLength(const char *data)
+{
+    const auto *header = reinterpret_cast<const uchar *>(data);
+    if (header[0] != 0xFF or (header[1] & 0xF6) != 0xF0)
+        return 0;
+
+    const qint64 length = (qint64(header[3] & 0x03) << 11) | (qint64(header[4]) << 3) | (header[5] >> 5);
+    return length >= 7 ? length : 0;
+}
+
+/* A file opened for probing with its beginning already read. */
+class Source
+{
+public:
+    QFile file;
+    qint64 size {};
+    QByteArray head;
+    qint64 headOffset {};
+
+    /* Copies length bytes at offset from head if they're there, from the file otherwise. */
+    bool read(qint64 offset, char *data, qint64 length)
+    {
+        if (offset < 0 or offset + length > size)
+            return false;
+
+        if (offset >= headOffset and offset + length <= headOffset + head.size()) {
+            std::memcpy(data, head.constData() + (offset - headOffset), length);
+            return true;
+        }
+
+        return file.seek(offset) and file.read(data, length) == length;
+    }
+};
+
+/* Two frames in a row somewhere in head tell a stream from random bytes that happen to
+ * look like a frame header. */
+template <typename FrameLength>
+bool findFrames(const Source &source, qint64 from, FrameLength frameLength)
+{
+    const auto &head = source.head;
+    for (qint64 i = from; i + 6 <= head.size(); ++i) {
+        const auto length = frameLength(head.constData() + i);
+        if (length == 0)
+            continue;
+
+        const auto next = i + length;
+        if (next + 6 <= head.size()) {
+            if (frameLength(head.constData() + next) > 0)
+                return true;
+        } else if (source.headOffset + next <= source.size) {
+            /* Its follower, if any, lies past what was read, one frame will have to do. */
+            return true;
+        }
+    }
+
+    return false;
+}
+
+FileProber::VERDICT checkFlac(Source &source, qint64 start)
+{
+    auto position = start + 4;
+    for (int i = 0; i < maximumBlocks; ++i) {
+        char header[4];
+        if (not source.read(position, header, sizeof(header)))
+            return FileProber::VERDICT::TRUNCATED;
+
+        const bool last = header[0] & 0x80;
+        position += 4 + (qFromBigEndian<quint32>(header) & 0x00FF'FFFF);
+        if (position > source.size)
+            return FileProber::VERDICT::TRUNCATED;
+
+        if (last) {
+            char sync[2];
+            if (not source.read(position, sync, sizeof(sync)))
+                return FileProber::VERDICT::NO_FRAMES;
+
+            const bool frame = uchar(sync[0]) == 0xFF and (uchar(sync[1]) & 0xFE) == 0xF8;
+            return frame ? FileProber::VERDICT::OK : FileProber::VERDICT::NO_FRAMES;
+        }
+    }
+
+    return FileProber::VERDICT::OK;
+}
+
+FileProber::VERDICT checkOgg(Source &source)
+{
+    const auto length = qMin(source.size, tailSize);
+    QByteArray tail(length, Qt::Uninitialized);
+    if (not source.read(source.size - length, tail.data(), length))
+        return FileProber::VERDICT::UNREADABLE;
+
+    /* "OggS" may turn up inside a packet too, so look for a page that ends right where the file does. */
+    for (auto page = tail.lastIndexOf("OggS"); page >= 0; page = page > 0 ? tail.lastIndexOf("OggS", page - 1) : -1) {
+        if (page + 27 > tail.size() or tail[page + 4] != 0)
+            continue;
+
+        const int segments = uchar(tail[page + 26]);
+        if (page + 27 + segments > tail.size())
+            continue;
+
+        qint64 end = page + 27 + segments;
+        for (int i = 0; i < segments; ++i)
+            end += uchar(tail[page + 27 + i]);
+
+        if (end == tail.size())
+            return FileProber::VERDICT::OK;
+    }
+
+    return FileProber::VERDICT::TRUNCATED;
+}
+
+FileProber::VERDICT checkRiff(Source &source, qint64 start, QMediaFormat::FileFormat format)
+{
+    char header[12];
+    if (not source.read(start, header, sizeof(header)))
+        return FileProber::VERDICT::TRUNCATED;
+
+    if (format == QMediaFormat::AVI) {
+        /* Writers that don't know the size yet leave it at zero or all ones. */
+        const auto riffSize = qFromLittleEndian<quint32>(header + 4);
+        if (riffSize != 0 and riffSize != 0xFFFF'FFFF and start + 8 + riffSize > source.size)
+            return FileProber::VERDICT::TRUNCATED;
+        return FileProber::VERDICT::OK;
+    }
+
+    auto position = start + 12;
+    for (int i = 0; i < maximumBlocks and position < source.size; ++i) {
+        char chunk[8];
+        if (not source.read(position, chunk, sizeof(chunk)))
+            return FileProber::VERDICT::TRUNCATED;
+
+        const auto chunkSize = qFromLittleEndian<quint32>(chunk + 4);
+        if (std::memcmp(chunk, "data", 4) == 0) {
+            if (chunkSize != 0 and chunkSize != 0xFFFF'FFFF and position + 8 + chunkSize > source.size)
+                return FileProber::VERDICT::TRUNCATED;
+            return FileProber::VERDICT::OK;
+        }
+
+        position += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    return FileProber::VERDICT::NO_FRAMES;
+}
+
+FileProber::VERDICT checkIsoMedia(Source &source, qint64 start)
+{
+    /* An interrupted recording is mostly missing its index, which goes at the end. */
+    bool haveIndex {};
+    auto position = start;
+    for (int i = 0; i < maximumBlocks and position < source.size; ++i) {
+        char header[16];
+        if (not source.read(position, header, 8))
+            return FileProber::VERDICT::TRUNCATED;
+
+        qint64 boxSize = qFromBigEndian<quint32>(header);
+        if (boxSize == 1) {
+            if (not source.read(position + 8, header + 8, 8))
+                return FileProber::VERDICT::TRUNCATED;
+            boxSize = qint64(qFromBigEndian<quint32>(header + 8)) << 32 | qFromBigEndian<quint32>(header + 12);
+        } else if (boxSize == 0) {
+            boxSize = source.size - position;
+        }
+
+        if (boxSize < 8)
+            return FileProber::VERDICT::UNRECOGNIZED;
+        if (position + boxSize > source.size)
+            return FileProber::VERDICT::TRUNCATED;
+
+        if (std::memcmp(header + 4, "moov", 4) == 0)
+            haveIndex = true;
+
+        position += boxSize;
+    }
+
+    return haveIndex or position < source.size ? FileProber::VERDICT::OK : FileProber::VERDICT::TRUNCATED;
+}
+} // namespace
+
+FileProber::FileProber(QObject *parent)
+    : QObject {parent}
+    , m_probing {0}
+    , m_generation {0}
+    , m_stopping {false}
+{
+    m_deliveryTimer.setInterval(deliveryInterval);
+    connect(&m_deliveryTimer, &QTimer::timeout, this, &FileProber::deliver);
+
+    /* Low priority so they never get in the way of decoding what's playing. */
+    const int count = qBound(2, QThread::idealThreadCount(), maximumThreads);
+    for (int i = 0; i < count; ++i) {
+        auto *thread = QThread::create([this] () { work(); });
+        thread->start(QThread::LowPriority);
+        m_threads << thread;
+    }
+}
+
+FileProber::~FileProber()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_condition.wakeAll();
+    }
+
+    for (auto *thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void FileProber::probe(const QStringList &paths)
+{
+    if (paths.isEmpty())
+        return;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.insert(m_queue.end(), paths.cbegin(), paths.cend());
+        m_condition.wakeAll();
+    }
+
+    if (not m_deliveryTimer.isActive())
+        m_deliveryTimer.start();
+}
+
+void FileProber::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    m_results.clear();
+    ++m_generation;
+}
+
+void FileProber::work()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (;;) {
+        while (not m_stopping and m_queue.empty())
+            m_condition.wait(&m_mutex);
+
+        if (m_stopping)
+            return;
+
+        const auto path = std::move(m_queue.front());
+        m_queue.pop_front();
+        const auto generation = m_generation;
+        ++m_probing;
+
+        locker.unlock();
+        const Result result {path, check(path)};
+        locker.relock();
+
+        --m_probing;
+        if (generation == m_generation)
+            m_results << result;
+    }
+}
+
+void FileProber::deliver()
+{
+    QList<Result> results;
+    bool done {};
+    {
+        QMutexLocker locker(&m_mutex);
+        results.swap(m_results);
+        done = m_queue.empty() and m_probing == 0;
+    }
+
+    if (not results.isEmpty())
+        emit probed(results);
+
+    if (done) {
+        m_deliveryTimer.stop();
+        emit idle();
+    }
+}
+
+FileProber::VERDICT FileProber::check(const QString &path)
+{
+    Source source;
+    source.file.setFileName(path);
+    if (not source.file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+        return VERDICT::UNREADABLE;
+
+    source.size = source.file.size();
+    if (source.size == 0)
+        return VERDICT::EMPTY;
+
+    source.head = source.file.read(headSize);
+    if (source.head.isEmpty())
+        return VERDICT::UNREADABLE;
+
+    /* Any format may come after an ID3v2 tag, and the tag may hold pictures bigger than head. */
+    const auto start = MpegAudio::id3v2Size(reinterpret_cast<const uchar *>(source.head.constData()), source.head.size());
+    if (start > 0) {
+        if (start >= source.size)
+            return VERDICT::TRUNCATED;
+
+        if (start + MediaFormats::headerSize > source.head.size()) {
+            if (not source.file.seek(start))
+                return VERDICT::UNREADABLE;
+
+            source.head = source.file.read(headSize);
+            source.headOffset = start;
+        }
+    }
+
+    const auto from = start - source.headOffset;
+    const auto format = MediaFormats::fromHeader(source.head.constData() + from, source.head.size() - from);
+    if (format != QMediaFormat::UnspecifiedFormat and not MediaFormats::instance().isSupported(format))
+        return VERDICT::UNSUPPORTED;
+
+    switch (format) {
+    case QMediaFormat::UnspecifiedFormat:
+        /* Some MP3 files start with a bit of junk before their first frame. */
+        if (findFrames(source, from, MpegAudio::frameSize))
+            return VERDICT::OK;
+        return VERDICT::UNRECOGNIZED;
+    case QMediaFormat::MP3:
+        return findFrames(source, from, MpegAudio::frameSize) ? VERDICT::OK : VERDICT::NO_FRAMES;
+    case QMediaFormat::AAC:
+        if (source.head.mid(from).startsWith("ADIF"))
+            return VERDICT::OK;
+        return findFrames(source, from, adtsFrameLength) ? VERDICT::OK : VERDICT::NO_FRAMES;
+    case QMediaFormat::FLAC:
+        return checkFlac(source, start);
+    case QMediaFormat::Ogg:
+        return checkOgg(source);
+    case QMediaFormat::Wave:
+    case QMediaFormat::AVI:
+        return checkRiff(source, start, format);
+    case QMediaFormat::MPEG4:
+    case QMediaFormat::Mpeg4Audio:
+    case QMediaFormat::QuickTime:
+        return checkIsoMedia(source, start);
+    default:
+        /* Matroska and ASF files don't tell their length cheaply, a sane header is all we check. */
+        return VERDICT::OK;
+    }
+}
+
+QString FileProber::describe(VERDICT verdict)
+{
+    switch (verdict) {
+    case VERDICT::OK:
+        break;
+    case VERDICT::UNREADABLE:
+        return tr("The file is missing or can't be read.");
+    case VERDICT::EMPTY:
+        return tr("The file is empty.");
+    case VERDICT::UNRECOGNIZED:
+        return tr("The file doesn't look like audio or video.");
+    case VERDICT::UNSUPPORTED:
+        return tr("The file's format can't be played here.");
+    case VERDICT::NO_FRAMES:
+        return tr("The file has a header but no audio after it.");
+    case VERDICT::TRUNCATED:
+        return tr("The file is truncated.");
+    }
+
+    return {};
+}
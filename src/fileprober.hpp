@@ -0,0 +1,77 @@
+#ifndef FILEPROBER_HPP
+#define FILEPROBER_HPP
+
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QWaitCondition>
+#include <deque>
+
+/* Checks files are what they claim to be before they're played, so a broken one is
+ * skipped instead of failing in the middle of a listening session. Only a few reads per
+ * file: the header, that frames are where the header says they start and, for formats
+ * that make it cheap, that the file ends where it should. Several threads probe at once
+ * so a big import keeps the disk busy, results are handed over in batches from the GUI
+ * thread. */
+class FileProber : public QObject
+{
+    Q_OBJECT
+
+    void work();
+
+public:
+    enum class VERDICT {
+        OK = 0,
+        /* Missing or not readable. */
+        UNREADABLE,
+        EMPTY,
+        /* Nothing we know of, e.g. zeros or some other kind of file. */
+        UNRECOGNIZED,
+        /* A format the backend can't decode. */
+        UNSUPPORTED,
+        /* The header is fine but no frame follows it. */
+        NO_FRAMES,
+        /* It ends before its header says it should. */
+        TRUNCATED
+    };
+
+    struct Result
+    {
+        QString path;
+        VERDICT verdict;
+    };
+
+    explicit FileProber(QObject *parent = nullptr);
+    ~FileProber();
+    void probe(const QStringList &paths);
+    /* Drops whatever is queued or not delivered yet. */
+    void clear();
+    /* Does the actual checks, blocking. */
+    static VERDICT check(const QString &path);
+    static QString describe(VERDICT verdict);
+
+signals:
+    void probed(const QList<FileProber::Result> &results);
+    /* Nothing left to probe nor to deliver. */
+    void idle();
+
+private slots:
+    void deliver();
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    std::deque<QString> m_queue;
+    QList<Result> m_results;
+    qsizetype m_probing;
+    /* Bumped by clear() so results of files probed before it are thrown away. */
+    quint64 m_generation;
+    bool m_stopping;
+    QTimer m_deliveryTimer;
+    QList<QThread *> m_threads;
+};
+
+#endif // FILEPROBER_HPP
@@ -0,0 +1,338 @@
+#include "filevalidator.hpp"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <memory>
+#include <vector>
+#ifdef Q_OS_LINUX
+    #include <cerrno>
+    #include <cstring>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #if __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+        #define HAVE_IO_URING
+    #endif
+#endif
+
+namespace {
+/* Enough requests in flight to hide the latency of a network filesystem. */
+constexpr unsigned ringEntries = 4'096;
+/* Threads mostly wait on the filesystem too, so there can be many more than cores. */
+constexpr int maximumThreads = 32;
+
+#ifdef HAVE_IO_URING
+/* Just enough of io_uring to batch statx calls, no liburing needed. */
+class Ring
+{
+    int m_fd {-1};
+    void *m_sq {nullptr};
+    void *m_cq {nullptr};
+    std::size_t m_sqSize {};
+    std::size_t m_cqSize {};
+    io_uring_sqe *m_sqes {nullptr};
+    std::size_t m_sqesSize {};
+    unsigned m_entries {};
+    unsigned *m_sqHead {};
+    unsigned *m_sqTail {};
+    unsigned *m_sqMask {};
+    unsigned *m_sqArray {};
+    unsigned *m_cqHead {};
+    unsigned *m_cqTail {};
+    unsigned *m_cqMask {};
+    io_uring_cqe *m_cqes {};
+
+    static void *map(int fd, std::size_t size, off_t offset)
+    {
+        auto *address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+
+public:
+    explicit Ring(unsigned entries)
+    {
+        io_uring_params params {};
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0)
+            return;
+
+        m_sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap)
+            m_sqSize = m_cqSize = qMax(m_sqSize, m_cqSize);
+
+        m_sq = map(m_fd, m_sqSize, IORING_OFF_SQ_RING);
+        m_cq = singleMap ? m_sq : map(m_fd, m_cqSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe *>(map(m_fd, m_sqesSize, IORING_OFF_SQES));
+        if (not m_sq or not m_cq or not m_sqes)
+            return;
+
+        auto *sq = static_cast<char *>(m_sq);
+        m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        m_sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+        auto *cq = static_cast<char *>(m_cq);
+        m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        m_entries = params.sq_entries;
+    }
+
+    ~Ring()
+    {
+        if (m_sqes)
+            ::munmap(m_sqes, m_sqesSize);
+        if (m_cq and m_cq != m_sq)
+            ::munmap(m_cq, m_cqSize);
+        if (m_sq)
+            ::munmap(m_sq, m_sqSize);
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    bool isValid() const { return m_entries > 0; }
+    unsigned entries() const { return m_entries; }
+
+    /* Queues a statx of path into status, false if the ring is full. Nothing
+     * reaches the kernel until enter(). Both must outlive the request. */
+    bool queueStatx(const char *path, struct statx *status, quint64 userData)
+    {
+        const auto tail = *m_sqTail;
+        if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_entries)
+            return false;
+
+        const auto index = tail & *m_sqMask;
+        auto &entry = m_sqes[index];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_STATX;
+        entry.fd = AT_FDCWD;
+        entry.addr = reinterpret_cast<quint64>(path);
+        entry.len = STATX_TYPE;
+        entry.off = reinterpret_cast<quint64>(status);
+        entry.user_data = userData;
+        m_sqArray[index] = index;
+
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    /* Submits what's queued and waits for at least one completion. Returns how many
+     * were submitted, or -1 and errno like the syscall. */
+    int enter(unsigned toSubmit)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, m_fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+    }
+
+    /* Calls done(userData, result) for every completed request. */
+    template <typename Done>
+    void reap(Done done)
+    {
+        auto head = *m_cqHead;
+        const auto tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const auto &completion = m_cqes[head & *m_cqMask];
+            done(completion.user_data, completion.res);
+        }
+
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    }
+};
+#endif // HAVE_IO_URING
+} // namespace
+
+FileValidator::FileValidator(QObject *parent)
+    : QObject {parent}
+#ifdef Q_OS_LINUX
+    , m_backend {BACKEND::NATIVE}
+#else
+    , m_backend {BACKEND::GENERIC}
+#endif
+    , m_cancelled {false}
+{
+}
+
+FileValidator::~FileValidator()
+{
+    m_cancelled = true;
+    m_job.wait();
+}
+
+void FileValidator::setBackend(BACKEND backend)
+{
+#ifdef Q_OS_LINUX
+    m_backend = backend;
+#else
+    Q_UNUSED(backend);
+    m_backend = BACKEND::GENERIC;
+#endif
+}
+
+FileValidator::BACKEND FileValidator::backend() const
+{
+    return m_backend;
+}
+
+bool FileValidator::isRunning() const
+{
+    return m_job.isRunning();
+}
+
+void FileValidator::start(const QStringList &paths)
+{
+    m_cancelled = true;
+    m_job.wait();
+
+    m_cancelled = false;
+    m_job.start([this, paths] () {
+        const auto missing = validate(paths);
+        if (not m_cancelled)
+            emit finished(missing);
+    });
+}
+
+QStringList FileValidator::missing(const QStringList &paths)
+{
+    m_cancelled = false;
+    return validate(paths);
+}
+
+void FileValidator::cancel()
+{
+    m_cancelled = true;
+}
+
+QStringList FileValidator::validate(const QStringList &paths)
+{
+    QList<STATE> states(paths.size(), STATE::UNKNOWN);
+#ifdef Q_OS_LINUX
+    if (m_backend == BACKEND::NATIVE)
+        validateWithRing(paths, states);
+#endif
+    validateWithThreads(paths, states);
+
+    QStringList missing;
+    for (qsizetype i = 0; i < paths.size(); ++i) {
+        if (states[i] == STATE::MISSING)
+            missing << paths[i];
+    }
+
+    return missing;
+}
+
+void FileValidator::validateWithThreads(const QStringList &paths, QList<STATE> &states) const
+{
+    qsizetype unknown {};
+    for (const auto state : std::as_const(states))
+        unknown += state == STATE::UNKNOWN;
+
+    if (unknown == 0)
+        return;
+
+    /* Detached once here so the workers may write their own elements without locking. */
+    auto *data = states.data();
+    std::atomic<qsizetype> next {0};
+    const auto work = [this, &paths, data, &next] () {
+        for (auto i = next++; i < paths.size() and not m_cancelled; i = next++) {
+            if (data[i] == STATE::UNKNOWN)
+                data[i] = QFileInfo::exists(paths[i]) ? STATE::PRESENT : STATE::MISSING;
+        }
+    };
+
+    const auto count = static_cast<int>(qMin<qsizetype>(maximumThreads, unknown));
+    BackgroundJob::runParallel(count, [&work] (int) { work(); });
+}
+
+#ifdef Q_OS_LINUX
+bool FileValidator::validateWithRing(const QStringList &paths, QList<STATE> &states) const
+{
+#ifdef HAVE_IO_URING
+    Ring ring(ringEntries);
+    if (not ring.isValid()) {
+        qInfo().noquote() << tr("io_uring isn't available (%1), validating with threads.")
+                                 .arg(QString::fromLocal8Bit(std::strerror(errno)));
+        return false;
+    }
+
+    struct Slot
+    {
+        QByteArray path;
+        struct statx status;
+        qsizetype index;
+    };
+
+    /* Owned by the kernel while their request is in flight. */
+    std::unique_ptr<Slot[]> slots(new Slot[ring.entries()]);
+    std::vector<unsigned> freeSlots;
+    freeSlots.reserve(ring.entries());
+    for (unsigned i = ring.entries(); i > 0; --i)
+        freeSlots.push_back(i - 1);
+
+    qsizetype next {};
+    qsizetype inFlight {};
+    unsigned queued {};
+    bool failed {};
+
+    const auto done = [&] (quint64 slot, int result) {
+        auto &state = states[slots[slot].index];
+        if (result == 0)
+            state = STATE::PRESENT;
+        else if (result == -ENOENT or result == -ENOTDIR)
+            state = STATE::MISSING;
+        else if (result != -EINVAL)
+            state = STATE::PRESENT; // It's there, just not readable, e.g. EACCES.
+        else
+            failed = true; // A kernel too old for statx in a ring, the threads will do the rest.
+
+        freeSlots.push_back(static_cast<unsigned>(slot));
+        --inFlight;
+    };
+
+    while (inFlight > 0 or (next < paths.size() and not m_cancelled and not failed)) {
+        while (next < paths.size() and not freeSlots.empty() and not m_cancelled and not failed) {
+            const auto slot = freeSlots.back();
+            slots[slot].path = QFile::encodeName(paths[next]);
+            slots[slot].index = next;
+            if (not ring.queueStatx(slots[slot].path.constData(), &slots[slot].status, slot))
+                break;
+
+            freeSlots.pop_back();
+            ++next;
+            ++inFlight;
+            ++queued;
+        }
+
+        const auto submitted = ring.enter(queued);
+        if (submitted >= 0) {
+            queued -= static_cast<unsigned>(submitted);
+        } else if (errno != EINTR and errno != EAGAIN and errno != EBUSY) {
+            qWarning().noquote() << tr("io_uring failed (%1), validating the rest with threads.")
+                                        .arg(QString::fromLocal8Bit(std::strerror(errno)));
+            /* Requests already submitted may still write to their slots. */
+            slots.release();
+            return true;
+        }
+
+        ring.reap(done);
+    }
+
+    return true;
+#else
+    Q_UNUSED(paths);
+    Q_UNUSED(states);
+    return false;
+#endif // HAVE_IO_URING
+}
+#endif // Q_OS_LINUX
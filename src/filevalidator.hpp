@@ -0,0 +1,60 @@
+#ifndef FILEVALIDATOR_HPP
+#define FILEVALIDATOR_HPP
+
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+
+#include "backgroundjob.hpp"
+
+/* Tells which of a list of files no longer exist, e.g. the entries of a playlist, without
+ * paying a round trip per file on a network filesystem. On Linux every stat request goes
+ * into one io_uring ring and thousands of them are in flight at once; where io_uring isn't
+ * available (old kernels, sandboxes that forbid it) a pool of threads stats in parallel. */
+class FileValidator : public QObject
+{
+    Q_OBJECT
+
+    enum class STATE : qint8 { UNKNOWN = 0, PRESENT, MISSING };
+
+    QStringList validate(const QStringList &paths);
+    /* Both fill in the states still UNKNOWN. The ring may give up halfway and leave some to the threads. */
+    void validateWithThreads(const QStringList &paths, QList<STATE> &states) const;
+#ifdef Q_OS_LINUX
+    /* False if io_uring couldn't be used at all. */
+    bool validateWithRing(const QStringList &paths, QList<STATE> &states) const;
+#endif
+
+public:
+    enum class BACKEND {
+        /* A pool of threads, available everywhere. */
+        GENERIC = 0,
+        /* Batches requests in an io_uring ring, only Linux, falls back to GENERIC if it can't. */
+        NATIVE
+    };
+
+    explicit FileValidator(QObject *parent = nullptr);
+    ~FileValidator();
+    void setBackend(BACKEND backend);
+    BACKEND backend() const;
+    bool isRunning() const;
+    /* Validates in the background, finished() tells which ones are missing. A validation
+     * already running is cancelled, its results aren't reported. */
+    void start(const QStringList &paths);
+    /* Blocks the calling thread, don't call it from the GUI thread. */
+    QStringList missing(const QStringList &paths);
+    void cancel();
+
+signals:
+    /* In the order they were given. */
+    void finished(const QStringList &missing);
+
+private:
+    BACKEND m_backend;
+    BackgroundJob m_job;
+    std::atomic<bool> m_cancelled;
+};
+
+#endif // FILEVALIDATOR_HPP
@@ -0,0 +1,347 @@
+#include "fingerprinter.hpp"
+
+#include <QAudioBuffer>
+#include <QAudioDecoder>
+#include <QEventLoop>
+#include <QTimer>
+#include <QUrl>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace {
+constexpr int sampleRate = 11025;
+constexpr int frameSize = 4096;
+constexpr int hopSize = frameSize / 2;
+/* From A0 to A7, where nearly all pitched energy of music is. */
+constexpr double minimumFrequency = 27.5;
+constexpr double maximumFrequency = 3520.0;
+/* Enough to tell a recording by, decoding the rest is just time. */
+constexpr qint64 maximumSamples = 120 * sampleRate;
+/* About 47 seconds worth of codes, more don't make a match any surer. */
+constexpr qsizetype maximumCodes = 256;
+/* Under 3 seconds of sound there's nothing to compare. */
+constexpr qsizetype minimumFrames = 16;
+/* A decoder that stopped delivering buffers won't start again. */
+constexpr int stallTimeout = 30'000;
+constexpr float silence = 1e-6f;
+
+using Chroma = std::array<float, 12>;
+
+/* Turns whatever the decoder delivers into chroma frames. */
+class ChromaExtractor
+{
+    std::vector<float> m_window;
+    /* Pitch class of every FFT bin, -1 for those out of range. */
+    std::vector<int> m_pitchClass;
+    std::vector<int> m_reversed;
+    std::vector<std::complex<float>> m_twiddles;
+    std::vector<std::complex<float>> m_spectrum;
+    std::vector<float> m_pending;
+    std::vector<Chroma> m_frames;
+    /* Input samples per output sample, and how far we're into the current one. */
+    double m_step;
+    double m_phase;
+    double m_accumulator;
+    int m_accumulated;
+    qint64 m_samples;
+
+    void push(float sample);
+    void analyzeFrame();
+    void fft();
+
+public:
+    ChromaExtractor();
+    void feed(const QAudioBuffer &buffer);
+    /* Samples fed so far, at sampleRate. */
+    qint64 samples() const { return m_samples; }
+    bool finish(AcousticFingerprint &fingerprint) const;
+};
+
+ChromaExtractor::ChromaExtractor()
+    : m_window(frameSize)
+    , m_pitchClass(frameSize / 2 + 1, -1)
+    , m_reversed(frameSize)
+    , m_twiddles(frameSize / 2)
+    , m_spectrum(frameSize)
+    , m_step {1.0}
+    , m_phase {0.0}
+    , m_accumulator {0.0}
+    , m_accumulated {0}
+    , m_samples {0}
+{
+    const double pi = std::acos(-1.0);
+    for (int i = 0; i < frameSize; ++i)
+        m_window[i] = float(0.5 - 0.5 * std::cos(2.0 * pi * i / (frameSize - 1)));
+
+    for (int bin = 1; bin <= frameSize / 2; ++bin) {
+        const double frequency = double(bin) * sampleRate / frameSize;
+        if (frequency < minimumFrequency or frequency > maximumFrequency)
+            continue;
+
+        /* Semitones above A0, so pitch class 0 is A. */
+        const auto note = qRound(12.0 * std::log2(frequency / minimumFrequency));
+        m_pitchClass[bin] = note % 12;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < frameSize)
+        ++bits;
+
+    for (int i = 0; i < frameSize; ++i) {
+        int reversed = 0;
+        for (int bit = 0; bit < bits; ++bit)
+            if (i & (1 << bit))
+                reversed |= 1 << (bits - 1 - bit);
+        m_reversed[i] = reversed;
+    }
+
+    for (int i = 0; i < frameSize / 2; ++i)
+        m_twiddles[i] = std::polar(1.0f, float(-2.0 * pi * i / frameSize));
+
+    m_pending.reserve(frameSize + hopSize);
+    m_frames.reserve(maximumSamples / hopSize);
+}
+
+void ChromaExtractor::feed(const QAudioBuffer &buffer)
+{
+    const auto format = buffer.format();
+    if (not buffer.isValid() or format.sampleRate() <= 0 or format.channelCount() <= 0)
+        return;
+
+    m_step = double(format.sampleRate()) / sampleRate;
+
+    const auto *data = buffer.constData<char>();
+    const auto channels = format.channelCount();
+    const auto bytesPerSample = format.bytesPerSample();
+    const auto frames = buffer.frameCount();
+
+    for (qsizetype frame = 0; frame < frames and m_samples < maximumSamples; ++frame) {
+        /* Mono is all chroma needs. */
+        float sample {};
+        for (int channel = 0; channel < channels; ++channel)
+            sample += format.normalizedSampleValue(data + (frame * channels + channel) * bytesPerSample);
+
+        /* Averaging every sample that falls into an output sample keeps most of
+         * what's above the new Nyquist frequency from folding back into range. */
+        m_accumulator += sample / channels;
+        ++m_accumulated;
+        m_phase += 1.0;
+        if (m_phase < m_step)
+            continue;
+
+        /* Below 11025 Hz a sample is simply repeated. */
+        const auto average = float(m_accumulator / m_accumulated);
+        while (m_phase >= m_step) {
+            push(average);
+            m_phase -= m_step;
+        }
+
+        m_accumulator = 0.0;
+        m_accumulated = 0;
+    }
+}
+
+void ChromaExtractor::push(float sample)
+{
+    ++m_samples;
+    m_pending.push_back(sample);
+    if (static_cast<int>(m_pending.size()) < frameSize)
+        return;
+
+    analyzeFrame();
+    m_pending.erase(m_pending.begin(), m_pending.begin() + hopSize);
+}
+
+void ChromaExtractor::analyzeFrame()
+{
+    for (int i = 0; i < frameSize; ++i)
+        m_spectrum[m_reversed[i]] = {m_pending[i] * m_window[i], 0.0f};
+
+    fft();
+
+    Chroma chroma {};
+    float total {};
+    for (int bin = 1; bin <= frameSize / 2; ++bin) {
+        if (m_pitchClass[bin] < 0)
+            continue;
+
+        const auto energy = std::norm(m_spectrum[bin]);
+        chroma[m_pitchClass[bin]] += energy;
+        total += energy;
+    }
+
+    /* Leading silence, e.g. encoder padding, would shift every code after it. */
+    if (total < silence and m_frames.empty())
+        return;
+
+    float norm {};
+    for (auto value : chroma)
+        norm += value * value;
+    norm = std::sqrt(norm);
+
+    if (norm > 0.0f)
+        for (auto &value : chroma)
+            value /= norm;
+
+    m_frames.push_back(chroma);
+}
+
+void ChromaExtractor::fft()
+{
+    /* m_spectrum is already in bit reversed order. */
+    for (int size = 2; size <= frameSize; size *= 2) {
+        const int half = size / 2;
+        const int stride = frameSize / size;
+        for (int start = 0; start < frameSize; start += size) {
+            for (int i = 0; i < half; ++i) {
+                const auto odd = m_spectrum[start + i + half] * m_twiddles[i * stride];
+                const auto even = m_spectrum[start + i];
+                m_spectrum[start + i] = even + odd;
+                m_spectrum[start + i + half] = even - odd;
+            }
+        }
+    }
+}
+
+bool ChromaExtractor::finish(AcousticFingerprint &fingerprint) const
+{
+    const auto count = static_cast<qsizetype>(m_frames.size());
+    if (count < minimumFrames)
+        return false;
+
+    /* Codes come from frames averaged with their neighbours, a lossy encoder
+     * shakes single frames a bit but hardly ever three in a row. */
+    std::vector<Chroma> smoothed(count);
+    for (qsizetype i = 0; i < count; ++i) {
+        const auto first = qMax<qsizetype>(0, i - 1);
+        const auto last = qMin<qsizetype>(count - 1, i + 1);
+        for (int pitch = 0; pitch < 12; ++pitch) {
+            float sum {};
+            for (auto j = first; j <= last; ++j)
+                sum += m_frames[j][pitch];
+            smoothed[i][pitch] = sum / float(last - first + 1);
+        }
+    }
+
+    fingerprint.codes.clear();
+    fingerprint.codes.reserve(qMin(count, maximumCodes));
+    for (qsizetype i = 0; i < count and i < maximumCodes; ++i) {
+        const auto &current = smoothed[i];
+        quint16 code {};
+
+        /* Which of every two neighbouring pitch classes is louder... */
+        for (int pitch = 0; pitch < 12; ++pitch)
+            if (current[pitch] > current[(pitch + 1) % 12])
+                code |= quint16(1) << pitch;
+
+        /* ...and which quarters of the octave got louder since the last frame. */
+        for (int quarter = 0; quarter < 4; ++quarter) {
+            float now {}, before {};
+            for (int pitch = quarter * 3; pitch < quarter * 3 + 3; ++pitch) {
+                now += current[pitch];
+                before += i > 0 ? smoothed[i - 1][pitch] : 0.0f;
+            }
+
+            if (now > before)
+                code |= quint16(1) << (12 + quarter);
+        }
+
+        fingerprint.codes << code;
+    }
+
+    Chroma mean {}, deviation {}, movement {};
+    for (qsizetype i = 0; i < count; ++i) {
+        for (int pitch = 0; pitch < 12; ++pitch) {
+            mean[pitch] += m_frames[i][pitch];
+            if (i > 0)
+                movement[pitch] += std::abs(m_frames[i][pitch] - m_frames[i - 1][pitch]);
+        }
+    }
+
+    for (int pitch = 0; pitch < 12; ++pitch) {
+        mean[pitch] /= float(count);
+        movement[pitch] /= float(count - 1);
+    }
+
+    for (qsizetype i = 0; i < count; ++i) {
+        for (int pitch = 0; pitch < 12; ++pitch) {
+            const auto difference = m_frames[i][pitch] - mean[pitch];
+            deviation[pitch] += difference * difference;
+        }
+    }
+
+    fingerprint.profile.clear();
+    fingerprint.profile.reserve(Fingerprinter::profileSize);
+    for (auto value : mean)
+        fingerprint.profile << value;
+    for (auto value : deviation)
+        fingerprint.profile << std::sqrt(value / float(count));
+    for (auto value : movement)
+        fingerprint.profile << value;
+
+    return true;
+}
+} // namespace
+
+bool Fingerprinter::compute(const QString &filename,
+                            AcousticFingerprint &fingerprint,
+                            const std::atomic<bool> *cancelled)
+{
+    QAudioDecoder decoder;
+    if (not decoder.isSupported())
+        return false;
+
+    ChromaExtractor extractor;
+    QEventLoop loop;
+    QTimer stall;
+    qint64 duration {};
+    bool complete {};
+
+    stall.setSingleShot(true);
+    stall.setInterval(stallTimeout);
+    QObject::connect(&stall, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    QObject::connect(&decoder, &QAudioDecoder::bufferReady, &loop, [&] () {
+        while (decoder.bufferAvailable())
+            extractor.feed(decoder.read());
+
+        if (extractor.samples() >= maximumSamples or (cancelled and *cancelled))
+            loop.quit();
+        else
+            stall.start();
+    });
+
+    QObject::connect(&decoder, &QAudioDecoder::durationChanged, &loop, [&duration] (qint64 value) {
+        duration = value;
+    });
+
+    QObject::connect(&decoder, &QAudioDecoder::finished, &loop, [&] () {
+        complete = true;
+        loop.quit();
+    });
+
+    /* Whatever was decoded until then may still be enough. */
+    QObject::connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), &loop, &QEventLoop::quit);
+
+    decoder.setSource(QUrl::fromLocalFile(filename));
+    decoder.start();
+    stall.start();
+    loop.exec();
+    decoder.stop();
+
+    if (cancelled and *cancelled)
+        return false;
+
+    if (not extractor.finish(fingerprint))
+        return false;
+
+    /* Decoded to the end the samples tell better than any header, and
+     * when the decoder couldn't tell at all they're a lower bound. */
+    if (complete or duration <= 0)
+        duration = extractor.samples() * 1'000 / sampleRate;
+
+    fingerprint.duration = duration;
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef FINGERPRINTER_HPP
+#define FINGERPRINTER_HPP
+
+#include <QString>
+#include <atomic>
+
+#include "acousticfingerprint.hpp"
+
+/* Decodes the first two minutes of a file with QAudioDecoder, folds it down to mono at
+ * 11025 Hz and takes the energy of each of the 12 pitch classes every 186 ms (chroma).
+ * The profile sums those frames up, the codes keep how bins compare to their neighbours
+ * frame by frame. Leading silence is skipped so encoder padding doesn't shift them. */
+class Fingerprinter
+{
+public:
+    static constexpr int profileSize = 36;
+    static constexpr int bitsPerCode = 16;
+
+    /* Blocks while the file is decoded, spinning an event loop of its own, so don't call it
+     * from the GUI thread. Returns false if it can't be decoded or it's too short to tell.
+     * cancelled is checked between decoded buffers. Thread safe. */
+    static bool compute(const QString &filename,
+                        AcousticFingerprint &fingerprint,
+                        const std::atomic<bool> *cancelled = nullptr);
+};
+
+#endif // FINGERPRINTER_HPP
@@ -0,0 +1,329 @@
+#include "library.hpp"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QReadLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QWriteLocker>
+#include <algorithm>
+
+#include "settings.hpp"
+
+namespace {
+constexpr quint32 magic = 0x51424D4C; /* QBML */
+constexpr quint32 version = 2;
+/* Had no play counts, still read so they needn't be scanned again. */
+constexpr quint32 firstVersion = 1;
+}
+
+Library::Library(const QString &filename, QObject *parent)
+    : QObject {parent}
+    , DirectoryCache {}
+    , m_filename {filename}
+{
+}
+
+QString Library::defaultLocation()
+{
+    /* createEnvironment() makes sure the directory exists. */
+    auto location = QFileInfo(
+        Settings::createEnvironment(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+    ).absolutePath();
+
+    return QString("%1%2%3").arg(location, QDir::separator(), "library.db");
+}
+
+bool Library::load()
+{
+    QFile file(m_filename);
+    if (not file.exists())
+        return true;
+
+    if (not file.open(QIODevice::ReadOnly)) {
+        emit error(tr("Unable to open the library index: %1.").arg(file.errorString()));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 fileMagic, fileVersion;
+    stream >> fileMagic >> fileVersion;
+    if (fileMagic != magic or fileVersion < firstVersion or fileVersion > version) {
+        qWarning().noquote() << tr("Ignoring library index: %1 written by an incompatible version.")
+                                    .arg(m_filename);
+        return false;
+    }
+
+    QStringList roots;
+    QHash<QString, Folder> folders;
+    QHash<QString, Entry> entries;
+    qint64 count;
+
+    stream >> roots >> count;
+    folders.reserve(count);
+    for (qint64 i = 0; i < count; ++i) {
+        QString path;
+        Folder folder;
+        stream >> path >> folder.modified >> folder.files >> folder.folders;
+        folders.insert(path, folder);
+    }
+
+    stream >> count;
+    entries.reserve(count);
+    for (qint64 i = 0; i < count; ++i) {
+        QString path;
+        Entry entry;
+        stream >> path >> entry.size >> entry.modified >> entry.stale >> entry.info;
+        if (fileVersion > firstVersion)
+            stream >> entry.lastPlayed >> entry.plays;
+        entries.insert(path, entry);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        emit error(tr("The library index: %1 is corrupted, it'll be rebuilt.").arg(m_filename));
+        return false;
+    }
+
+    QWriteLocker locker(&m_lock);
+    m_roots = roots;
+    m_folders = std::move(folders);
+    m_entries = std::move(entries);
+    return true;
+}
+
+bool Library::save() const
+{
+    QReadLocker locker(&m_lock);
+    QSaveFile file(m_filename);
+
+    if (not file.open(QIODevice::WriteOnly)) {
+        qCritical().noquote() << tr("Unable to save the library index: %1.").arg(file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << magic << version << m_roots << qint64(m_folders.size());
+
+    for (auto it = m_folders.cbegin(); it != m_folders.cend(); ++it)
+        stream << it.key() << it->modified << it->files << it->folders;
+
+    stream << qint64(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        stream << it.key() << it->size << it->modified << it->stale << it->info << it->lastPlayed << it->plays;
+
+    if (not file.commit()) {
+        qCritical().noquote() << tr("Unable to save the library index: %1.").arg(file.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+bool Library::containsDirectory(const QString &dir) const
+{
+    QReadLocker locker(&m_lock);
+    return m_folders.contains(dir);
+}
+
+QStringList Library::files(const QString &dir) const
+{
+    QStringList files;
+    {
+        QReadLocker locker(&m_lock);
+        collectFiles(dir, files);
+    }
+
+    std::sort(files.begin(), files.end(), &Scanner::lessThan);
+    return files;
+}
+
+void Library::collectFiles(const QString &path, QStringList &files) const
+{
+    auto it = m_folders.constFind(path);
+    if (it == m_folders.cend())
+        return;
+
+    const auto separator = QDir::separator();
+    for (const auto &file : it->files)
+        files << path + separator + file;
+
+    for (const auto &folder : it->folders)
+        collectFiles(path + separator + folder, files);
+}
+
+QStringList Library::directories(const QString &dir) const
+{
+    QStringList folders;
+    QReadLocker locker(&m_lock);
+    collectFolders(dir, folders);
+    return folders;
+}
+
+void Library::collectFolders(const QString &path, QStringList &folders) const
+{
+    auto it = m_folders.constFind(path);
+    if (it == m_folders.cend())
+        return;
+
+    folders << path;
+    const auto separator = QDir::separator();
+    for (const auto &folder : it->folders)
+        collectFolders(path + separator + folder, folders);
+}
+
+bool Library::listing(const QString &dir,
+                      qint64 modified,
+                      QStringList &files,
+                      QStringList &directories) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_folders.constFind(dir);
+    if (it == m_folders.cend() or it->modified != modified)
+        return false;
+
+    files = it->files;
+    directories = it->folders;
+    return true;
+}
+
+void Library::update(const QString &root, const QList<Scanner::Listing> &listings)
+{
+    QWriteLocker locker(&m_lock);
+    const auto separator = QDir::separator();
+
+    if (not m_roots.contains(root))
+        m_roots << root;
+
+    for (const auto &listing : listings) {
+        auto &folder = m_folders[listing.path];
+        QSet<QString> names;
+
+        for (const auto &file : listing.files) {
+            names.insert(file.name);
+            auto &entry = m_entries[listing.path + separator + file.name];
+            if (entry.size != file.size or entry.modified != file.modified) {
+                entry.size = file.size;
+                entry.modified = file.modified;
+                entry.stale = true;
+            }
+        }
+
+        for (const auto &file : std::as_const(folder.files))
+            if (not names.contains(file))
+                m_entries.remove(listing.path + separator + file);
+
+        const QSet<QString> directories(listing.directories.cbegin(), listing.directories.cend());
+        const auto previousFolders = folder.folders;
+        for (const auto &previous : previousFolders)
+            if (not directories.contains(previous))
+                removeFolder(listing.path + separator + previous);
+
+        /* removeFolder() may have rehashed m_folders, don't trust the reference anymore. */
+        auto &current = m_folders[listing.path];
+        current.modified = listing.modified;
+        current.files.clear();
+        for (const auto &file : listing.files)
+            current.files << file.name;
+        current.folders = listing.directories;
+    }
+}
+
+void Library::removeFolder(const QString &path)
+{
+    auto it = m_folders.find(path);
+    if (it == m_folders.end())
+        return;
+
+    const auto folder = *it;
+    m_folders.erase(it);
+
+    const auto separator = QDir::separator();
+    for (const auto &file : folder.files)
+        m_entries.remove(path + separator + file);
+
+    for (const auto &subfolder : folder.folders)
+        removeFolder(path + separator + subfolder);
+}
+
+bool Library::contains(const QString &path) const
+{
+    QReadLocker locker(&m_lock);
+    return m_entries.contains(path);
+}
+
+Library::Entry Library::entry(const QString &path) const
+{
+    QReadLocker locker(&m_lock);
+    return m_entries.value(path);
+}
+
+QHash<QString, qint64> Library::sizes() const
+{
+    QReadLocker locker(&m_lock);
+    QHash<QString, qint64> sizes;
+    sizes.reserve(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        sizes.insert(it.key(), it->size);
+    return sizes;
+}
+
+QHash<QString, Library::Entry> Library::entries() const
+{
+    QReadLocker locker(&m_lock);
+    return m_entries;
+}
+
+QStringList Library::staleFiles() const
+{
+    QReadLocker locker(&m_lock);
+    QStringList files;
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        if (it->stale)
+            files << it.key();
+    return files;
+}
+
+void Library::setTrackInfo(const QString &path, const TrackInfo &info)
+{
+    QWriteLocker locker(&m_lock);
+    auto it = m_entries.find(path);
+    if (it == m_entries.end())
+        return;
+
+    it->info = info;
+    it->stale = false;
+}
+
+void Library::setPlayed(const QString &path, qint64 when)
+{
+    QWriteLocker locker(&m_lock);
+    auto it = m_entries.find(path);
+    if (it == m_entries.end())
+        return;
+
+    it->lastPlayed = when;
+    ++it->plays;
+}
+
+void Library::invalidate(const QStringList &files)
+{
+    QWriteLocker locker(&m_lock);
+    for (const auto &file : files) {
+        auto it = m_entries.find(file);
+        if (it != m_entries.end())
+            it->stale = true;
+    }
+}
+
+qsizetype Library::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_entries.size();
+}
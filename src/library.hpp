@@ -0,0 +1,85 @@
+#ifndef LIBRARY_HPP
+#define LIBRARY_HPP
+
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QStringList>
+
+#include "scanner.hpp"
+#include "trackinfo.hpp"
+
+/* On-disk index of every directory we've scanned: what each folder held and when it
+ * last changed, plus size, modification time and metadata of every music file in it.
+ * Scanner asks it for unchanged folders so a rescan only reads those which changed. */
+class Library : public QObject, public DirectoryCache
+{
+    Q_OBJECT
+
+    struct Folder
+    {
+        qint64 modified;
+        QStringList files;
+        QStringList folders;
+    };
+
+    void removeFolder(const QString &path);
+    void collectFiles(const QString &path, QStringList &files) const;
+    void collectFolders(const QString &path, QStringList &folders) const;
+
+public:
+    struct Entry
+    {
+        qint64 size {};
+        qint64 modified {};
+        /* Size or modification time changed since its metadata was read. */
+        bool stale {true};
+        TrackInfo info;
+        /* When it last started playing, in ms since epoch, 0 if it never did. */
+        qint64 lastPlayed {};
+        qint64 plays {};
+    };
+
+    explicit Library(const QString &filename = defaultLocation(), QObject *parent = nullptr);
+    static QString defaultLocation();
+    bool load();
+    bool save() const;
+    /* Whether dir was scanned before, either as a root or inside one. */
+    bool containsDirectory(const QString &dir) const;
+    /* Known music files under dir, in Scanner's order. */
+    QStringList files(const QString &dir) const;
+    /* Every known music file, wherever it is, and its size. */
+    QHash<QString, qint64> sizes() const;
+    /* Every known music file. Implicitly shared, copying it costs nothing. */
+    QHash<QString, Entry> entries() const;
+    /* dir and every known folder under it. */
+    QStringList directories(const QString &dir) const;
+    bool listing(const QString &dir,
+                 qint64 modified,
+                 QStringList &files,
+                 QStringList &directories) const override;
+    /* Applies the directories a scan of root actually had to read. */
+    void update(const QString &root, const QList<Scanner::Listing> &listings);
+    bool contains(const QString &path) const;
+    Entry entry(const QString &path) const;
+    /* Files whose metadata has to be read again. */
+    QStringList staleFiles() const;
+    void setTrackInfo(const QString &path, const TrackInfo &info);
+    /* Counts a play of path starting at when, in ms since epoch. */
+    void setPlayed(const QString &path, qint64 when);
+    /* Files written to in place, their folder's mtime doesn't tell. */
+    void invalidate(const QStringList &files);
+    qsizetype size() const;
+
+signals:
+    void error(const QString &message);
+
+private:
+    QString m_filename;
+    mutable QReadWriteLock m_lock;
+    QStringList m_roots;
+    QHash<QString, Folder> m_folders;
+    QHash<QString, Entry> m_entries;
+};
+
+#endif // LIBRARY_HPP
@@ -0,0 +1,292 @@
+#include "librarybrowser.hpp"
+
+#include <QFileInfo>
+#include <QHeaderView>
+
+namespace {
+/* Where tracks go on their album, disc first. */
+constexpr int POSITION_ROLE = Qt::UserRole + 1;
+
+class BrowserItem : public QTreeWidgetItem
+{
+public:
+    using QTreeWidgetItem::QTreeWidgetItem;
+
+    bool operator<(const QTreeWidgetItem &other) const override
+    {
+        if (type() == LibraryBrowser::TRACK) {
+            const auto position = data(0, POSITION_ROLE).toInt();
+            const auto otherPosition = other.data(0, POSITION_ROLE).toInt();
+            if (position != otherPosition)
+                return position < otherPosition;
+
+            return QString::localeAwareCompare(text(0), other.text(0)) < 0;
+        }
+
+        /* Unknown artists and albums go last rather than first. */
+        const auto unknown = data(0, Qt::UserRole).toString().isEmpty();
+        const auto otherUnknown = other.data(0, Qt::UserRole).toString().isEmpty();
+        if (unknown != otherUnknown)
+            return otherUnknown;
+
+        return QString::localeAwareCompare(text(0), other.text(0)) < 0;
+    }
+};
+}
+
+LibraryBrowser::LibraryBrowser(QWidget *parent)
+    : QTreeWidget {parent}
+{
+    setColumnCount(3);
+    setHeaderLabels({tr("Library"), tr("Tracks"), tr("Duration")});
+    header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    header()->setStretchLastSection(false);
+    setEditTriggers(QTreeWidget::NoEditTriggers);
+    setSelectionMode(QAbstractItemView::ExtendedSelection);
+    setUniformRowHeights(true);
+    setSortingEnabled(true);
+    sortByColumn(0, Qt::AscendingOrder);
+    /* Rows order themselves by name or position, not by whatever column is clicked. */
+    header()->setSectionsClickable(false);
+
+    connect(this, &QTreeWidget::itemExpanded, this, &LibraryBrowser::onItemExpanded);
+    connect(this, &QTreeWidget::itemActivated, this, &LibraryBrowser::onItemActivated);
+}
+
+void LibraryBrowser::insert(const QString &path, const TrackInfo &info)
+{
+    Track track;
+    track.artist = key(info.artist);
+    track.album = key(info.album);
+    track.title = info.title.trimmed().isEmpty() ? QFileInfo(path).completeBaseName() : info.title.trimmed();
+    track.disc = info.disc;
+    track.number = info.track;
+    track.duration = info.duration;
+
+    /* Out of its old groups first, they may be gone once it's taken. */
+    take(path);
+
+    /* Keep the spelling of whichever track named the group first. */
+    auto &artist = m_artists[track.artist];
+    if (artist.name.isEmpty())
+        artist.name = track.artist.isEmpty() ? tr("Unknown Artist") : info.artist.trimmed();
+
+    auto &album = artist.albums[track.album];
+    if (album.name.isEmpty())
+        album.name = track.album.isEmpty() ? tr("Unknown Album") : info.album.trimmed();
+
+    add(path, std::move(track));
+}
+
+void LibraryBrowser::remove(const QStringList &paths)
+{
+    for (const auto &path : paths)
+        take(path);
+}
+
+bool LibraryBrowser::contains(const QString &path) const
+{
+    return m_tracks.contains(path);
+}
+
+QStringList LibraryBrowser::tracks(const QTreeWidgetItem *item) const
+{
+    QStringList paths;
+    switch (item->type()) {
+    case TRACK:
+        paths << item->data(0, Qt::UserRole).toString();
+        break;
+    case ALBUM: {
+        const auto artist = m_artists.constFind(item->parent()->data(0, Qt::UserRole).toString());
+        if (artist != m_artists.cend()) {
+            const auto album = artist->albums.value(item->data(0, Qt::UserRole).toString());
+            paths = QStringList(album.tracks.cbegin(), album.tracks.cend());
+        }
+        break;
+    }
+    case ARTIST: {
+        const auto artist = m_artists.value(item->data(0, Qt::UserRole).toString());
+        for (const auto &album : artist.albums)
+            paths.append(QStringList(album.tracks.cbegin(), album.tracks.cend()));
+        break;
+    }
+    }
+
+    return paths;
+}
+
+QStringList LibraryBrowser::selectedTracks() const
+{
+    /* A track may be selected along with its album, list it once. */
+    QSet<QString> paths;
+    for (const auto *item : selectedItems()) {
+        for (const auto &path : tracks(item))
+            paths.insert(path);
+    }
+
+    return QStringList(paths.cbegin(), paths.cend());
+}
+
+void LibraryBrowser::onItemExpanded(QTreeWidgetItem *item)
+{
+    if (item->type() == ARTIST) {
+        auto &artist = m_artists[item->data(0, Qt::UserRole).toString()];
+        if (artist.populated)
+            return;
+
+        QList<QTreeWidgetItem *> albums;
+        for (auto it = artist.albums.begin(); it != artist.albums.end(); ++it) {
+            it->item = albumItem(it.key(), it.value());
+            albums << it->item;
+        }
+
+        artist.populated = true;
+        item->addChildren(albums);
+    } else if (item->type() == ALBUM) {
+        auto &artist = m_artists[item->parent()->data(0, Qt::UserRole).toString()];
+        auto &album = artist.albums[item->data(0, Qt::UserRole).toString()];
+        if (album.populated)
+            return;
+
+        QList<QTreeWidgetItem *> tracks;
+        for (const auto &path : std::as_const(album.tracks)) {
+            auto &track = m_tracks[path];
+            track.item = trackItem(path, track);
+            tracks << track.item;
+        }
+
+        album.populated = true;
+        item->addChildren(tracks);
+    }
+}
+
+void LibraryBrowser::onItemActivated(QTreeWidgetItem *item)
+{
+    if (item->type() == TRACK)
+        emit trackActivated(item->data(0, Qt::UserRole).toString());
+}
+
+QString LibraryBrowser::key(const QString &name)
+{
+    /* "The Beatles" and "the beatles " are the same group. */
+    return name.trimmed().toCaseFolded();
+}
+
+QString LibraryBrowser::durationText(qint64 milliseconds)
+{
+    const auto seconds = milliseconds / 1'000;
+    if (seconds >= 3'600) {
+        return QString("%1:%2:%3")
+            .arg(seconds / 3'600)
+            .arg((seconds / 60) % 60, 2, 10, QChar('0'))
+            .arg(seconds % 60, 2, 10, QChar('0'));
+    }
+
+    return QString("%1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+QTreeWidgetItem *LibraryBrowser::artistItem(const QString &key, const Artist &artist)
+{
+    auto *item = new BrowserItem(ARTIST);
+    item->setText(0, artist.name);
+    item->setData(0, Qt::UserRole, key);
+    item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    showTotals(item, artist.tracks, artist.duration);
+    return item;
+}
+
+QTreeWidgetItem *LibraryBrowser::albumItem(const QString &key, const Album &album)
+{
+    auto *item = new BrowserItem(ALBUM);
+    item->setText(0, album.name);
+    item->setData(0, Qt::UserRole, key);
+    item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    showTotals(item, album.tracks.size(), album.duration);
+    return item;
+}
+
+QTreeWidgetItem *LibraryBrowser::trackItem(const QString &path, const Track &track)
+{
+    auto *item = new BrowserItem(TRACK);
+    item->setText(0, track.title);
+    item->setText(2, durationText(track.duration));
+    item->setData(0, Qt::UserRole, path);
+    item->setData(0, POSITION_ROLE, track.disc * 1'000 + track.number);
+    item->setToolTip(0, path);
+    return item;
+}
+
+void LibraryBrowser::showTotals(QTreeWidgetItem *item, qsizetype tracks, qint64 duration)
+{
+    item->setText(1, QString::number(tracks));
+    item->setText(2, durationText(duration));
+}
+
+void LibraryBrowser::add(const QString &path, Track track)
+{
+    auto &artist = m_artists[track.artist];
+    auto &album = artist.albums[track.album];
+    const bool newAlbum = album.tracks.isEmpty();
+
+    album.tracks.insert(path);
+    album.duration += track.duration;
+    artist.tracks += 1;
+    artist.duration += track.duration;
+
+    /* Only rows that exist are touched, those made later start from the totals. */
+    if (not artist.item) {
+        artist.item = artistItem(track.artist, artist);
+        addTopLevelItem(artist.item);
+    } else {
+        showTotals(artist.item, artist.tracks, artist.duration);
+    }
+
+    if (artist.populated) {
+        if (newAlbum) {
+            album.item = albumItem(track.album, album);
+            artist.item->addChild(album.item);
+        } else {
+            showTotals(album.item, album.tracks.size(), album.duration);
+        }
+    }
+
+    if (album.populated) {
+        track.item = trackItem(path, track);
+        album.item->addChild(track.item);
+    }
+
+    m_tracks.insert(path, std::move(track));
+}
+
+void LibraryBrowser::take(const QString &path)
+{
+    const auto it = m_tracks.constFind(path);
+    if (it == m_tracks.cend())
+        return;
+
+    const auto track = it.value();
+    m_tracks.erase(it);
+    delete track.item;
+
+    auto artist = m_artists.find(track.artist);
+    auto album = artist->albums.find(track.album);
+
+    album->tracks.remove(path);
+    album->duration -= track.duration;
+    artist->tracks -= 1;
+    artist->duration -= track.duration;
+
+    if (album->tracks.isEmpty()) {
+        delete album->item;
+        artist->albums.erase(album);
+    } else if (album->item) {
+        showTotals(album->item, album->tracks.size(), album->duration);
+    }
+
+    if (artist->tracks == 0) {
+        delete artist->item;
+        m_artists.erase(artist);
+    } else {
+        showTotals(artist->item, artist->tracks, artist->duration);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef LIBRARYBROWSER_HPP
+#define LIBRARYBROWSER_HPP
+
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QTreeWidget>
+
+#include "trackinfo.hpp"
+
+/* Tracks grouped by artist, then album, each group showing how many tracks it has and
+ * how long they last. Counts and durations are kept up to date track by track as they're
+ * inserted, removed or get their tags, never summed over everything again. Only artists
+ * get a row up front, albums and tracks get theirs once their group is first expanded. */
+class LibraryBrowser : public QTreeWidget
+{
+    Q_OBJECT
+
+public:
+    /* Returned by QTreeWidgetItem::type() for the rows of each level. */
+    enum ROW { ARTIST = QTreeWidgetItem::UserType, ALBUM, TRACK };
+
+private:
+    struct Track
+    {
+        /* Folded names of its groups. */
+        QString artist;
+        QString album;
+        QString title;
+        int disc {};
+        int number {};
+        qint64 duration {};
+        QTreeWidgetItem *item {};
+    };
+
+    struct Album
+    {
+        QString name;
+        QSet<QString> tracks;
+        qint64 duration {};
+        QTreeWidgetItem *item {};
+        bool populated {};
+    };
+
+    struct Artist
+    {
+        QString name;
+        QHash<QString, Album> albums;
+        qsizetype tracks {};
+        qint64 duration {};
+        QTreeWidgetItem *item {};
+        bool populated {};
+    };
+
+    static QString key(const QString &name);
+    static QString durationText(qint64 milliseconds);
+    QTreeWidgetItem *artistItem(const QString &key, const Artist &artist);
+    QTreeWidgetItem *albumItem(const QString &key, const Album &album);
+    QTreeWidgetItem *trackItem(const QString &path, const Track &track);
+    void showTotals(QTreeWidgetItem *item, qsizetype tracks, qint64 duration);
+    void add(const QString &path, Track track);
+    void take(const QString &path);
+
+public:
+    explicit LibraryBrowser(QWidget *parent = nullptr);
+    /* Adds path, or moves it to wherever its new tags put it. */
+    void insert(const QString &path, const TrackInfo &info);
+    void remove(const QStringList &paths);
+    bool contains(const QString &path) const;
+    /* Every track under item, in no particular order. */
+    QStringList tracks(const QTreeWidgetItem *item) const;
+    QStringList selectedTracks() const;
+
+signals:
+    void trackActivated(const QString &path);
+
+private slots:
+    void onItemExpanded(QTreeWidgetItem *item);
+    void onItemActivated(QTreeWidgetItem *item);
+
+private:
+    QHash<QString, Artist> m_artists;
+    QHash<QString, Track> m_tracks;
+};
+
+#endif // LIBRARYBROWSER_HPP
@@ -0,0 +1,159 @@
+#include "libraryindexer.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "mediaformats.hpp"
+
+namespace {
+/* Bytes this process, all threads included, had fetched from storage so far. */
+qint64 bytesReadFromStorage()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/io");
+    if (not file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+
+    while (not file.atEnd()) {
+        const auto line = file.readLine();
+        if (line.startsWith("read_bytes:"))
+            return line.mid(11).trimmed().toLongLong();
+    }
+#endif
+    return -1;
+}
+}
+
+LibraryIndexer::LibraryIndexer(QObject *parent)
+    : QObject {parent}
+    , m_cursor {0}
+    , m_harvested {0}
+    , m_phaseBytesRead {-1}
+{
+    connect(&m_library, &Library::error, this, [] (const QString &message) {
+        qCritical().noquote() << message;
+    });
+    connect(&m_scanner, &Scanner::finished, this, &LibraryIndexer::onScanFinished);
+    connect(&m_harvester, &MetadataHarvester::demand, this, &LibraryIndexer::onHarvestDemand);
+    connect(&m_harvester, &MetadataHarvester::harvested, this, &LibraryIndexer::onMetadataHarvested);
+}
+
+void LibraryIndexer::start(const QString &root)
+{
+    const QFileInfo info(root);
+    if (not info.isDir()) {
+        qCritical().noquote() << tr("%1 isn't a directory.").arg(root);
+        finish(false);
+        return;
+    }
+
+    /* Same form the GUI gives, so both share the library's entries. */
+    m_root = QDir::cleanPath(info.absoluteFilePath());
+    m_phases.clear();
+
+    beginPhase(tr("Loading the index"));
+    if (not m_library.load()) {
+        finish(false);
+        return;
+    }
+    endPhase(m_library.size());
+
+    beginPhase(tr("Scanning"));
+    /* Asks the backend what it decodes here rather than from a worker. */
+    MediaFormats::instance();
+    m_scanner.setCache(&m_library);
+    m_scanner.start(m_root);
+}
+
+QList<LibraryIndexer::Phase> LibraryIndexer::phases() const
+{
+    return m_phases;
+}
+
+Scanner::Statistics LibraryIndexer::scanStatistics() const
+{
+    return m_scanner.statistics();
+}
+
+void LibraryIndexer::beginPhase(const QString &name)
+{
+    m_phases.append({name, 0, 0, 0});
+    m_phaseBytesRead = bytesReadFromStorage();
+    m_phaseTimer.start();
+}
+
+void LibraryIndexer::endPhase(qint64 files)
+{
+    auto &phase = m_phases.last();
+    phase.elapsed = m_phaseTimer.elapsed();
+    phase.files = files;
+
+    const auto bytesRead = bytesReadFromStorage();
+    phase.bytesRead = bytesRead >= 0 and m_phaseBytesRead >= 0 ? bytesRead - m_phaseBytesRead : -1;
+}
+
+void LibraryIndexer::onScanFinished(const QStringList &files)
+{
+    m_library.update(m_root, m_scanner.listings());
+    endPhase(files.size());
+
+    /* Only what's under root, stale files elsewhere belong to another run. */
+    const auto prefix = m_root.endsWith('/') ? m_root : m_root + '/';
+    m_stale.clear();
+    for (const auto &file : m_library.staleFiles()) {
+        if (file.startsWith(prefix))
+            m_stale << file;
+    }
+
+    beginPhase(tr("Reading tags"));
+    readTags();
+}
+
+void LibraryIndexer::readTags()
+{
+    m_cursor = 0;
+    m_harvested = 0;
+
+    if (m_stale.isEmpty()) {
+        endPhase(0);
+        finish(true);
+        return;
+    }
+
+    onHarvestDemand(m_harvester.room());
+}
+
+void LibraryIndexer::onHarvestDemand(qsizetype room)
+{
+    if (m_cursor >= m_stale.size())
+        return;
+
+    m_cursor += m_harvester.enqueue(m_stale.mid(m_cursor, room));
+}
+
+void LibraryIndexer::onMetadataHarvested(const QList<MetadataHarvester::Result> &results)
+{
+    /* Unreadable files too, so the next run doesn't try them again. */
+    for (const auto &result : results)
+        m_library.setTrackInfo(result.path, result.info);
+
+    m_harvested += results.size();
+    if (m_harvested < m_stale.size())
+        return;
+
+    endPhase(m_harvested);
+    finish(true);
+}
+
+void LibraryIndexer::finish(bool ok)
+{
+    if (ok) {
+        beginPhase(tr("Saving the index"));
+        ok = m_library.save();
+        endPhase(m_library.size());
+    }
+
+    emit finished(ok);
+}
@@ -0,0 +1,64 @@
+#ifndef LIBRARYINDEXER_HPP
+#define LIBRARYINDEXER_HPP
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+
+#include "library.hpp"
+#include "metadataharvester.hpp"
+#include "scanner.hpp"
+
+/* Brings the library index of a directory up to date without any window: scans it,
+ * reusing unchanged folders, reads the tags of new and changed files and saves the
+ * index. Every phase is timed so runs can be compared, e.g. from one release to the next. */
+class LibraryIndexer : public QObject
+{
+    Q_OBJECT
+
+    void beginPhase(const QString &name);
+    void endPhase(qint64 files);
+    void readTags();
+    void finish(bool ok);
+
+public:
+    struct Phase
+    {
+        QString name;
+        qint64 elapsed; /* Milliseconds. */
+        qint64 files;
+        /* Fetched from storage rather than the page cache, -1 where it isn't known. */
+        qint64 bytesRead;
+    };
+
+    explicit LibraryIndexer(QObject *parent = nullptr);
+    /* finished() is emitted once the index is saved or something failed. */
+    void start(const QString &root);
+    QList<Phase> phases() const;
+    /* Of the last scan. */
+    Scanner::Statistics scanStatistics() const;
+
+signals:
+    void finished(bool ok);
+
+private slots:
+    void onScanFinished(const QStringList &files);
+    void onHarvestDemand(qsizetype room);
+    void onMetadataHarvested(const QList<MetadataHarvester::Result> &results);
+
+private:
+    Library m_library;
+    Scanner m_scanner;
+    MetadataHarvester m_harvester;
+    QString m_root;
+    /* Files whose tags have to be read, those before m_cursor went to the harvester. */
+    QStringList m_stale;
+    qsizetype m_cursor;
+    qsizetype m_harvested;
+    QList<Phase> m_phases;
+    QElapsedTimer m_phaseTimer;
+    qint64 m_phaseBytesRead;
+};
+
+#endif // LIBRARYINDEXER_HPP
@@ -0,0 +1,170 @@
+#include "librarystatistics.hpp"
+
+#include <QFileInfo>
+#include <algorithm>
+#include <vector>
+
+namespace {
+/* Below this many files per thread, spawning more threads costs more than it saves. */
+constexpr qsizetype minimumSlice = 4'096;
+
+template <typename Key>
+Key bucket(Key value, const QList<Key> &bounds)
+{
+    const auto it = std::upper_bound(bounds.cbegin(), bounds.cend(), value);
+    return it == bounds.cbegin() ? bounds.constFirst() : *(it - 1);
+}
+
+template <typename Map>
+void merge(Map &into, const Map &from)
+{
+    for (auto it = from.cbegin(); it != from.cend(); ++it)
+        into[it.key()] += it.value();
+}
+}
+
+const QList<int> LibraryStatistics::bitrateBuckets {0, 96, 128, 192, 256, 320, 500, 1'000};
+const QList<qint64> LibraryStatistics::sizeBuckets {
+    0, 1'000'000, 5'000'000, 10'000'000, 20'000'000, 50'000'000, 100'000'000, 500'000'000
+};
+const QList<qint64> LibraryStatistics::durationBuckets {
+    0, 60'000, 3 * 60'000, 5 * 60'000, 10 * 60'000, 20 * 60'000, 60 * 60'000
+};
+
+LibraryStatistics::Totals &LibraryStatistics::Totals::operator+=(const Totals &other)
+{
+    files += other.files;
+    bytes += other.bytes;
+    duration += other.duration;
+    return *this;
+}
+
+void LibraryStatistics::Summary::add(const QString &path, qint64 size, const Library::Entry &entry)
+{
+    /* Tags read with nothing in them still tell the duration, only those never read don't count. */
+    const bool tagged = not entry.stale or entry.info.duration > 0;
+    const Totals totals {1, size, tagged ? entry.info.duration : 0};
+
+    total += totals;
+
+    const auto slash = path.lastIndexOf('/');
+    const auto dot = path.lastIndexOf('.');
+    formats[dot > slash ? path.mid(dot + 1).toLower() : QString()] += totals;
+    directories[path.left(qMax<qsizetype>(0, slash))] += totals;
+    sizes[bucket(size, sizeBuckets)] += totals;
+
+    if (not tagged) {
+        ++untagged;
+        bitrates[-1] += totals;
+        sampleRates[-1] += totals;
+        durations[-1] += totals;
+        return;
+    }
+
+    bitrates[entry.info.bitrate > 0 ? bucket(entry.info.bitrate, bitrateBuckets) : -1] += totals;
+    sampleRates[entry.info.sampleRate > 0 ? entry.info.sampleRate : -1] += totals;
+    durations[entry.info.duration > 0 ? bucket(entry.info.duration, durationBuckets) : -1] += totals;
+}
+
+LibraryStatistics::Summary &LibraryStatistics::Summary::operator+=(const Summary &other)
+{
+    total += other.total;
+    merge(formats, other.formats);
+    merge(bitrates, other.bitrates);
+    merge(sampleRates, other.sampleRates);
+    merge(sizes, other.sizes);
+    merge(durations, other.durations);
+    merge(directories, other.directories);
+    untagged += other.untagged;
+    return *this;
+}
+
+QList<QPair<QString, LibraryStatistics::Totals>> LibraryStatistics::Summary::largestDirectories(qsizetype count) const
+{
+    QList<QPair<QString, Totals>> largest;
+    largest.reserve(directories.size());
+    for (auto it = directories.cbegin(); it != directories.cend(); ++it)
+        largest.append({it.key(), it.value()});
+
+    count = qMin(count, largest.size());
+    std::partial_sort(largest.begin(), largest.begin() + count, largest.end(), [] (const auto &first, const auto &second) {
+        return first.second.bytes > second.second.bytes;
+    });
+    largest.resize(count);
+    return largest;
+}
+
+LibraryStatistics::LibraryStatistics(QObject *parent)
+    : QObject {parent}
+    , m_threadCount {QThread::idealThreadCount()}
+{
+}
+
+LibraryStatistics::~LibraryStatistics()
+{
+    m_job.wait();
+}
+
+void LibraryStatistics::setThreadCount(int count)
+{
+    m_threadCount = qMax(1, count);
+}
+
+int LibraryStatistics::threadCount() const
+{
+    return m_threadCount;
+}
+
+bool LibraryStatistics::isRunning() const
+{
+    return m_job.isRunning();
+}
+
+void LibraryStatistics::start(const QHash<QString, Library::Entry> &entries)
+{
+    Q_ASSERT_X(not isRunning(), "Only one computation at a time is allowed.", Q_FUNC_INFO);
+
+    m_job.start([this, entries] () {
+        const auto summary = compute(entries);
+        /* Emitted from the GUI thread, Summary isn't a registered meta type. */
+        QMetaObject::invokeMethod(this, [this, summary] () { emit computed(summary); }, Qt::QueuedConnection);
+    }, QThread::LowPriority);
+}
+
+LibraryStatistics::Summary LibraryStatistics::compute(const QHash<QString, Library::Entry> &entries) const
+{
+    using Iterator = QHash<QString, Library::Entry>::const_iterator;
+
+    const auto count = static_cast<int>(qBound<qsizetype>(1, entries.size() / minimumSlice, m_threadCount));
+
+    /* Map: hashes can't be indexed, so the slices' boundaries are found in one pass. */
+    std::vector<Iterator> bounds;
+    bounds.reserve(count + 1);
+    const auto slice = entries.size() / count;
+    auto it = entries.cbegin();
+    for (int i = 0; i < count; ++i) {
+        bounds.push_back(it);
+        if (i + 1 < count)
+            it = std::next(it, slice);
+    }
+    bounds.push_back(entries.cend());
+
+    std::vector<Summary> partials(count);
+    const auto work = [&bounds, &partials] (int index) {
+        auto &partial = partials[index];
+        for (auto it = bounds[index]; it != bounds[index + 1]; ++it) {
+            /* Files found by a scan still going on have no size yet. */
+            const auto size = it->size >= 0 ? it->size : QFileInfo(it.key()).size();
+            partial.add(it.key(), size, it.value());
+        }
+    };
+
+    BackgroundJob::runParallel(count, work);
+
+    /* Reduce. */
+    Summary summary = std::move(partials.front());
+    for (int i = 1; i < count; ++i)
+        summary += partials[i];
+
+    return summary;
+}
@@ -0,0 +1,78 @@
+#ifndef LIBRARYSTATISTICS_HPP
+#define LIBRARYSTATISTICS_HPP
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QThread>
+
+#include "backgroundjob.hpp"
+#include "library.hpp"
+
+/* Totals over the library by format, bitrate, sample rate, file size and duration, and
+ * per folder. Computed as a parallel map-reduce: every thread sums up its own slice of
+ * the files into a partial Summary, partials are merged once all are done. Cheap enough
+ * to be run again every second or so while a scan is adding files. */
+class LibraryStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Totals
+    {
+        qint64 files {};
+        qint64 bytes {};
+        /* Milliseconds, of files whose tags were read. */
+        qint64 duration {};
+
+        Totals &operator+=(const Totals &other);
+    };
+
+    struct Summary
+    {
+        Totals total;
+        /* By lower case extension, empty for files without one. */
+        QHash<QString, Totals> formats;
+        /* By the lower bound of their bucket, -1 when unknown. Bitrates in kbit/s. */
+        QMap<int, Totals> bitrates;
+        QMap<int, Totals> sampleRates;
+        QMap<qint64, Totals> sizes;
+        QMap<qint64, Totals> durations;
+        /* By the folder files are directly in. */
+        QHash<QString, Totals> directories;
+        /* Files whose tags haven't been read yet, their duration, bitrate and sample rate are unknown. */
+        qint64 untagged {};
+
+        void add(const QString &path, qint64 size, const Library::Entry &entry);
+        Summary &operator+=(const Summary &other);
+        /* Biggest first. */
+        QList<QPair<QString, Totals>> largestDirectories(qsizetype count) const;
+    };
+
+    /* Lower bounds of the buckets. */
+    static const QList<int> bitrateBuckets;
+    static const QList<qint64> sizeBuckets;
+    static const QList<qint64> durationBuckets;
+
+    explicit LibraryStatistics(QObject *parent = nullptr);
+    ~LibraryStatistics();
+    void setThreadCount(int count);
+    int threadCount() const;
+    bool isRunning() const;
+    /* Sums up entries in the background, computed() is emitted when done. Entries
+     * whose size is negative aren't known yet and are stat'ed. */
+    void start(const QHash<QString, Library::Entry> &entries);
+    /* Blocks the calling thread. */
+    Summary compute(const QHash<QString, Library::Entry> &entries) const;
+
+signals:
+    void computed(const LibraryStatistics::Summary &summary);
+
+private:
+    int m_threadCount;
+    BackgroundJob m_job;
+};
+
+#endif // LIBRARYSTATISTICS_HPP
@@ -0,0 +1,435 @@
+#include "librarywatcher.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <cerrno>
+#include <cstring>
+#ifdef Q_OS_LINUX
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+#include "mediaformats.hpp"
+
+namespace {
+/* Quiet time after an event before the batch is reported... */
+constexpr int flushDelay = 500;
+/* ...unless events keep coming for longer than this. */
+constexpr int maximumDelay = 3'000;
+constexpr int pollInterval = 60'000;
+
+#ifdef Q_OS_LINUX
+constexpr quint32 watchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                              | IN_CLOSE_WRITE | IN_ONLYDIR | IN_EXCL_UNLINK;
+#endif
+
+bool isUnder(const QString &path, const QString &dir)
+{
+    return path.size() > dir.size() and path.startsWith(dir) and path[dir.size()] == QDir::separator();
+}
+} // namespace
+
+bool LibraryWatcher::Changes::isEmpty() const
+{
+    return added.isEmpty() and removed.isEmpty() and modified.isEmpty() and renamed.isEmpty()
+           and removedDirectories.isEmpty() and renamedDirectories.isEmpty();
+}
+
+LibraryWatcher::LibraryWatcher(QObject *parent)
+    : QObject {parent}
+    , m_fd {-1}
+    , m_notifier {nullptr}
+    , m_overflowed {false}
+{
+#ifdef Q_OS_LINUX
+    m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        qWarning().noquote() << tr("Unable to use inotify: %1. Loaded directories will be polled instead.")
+                                    .arg(QString::fromLocal8Bit(std::strerror(errno)));
+    } else {
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &LibraryWatcher::readEvents);
+    }
+#endif
+
+    m_pool.setMaxThreadCount(1);
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(flushDelay);
+    m_pollTimer.setInterval(pollInterval);
+
+    connect(&m_flushTimer, &QTimer::timeout, this, &LibraryWatcher::flush);
+    connect(&m_pollTimer, &QTimer::timeout, this, &LibraryWatcher::poll);
+}
+
+LibraryWatcher::~LibraryWatcher()
+{
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0)
+        ::close(m_fd);
+#endif
+}
+
+void LibraryWatcher::watch(const QString &root, const QStringList &directories)
+{
+    if (not m_roots.contains(root))
+        m_roots << root;
+
+    if (m_polledRoots.contains(root))
+        return;
+
+    if (m_fd < 0) {
+        startPolling(root);
+        return;
+    }
+
+    for (const auto &dir : directories) {
+        if (not addWatch(dir)) {
+            startPolling(root);
+            return;
+        }
+    }
+}
+
+void LibraryWatcher::clear()
+{
+#ifdef Q_OS_LINUX
+    for (auto it = m_directories.cbegin(); it != m_directories.cend(); ++it)
+        ::inotify_rm_watch(m_fd, it.key());
+#endif
+
+    m_directories.clear();
+    m_watches.clear();
+    m_roots.clear();
+    m_polledRoots.clear();
+    m_pollTimer.stop();
+    m_flushTimer.stop();
+
+    m_added.clear();
+    m_removed.clear();
+    m_modified.clear();
+    m_renamed.clear();
+    m_createdDirectories.clear();
+    m_removedDirectories.clear();
+    m_renamedDirectories.clear();
+    m_moves.clear();
+    m_overflowed = false;
+}
+
+QStringList LibraryWatcher::roots() const
+{
+    return m_roots;
+}
+
+bool LibraryWatcher::addWatch(const QString &dir)
+{
+#ifdef Q_OS_LINUX
+    if (m_watches.contains(dir))
+        return true;
+
+    int wd = ::inotify_add_watch(m_fd, QFile::encodeName(dir).constData(), watchMask);
+    if (wd < 0) {
+        /* Out of watches (fs.inotify.max_user_watches) or kernel memory. */
+        if (errno == ENOSPC or errno == ENOMEM)
+            return false;
+
+        /* It's gone already or we can't read it, nothing to watch. */
+        return true;
+    }
+
+    m_directories.insert(wd, dir);
+    m_watches.insert(dir, wd);
+    return true;
+#else
+    Q_UNUSED(dir);
+    return false;
+#endif
+}
+
+void LibraryWatcher::removeWatches(const QString &dir)
+{
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        if (it.key() == dir or isUnder(it.key(), dir)) {
+#ifdef Q_OS_LINUX
+            ::inotify_rm_watch(m_fd, it.value());
+#endif
+            m_directories.remove(it.value());
+            it = m_watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LibraryWatcher::startPolling(const QString &root)
+{
+    if (m_fd >= 0) {
+        qWarning().noquote() << tr("Ran out of inotify watches for: %1, polling it every %2 seconds instead. "
+                                   "Consider raising fs.inotify.max_user_watches.")
+                                    .arg(root)
+                                    .arg(pollInterval / 1'000);
+    }
+
+    /* Don't hold watches we're not relying on. */
+    removeWatches(root);
+    m_polledRoots.insert(root);
+
+    if (not m_pollTimer.isActive())
+        m_pollTimer.start();
+}
+
+bool LibraryWatcher::isMusicFile(const QString &path) const
+{
+    /* By name only, a file that just showed up may not have its header written yet. */
+    return MediaFormats::instance().isPlayable(path);
+}
+
+void LibraryWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    const auto separator = QDir::separator();
+
+    for (;;) {
+        const auto length = ::read(m_fd, buffer, sizeof buffer);
+        if (length <= 0)
+            break; // EAGAIN, we've read everything.
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                m_overflowed = true;
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                m_watches.remove(m_directories.take(event->wd));
+                continue;
+            }
+
+            const auto dir = m_directories.value(event->wd);
+            if (dir.isEmpty() or event->len == 0)
+                continue;
+
+            const auto name = QFile::decodeName(event->name);
+            /* Hidden entries, e.g. rsync's temporary files. Scanner skips them too. */
+            if (name.startsWith('.'))
+                continue;
+
+            const auto path = dir + separator + name;
+            const bool directory = event->mask & IN_ISDIR;
+
+            if (event->mask & IN_MOVED_FROM) {
+                m_moves.insert(event->cookie, {path, directory});
+            } else if (event->mask & IN_MOVED_TO) {
+                auto it = m_moves.find(event->cookie);
+                if (it != m_moves.end()) {
+                    renamed(it->path, path, directory);
+                    m_moves.erase(it);
+                } else {
+                    created(path, directory);
+                }
+            } else if (event->mask & IN_CREATE) {
+                created(path, directory);
+            } else if (event->mask & IN_DELETE) {
+                deleted(path, directory);
+            } else if (event->mask & IN_CLOSE_WRITE) {
+                if (isMusicFile(path) and not m_added.contains(path))
+                    m_modified.insert(path);
+            }
+        }
+    }
+
+    scheduleFlush();
+#endif
+}
+
+void LibraryWatcher::created(const QString &path, bool directory)
+{
+    if (directory) {
+        m_createdDirectories.insert(path);
+        return;
+    }
+
+    if (not isMusicFile(path))
+        return;
+
+    if (not m_removed.remove(path))
+        m_added.insert(path);
+    else
+        m_modified.insert(path); // Replaced.
+}
+
+void LibraryWatcher::deleted(const QString &path, bool directory)
+{
+    if (directory) {
+        if (not m_createdDirectories.remove(path))
+            m_removedDirectories.insert(path);
+        removeWatches(path);
+        return;
+    }
+
+    if (not isMusicFile(path))
+        return;
+
+    m_modified.remove(path);
+    if (not m_added.remove(path))
+        m_removed.insert(path);
+}
+
+void LibraryWatcher::renamed(const QString &from, const QString &to, bool directory)
+{
+    if (directory) {
+        if (m_createdDirectories.remove(from)) {
+            m_createdDirectories.insert(to);
+            return;
+        }
+
+        m_renamedDirectories.append({from, to});
+
+        /* Keep the watches but update where they point to. */
+        for (auto it = m_directories.begin(); it != m_directories.end(); ++it) {
+            if (it.value() == from or isUnder(it.value(), from)) {
+                m_watches.remove(it.value());
+                it.value() = to + it.value().mid(from.size());
+                m_watches.insert(it.value(), it.key());
+            }
+        }
+
+        return;
+    }
+
+    const bool wasMusic = isMusicFile(from);
+    const bool isMusic = isMusicFile(to);
+
+    if (wasMusic and not isMusic) {
+        deleted(from, false);
+    } else if (isMusic and not wasMusic) {
+        created(to, false);
+    } else if (isMusic) {
+        if (m_added.remove(from))
+            m_added.insert(to);
+        else
+            m_renamed.append({from, to});
+    }
+}
+
+void LibraryWatcher::scheduleFlush()
+{
+    if (not m_flushTimer.isActive() and not m_batchAge.isValid())
+        m_batchAge.start();
+
+    /* Coalesce bursts, but don't keep the user waiting forever during a long copy. */
+    if (m_batchAge.isValid() and m_batchAge.elapsed() >= maximumDelay)
+        flush();
+    else
+        m_flushTimer.start();
+}
+
+void LibraryWatcher::flush()
+{
+    m_flushTimer.stop();
+    m_batchAge.invalidate();
+
+    if (m_overflowed) {
+        /* We lost events, let the library find out what changed. Only changed folders are read. */
+        m_overflowed = false;
+        m_added.clear();
+        m_removed.clear();
+        m_modified.clear();
+        m_renamed.clear();
+        m_removedDirectories.clear();
+        m_renamedDirectories.clear();
+        m_moves.clear();
+
+        for (const auto &root : std::as_const(m_roots))
+            emit rescanRequested(root);
+    }
+
+    /* Moved out of anything we watch. */
+    for (const auto &move : std::as_const(m_moves))
+        deleted(move.path, move.directory);
+    m_moves.clear();
+
+    Changes changes;
+    changes.added = m_added.values();
+    changes.removed = m_removed.values();
+    changes.modified = m_modified.values();
+    changes.renamed = m_renamed;
+    changes.removedDirectories = m_removedDirectories.values();
+    changes.renamedDirectories = m_renamedDirectories;
+
+    m_added.clear();
+    m_removed.clear();
+    m_modified.clear();
+    m_renamed.clear();
+    m_removedDirectories.clear();
+    m_renamedDirectories.clear();
+
+    if (not m_createdDirectories.isEmpty()) {
+        walk(m_createdDirectories.values());
+        m_createdDirectories.clear();
+    }
+
+    if (not changes.isEmpty())
+        emit changed(changes);
+}
+
+void LibraryWatcher::walk(const QStringList &directories)
+{
+    /* Watched before they're listed: whatever shows up in between is reported twice at
+     * worst, the batch merges it, but never missed. */
+    for (const auto &dir : directories) {
+        QString root;
+        for (const auto &candidate : std::as_const(m_roots))
+            if (isUnder(dir, candidate))
+                root = candidate;
+
+        if (root.isEmpty() or m_polledRoots.contains(root))
+            continue;
+
+        if (not addWatch(dir))
+            startPolling(root);
+    }
+
+    /* Only the new folders are walked, never the whole tree, a level at a time so
+     * subfolders are watched in turn before they're listed. */
+    m_pool.start([this, directories, &formats = MediaFormats::instance()] () {
+        QStringList files;
+        QStringList folders;
+
+        for (const auto &dir : directories) {
+            QDirIterator it(dir, QDir::Filter::AllEntries | QDir::Filter::NoDotAndDotDot);
+            while (it.hasNext()) {
+                const auto info = it.nextFileInfo();
+                /* Like a recursive QDirIterator, links to folders aren't followed. */
+                if (info.isDir() and not info.isSymLink())
+                    folders << info.filePath();
+                else if (info.isFile() and formats.isPlayable(info.filePath()))
+                    files << info.filePath();
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [this, files, folders] () {
+            for (const auto &file : files)
+                created(file, false);
+
+            if (not files.isEmpty())
+                scheduleFlush();
+
+            if (not folders.isEmpty())
+                walk(folders);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void LibraryWatcher::poll()
+{
+    for (const auto &root : std::as_const(m_polledRoots))
+        emit rescanRequested(root);
+}
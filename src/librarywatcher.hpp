@@ -0,0 +1,99 @@
+#ifndef LIBRARYWATCHER_HPP
+#define LIBRARYWATCHER_HPP
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+/* Keeps an eye on the directories loaded into the playlist. On Linux every folder gets
+ * an inotify watch; events are coalesced for a little while and reported as one batch of
+ * changes so a big copy or rsync doesn't flood the playlist. Once the kernel runs out of
+ * watches, or on other systems, roots are polled instead: rescanRequested() is emitted
+ * periodically and, since the library only rereads folders whose mtime changed, that
+ * costs about a stat per folder. */
+class LibraryWatcher : public QObject
+{
+    Q_OBJECT
+
+    struct Move
+    {
+        QString path;
+        bool directory;
+    };
+
+    bool addWatch(const QString &dir);
+    void removeWatches(const QString &dir);
+    void startPolling(const QString &root);
+    bool isMusicFile(const QString &path) const;
+    void created(const QString &path, bool directory);
+    void deleted(const QString &path, bool directory);
+    void renamed(const QString &from, const QString &to, bool directory);
+    void scheduleFlush();
+    void walk(const QStringList &directories);
+
+public:
+    struct Changes
+    {
+        QStringList added;
+        QStringList removed;
+        /* Files written to, their metadata may be outdated. */
+        QStringList modified;
+        QList<QPair<QString, QString>> renamed;
+        /* Everything under these is gone. */
+        QStringList removedDirectories;
+        /* Everything under first now lives under second. */
+        QList<QPair<QString, QString>> renamedDirectories;
+
+        bool isEmpty() const;
+    };
+
+    explicit LibraryWatcher(QObject *parent = nullptr);
+    ~LibraryWatcher();
+    /* Watches root and the given folders under it, adding a folder twice is harmless. */
+    void watch(const QString &root, const QStringList &directories);
+    void clear();
+    QStringList roots() const;
+
+signals:
+    void changed(const LibraryWatcher::Changes &changes);
+    void rescanRequested(const QString &root);
+
+private slots:
+    void readEvents();
+    void flush();
+    void poll();
+
+private:
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    QStringList m_roots;
+    QSet<QString> m_polledRoots;
+    QHash<int, QString> m_directories;
+    QHash<QString, int> m_watches;
+
+    /* Pending batch. */
+    QSet<QString> m_added;
+    QSet<QString> m_removed;
+    QSet<QString> m_modified;
+    QList<QPair<QString, QString>> m_renamed;
+    QSet<QString> m_createdDirectories;
+    QSet<QString> m_removedDirectories;
+    QList<QPair<QString, QString>> m_renamedDirectories;
+    QHash<quint32, Move> m_moves;
+    bool m_overflowed;
+
+    QElapsedTimer m_batchAge;
+    QTimer m_flushTimer;
+    QTimer m_pollTimer;
+    /* Last so it's destroyed first, waiting for any walk still running. */
+    QThreadPool m_pool;
+};
+
+#endif // LIBRARYWATCHER_HPP
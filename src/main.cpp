@@ -22,6 +22,7 @@
 #endif // SINGLE_INSTANCE
 
 #include "config.hpp"
+#include "libraryindexer.hpp"
 #include "player.hpp"
 #include "settings.hpp"
 
@@ -33,6 +34,10 @@ const QMap<QString, QString> availableLanguages {
 };
 
 QList<QCommandLineOption> commandLineOptions();
+/* Whether --scan was given, checked before any application object exists. */
+bool isHeadlessScan(int argc, char *argv[]);
+/* Indexes the directory given to --scan and prints how long every phase took. */
+int scanHeadless(int argc, char *argv[]);
 /* Prompts user for a reply with a QMessageBox or in the command line. */
 QMessageBox::StandardButton showMessage(int argc, const QString &message, bool question);
 
@@ -46,6 +51,10 @@ QMessageBox::StandardButton showMessage(int argc, const QString &message, bool q
 
 int main(int argc, char *argv[])
 {
+    /* Meant for servers without a display, where a QApplication can't even be created. */
+    if (isHeadlessScan(argc, argv))
+        return scanHeadless(argc, argv);
+
     QApplication a(argc, argv);
     QApplication::setApplicationName(PROJECT_NAME);
     QApplication::setApplicationVersion(PROJECT_VERSION);
@@ -243,7 +252,7 @@ int main(int argc, char *argv[])
     });
     QObject::connect(&player, &Player::error, &a, &QApplication::quit, Qt::QueuedConnection);
 
-    player.setPlayList(playlist);
+    player.setPlayList(Playlist(playlist));
     player.setAutoPlay(true);
     player.playNext();
     return a.exec();
@@ -262,6 +271,13 @@ QList<QCommandLineOption> commandLineOptions()
         "files"
     );
 
+    options << QCommandLineOption(
+        QStringList() << "scan",
+        QObject::tr("Update the library index with the music files under dir without "
+                    "showing any window, then print how long it took."),
+        "dir"
+    );
+
     options << QCommandLineOption(
         QStringList() << "l" << "language",
         QObject::tr("Which language to display the app in other than English. "
@@ -294,6 +310,72 @@ QList<QCommandLineOption> commandLineOptions()
     return options;
 }
 
+bool isHeadlessScan(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const QByteArrayView argument(argv[i]);
+        if (argument == "--scan" or argument.startsWith("--scan="))
+            return true;
+    }
+
+    return false;
+}
+
+int scanHeadless(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName(PROJECT_NAME);
+    QCoreApplication::setApplicationVersion(PROJECT_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(PROJECT_DESCRIPTION);
+    parser.addHelpOption();
+    parser.addOptions(commandLineOptions());
+    parser.addVersionOption();
+    parser.process(a);
+
+    const auto root = parser.value("scan");
+    LibraryIndexer indexer;
+
+    QObject::connect(&indexer, &LibraryIndexer::finished, &a, [&a, &indexer] (bool ok) {
+        qint64 elapsed {};
+        qint64 bytesRead {};
+        for (const auto &phase : indexer.phases()) {
+            const auto seconds = qMax<qint64>(1, phase.elapsed) / 1'000.0;
+            std::cout << QObject::tr("%1: %2 ms, %3 files, %4 files/s, %5 bytes read")
+                             .arg(phase.name)
+                             .arg(phase.elapsed)
+                             .arg(phase.files)
+                             .arg(qRound64(phase.files / seconds))
+                             .arg(phase.bytesRead >= 0 ? QString::number(phase.bytesRead) : QObject::tr("unknown"))
+                             .toStdString()
+                      << std::endl;
+
+            elapsed += phase.elapsed;
+            bytesRead = phase.bytesRead >= 0 and bytesRead >= 0 ? bytesRead + phase.bytesRead : -1;
+        }
+
+        const auto statistics = indexer.scanStatistics();
+        std::cout << QObject::tr("Scanned %1 folders, %2 of them unchanged, with %3 system calls")
+                         .arg(statistics.directories)
+                         .arg(statistics.cachedDirectories)
+                         .arg(statistics.syscalls())
+                         .toStdString()
+                  << std::endl
+                  << QObject::tr("Total: %1 ms, %2 bytes read")
+                         .arg(elapsed)
+                         .arg(bytesRead >= 0 ? QString::number(bytesRead) : QObject::tr("unknown"))
+                         .toStdString()
+                  << std::endl;
+
+        a.exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    });
+
+    /* Once the event loop runs, finished() may come before start() returns. */
+    QMetaObject::invokeMethod(&indexer, [&indexer, root] () { indexer.start(root); }, Qt::QueuedConnection);
+    return a.exec();
+}
+
 QMessageBox::StandardButton showMessage(int argc, const QString &message, bool question)
 {
     if (argc == 3) {
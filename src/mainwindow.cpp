@@ -2,29 +2,68 @@
 #include "./ui_mainwindow.h"
 
 #include <QAudioDevice>
+#include <QDateTime>
 #include <QDir>
 #include <QDirIterator>
 #include <QEventLoop>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QHash>
 #include <QInputDialog>
+#include <QMenu>
 #include <QMediaDevices>
-#include <QMediaFormat>
 #include <QMessageBox>
+#include <QScrollBar>
+#include <QSet>
 #include <QStandardPaths>
 #include <QShortcut>
+#include <QTimer>
+#include <algorithm>
+#include <iterator>
+#include <memory>
 
 #include "config.hpp"
+#include "duplicatesdialog.hpp"
+#include "mediaformats.hpp"
 #include "playlistchooser.hpp"
 #include "settings.hpp"
+#include "similartracksdialog.hpp"
 #ifdef ENABLE_NOTIFICATIONS
     #include "notifier.hpp"
 #endif
 
+namespace {
+/* Offered by the playlist's "Sort by" menu, saved by their index. The first is the
+ * order saved playlists are kept in. */
+struct SortOrder
+{
+    const char *name;
+    QList<TrackSorter::KEY> keys;
+};
+
+const SortOrder sortOrders[] = {
+    {QT_TRANSLATE_NOOP("MainWindow", "File name"), TrackSorter::defaultKeys()},
+    {QT_TRANSLATE_NOOP("MainWindow", "Artist, album and track"),
+     {TrackSorter::KEY::ARTIST, TrackSorter::KEY::ALBUM, TrackSorter::KEY::DISC,
+      TrackSorter::KEY::TRACK, TrackSorter::KEY::TITLE, TrackSorter::KEY::PATH}},
+    {QT_TRANSLATE_NOOP("MainWindow", "Title"),
+     {TrackSorter::KEY::TITLE, TrackSorter::KEY::ARTIST, TrackSorter::KEY::PATH}},
+    {QT_TRANSLATE_NOOP("MainWindow", "Path"), {TrackSorter::KEY::PATH}},
+};
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , m_ui {new Ui::MainWindow}
     , m_systray {QIcon::fromTheme(QIcon::ThemeIcon::MultimediaPlayer), this}
+    , m_scanSegmentStart {0}
+    , m_harvestCursor {0}
+    , m_newSuspects {0}
+    , m_duplicatesProgress {nullptr}
+    , m_libraryBrowserPopulated {false}
+    , m_statisticsDialog {nullptr}
+    , m_statisticsStale {false}
+    , m_playsUnsaved {false}
     , m_canModifySlider {true}
     , m_quitShortcut {new QShortcut(QKeySequence(Qt::Modifier::CTRL | Qt::Key_Q), this)}
     , m_openFilesShortcut {new QShortcut(QKeySequence(Qt::Modifier::CTRL | Qt::Key_O), this)}
@@ -44,6 +83,7 @@ MainWindow::MainWindow(QWidget *parent)
     , m_increaseVolumeBy10Shortcut {new QShortcut(QKeySequence(Qt::Modifier::SHIFT | Qt::Key_Up), this)}
     , m_decreaseVolumeBy5Shortcut {new QShortcut(QKeySequence(Qt::Key_Down), this)}
     , m_decreaseVolumeBy10Shortcut {new QShortcut(QKeySequence(Qt::Modifier::SHIFT | Qt::Key_Down), this)}
+    , m_searchShortcut {new QShortcut(QKeySequence(Qt::Modifier::CTRL | Qt::Key_F), this)}
     , m_currentPosition(0)
 #ifdef ENABLE_IPC
     , m_dbusConnection {QDBusConnection::sessionBus()}
@@ -66,19 +106,64 @@ MainWindow::MainWindow(QWidget *parent)
     m_addSongToPlaylist->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::DocumentNew));
     m_removeSongAction = new QAction(tr("Remove song from playlist"), this);
     m_removeSongAction->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::EditDelete));
-
-    m_ui->treeWidget->setColumnCount(1);
-    m_ui->treeWidget->setHeaderLabel(tr("Playlist: Unnamed"));
-    m_ui->treeWidget->viewport()->setAcceptDrops(true);
-    m_ui->treeWidget->setDropIndicatorShown(true);
-    m_ui->treeWidget->setContextMenuPolicy(Qt::ActionsContextMenu);
-    m_ui->treeWidget->addActions({
+    m_songPlaylistsAction = new QAction(tr("Show playlists with this song"), this);
+    m_songPlaylistsAction->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::DocumentProperties));
+    auto *sortMenu = new QMenu(tr("Sort by"), this);
+    m_sortByGroup = new QActionGroup(this);
+    for (int i = 0; i < static_cast<int>(std::size(sortOrders)); ++i) {
+        auto *action = sortMenu->addAction(tr(sortOrders[i].name));
+        action->setCheckable(true);
+        action->setData(i);
+        m_sortByGroup->addAction(action);
+    }
+    auto *similarSeparator = new QAction(this);
+    similarSeparator->setSeparator(true);
+    m_findSimilarAction = new QAction(tr("Find similar tracks"), this);
+    m_findSimilarAction->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::EditFind));
+    m_addBrowsedTracksAction = new QAction(tr("Add to playlist"), this);
+    m_addBrowsedTracksAction->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::ListAdd));
+
+    /* Column 0 is the file name, its header the playlist's name. */
+    m_ui->playlistView->setModel(&m_playlistModel);
+    m_ui->playlistView->viewport()->setAcceptDrops(true);
+    m_ui->playlistView->setDropIndicatorShown(true);
+    m_ui->playlistView->setContextMenuPolicy(Qt::ActionsContextMenu);
+    m_ui->playlistView->addActions({
         m_showHideControlsTreeWidgetAction,
         separator,
         m_addSongToPlaylist,
-        m_removeSongAction
+        m_removeSongAction,
+        m_songPlaylistsAction,
+        sortMenu->menuAction(),
+        similarSeparator,
+        m_findSimilarAction
     });
 
+    m_libraryBrowser = new LibraryBrowser(this);
+    m_libraryBrowser->setVisible(false);
+    m_ui->topLevelHorizontalLayout->insertWidget(0, m_libraryBrowser);
+    m_libraryBrowser->setContextMenuPolicy(Qt::ActionsContextMenu);
+    m_libraryBrowser->addAction(m_addBrowsedTracksAction);
+
+    /* Takes the playlist's place while there's something in searchEdit. */
+    m_ui->searchResultsWidget->setColumnCount(4);
+    m_ui->searchResultsWidget->setHeaderLabels({tr("File"), tr("Title"), tr("Artist"), tr("Album")});
+    m_ui->searchResultsWidget->setEditTriggers(QTreeWidget::NoEditTriggers);
+    m_ui->searchResultsWidget->setUniformRowHeights(true);
+    m_ui->searchResultsWidget->setRootIsDecorated(false);
+
+    m_scanLabel = new QLabel(this);
+    m_scanProgressBar = new QProgressBar(this);
+    /* There's no telling how many files a directory has until it's been walked. */
+    m_scanProgressBar->setRange(0, 0);
+    m_scanProgressBar->setMaximumWidth(150);
+    m_cancelScanButton = new QPushButton(QIcon::fromTheme(QIcon::ThemeIcon::ProcessStop), tr("Cancel"), this);
+    m_cancelScanButton->setToolTip(tr("Stop loading the directory, files found so far are kept."));
+    m_ui->statusbar->addPermanentWidget(m_scanLabel);
+    m_ui->statusbar->addPermanentWidget(m_scanProgressBar);
+    m_ui->statusbar->addPermanentWidget(m_cancelScanButton);
+    hideScanProgress();
+
     m_settings = new QSettings(Settings::createEnvironment(), QSettings::IniFormat, this);
     setAudioOutputs();
 
@@ -87,6 +172,89 @@ MainWindow::MainWindow(QWidget *parent)
         QSettings::IniFormat,
         this
     );
+    m_playlists.migrate(m_playlistSettings);
+
+    connect(&m_library, &Library::error, this, &MainWindow::error);
+    m_library.load();
+    m_scanner.setCache(&m_library);
+    m_searchIndex.build(m_library);
+    m_smartPlaylist.setLibrary(&m_library);
+    connect(&m_similarityIndex, &SimilarityIndex::error, this, &MainWindow::error);
+    m_similarityIndex.load();
+    m_analyzer.setIndex(&m_similarityIndex);
+    /* Asks the backend what it decodes now, before any scan needs it from another thread. */
+    MediaFormats::instance();
+
+    connect(&m_watcher, &LibraryWatcher::changed, this, &MainWindow::onLibraryChanged);
+    connect(&m_watcher, &LibraryWatcher::rescanRequested, this, &MainWindow::rescanDirectory);
+    connect(&m_scanner, &Scanner::filesFound, this, &MainWindow::onScanFilesFound);
+    connect(&m_scanner, &Scanner::progress, this, &MainWindow::onScanProgress);
+    connect(&m_scanner, &Scanner::finished, this, &MainWindow::onScanFinished);
+    connect(m_cancelScanButton, &QPushButton::clicked, this, &MainWindow::onCancelScan);
+    connect(&m_importer, &PlaylistImporter::tracksFound, this, &MainWindow::onImportTracksFound);
+    connect(&m_importer, &PlaylistImporter::error, this, &MainWindow::warning);
+    connect(&m_importer, &PlaylistImporter::finished, this, &MainWindow::onImportFinished);
+    connect(&m_duplicateFinder, &DuplicateFinder::progress, this, &MainWindow::onDuplicatesProgress);
+    connect(&m_duplicateFinder, &DuplicateFinder::finished, this, &MainWindow::onDuplicatesFound);
+    connect(&m_analyzer, &AcousticAnalyzer::progress, this, &MainWindow::onAnalysisProgress);
+    connect(&m_analyzer, &AcousticAnalyzer::finished, this, &MainWindow::onAnalysisFinished);
+    connect(&m_statistics, &LibraryStatistics::computed, this, &MainWindow::onStatisticsComputed);
+
+    m_harvestTimer.setSingleShot(true);
+    m_harvestTimer.setInterval(0);
+
+    m_playlistReadTimer.setSingleShot(true);
+    m_playlistReadTimer.setInterval(0);
+    connect(&m_playlistReadTimer, &QTimer::timeout, this, &MainWindow::readPlaylist);
+
+    m_statisticsTimer.setInterval(1'000);
+    connect(&m_statisticsTimer, &QTimer::timeout, this, [this] () {
+        if (not m_statisticsDialog or not m_statisticsDialog->isVisible())
+            m_statisticsTimer.stop();
+        else if (m_statisticsStale or not m_scanningDirectory.isEmpty())
+            refreshStatistics();
+    });
+    connect(&m_harvestTimer, &QTimer::timeout, this, &MainWindow::harvestMetadata);
+    connect(&m_harvester, &MetadataHarvester::demand, this, &MainWindow::onHarvestDemand);
+    connect(&m_harvester, &MetadataHarvester::harvested, this, &MainWindow::onMetadataHarvested);
+    /* Saving the whole index is too much to do after every batch. */
+    connect(&m_harvester, &MetadataHarvester::idle, this, [this] () { m_library.save(); });
+
+    /* However rows get in or move, the harvester catches up from the first one affected. */
+    connect(&m_playlistModel, &QAbstractItemModel::rowsInserted, this, [this] ([[maybe_unused]] const QModelIndex &parent, int first, int last) {
+        m_harvestCursor = qMin<qsizetype>(m_harvestCursor, first);
+        m_harvestTimer.start();
+
+        /* Whatever enters the playlist is checked before its turn to play comes. */
+        QStringList paths;
+        paths.reserve(last - first + 1);
+        for (int row = first; row <= last; ++row)
+            paths << m_playlistModel.path(row);
+        m_prober.probe(paths);
+    });
+    connect(&m_playlistModel, &QAbstractItemModel::rowsRemoved, this, [this] ([[maybe_unused]] const QModelIndex &parent, int first) {
+        m_harvestCursor = qMin<qsizetype>(m_harvestCursor, first);
+    });
+    connect(&m_playlistModel, &QAbstractItemModel::layoutChanged, this, [this] () {
+        m_harvestCursor = 0;
+        m_harvestTimer.start();
+    });
+    connect(&m_playlistModel, &QAbstractItemModel::modelReset, this, [this] () {
+        m_harvestCursor = 0;
+        m_harvestTimer.start();
+
+        QStringList paths;
+        paths.reserve(m_playlistModel.rowCount());
+        for (int row = 0; row < m_playlistModel.rowCount(); ++row)
+            paths << m_playlistModel.path(row);
+        m_prober.probe(paths);
+    });
+    connect(m_ui->playlistView->verticalScrollBar(), &QScrollBar::valueChanged, &m_harvestTimer, [this] () {
+        m_harvestTimer.start();
+    });
+
+    connect(&m_prober, &FileProber::probed, this, &MainWindow::onFilesProbed);
+    connect(&m_prober, &FileProber::idle, this, &MainWindow::onProberIdle);
 
     m_settings->beginGroup("WindowSettings");
     if (m_settings->value("Centered", false).toBool()) {
@@ -101,6 +269,9 @@ MainWindow::MainWindow(QWidget *parent)
 
     m_settings->endGroup();
 
+    if (m_settings->value("WindowSettings/ShowLibraryBrowser", false).toBool())
+        m_ui->actionShowLibraryBrowser->trigger();
+
     m_settings->beginGroup("AudioSettings");
     m_ui->volumeSlider->setRange(0, 100);
     m_ui->volumeSlider->setValue(m_settings->value("VolumeLevel", 50).toInt());
@@ -110,6 +281,10 @@ MainWindow::MainWindow(QWidget *parent)
     m_settings->endGroup();
 
     m_settings->beginGroup("PlaylistSettings");
+    const auto sortBy = qBound(0, m_settings->value("SortBy", 0).toInt(), static_cast<int>(std::size(sortOrders)) - 1);
+    m_sortByGroup->actions().at(sortBy)->setChecked(true);
+    m_playlistModel.setSortKeys(sortOrders[sortBy].keys);
+
     auto playlistName = m_settings->value("DefaultPlaylist", "").toString();
 
     if (not playlistName.isEmpty() and playlistName != "None") {
@@ -122,7 +297,7 @@ MainWindow::MainWindow(QWidget *parent)
                 if (m_playlist.contains(lastSong)) {
                     int index = m_playlist.indexOf(lastSong);
                     m_player.setCurrent(index);
-                    m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(index));
+                    setCurrentRow(index);
                     m_ui->playingEdit->setText(musicName(m_playlist[index]));
                 } else {
                     QMessageBox::warning(
@@ -172,9 +347,11 @@ MainWindow::MainWindow(QWidget *parent)
 
     m_settings->beginGroup("Songs");
 
+    QStringList recentSongs;
     for (const auto &song : m_settings->childKeys()) {
         auto *action = new QAction(song, m_ui->menuSongs);
         m_ui->menuSongs->addAction(action);
+        recentSongs << m_settings->value(song).toString();
 
         connect(action, &QAction::triggered, this, &MainWindow::onOpenSongActionTriggered);
     }
@@ -182,6 +359,12 @@ MainWindow::MainWindow(QWidget *parent)
     m_settings->endGroup(); // Songs
     m_settings->endGroup(); // Recents
 
+    /* Checked all at once in the background, those gone are disabled rather than failing when picked. */
+    m_ui->menuSongs->setToolTipsVisible(true);
+    connect(&m_recentSongsValidator, &FileValidator::finished, this, &MainWindow::onRecentSongsValidated);
+    m_recentSongsValidator.start(recentSongs);
+    connect(&m_playlistValidator, &FileValidator::finished, this, &MainWindow::onPlaylistValidated);
+
 #ifdef ENABLE_VIDEO_PLAYER
     m_videoPlayer.setAspectRatioMode(Qt::KeepAspectRatioByExpanding);
     m_ui->videoPlayerHorizontalLayout->addWidget(&m_videoPlayer, 1);
@@ -219,6 +402,9 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(m_addSongToPlaylist, &QAction::triggered, this, &MainWindow::onOpenFilesActionRequested);
     connect(m_removeSongAction, &QAction::triggered, this, &MainWindow::onRemoveSongActionTriggered);
+    connect(m_songPlaylistsAction, &QAction::triggered, this, &MainWindow::onSongPlaylistsActionTriggered);
+    connect(m_sortByGroup, &QActionGroup::triggered, this, &MainWindow::onSortByActionTriggered);
+    connect(m_findSimilarAction, &QAction::triggered, this, &MainWindow::onFindSimilarActionTriggered);
     connect(m_ui->actionOpenFiles, &QAction::triggered, this, &MainWindow::onOpenFilesActionRequested);
     connect(m_ui->actionOpen_Directory, &QAction::triggered, this, &MainWindow::onOpenFilesActionRequested);
     connect(m_ui->actionQuit, &QAction::triggered, this, &MainWindow::onQuit);
@@ -226,17 +412,38 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_ui->actionAboutQt, &QAction::triggered, this, &QApplication::aboutQt);
     connect(m_ui->actionHideShowControls, &QAction::triggered, this, &MainWindow::onHideShowControls);
     connect(m_showHideControlsTreeWidgetAction, &QAction::triggered, this, &MainWindow::onHideShowControls);
-    connect(m_ui->treeWidget, &QTreeWidget::itemDoubleClicked, this, &MainWindow::onPlaylistItemDoubleClicked);
+    connect(m_ui->playlistView, &QTreeView::doubleClicked, this, &MainWindow::onPlaylistItemDoubleClicked);
+    connect(m_ui->searchEdit, &QLineEdit::textChanged, this, &MainWindow::onSearchTextChanged);
+    connect(m_ui->searchEdit, &QLineEdit::returnPressed, this, [this] () {
+        if (auto *first = m_ui->searchResultsWidget->topLevelItem(0))
+            onSearchResultActivated(first);
+    });
+    connect(m_ui->searchResultsWidget, &QTreeWidget::itemActivated, this, &MainWindow::onSearchResultActivated);
+    connect(m_libraryBrowser, &LibraryBrowser::trackActivated, this, &MainWindow::playTrack);
+    connect(m_addBrowsedTracksAction, &QAction::triggered, this, [this] () {
+        applyLibraryChanges(m_libraryBrowser->selectedTracks(), {});
+    });
+    connect(m_ui->actionShowLibraryBrowser, &QAction::triggered, this, &MainWindow::onShowLibraryBrowserActionTriggered);
+    connect(m_ui->actionLibraryStatistics, &QAction::triggered, this, &MainWindow::onLibraryStatisticsActionTriggered);
+    connect(m_ui->actionNewSmartPlaylist, &QAction::triggered, this, &MainWindow::onNewSmartPlaylistActionRequested);
+    connect(&m_smartPlaylist, &SmartPlaylist::matched, this, &MainWindow::onSmartPlaylistMatched);
+    connect(&m_smartPlaylist, &SmartPlaylist::finished, this, &MainWindow::onSmartPlaylistFinished);
+    connect(&m_smartPlaylist, &SmartPlaylist::changed, this, &MainWindow::onSmartPlaylistChanged);
     connect(m_ui->openFilesButton, &QPushButton::clicked, this, &MainWindow::onOpenFilesActionRequested);
     connect(m_ui->actionOpenPlaylist, &QAction::triggered, this, &MainWindow::onOpenPlayListActionRequested);
     connect(m_ui->actionClosePlaylist, &QAction::triggered, this, &MainWindow::onClosePlayListActionRequested);
     connect(m_ui->actionSavePlaylist, &QAction::triggered, this, &MainWindow::onSavePlayListActionRequested);
     connect(m_ui->actionRemovePlaylist, &QAction::triggered, this, &MainWindow::onRemovePlayListActionRequested);
+    connect(m_ui->actionImportPlaylist, &QAction::triggered, this, &MainWindow::onImportPlayListActionRequested);
+    connect(m_ui->actionExportPlaylist, &QAction::triggered, this, &MainWindow::onExportPlayListActionRequested);
     connect(m_ui->openPlaylistButton, &QPushButton::clicked, this, &MainWindow::onOpenPlayListActionRequested);
     connect(m_ui->closePlayListButton, &QPushButton::clicked, this, &MainWindow::onClosePlayListActionRequested);
     connect(m_ui->savePlaylistButton, &QPushButton::clicked, this, &MainWindow::onSavePlayListActionRequested);
     connect(m_ui->removePlaylistButton, &QPushButton::clicked, this, &MainWindow::onRemovePlayListActionRequested);
     connect(m_ui->actionSettings, &QAction::triggered, this, &MainWindow::onOpenSettings);
+    connect(m_ui->actionFindDuplicates, &QAction::triggered, this, &MainWindow::onFindDuplicatesActionRequested);
+    connect(m_ui->actionFindSameRecordings, &QAction::triggered, this, &MainWindow::onFindSameRecordingsActionRequested);
+    connect(m_ui->actionAnalyzeAudio, &QAction::triggered, this, &MainWindow::onAnalyzeAudioActionTriggered);
     connect(m_ui->seekMusicSlider, &QSlider::sliderPressed, this, &MainWindow::onSeekSliderPressed);
     connect(m_ui->seekMusicSlider, &QSlider::sliderReleased, this, &MainWindow::onSeekSliderReleased);
     connect(m_ui->playButton, &QPushButton::clicked, this, &MainWindow::onPlayButtonClicked);
@@ -269,14 +476,25 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_increaseVolumeBy10Shortcut, &QShortcut::activated, this, &MainWindow::onVolumeIncrease);
     connect(m_decreaseVolumeBy5Shortcut, &QShortcut::activated, this, &MainWindow::onVolumeDecrease);
     connect(m_decreaseVolumeBy10Shortcut, &QShortcut::activated, this, &MainWindow::onVolumeDecrease);
+    connect(m_searchShortcut, &QShortcut::activated, this, &MainWindow::onSearchShortcutActivated);
 
     connect(&m_player, &Player::nowPlaying, this, [this] (const QString &filename) {
         sendNotification(musicName(filename));
+
+        if (not m_library.contains(filename) or m_library.entry(filename).stale)
+            m_harvester.prioritize({filename});
+
+        m_library.setPlayed(filename, QDateTime::currentMSecsSinceEpoch());
+        m_playsUnsaved = true;
+        m_smartPlaylist.reevaluate({filename});
     });
 }
 
 MainWindow::~MainWindow()
 {
+    if (m_playsUnsaved)
+        m_library.save();
+
     delete m_ui;
 }
 
@@ -299,7 +517,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 
     m_settings->beginGroup("PlaylistSettings");
     if (m_settings->value("RememberLastSong", false).toBool() and not m_currentPlaylistName.isEmpty()) {
-        auto filename = m_playlist[m_ui->treeWidget->currentIndex().row()];
+        auto filename = m_playlist.value(m_ui->playlistView->currentIndex().row());
         m_settings->setValue("LastSong", filename);
     }
     m_settings->endGroup();
@@ -488,6 +706,44 @@ QString MainWindow::musicName(const QString &filename)
     return musicName;
 }
 
+void MainWindow::setCurrentRow(qsizetype row)
+{
+    const auto index = m_playlistModel.index(static_cast<int>(row), 0);
+    m_ui->playlistView->setCurrentIndex(index);
+    m_ui->playlistView->scrollTo(index);
+}
+
+void MainWindow::sortPlaylist()
+{
+    if (m_playlistModel.sortKeys() != TrackSorter::defaultKeys()) {
+        /* Tags decide, the library knows those of rows the harvester didn't get to yet. */
+        QStringList paths;
+        QList<TrackInfo> known;
+        for (int row = 0; row < m_playlistModel.rowCount(); ++row) {
+            if (m_playlistModel.metadata(row) != PlaylistModel::METADATA::UNKNOWN)
+                continue;
+
+            const auto path = m_playlistModel.path(row);
+            if (not m_library.contains(path))
+                continue;
+
+            const auto entry = m_library.entry(path);
+            if (not entry.stale) {
+                paths << path;
+                known << entry.info;
+            }
+        }
+
+        QHash<QString, const TrackInfo *> infos;
+        infos.reserve(paths.size());
+        for (qsizetype i = 0; i < paths.size(); ++i)
+            infos.insert(paths[i], &known[i]);
+        m_playlistModel.setTrackInfos(infos);
+    }
+
+    m_playlistModel.sortPlaylist(m_playlist);
+}
+
 void MainWindow::error(const QString &message)
 {
     QMessageBox::critical(this, tr("Error"), message);
@@ -558,7 +814,12 @@ void MainWindow::onHideShowControls(bool triggered)
     m_ui->playingLabel->setVisible(!m_controlsHidden);
     m_ui->playingEdit->setVisible(!m_controlsHidden);
     m_ui->openFilesButton->setVisible(!m_controlsHidden);
-    m_ui->treeWidget->setVisible(!m_controlsHidden);
+    m_ui->searchEdit->setVisible(!m_controlsHidden);
+    /* Whichever of the playlist and the search results was showing. */
+    const bool searching = not m_ui->searchEdit->text().trimmed().isEmpty();
+    m_ui->playlistView->setVisible(!m_controlsHidden and not searching);
+    m_ui->searchResultsWidget->setVisible(!m_controlsHidden and searching);
+    m_libraryBrowser->setVisible(!m_controlsHidden and m_ui->actionShowLibraryBrowser->isChecked());
     m_ui->openPlaylistButton->setVisible(!m_controlsHidden);
     m_ui->closePlayListButton->setVisible(!m_controlsHidden);
     m_ui->savePlaylistButton->setVisible(!m_controlsHidden);
@@ -623,22 +884,13 @@ void MainWindow::onOpenSongActionTriggered(bool triggered)
     }
 
     onStopPlayer();
+    indexTracks({filename});
     m_playlistInitState = m_playlist;
     m_player.setPlayList(m_playlist);
     m_player.setCurrent(currentIndex);
-    m_ui->treeWidget->clear();
-
-    for (const auto &filename : m_playlist) {
-        m_ui->treeWidget->insertTopLevelItem(
-            0,
-            new QTreeWidgetItem(
-                static_cast<QTreeWidget *>(nullptr),
-                { musicName(filename) }
-            )
-        );
-    }
+    m_playlistModel.setPlaylist(m_playlist, m_suspects);
 
-    m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(0));
+    setCurrentRow(currentIndex);
     m_ui->playingEdit->setText(musicName(m_playlist[currentIndex]));
 }
 
@@ -718,8 +970,8 @@ void MainWindow::finished()
     switch (m_autorepeat)
     {
     case AUTOREPEAT::NONE:
-        if (m_player.playNext())
-            m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(0));
+        if (m_player.playNext(true))
+            setCurrentRow(m_player.currentIndex());
         else
             resetControls();
         break;
@@ -730,14 +982,22 @@ void MainWindow::finished()
         if (m_playlist.size() == 1) {
             m_player.play();
         } else {
-            if (m_player.playNext()) {
-                int index = m_ui->treeWidget->currentIndex().row();
-                m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(index));
+            if (m_player.playNext(true)) {
+                setCurrentRow(m_player.currentIndex());
             } else {
-                /* We've reached the end of the playlist, let's start again. */
-                m_player.setCurrent(0);
+                /* We've reached the end of the playlist, let's start again from the first sound file. */
+                qsizetype index {};
+                while (index < m_playlist.size() and m_suspects.contains(m_playlist[index]))
+                    ++index;
+
+                if (index == m_playlist.size()) {
+                    resetControls();
+                    break;
+                }
+
+                m_player.setCurrent(index);
                 m_player.play();
-                m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(0));
+                setCurrentRow(index);
             }
         }
         break;
@@ -770,10 +1030,10 @@ void MainWindow::onChangeAudioDevice(bool checked)
     }
 }
 
-void MainWindow::onPlaylistItemDoubleClicked(QTreeWidgetItem *item)
+void MainWindow::onPlaylistItemDoubleClicked(const QModelIndex &item)
 {
-    /* Items in playlistWidget are added in the same order as those in m_playlist. */
-    auto index = m_ui->treeWidget->indexFromItem(item).row();
+    /* Rows of the model are in the same order as m_playlist. */
+    auto index = item.row();
 
     m_player.stop();
     resetControls();
@@ -787,348 +1047,1335 @@ void MainWindow::onPlaylistItemDoubleClicked(QTreeWidgetItem *item)
 
 void MainWindow::onRemoveSongActionTriggered(bool triggered)
 {
-    auto selectedItems = m_ui->treeWidget->selectedItems();
-    if (selectedItems.isEmpty()) {
+    auto selectedRows = m_ui->playlistView->selectionModel()->selectedRows();
+    if (selectedRows.isEmpty()) {
         return;
     }
 
-    /* Remember that playlistWidget has its items added in the same order as m_playlist */
-    auto index = m_ui->treeWidget->indexFromItem(selectedItems[0]).row();
-    m_ui->treeWidget->removeItemWidget(selectedItems[0], 0);
+    /* Remember that the model has its rows in the same order as m_playlist */
+    auto index = selectedRows[0].row();
+    m_playlistModel.removeRow(index);
 
     auto filename = m_playlist[index];
     m_playlist.removeAt(index);
 
-    if (filename == m_player.currentMusicFilename())
+    /* Closing the playlist forgets its name. */
+    const auto playlist = m_currentPlaylistName;
+    if (filename == m_player.currentMusicFilename()) {
         onClosePlayListActionRequested();
+    } else {
+        /* Its snapshot still has the row, next and previous would land on it. */
+        m_player.setPlayList(m_playlist);
+    }
 
-    m_playlistSettings->beginGroup("Playlists");
-    for (const auto &playlist : m_playlistSettings->childGroups()) {
-        m_playlistSettings->beginGroup(playlist);
-        if (m_playlistSettings->contains(filename)) {
-            m_playlistSettings->remove(filename);
-
-            if (m_playlistSettings->allKeys().isEmpty()) {
-                m_playlistSettings->remove(playlist);
-                m_ui->treeWidget->setHeaderLabel(tr("Playlist: Unnamed"));
-
-                m_settings->beginGroup("PlaylistSettings");
-                if (m_settings->value("DefaultPlaylist").toString() == playlist) {
-                    m_settings->setValue("DefaultPlaylist", "None");
-                }
-                m_settings->endGroup();
-            }
+    /* Only the playlist being edited loses the song, smart ones have no file. */
+    if (playlist.isEmpty() or not m_playlists.contains(playlist))
+        return;
 
-            m_playlistSettings->endGroup();
+    if (m_playlists.removePaths(playlist, {filename}) and m_playlists.size(playlist) == 0) {
+        m_playlists.remove(playlist);
+        m_playlistModel.setTitle(tr("Playlist: Unnamed"));
 
-            break;
+        m_settings->beginGroup("PlaylistSettings");
+        if (m_settings->value("DefaultPlaylist").toString() == playlist) {
+            m_settings->setValue("DefaultPlaylist", "None");
         }
-        m_playlistSettings->endGroup();
+        m_settings->endGroup();
     }
-    m_playlistSettings->endGroup();
 }
 
-QStringList MainWindow::findFiles(const QString &dir, const QStringList &filters)
+void MainWindow::onSortByActionTriggered(QAction *action)
 {
-    QStringList files;
-    for (const auto &entry : QDir(dir).entryList(QDir::Filter::AllEntries | QDir::Filter::NoDotAndDotDot)) {
-        auto filepath = QString("%1%2%3").arg(dir, QDir::separator(), entry);
+    const auto index = action->data().toInt();
+    m_playlistModel.setSortKeys(sortOrders[index].keys);
 
-        if (QFileInfo info(filepath); info.isFile()) {
-            auto fileExtension = entry.mid(entry.lastIndexOf('.'));
-            if (filters.contains(fileExtension))
-                files << filepath;
-        } else {
-            qInfo().noquote() << tr("Found directory: %1 in: %2. Looking into it...").arg(entry, dir);
-            files << findFiles(filepath, filters);
-        }
-    }
+    m_settings->beginGroup("PlaylistSettings");
+    m_settings->setValue("SortBy", index);
+    m_settings->endGroup();
+
+    /* Tracks still coming in are put in order by the scan or kept in the imported file's,
+     * the new order applies from the next sort. */
+    if (m_playlist.isEmpty() or not m_scanningDirectory.isEmpty() or not m_importingPlaylist.isEmpty()
+        or m_playlistReader)
+        return;
+
+    sortPlaylist();
+
+    /* Player finds the current song again by its name, the selection has to follow it. */
+    m_player.setPlayList(m_playlist);
+    const auto current = m_player.currentIndex();
+    if (current >= 0 and current < m_playlist.size())
+        setCurrentRow(current);
+}
 
-    if (!files.isEmpty()) {
-        qInfo().noquote() << tr("Loaded all music files from directory: %1.").arg(dir);
+void MainWindow::onSongPlaylistsActionTriggered(bool triggered)
+{
+    auto selectedRows = m_ui->playlistView->selectionModel()->selectedRows();
+    if (selectedRows.isEmpty()) {
+        return;
     }
 
-    return files;
+    const auto filename = m_playlist[selectedRows[0].row()];
+    const auto playlists = m_playlists.playlistsContaining(filename);
+    const auto message = playlists.isEmpty()
+                             ? tr("%1 isn't in any saved playlist.").arg(musicName(filename))
+                             : tr("%1 is in these playlists:\n%2").arg(musicName(filename), playlists.join('\n'));
+
+    QMessageBox::information(this, tr("Playlists"), message);
 }
 
 QStringList MainWindow::openFiles(bool justFiles)
 {
     auto dir = QStandardPaths::writableLocation(QStandardPaths::MusicLocation);
-    QString filters = tr("Audio files (");
-    QMediaFormat mediaFormat;
-    auto supportedFormats = mediaFormat.supportedFileFormats(QMediaFormat::Decode);
-    for (const auto &format : supportedFormats) {
-        switch (format)
-        {
-        case QMediaFormat::UnspecifiedFormat:
-            break;
-        case QMediaFormat::WMV:
-            filters += "*.wmv ";
-            break;
-        case QMediaFormat::AVI:
-            filters += "*.avi ";
-            break;
-        case QMediaFormat::Matroska:
-            filters += "*.mkv *.mk3d *.mka *.mks ";
-            break;
-        case QMediaFormat::MPEG4:
-            filters += "*.mp4 ";
-            break;
-        case QMediaFormat::Ogg:
-            filters += "*.ogg *.ogv *.oga *.ogx *.ogm *.spx *.opus ";
-            break;
-        case QMediaFormat::QuickTime:
-            break;
-        case QMediaFormat::WebM:
-            filters += "*.webm ";
-            break;
-        case QMediaFormat::Mpeg4Audio:
-            filters += "*.m4a ";
-            break;
-        case QMediaFormat::AAC:
-            filters += "*.aac *.3gp ";
-            break;
-        case QMediaFormat::WMA:
-            filters += "*.wma ";
-            break;
-        case QMediaFormat::MP3:
-            filters += "*.mp3 ";
-            break;
-        case QMediaFormat::FLAC:
-            filters += "*.flac ";
-            break;
-        case QMediaFormat::Wave:
-            filters += "*.wav *.wave ";
-            break;
-        }
-    }
-
-    filters = QString("%1)").arg(filters.trimmed());
 
     QStringList files;
+    /* Rows of the directory being loaded must keep matching m_playlist until it's done. */
+    if (not m_scanningDirectory.isEmpty() or not m_importingPlaylist.isEmpty() or m_playlistReader
+        or (not justFiles and m_scanner.isRunning())) {
+        QMessageBox::warning(this,
+                             tr("Warning"),
+                             tr("A directory is already being scanned, please wait until it finishes."));
+        return {};
+    }
+
     if (justFiles)
         return QFileDialog::getOpenFileNames(this,
                                              tr("Open Audio Files"),
                                              dir,
-                                             filters
+                                             MediaFormats::instance().filter()
                                              );
 
     dir = QFileDialog::getExistingDirectory(this, tr("Open Music Directory"), dir);
     if (dir.isEmpty())
         return {};
 
-    filters = filters
-                  .mid(filters.indexOf('(') + 1)
-                  .replace(")", "")
-                  .replace("*", "");
-
-    files = findFiles(dir, filters.split(' '));
-
-    if (not files.isEmpty() and m_ui->treeWidget->headerItem()->text(0).contains(tr("Unnamed"))) {
-        auto playlistName = dir.mid(dir.lastIndexOf('/') + 1);
-        m_ui->treeWidget->setHeaderLabel(tr("Playlist: %1*").arg(playlistName));
-        m_ui->treeWidget->headerItem()->setToolTip(0, tr("Playlist is currently not saved."));
+    if (m_library.containsDirectory(dir)) {
+        /* Known directory: show what the index has right away, whatever
+         * changed on disk since is applied once the rescan is done. */
+        files = m_library.files(dir);
+        QTimer::singleShot(0, this, [this, dir] () {
+            rescanDirectory(dir);
+        });
+    } else {
+        /* Files are added to the playlist as they're found, see onScanFilesFound(). */
+        startScan(dir);
+        return {};
     }
 
+    if (not files.isEmpty())
+        setUnsavedPlaylistName(dir);
+
     return files;
 }
 
-void MainWindow::onOpenFilesActionRequested()
+void MainWindow::setUnsavedPlaylistName(const QString &dir)
 {
-    bool wasPlaylistEmpty = m_playlist.isEmpty();
-    auto playlist = openFiles(sender() != m_ui->actionOpen_Directory);
-
-    if (playlist.isEmpty()) {
+    if (not m_playlistModel.title().contains(tr("Unnamed")))
         return;
-    }
 
-    m_playlist << playlist;
+    auto playlistName = dir.mid(dir.lastIndexOf('/') + 1);
+    m_playlistModel.setTitle(tr("Playlist: %1*").arg(playlistName), tr("Playlist is currently not saved."));
+}
 
-    m_player.setPlayList(m_playlist);
+void MainWindow::startScan(const QString &dir)
+{
+    m_scanningDirectory = dir;
+    m_scanSegmentStart = m_playlist.size();
+    m_scanTimer.start();
 
-    m_settings->beginGroup("Recents/Songs");
-    for (const auto &filename : playlist) {
-        auto name = musicName(filename);
+    m_scanLabel->setText(tr("Scanning: %1").arg(dir));
+    m_scanLabel->setVisible(true);
+    m_scanProgressBar->setVisible(true);
+    m_cancelScanButton->setEnabled(true);
+    m_cancelScanButton->setVisible(true);
 
-        m_ui->treeWidget->insertTopLevelItem(
-            0,
-            new QTreeWidgetItem(
-                static_cast<QTreeWidget *>(nullptr),
-                { name }
-            )
-        );
+    m_scanner.start(dir);
+}
 
-        if (wasPlaylistEmpty and not m_settings->childKeys().contains(filename))
-            m_settings->setValue(name, filename);
+void MainWindow::hideScanProgress()
+{
+    m_scanLabel->setVisible(false);
+    m_scanProgressBar->setVisible(false);
+    m_cancelScanButton->setVisible(false);
+}
 
-        auto *action = new QAction(name, this);
-        m_ui->menuSongs->addAction(action);
+void MainWindow::onScanFilesFound(const QStringList &files)
+{
+    /* Rescans report their changes in rescanDirectory(), and batches
+     * of a scan dropped by closing the playlist may still come in. */
+    if (m_scanningDirectory.isEmpty())
+        return;
 
-        connect(action, &QAction::triggered, this, &MainWindow::onOpenSongActionTriggered);
-    }
-    m_settings->endGroup();
+    const bool wasPlaylistEmpty = m_playlist.isEmpty();
+
+    /* Appended to both in the same order so rows keep matching m_playlist,
+     * they're put in order once the scan is done. */
+    m_playlist << files;
+    m_playlistModel.append(files, m_suspects);
+    m_player.setPlayList(m_playlist);
+    indexTracks(files);
 
-    m_ui->treeWidget->sortItems(0, Qt::AscendingOrder);
+    addRecentSongs(files, m_scanSegmentStart == 0);
+    setUnsavedPlaylistName(m_scanningDirectory);
 
     if (wasPlaylistEmpty) {
+        /* Playable right away, no need to wait for the rest. */
         m_player.setCurrent(0);
         m_ui->playingEdit->setText(musicName(m_playlist[0]));
-        m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(0));
+        setCurrentRow(0);
     }
 }
 
-void MainWindow::onOpenPlayListActionRequested()
+void MainWindow::onScanProgress(qint64 files, qint64 directories)
 {
-    QEventLoop loop;
-    PlaylistChooser chooser(m_playlistSettings);
-    connect(&chooser, &PlaylistChooser::closed, &loop, &QEventLoop::quit);
-    chooser.show();
-    loop.exec();
+    if (m_scanningDirectory.isEmpty() or not m_cancelScanButton->isEnabled())
+        return;
 
-    auto playlist = chooser.playlist();
-    if (playlist.isEmpty()) {
+    const double seconds = qMax<qint64>(1, m_scanTimer.elapsed()) / 1'000.0;
+    m_scanLabel->setText(tr("%1 files in %2 folders, %3 files/s")
+                             .arg(files)
+                             .arg(directories)
+                             .arg(qRound64(files / seconds)));
+}
+
+void MainWindow::onScanFinished([[maybe_unused]] const QStringList &files)
+{
+    if (m_scanningDirectory.isEmpty())
         return;
+
+    const auto dir = m_scanningDirectory;
+    m_scanningDirectory.clear();
+    hideScanProgress();
+
+    /* A cancelled scan didn't see the whole tree, don't let the library think it did. */
+    if (not m_scanner.wasCancelled()) {
+        m_library.update(dir, m_scanner.listings());
+        /* Tags read while scanning had no library entry to go to yet. */
+        for (auto it = m_unindexedTrackInfo.cbegin(); it != m_unindexedTrackInfo.cend(); ++it)
+            m_library.setTrackInfo(it.key(), it.value());
+        m_library.save();
+        m_watcher.watch(dir, m_library.directories(dir));
     }
+    m_unindexedTrackInfo.clear();
+    m_statisticsStale = true;
 
-    loadPlaylist(playlist);
+    /* Batches came in whatever order workers found them, give the segment Scanner's order. */
+    m_playlist.sort(&Scanner::lessThan, m_scanSegmentStart);
 
-    m_settings->beginGroup("Recents/Playlists");
-    if (not m_settings->childKeys().contains(playlist)) {
-        m_settings->setValue(playlist, "");
-        auto *action = new QAction(playlist, this);
-        m_ui->menuPlaylists->addAction(action);
+    /* Same rows moved around, whatever the harvester already filled in goes along with its file. */
+    m_playlistModel.reorder(m_playlist);
 
-        connect(action, &QAction::triggered, this, [this] ([[maybe_unused]] bool triggered) {
-            auto *action = qobject_cast<QAction *>(sender());
-            loadPlaylist(action->text());
-        });
-    }
-    m_settings->endGroup();
+    /* Player finds the current song again by its name, the selection has to follow it. */
+    m_player.setPlayList(m_playlist);
+    const auto current = m_player.currentIndex();
+    if (current >= 0 and current < m_playlist.size())
+        setCurrentRow(current);
 }
 
-void MainWindow::loadPlaylist(const QString &playlistName)
+void MainWindow::onCancelScan()
 {
-    if (m_player.playlistName() == playlistName)
+    /* Workers notice right away; finished() comes shortly after, nothing to wait for here. */
+    m_scanner.cancel();
+    m_importer.cancel();
+    m_cancelScanButton->setEnabled(false);
+    m_scanLabel->setText(tr("Cancelling..."));
+}
+
+void MainWindow::rescanDirectory(const QString &dir)
+{
+    if (m_scanner.isRunning())
         return;
 
-    /* First close the current playlist if there's one. */
-    onClosePlayListActionRequested();
+    auto known = m_library.files(dir);
+    auto connection = std::make_shared<QMetaObject::Connection>();
 
-    if (playlistName == "None") {
+    *connection = connect(&m_scanner, &Scanner::finished, this, [this, dir, known, connection] (const QStringList &files) {
+        disconnect(*connection);
+
+        /* The playlist was closed meanwhile. */
+        if (m_scanner.wasCancelled())
+            return;
+
+        m_library.update(dir, m_scanner.listings());
+        m_library.save();
+        m_statisticsStale = true;
+        /* Folders created while we weren't looking need a watch too. */
+        m_watcher.watch(dir, m_library.directories(dir));
+
+        const QSet<QString> before(known.cbegin(), known.cend());
+        const QSet<QString> after(files.cbegin(), files.cend());
+
+        QStringList added;
+        for (const auto &file : files)
+            if (not before.contains(file))
+                added << file;
+
+        QStringList removed;
+        for (const auto &file : known)
+            if (not after.contains(file))
+                removed << file;
+
+        applyLibraryChanges(added, removed);
+    });
+
+    m_scanner.start(dir);
+}
+
+void MainWindow::onLibraryChanged(const LibraryWatcher::Changes &changes)
+{
+    if (m_playlist.isEmpty())
         return;
-    }
 
-    m_playlistSettings->beginGroup("Playlists");
-    m_playlistSettings->beginGroup(playlistName);
+    const auto separator = QDir::separator();
+    auto isUnder = [&separator] (const QString &path, const QString &dir) {
+        return path.startsWith(dir) and path.size() > dir.size() and path[dir.size()] == separator;
+    };
 
-    QList<QTreeWidgetItem *> items;
-    for (auto filename : m_playlistSettings->allKeys()) {
-#ifdef Q_OS_LINUX
-        /* For some reason QSettings removes the first slash.
-         * Test is required for a Windows machine */
-        filename.prepend("/");
-#endif
-        m_playlist << filename;
-        auto name = musicName(m_playlistSettings->value(filename).toString());
+    /* Renames keep their place in the playlist, even the one playing. */
+    QHash<QString, QString> renamed;
+    for (const auto &[from, to] : changes.renamed)
+        renamed.insert(from, to);
 
-        items.append(
-            new QTreeWidgetItem(
-                static_cast<QTreeWidget *>(nullptr),
-                { name }
-            )
-        );
-    }
+    auto newLocation = [&] (const QString &path) {
+        if (auto it = renamed.constFind(path); it != renamed.cend())
+            return *it;
 
-    m_playlist.sort();
+        for (const auto &[from, to] : changes.renamedDirectories)
+            if (isUnder(path, from))
+                return to + path.mid(from.size());
 
-    m_ui->treeWidget->setHeaderLabel(tr("Playlist: %1").arg(playlistName));
-    m_ui->treeWidget->insertTopLevelItems(0, items);
-    m_ui->treeWidget->sortItems(0, Qt::AscendingOrder);
+        return path;
+    };
 
-    m_playlistInitState = m_playlist;
-    m_player.setPlaylistName(playlistName);
-    m_player.setPlayList(m_playlist);
-    m_player.setCurrent(0);
+    const bool moved = not renamed.isEmpty() or not changes.renamedDirectories.isEmpty();
+    if (moved) {
+        QStringList from;
+        QHash<TrackId, TrackId> tracks;
+        auto &table = TrackTable::instance();
+        for (qsizetype row = 0; row < m_playlist.size(); ++row) {
+            const auto filename = m_playlist[row];
+            const auto to = newLocation(filename);
+            if (to == filename)
+                continue;
+
+            /* Tags are the same, only the words taken from the path change. */
+            from << filename;
+            tracks.insert(m_playlist.id(row), table.intern(to));
+            reindexTrack(to, m_library.entry(filename).info);
+            m_playlistModel.setPath(row, to);
+        }
+        unindexTracks(from);
+
+        /* Once each, replacing row by row would index the playlists over and over. */
+        m_playlist.replace(tracks);
+        m_playlistInitState.replace(tracks);
+
+        /* Every saved playlist follows, not just the one that's open. */
+        QList<QPair<QString, QString>> moves;
+        for (const auto &[from, to] : changes.renamed)
+            moves << qMakePair(from, to);
+        for (const auto &[from, to] : changes.renamedDirectories) {
+            for (const auto &path : m_playlists.pathsUnder(from))
+                moves << qMakePair(path, to + path.mid(from.size()));
+        }
+        m_playlists.moveEverywhere(moves);
 
-    m_playlistSettings->endGroup(); /* Playlists */
-    m_playlistSettings->endGroup(); /* playlist */
+        const auto current = m_player.currentMusicFilename();
+        if (not current.isEmpty() and newLocation(current) != current) {
+            m_player.setCurrentMusicFilename(newLocation(current));
+            m_ui->playingEdit->setText(musicName(newLocation(current)));
+        }
+    }
 
-    m_ui->treeWidget->setHeaderLabel(tr("Playlist: %1").arg(playlistName));
-    m_ui->treeWidget->headerItem()->setToolTip(0, "");
-    m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(0));
-    m_ui->playingEdit->setText(musicName(m_playlist[0]));
+    auto removed = changes.removed;
+    for (const auto &dir : changes.removedDirectories)
+        removed << m_playlist.pathsUnder(dir);
 
-    m_currentPlaylistName = playlistName;
+    if (not changes.modified.isEmpty()) {
+        m_library.invalidate(changes.modified);
+        m_library.save();
+    }
+
+    /* Saved along with the next analysis, files that are gone are never shown anyway. */
+    m_similarityIndex.remove(removed);
+
+    /* Only files under the directories we opened are reported, those belong in the playlist. */
+    applyLibraryChanges(changes.added, removed);
+
+    if (moved and changes.added.isEmpty() and removed.isEmpty()) {
+        sortPlaylist();
+        m_player.setPlayList(m_playlist);
+    }
 }
 
-void MainWindow::setVolumeIcon()
+void MainWindow::applyLibraryChanges(const QStringList &added, const QStringList &removed)
 {
-    int level = m_ui->volumeSlider->value();
-    if (level < 25) {
-        m_ui->volumeIconButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::AudioVolumeLow));
-    } else if (level < 75) {
-        m_ui->volumeIconButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::AudioVolumeMedium));
-    } else {
-        m_ui->volumeIconButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::AudioVolumeHigh));
+    if (added.isEmpty() and removed.isEmpty())
+        return;
+
+    unindexTracks(removed);
+    indexTracks(added);
+
+    if (not removed.isEmpty()) {
+        const QSet<QString> gone(removed.cbegin(), removed.cend());
+        m_playlist.removeIf([&gone] (const QString &filename) {
+            return gone.contains(filename);
+        });
+        m_playlistModel.remove(gone);
     }
+
+    QStringList fresh;
+    for (const auto &filename : added) {
+        if (not m_playlist.contains(filename))
+            fresh << filename;
+    }
+
+    m_playlist << fresh;
+    m_playlistModel.append(fresh, m_suspects);
+    sortPlaylist();
+    m_player.setPlayList(m_playlist);
 }
 
-void MainWindow::sendNotification(const QString &name)
+void MainWindow::removeFromPlaylist(const QStringList &filenames)
 {
-    m_systray.setToolTip(tr("%1 - Now playing: %2").arg(PROJECT_NAME, name));
+    if (filenames.isEmpty())
+        return;
 
-#ifdef ENABLE_NOTIFICATIONS
-    Notifier *notifier {nullptr};
-#ifdef Q_OS_LINUX
-    const auto body = tr("Now playing:\n%1").arg(name).toStdString();
+    const QSet<QString> gone(filenames.cbegin(), filenames.cend());
+    const bool currentGone = gone.contains(m_player.currentMusicFilename());
 
-    try {
-        notifier = new Notifier(PROJECT_NAME, body.c_str());
-    } catch (NotificationException &e) {
-        QMessageBox::critical(this, tr("Error"), e.what());
+    /* One pass over the saved playlist rather than one per file, before closing it
+     * if nothing is left, which forgets its name. */
+    if (not m_currentPlaylistName.isEmpty())
+        m_playlists.removePaths(m_currentPlaylistName, filenames);
+
+    m_playlist.removeIf([&gone] (const QString &filename) {
+        return gone.contains(filename);
+    });
+
+    /* A smart playlist stays open, tracks matching its rule later on still go to it. */
+    if (m_playlist.isEmpty() and not m_smartPlaylist.isValid()) {
+        onClosePlayListActionRequested();
         return;
     }
-#elif defined(Q_OS_WIN)
-    std::wstring body {
-        tr("Now playing: %1").arg(name).toStdWString()
-    };
 
-    try {
-        notifier = new Notifier(L"" PROJECT_NAME, body);
-    } catch (NotificationException &e) {
-        QMessageBox::critical(this, tr("Error"), e.what());
-        return;
+    m_playlistModel.remove(gone);
+
+    m_player.setPlayList(m_playlist);
+    if (currentGone) {
+        m_player.stop();
+        resetControls();
+        if (m_playlist.isEmpty()) {
+            m_player.clearSource();
+            m_ui->playingEdit->clear();
+        } else {
+            m_player.setCurrent(0);
+            setCurrentRow(0);
+            m_ui->playingEdit->setText(musicName(m_playlist[0]));
+        }
     }
-#else
-    return;
-#endif
+}
 
-    connect(notifier, &Notifier::errorOccurred, this, [this] (const QString &reason) {
-        QMessageBox::critical(this, tr("Error"), reason);
-    });
+void MainWindow::onFindDuplicatesActionRequested()
+{
+    if (m_duplicateFinder.isRunning())
+        return;
 
-    notifier->sendNotification();
-    delete notifier;
-#endif // ENABLE_NOTIFICATIONS
+    if (m_playlist.isEmpty()) {
+        QMessageBox::warning(this,
+                             tr("Warning"),
+                             tr("You must first load some music files."));
+        return;
+    }
+
+    /* Sizes the library knows save stat'ing every file. Its files are searched too,
+     * a copy elsewhere in the library is worth knowing about. */
+    const auto sizes = m_library.sizes();
+    auto files = m_playlist.paths();
+    files.reserve(files.size() + sizes.size());
+    for (auto it = sizes.cbegin(); it != sizes.cend(); ++it)
+        files << it.key();
+
+    m_duplicatesProgress = new QProgressDialog(tr("Looking for identical files..."), tr("Cancel"), 0, 0, this);
+    m_duplicatesProgress->setWindowTitle(tr("Find Duplicates"));
+    m_duplicatesProgress->setWindowModality(Qt::WindowModal);
+    m_duplicatesProgress->setMinimumDuration(500);
+    connect(m_duplicatesProgress, &QProgressDialog::canceled, &m_duplicateFinder, &DuplicateFinder::cancel);
+
+    m_duplicateFinder.start(files, sizes);
 }
 
-#if defined(ENABLE_IPC) && defined(SINGLE_INSTANCE)
-void MainWindow::show()
+void MainWindow::onDuplicatesProgress(qint64 bytes, qint64 total)
 {
-    setVisible(true);
-    m_showHideSystrayAction->setText(tr("Hide"));
+    if (m_duplicatesProgress == nullptr or total == 0)
+        return;
+
+    /* In MiB, the dialog only takes ints. */
+    m_duplicatesProgress->setMaximum(static_cast<int>(total >> 20));
+    m_duplicatesProgress->setValue(static_cast<int>(bytes >> 20));
 }
-#endif
 
-void MainWindow::onClosePlayListActionRequested()
+void MainWindow::onDuplicatesFound(const QList<QStringList> &groups)
 {
-    m_player.clearSource();
+    if (m_duplicatesProgress) {
+        m_duplicatesProgress->deleteLater();
+        m_duplicatesProgress = nullptr;
+    }
+
+    if (m_duplicateFinder.wasCancelled())
+        return;
+
+    DuplicatesDialog dialog(groups, m_playlist, m_player.currentMusicFilename(), DuplicatesDialog::KIND::IDENTICAL, this);
+    if (dialog.exec() == QDialog::Accepted)
+        removeFromPlaylist(dialog.checkedFiles());
+}
+
+void MainWindow::onFindSimilarActionTriggered(bool triggered)
+{
+    auto selectedRows = m_ui->playlistView->selectionModel()->selectedRows();
+    if (selectedRows.isEmpty())
+        return;
+
+    const auto filename = m_playlistModel.path(selectedRows[0].row());
+    const QFileInfo info(filename);
+    if (m_similarityIndex.contains(filename, info.size(), info.lastModified().toMSecsSinceEpoch())) {
+        showSimilarTracks(filename);
+        return;
+    }
+
+    /* It takes a second or so, the dialog shows up as soon as it's done. */
+    m_similarPending = filename;
+    m_analyzer.prioritize(filename);
+    m_ui->statusbar->showMessage(tr("Analyzing: %1").arg(musicName(filename)));
+}
+
+void MainWindow::showSimilarTracks(const QString &filename)
+{
+    constexpr int maximumMatches = 50;
+
+    if (not m_similarityIndex.hasFingerprint(filename)) {
+        QMessageBox::warning(this,
+                             tr("Warning"),
+                             tr("%1 couldn't be decoded, there's no telling what it sounds like.")
+                                 .arg(musicName(filename)));
+        return;
+    }
+
+    auto matches = m_similarityIndex.similar(filename, maximumMatches);
+
+    /* Deleted since they were analyzed. */
+    matches.removeIf([] (const SimilarityIndex::Match &match) {
+        return not QFileInfo::exists(match.path);
+    });
+
+    QHash<QString, TrackInfo> infos;
+    for (const auto &match : std::as_const(matches))
+        if (m_library.contains(match.path))
+            infos.insert(match.path, m_library.entry(match.path).info);
+
+    SimilarTracksDialog dialog(filename, matches, infos, m_playlist, this);
+    if (dialog.exec() == QDialog::Accepted)
+        applyLibraryChanges(dialog.checkedFiles(), {});
+}
+
+void MainWindow::onFindSameRecordingsActionRequested()
+{
+    if (m_similarityIndex.size() < 2) {
+        QMessageBox::information(this,
+                                 tr("Find Re-encodes"),
+                                 tr("Nothing has been analyzed yet, use Library > Analyze Audio first."));
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    auto groups = m_similarityIndex.sameRecordings();
+    QApplication::restoreOverrideCursor();
+
+    /* Deleted since they were analyzed. */
+    for (auto &group : groups) {
+        group.removeIf([] (const QString &path) {
+            return not QFileInfo::exists(path);
+        });
+    }
+    groups.removeIf([] (const QStringList &group) {
+        return group.size() < 2;
+    });
+
+    DuplicatesDialog dialog(groups, m_playlist, m_player.currentMusicFilename(), DuplicatesDialog::KIND::SAME_RECORDING, this);
+    if (dialog.exec() == QDialog::Accepted)
+        removeFromPlaylist(dialog.checkedFiles());
+}
+
+void MainWindow::onAnalyzeAudioActionTriggered(bool checked)
+{
+    if (not checked) {
+        /* Fingerprints taken so far are kept, finished() saves them. */
+        m_analyzer.cancel();
+        m_ui->actionAnalyzeAudio->setEnabled(false);
+        m_ui->statusbar->showMessage(tr("Stopping audio analysis..."));
+        return;
+    }
+
+    /* The library's files and whatever else is in the playlist. */
+    const auto sizes = m_library.sizes();
+    QStringList files;
+    files.reserve(sizes.size() + m_playlist.size());
+    for (auto it = sizes.cbegin(); it != sizes.cend(); ++it)
+        files << it.key();
+    for (const auto &filename : m_playlist.paths())
+        if (not sizes.contains(filename))
+            files << filename;
+
+    if (files.isEmpty()) {
+        m_ui->actionAnalyzeAudio->setChecked(false);
+        QMessageBox::warning(this,
+                             tr("Warning"),
+                             tr("You must first load some music files."));
+        return;
+    }
+
+    m_ui->actionAnalyzeAudio->setToolTip(tr("Stop analyzing, fingerprints taken so far are kept"));
+    m_analyzer.start(files);
+}
+
+void MainWindow::onAnalysisProgress(qint64 files, qint64 total)
+{
+    if (m_ui->actionAnalyzeAudio->isChecked())
+        m_ui->statusbar->showMessage(tr("Analyzing audio: %1 of %2 files").arg(files).arg(total));
+
+    if (m_similarPending.isEmpty())
+        return;
+
+    const QFileInfo info(m_similarPending);
+    if (m_similarityIndex.contains(m_similarPending, info.size(), info.lastModified().toMSecsSinceEpoch())) {
+        /* Cleared first, the dialog runs an event loop of its own where more progress comes in. */
+        const auto filename = m_similarPending;
+        m_similarPending.clear();
+        m_ui->statusbar->clearMessage();
+        showSimilarTracks(filename);
+    }
+}
+
+void MainWindow::onAnalysisFinished(qint64 analyzed, qint64 failed)
+{
+    m_similarityIndex.save();
+
+    const bool cancelled = m_analyzer.wasCancelled();
+    if (m_ui->actionAnalyzeAudio->isChecked() and not cancelled)
+        m_ui->statusbar->showMessage(tr("Audio analysis done: %1 files analyzed, %2 couldn't be decoded.")
+                                         .arg(analyzed)
+                                         .arg(failed),
+                                     10'000);
+    else
+        m_ui->statusbar->clearMessage();
+
+    m_ui->actionAnalyzeAudio->setChecked(false);
+    m_ui->actionAnalyzeAudio->setEnabled(true);
+    m_ui->actionAnalyzeAudio->setToolTip(tr("Fingerprint the playlist and the library to find similar tracks and re-encodes"));
+
+    /* E.g. it was deleted before its turn came, showSimilarTracks() tells. */
+    if (not m_similarPending.isEmpty()) {
+        const auto filename = m_similarPending;
+        m_similarPending.clear();
+        if (not cancelled)
+            showSimilarTracks(filename);
+    }
+}
+
+void MainWindow::indexTracks(const QStringList &filenames)
+{
+    for (const auto &filename : filenames) {
+        if (m_searchIndex.contains(filename) and m_libraryBrowser->contains(filename))
+            continue;
+
+        const auto info = m_library.entry(filename).info;
+        if (not m_searchIndex.contains(filename))
+            m_searchIndex.insert(filename, info);
+        if (not m_libraryBrowser->contains(filename))
+            m_libraryBrowser->insert(filename, info);
+    }
+}
+
+void MainWindow::reindexTrack(const QString &filename, const TrackInfo &info)
+{
+    m_searchIndex.insert(filename, info);
+    m_libraryBrowser->insert(filename, info);
+}
+
+void MainWindow::unindexTracks(const QStringList &filenames)
+{
+    m_searchIndex.remove(filenames);
+    m_libraryBrowser->remove(filenames);
+}
+
+bool MainWindow::playTrack(const QString &filename)
+{
+    if (not QFileInfo::exists(filename)) {
+        unindexTracks({filename});
+        warning(tr("The file: %1 no longer exists.").arg(filename));
+        return false;
+    }
+
+    if (not m_playlist.contains(filename))
+        applyLibraryChanges({filename}, {});
+
+    const auto index = m_playlist.indexOf(filename);
+
+    m_player.stop();
+    resetControls();
+    m_player.setCurrent(index);
+    m_player.play();
+
+    m_ui->playingEdit->setText(musicName(filename));
+    m_ui->playButton->setText(tr("Pause"));
+    m_ui->playButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::MediaPlaybackPause));
+
+    setCurrentRow(index);
+
+    return true;
+}
+
+void MainWindow::onSearchTextChanged(const QString &text)
+{
+    constexpr int maximumResults = 200;
+
+    const bool searching = not text.trimmed().isEmpty();
+    m_ui->playlistView->setVisible(not m_controlsHidden and not searching);
+    m_ui->searchResultsWidget->setVisible(not m_controlsHidden and searching);
+    m_ui->searchResultsWidget->clear();
+
+    if (not searching) {
+        m_ui->statusbar->clearMessage();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const auto paths = m_searchIndex.search(text, maximumResults);
+    const auto elapsed = timer.nsecsElapsed();
+
+    QList<QTreeWidgetItem *> items;
+    items.reserve(paths.size());
+    for (const auto &path : paths) {
+        const auto info = m_library.entry(path).info;
+        auto *item = new QTreeWidgetItem(QStringList {musicName(path), info.title, info.artist, info.album});
+        item->setData(0, Qt::UserRole, path);
+        item->setToolTip(0, path);
+        items << item;
+    }
+
+    m_ui->searchResultsWidget->addTopLevelItems(items);
+    if (not items.isEmpty())
+        m_ui->searchResultsWidget->setCurrentItem(items.first());
+
+    m_ui->statusbar->showMessage(
+        tr("%n result(s) in %1 ms", nullptr, static_cast<int>(paths.size()))
+            .arg(static_cast<double>(elapsed) / 1'000'000, 0, 'f', 1)
+    );
+}
+
+void MainWindow::onSearchResultActivated(QTreeWidgetItem *item)
+{
+    /* Back to the playlist, showing where the track is. */
+    if (playTrack(item->data(0, Qt::UserRole).toString()))
+        m_ui->searchEdit->clear();
+    else
+        delete item;
+}
+
+void MainWindow::onShowLibraryBrowserActionTriggered(bool checked)
+{
+    m_settings->setValue("WindowSettings/ShowLibraryBrowser", checked);
+
+    /* Filled from the library the first time it's shown, kept up to date since then. */
+    if (checked and not m_libraryBrowserPopulated) {
+        m_libraryBrowserPopulated = true;
+        const auto entries = m_library.entries();
+
+        m_libraryBrowser->setUpdatesEnabled(false);
+        for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+            if (not m_libraryBrowser->contains(it.key()))
+                m_libraryBrowser->insert(it.key(), it->info);
+        }
+        m_libraryBrowser->setUpdatesEnabled(true);
+    }
+
+    m_libraryBrowser->setVisible(checked and not m_controlsHidden);
+}
+
+void MainWindow::onLibraryStatisticsActionTriggered(bool triggered)
+{
+    if (not m_statisticsDialog)
+        m_statisticsDialog = new StatisticsDialog(this);
+
+    m_statisticsDialog->show();
+    m_statisticsDialog->raise();
+    m_statisticsDialog->activateWindow();
+
+    refreshStatistics();
+    m_statisticsTimer.start();
+}
+
+void MainWindow::refreshStatistics()
+{
+    /* The next tick picks up whatever changed meanwhile. */
+    if (m_statistics.isRunning())
+        return;
+
+    m_statisticsStale = false;
+    auto entries = m_library.entries();
+
+    /* Files the scan found so far aren't in the library until it's done. Their size
+     * isn't known here, the statistics' threads stat them. */
+    if (not m_scanningDirectory.isEmpty()) {
+        for (auto i = qMin(m_scanSegmentStart, m_playlist.size()); i < m_playlist.size(); ++i) {
+            const auto filename = m_playlist[i];
+            if (entries.contains(filename))
+                continue;
+
+            Library::Entry entry;
+            entry.size = -1;
+            if (auto it = m_unindexedTrackInfo.constFind(filename); it != m_unindexedTrackInfo.cend()) {
+                entry.info = *it;
+                entry.stale = false;
+            }
+            entries.insert(filename, entry);
+        }
+    }
+
+    m_statistics.start(entries);
+}
+
+void MainWindow::onStatisticsComputed(const LibraryStatistics::Summary &summary)
+{
+    if (m_statisticsDialog)
+        m_statisticsDialog->setSummary(summary, not m_scanningDirectory.isEmpty());
+}
+
+void MainWindow::onSearchShortcutActivated()
+{
+    if (m_controlsHidden)
+        m_ui->actionHideShowControls->trigger();
+
+    m_ui->searchEdit->setFocus(Qt::ShortcutFocusReason);
+    m_ui->searchEdit->selectAll();
+}
+
+void MainWindow::appendToPlaylist(const QStringList &filenames)
+{
+    const bool wasPlaylistEmpty = m_playlist.isEmpty();
+
+    QStringList added;
+    for (const auto &filename : filenames) {
+        if (not m_playlist.contains(filename))
+            added << filename;
+    }
+
+    if (added.isEmpty())
+        return;
+
+    /* Rows keep matching m_playlist, they're put in order once everything is in. */
+    m_playlist << added;
+    m_playlistModel.append(added, m_suspects);
+    m_player.setPlayList(m_playlist);
+    indexTracks(added);
+
+    if (wasPlaylistEmpty) {
+        m_player.setCurrent(0);
+        m_ui->playingEdit->setText(musicName(m_playlist[0]));
+        setCurrentRow(0);
+    }
+}
+
+void MainWindow::loadSmartPlaylist(const QString &name, const QString &rule)
+{
+    if (not m_smartPlaylist.setRule(rule)) {
+        error(tr("The smart playlist %1 can't be opened: %2").arg(name, m_smartPlaylist.errorString()));
+        return;
+    }
+
+    m_playlistModel.setTitle(tr("Playlist: %1").arg(name), rule);
+    m_player.setPlaylistName(name);
+    m_currentPlaylistName = name;
+
+    /* Matches come in a chunk at a time, the first one is playable right away. */
+    m_smartPlaylist.start();
+}
+
+void MainWindow::onNewSmartPlaylistActionRequested()
+{
+    const auto name = QInputDialog::getText(this,
+                                            tr("Give it a name"),
+                                            tr("How should we call this smart playlist?"));
+    if (name.isEmpty())
+        return;
+
+    SmartPlaylist check;
+    QString rule;
+    for (;;) {
+        bool ok {};
+        rule = QInputDialog::getText(this,
+                                     tr("Smart Playlist"),
+                                     tr("Which tracks should %1 have? For example:\n"
+                                        "genre = jazz and duration > 5min and not played in 30 days").arg(name),
+                                     QLineEdit::Normal,
+                                     rule,
+                                     &ok);
+        if (not ok or rule.isEmpty())
+            return;
+
+        if (check.setRule(rule))
+            break;
+
+        QMessageBox::warning(this, tr("Invalid Rule"), check.errorString());
+    }
+
+    const bool isStatic = m_playlists.contains(name);
+
+    if (isStatic or m_playlistSettings->contains(QString("SmartPlaylists/%1/Rule").arg(name))) {
+        auto reply = QMessageBox::question(this,
+                                           tr("Oops"),
+                                           tr("It seems that this playlist already exists. "
+                                              "Would you like to replace it?"));
+        if (reply != QMessageBox::Yes)
+            return;
+
+        m_playlists.remove(name);
+    }
+
+    m_playlistSettings->setValue(QString("SmartPlaylists/%1/Rule").arg(name), rule);
+
+    /* Reopened even if it's the current one, its rule may have changed. */
+    if (m_currentPlaylistName == name)
+        onClosePlayListActionRequested();
+    loadPlaylist(name);
+}
+
+void MainWindow::onSmartPlaylistMatched(const QStringList &filenames)
+{
+    appendToPlaylist(filenames);
+}
+
+void MainWindow::onSmartPlaylistFinished(qsizetype count)
+{
+    /* Same order as other playlists. */
+    sortPlaylist();
+
+    m_playlistInitState = m_playlist;
+    m_player.setPlayList(m_playlist);
+    const auto current = m_player.currentIndex();
+    if (current >= 0 and current < m_playlist.size())
+        setCurrentRow(current);
+
+    if (count == 0)
+        m_ui->statusbar->showMessage(tr("No track in the library matches %1.").arg(m_smartPlaylist.rule()));
+}
+
+void MainWindow::onSmartPlaylistChanged(const QStringList &added, const QStringList &removed)
+{
+    /* The track playing stays until it's done even if it no longer matches, e.g. because it's
+     * just been played. */
+    auto leaving = removed;
+    leaving.removeAll(m_player.currentMusicFilename());
+
+    /* Added first, so the playlist is never left empty in between. */
+    appendToPlaylist(added);
+    removeFromPlaylist(leaving);
+}
+
+void MainWindow::harvestMetadata()
+{
+    prioritizeVisibleRows();
+    onHarvestDemand(m_harvester.room());
+}
+
+void MainWindow::onHarvestDemand(qsizetype room)
+{
+    /* Rows whose info is in the library don't count against room, but
+     * don't hold the GUI too long going over thousands of them either. */
+    constexpr int maximumRows = 2'048;
+
+    const auto count = m_playlistModel.rowCount();
+    QStringList paths;
+    int visited {};
+
+    for (; m_harvestCursor < count and paths.size() < room and visited < maximumRows; ++m_harvestCursor, ++visited) {
+        if (m_playlistModel.metadata(m_harvestCursor) != PlaylistModel::METADATA::UNKNOWN)
+            continue;
+
+        const auto path = m_playlistModel.path(m_harvestCursor);
+        if (m_library.contains(path)) {
+            const auto entry = m_library.entry(path);
+            if (not entry.stale) {
+                m_playlistModel.setTrackInfo(m_harvestCursor, entry.info);
+                continue;
+            }
+        }
+
+        m_playlistModel.setMetadata(m_harvestCursor, PlaylistModel::METADATA::QUEUED);
+        paths << path;
+    }
+
+    m_harvester.enqueue(paths);
+
+    /* Nothing went to the harvester so no demand() will come, carry on by ourselves. */
+    if (paths.isEmpty() and visited == maximumRows)
+        m_harvestTimer.start();
+}
+
+void MainWindow::onMetadataHarvested(const QList<MetadataHarvester::Result> &results)
+{
+    QHash<QString, const TrackInfo *> infos;
+    infos.reserve(results.size());
+    for (const auto &result : results) {
+        /* Unreadable files too, so they aren't tried over and over. */
+        if (m_library.contains(result.path)) {
+            m_library.setTrackInfo(result.path, result.info);
+            m_statisticsStale = true;
+        } else if (not m_scanningDirectory.isEmpty() and result.path.startsWith(m_scanningDirectory))
+            m_unindexedTrackInfo.insert(result.path, result.info);
+
+        reindexTrack(result.path, result.info);
+        infos.insert(result.path, &result.info);
+    }
+
+    /* Tags may bring tracks into the smart playlist or take them out. */
+    m_smartPlaylist.reevaluate(infos.keys());
+
+    m_playlistModel.setTrackInfos(infos);
+}
+
+void MainWindow::onFilesProbed(const QList<FileProber::Result> &results)
+{
+    QHash<QString, FileProber::VERDICT> changed;
+    for (const auto &result : results) {
+        const bool suspect = result.verdict != FileProber::VERDICT::OK;
+        const auto known = m_suspects.constFind(result.path);
+        const bool wasSuspect = known != m_suspects.cend();
+        if (suspect ? wasSuspect and known.value() == result.verdict : not wasSuspect)
+            continue;
+
+        if (suspect) {
+            if (not wasSuspect)
+                ++m_newSuspects;
+            m_suspects.insert(result.path, result.verdict);
+            qWarning().noquote() << QString("%1: %2").arg(result.path, FileProber::describe(result.verdict));
+        } else {
+            m_suspects.remove(result.path);
+        }
+
+        m_player.setSuspect(result.path, suspect);
+        changed.insert(result.path, result.verdict);
+    }
+
+    if (not changed.isEmpty())
+        m_playlistModel.setVerdicts(changed);
+}
+
+void MainWindow::onProberIdle()
+{
+    if (m_newSuspects == 0)
+        return;
+
+    m_ui->statusbar->showMessage(tr("%n file(s) in the playlist look broken and will be skipped.", "", m_newSuspects));
+    m_newSuspects = 0;
+}
+
+void MainWindow::prioritizeVisibleRows()
+{
+    auto *view = m_ui->playlistView;
+    const auto first = view->indexAt(QPoint(0, 0)).row();
+    if (first < 0)
+        return;
+
+    /* Rows are all as high, the last one on screen may be cut. */
+    const auto bottom = view->indexAt(QPoint(0, view->viewport()->height() - 1)).row();
+    const auto last = bottom >= 0 ? bottom : m_playlistModel.rowCount() - 1;
+    QStringList paths;
+
+    for (auto row = first; row <= last; ++row) {
+        if (m_playlistModel.metadata(row) == PlaylistModel::METADATA::KNOWN)
+            continue;
+
+        m_playlistModel.setMetadata(row, PlaylistModel::METADATA::QUEUED);
+        paths << m_playlistModel.path(row);
+    }
+
+    m_harvester.prioritize(paths);
+}
+
+void MainWindow::onOpenFilesActionRequested()
+{
+    bool wasPlaylistEmpty = m_playlist.isEmpty();
+    auto playlist = openFiles(sender() != m_ui->actionOpen_Directory);
+
+    if (playlist.isEmpty()) {
+        return;
+    }
+
+    m_playlist << playlist;
+    m_playlistModel.append(playlist, m_suspects);
+    sortPlaylist();
+
+    m_player.setPlayList(m_playlist);
+    indexTracks(playlist);
+
+    addRecentSongs(playlist, wasPlaylistEmpty);
+
+    if (wasPlaylistEmpty) {
+        m_player.setCurrent(0);
+        m_ui->playingEdit->setText(musicName(m_playlist[0]));
+        setCurrentRow(0);
+    }
+}
+
+void MainWindow::addRecentSongs(const QStringList &filenames, bool remember)
+{
+    m_settings->beginGroup("Recents/Songs");
+    const auto keys = m_settings->childKeys();
+
+    for (const auto &filename : filenames) {
+        auto name = musicName(filename);
+
+        if (remember and not keys.contains(filename))
+            m_settings->setValue(name, filename);
+
+        auto *action = new QAction(name, this);
+        m_ui->menuSongs->addAction(action);
+
+        connect(action, &QAction::triggered, this, &MainWindow::onOpenSongActionTriggered);
+    }
+
+    m_settings->endGroup();
+}
+
+void MainWindow::onOpenPlayListActionRequested()
+{
+    QEventLoop loop;
+    PlaylistChooser chooser(&m_playlists, m_playlistSettings);
+    connect(&chooser, &PlaylistChooser::closed, &loop, &QEventLoop::quit);
+    chooser.show();
+    loop.exec();
+
+    auto playlist = chooser.playlist();
+    if (playlist.isEmpty()) {
+        return;
+    }
+
+    loadPlaylist(playlist);
+
+    m_settings->beginGroup("Recents/Playlists");
+    if (not m_settings->childKeys().contains(playlist)) {
+        m_settings->setValue(playlist, "");
+        auto *action = new QAction(playlist, this);
+        m_ui->menuPlaylists->addAction(action);
+
+        connect(action, &QAction::triggered, this, [this] ([[maybe_unused]] bool triggered) {
+            auto *action = qobject_cast<QAction *>(sender());
+            loadPlaylist(action->text());
+        });
+    }
+    m_settings->endGroup();
+}
+
+void MainWindow::loadPlaylist(const QString &playlistName)
+{
+    if (m_player.playlistName() == playlistName)
+        return;
+
+    /* First close the current playlist if there's one. */
+    onClosePlayListActionRequested();
+
+    if (playlistName == "None") {
+        return;
+    }
+
+    const auto rule = m_playlistSettings->value(QString("SmartPlaylists/%1/Rule").arg(playlistName)).toString();
+    if (not rule.isEmpty()) {
+        loadSmartPlaylist(playlistName, rule);
+        return;
+    }
+
+    QString errorString;
+    auto reader = m_playlists.open(playlistName, &errorString);
+    if (not reader) {
+        error(tr("The playlist %1 can't be opened: %2").arg(playlistName, errorString));
+        return;
+    }
+
+    m_playlistModel.setTitle(tr("Playlist: %1").arg(playlistName));
+    m_player.setPlaylistName(playlistName);
+    m_currentPlaylistName = playlistName;
+
+    /* The first tracks are playable right away, whatever the size of the playlist. */
+    m_playlistReader = std::move(reader);
+    readPlaylist();
+}
+
+void MainWindow::readPlaylist()
+{
+    /* Enough to fill the view, few enough to keep the window responsive. */
+    constexpr qsizetype chunkSize = 4'096;
+
+    if (not m_playlistReader)
+        return;
+
+    /* Saved in TrackSorter's default order already. */
+    appendToPlaylist(m_playlistReader->read(chunkSize));
+    if (not m_playlistReader->atEnd()) {
+        m_playlistReadTimer.start();
+        return;
+    }
+
+    m_playlistReader.reset();
+    if (m_playlistModel.sortKeys() != TrackSorter::defaultKeys())
+        sortPlaylist();
+
+    m_playlistInitState = m_playlist;
+    m_player.setPlayList(m_playlist);
+    if (m_player.currentIndex() >= 0)
+        setCurrentRow(m_player.currentIndex());
+
+    /* Every entry at once rather than a round trip each, what's missing is reported in one go. */
+    m_validatedPlaylistName = m_currentPlaylistName;
+    m_playlistValidator.start(m_playlist.paths());
+}
+
+void MainWindow::onPlaylistValidated(const QStringList &missing)
+{
+    if (missing.isEmpty() or m_currentPlaylistName != m_validatedPlaylistName)
+        return;
+
+    /* Entries may have been removed meanwhile. */
+    const QSet<QString> missingSet(missing.cbegin(), missing.cend());
+    QStringList gone;
+    for (const auto &filename : m_playlist.paths()) {
+        if (missingSet.contains(filename))
+            gone << filename;
+    }
+
+    if (gone.isEmpty())
+        return;
+
+    QMessageBox question(this);
+    question.setIcon(QMessageBox::Warning);
+    question.setWindowTitle(tr("Missing Files"));
+    question.setText(tr("%n file(s) of the playlist %1 no longer exist.", "", gone.size()).arg(m_currentPlaylistName));
+    question.setInformativeText(tr("Remove them from the playlist?"));
+    question.setDetailedText(gone.join('\n'));
+    question.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+
+    if (question.exec() == QMessageBox::Yes)
+        removeFromPlaylist(gone);
+}
+
+void MainWindow::onRecentSongsValidated(const QStringList &missing)
+{
+    if (missing.isEmpty())
+        return;
+
+    const QSet<QString> missingSet(missing.cbegin(), missing.cend());
+    m_settings->beginGroup("Recents/Songs");
+    for (auto *action : m_ui->menuSongs->actions()) {
+        if (action == m_clearRecentSongs)
+            continue;
+
+        if (missingSet.contains(m_settings->value(action->text()).toString())) {
+            action->setEnabled(false);
+            action->setToolTip(tr("This file no longer exists."));
+        }
+    }
+    m_settings->endGroup();
+}
+
+void MainWindow::setVolumeIcon()
+{
+    int level = m_ui->volumeSlider->value();
+    if (level < 25) {
+        m_ui->volumeIconButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::AudioVolumeLow));
+    } else if (level < 75) {
+        m_ui->volumeIconButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::AudioVolumeMedium));
+    } else {
+        m_ui->volumeIconButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::AudioVolumeHigh));
+    }
+}
+
+void MainWindow::sendNotification(const QString &name)
+{
+    m_systray.setToolTip(tr("%1 - Now playing: %2").arg(PROJECT_NAME, name));
+
+#ifdef ENABLE_NOTIFICATIONS
+    Notifier *notifier {nullptr};
+#ifdef Q_OS_LINUX
+    const auto body = tr("Now playing:\n%1").arg(name).toStdString();
+
+    try {
+        notifier = new Notifier(PROJECT_NAME, body.c_str());
+    } catch (NotificationException &e) {
+        QMessageBox::critical(this, tr("Error"), e.what());
+        return;
+    }
+#elif defined(Q_OS_WIN)
+    std::wstring body {
+        tr("Now playing: %1").arg(name).toStdWString()
+    };
+
+    try {
+        notifier = new Notifier(L"" PROJECT_NAME, body);
+    } catch (NotificationException &e) {
+        QMessageBox::critical(this, tr("Error"), e.what());
+        return;
+    }
+#else
+    return;
+#endif
+
+    connect(notifier, &Notifier::errorOccurred, this, [this] (const QString &reason) {
+        QMessageBox::critical(this, tr("Error"), reason);
+    });
+
+    notifier->sendNotification();
+    delete notifier;
+#endif // ENABLE_NOTIFICATIONS
+}
+
+#if defined(ENABLE_IPC) && defined(SINGLE_INSTANCE)
+void MainWindow::show()
+{
+    setVisible(true);
+    m_showHideSystrayAction->setText(tr("Hide"));
+}
+#endif
+
+void MainWindow::onClosePlayListActionRequested()
+{
+    if (not m_scanningDirectory.isEmpty()) {
+        m_scanningDirectory.clear();
+        m_unindexedTrackInfo.clear();
+        hideScanProgress();
+    }
+
+    if (not m_importingPlaylist.isEmpty()) {
+        m_importingPlaylist.clear();
+        hideScanProgress();
+    }
+
+    /* Whatever it finds has nowhere to go now. */
+    if (m_scanner.isRunning())
+        m_scanner.cancel();
+    if (m_importer.isRunning())
+        m_importer.cancel();
+
+    m_playlistReader.reset();
+    m_playlistReadTimer.stop();
+    m_player.clearSource();
     m_playlist.clear();
-    m_ui->treeWidget->setHeaderLabel(tr("Playlist: Unnamed"));
-    m_ui->treeWidget->headerItem()->setToolTip(0, "");
+    m_smartPlaylist.clear();
+    m_watcher.clear();
+    m_harvester.clear();
     m_currentPlaylistName.clear();
-    m_ui->treeWidget->clear();
-    m_ui->treeWidget->setHeaderLabel(tr("Playlist: Unnamed"));
+    m_playlistModel.clear();
+    m_playlistModel.setTitle(tr("Playlist: Unnamed"));
     m_ui->playingEdit->setText("");
     m_ui->playButton->setText(tr("Play"));
     m_ui->playButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::MediaPlaybackStart));
@@ -1145,11 +2392,18 @@ void MainWindow::onSavePlayListActionRequested()
         return;
     }
 
+    if (m_smartPlaylist.isValid()) {
+        QMessageBox::information(this,
+                                 tr("Smart Playlist"),
+                                 tr("%1 is a smart playlist, it keeps itself up to date.").arg(m_currentPlaylistName));
+        return;
+    }
+
     bool updated {false};
     QString name;
     QStringList songs;
 
-    if (m_ui->treeWidget->headerItem()->text(0) == tr("Playlist: Unnamed")) {
+    if (m_playlistModel.title() == tr("Playlist: Unnamed")) {
         name = QInputDialog::getText(this,
                                      tr("Give it a name"),
                                      tr("How should we call this awesome playlist?"));
@@ -1157,11 +2411,11 @@ void MainWindow::onSavePlayListActionRequested()
             return;
         }
 
-        songs = m_playlist;
+        songs = m_playlist.paths();
     } else {
-        for (const auto &song : m_playlist) {
-            if (not m_playlistInitState.contains(song)) {
-                songs << song;
+        for (const auto id : m_playlist.ids()) {
+            if (not m_playlistInitState.contains(id)) {
+                songs << TrackTable::instance().path(id);
             }
         }
 
@@ -1169,35 +2423,32 @@ void MainWindow::onSavePlayListActionRequested()
             return;
         }
 
-        name = m_ui->treeWidget->headerItem()->text(0);
+        name = m_playlistModel.title();
         name = name.mid(name.indexOf(':') + 2);
         if (name.endsWith('*'))
             name = name.mid(0, name.lastIndexOf('*'));
         updated = true;
     }
 
-    m_playlistSettings->beginGroup("Playlists");
-    if (m_playlistSettings->childGroups().contains(name, Qt::CaseInsensitive) and not updated) {
+    if (m_playlists.contains(name) and not updated) {
         auto reply = QMessageBox::question(this,
                                            tr("Oops"),
                                            tr("It seems that this playlist already exists. "
                                               "Would you like to replace it?")
                                            );
         if (reply != QMessageBox::Yes) {
-            m_playlistSettings->endGroup();
             return;
         }
     }
 
-    m_playlistSettings->beginGroup(name);
-    for (const auto &filename : songs) {
-        m_playlistSettings->setValue(filename, musicName(filename));
+    if (not (updated ? m_playlists.add(name, songs) : m_playlists.save(name, songs))) {
+        error(tr("Unable to save the playlist %1.").arg(name));
+        return;
     }
-    m_playlistSettings->endGroup(); /* name */
-    m_playlistSettings->endGroup(); /* Playlists */
 
-    m_ui->treeWidget->setHeaderLabel(tr("Playlist: %1").arg(name));
+    m_playlistModel.setTitle(tr("Playlist: %1").arg(name));
     m_currentPlaylistName = name;
+    m_playlistInitState = m_playlist;
 
     if (not updated) {
         m_settings->beginGroup("Recents/Songs");
@@ -1226,7 +2477,7 @@ void MainWindow::onSavePlayListActionRequested()
 void MainWindow::onRemovePlayListActionRequested()
 {
     QEventLoop loop;
-    PlaylistChooser chooser(m_playlistSettings);
+    PlaylistChooser chooser(&m_playlists, m_playlistSettings);
     connect(&chooser, &PlaylistChooser::closed, &loop, &QEventLoop::quit);
     chooser.show();
     loop.exec();
@@ -1236,7 +2487,8 @@ void MainWindow::onRemovePlayListActionRequested()
         return;
     }
 
-    m_playlistSettings->beginGroup("Playlists");
+    m_playlists.remove(playlist);
+    m_playlistSettings->beginGroup("SmartPlaylists");
     m_playlistSettings->remove(playlist);
     m_playlistSettings->endGroup();
 
@@ -1250,6 +2502,113 @@ void MainWindow::onRemovePlayListActionRequested()
                              );
 }
 
+void MainWindow::onImportPlayListActionRequested()
+{
+    /* Imported rows are appended like a scan's, one at a time keeps them matching m_playlist. */
+    if (not m_scanningDirectory.isEmpty() or not m_importingPlaylist.isEmpty() or m_playlistReader
+        or m_scanner.isRunning()) {
+        QMessageBox::warning(this,
+                             tr("Warning"),
+                             tr("Music is already being loaded, please wait until it finishes."));
+        return;
+    }
+
+    const auto filename = QFileDialog::getOpenFileName(this,
+                                                       tr("Import Playlist"),
+                                                       QStandardPaths::writableLocation(QStandardPaths::MusicLocation),
+                                                       PlaylistFormats::filter());
+    if (filename.isEmpty())
+        return;
+
+    m_importingPlaylist = filename;
+    m_scanLabel->setText(tr("Importing: %1").arg(filename));
+    m_scanLabel->setVisible(true);
+    m_scanProgressBar->setVisible(true);
+    m_cancelScanButton->setEnabled(true);
+    m_cancelScanButton->setVisible(true);
+
+    m_importer.start(filename);
+}
+
+void MainWindow::onImportTracksFound(const QStringList &files)
+{
+    /* Batches of an import dropped by closing the playlist may still come in. */
+    if (m_importingPlaylist.isEmpty())
+        return;
+
+    QStringList fresh;
+    QSet<QString> seen;
+    for (const auto &file : files) {
+        if (not m_playlist.contains(file) and not seen.contains(file)) {
+            seen.insert(file);
+            fresh << file;
+        }
+    }
+
+    if (fresh.isEmpty())
+        return;
+
+    const bool wasPlaylistEmpty = m_playlist.isEmpty();
+
+    /* Already in the playlist file's order, which is kept. */
+    m_playlist << fresh;
+    m_playlistModel.append(fresh, m_suspects);
+    m_player.setPlayList(m_playlist);
+    indexTracks(fresh);
+    setUnsavedPlaylistName(QFileInfo(m_importingPlaylist).completeBaseName());
+
+    if (wasPlaylistEmpty) {
+        /* Playable right away, no need to wait for the rest. */
+        m_player.setCurrent(0);
+        m_ui->playingEdit->setText(musicName(m_playlist[0]));
+        setCurrentRow(0);
+    }
+}
+
+void MainWindow::onImportFinished(qint64 imported, qint64 missing)
+{
+    if (m_importingPlaylist.isEmpty())
+        return;
+
+    const auto filename = m_importingPlaylist;
+    m_importingPlaylist.clear();
+    hideScanProgress();
+
+    if (missing > 0)
+        warning(tr("%1 of the tracks in %2 couldn't be found.").arg(missing).arg(filename));
+    else if (imported == 0 and not m_importer.wasCancelled())
+        warning(tr("%1 has no tracks.").arg(filename));
+}
+
+void MainWindow::onExportPlayListActionRequested()
+{
+    if (m_playlist.isEmpty()) {
+        QMessageBox::warning(this,
+                             tr("Warning"),
+                             tr("You must first load some music files."));
+        return;
+    }
+
+    const auto name = m_currentPlaylistName.isEmpty() ? tr("Playlist") : m_currentPlaylistName;
+    const auto filename = QFileDialog::getSaveFileName(this,
+                                                       tr("Export Playlist"),
+                                                       QDir(QStandardPaths::writableLocation(QStandardPaths::MusicLocation))
+                                                           .filePath(name + ".m3u8"),
+                                                       PlaylistFormats::filter());
+    if (filename.isEmpty())
+        return;
+
+    QString errorString;
+    const bool written = PlaylistFormats::write(filename, m_playlist.paths(), [this] (const QString &path) {
+        return m_library.entry(path).info;
+    }, &errorString);
+
+    if (not written) {
+        error(tr("Unable to export the playlist to %1: %2").arg(filename, errorString));
+        return;
+    }
+}
+
 void MainWindow::onOpenSettings()
 {
     QEventLoop loop;
@@ -1333,7 +2692,7 @@ void MainWindow::onPlayPrevious()
 {
     if (m_player.playPrevious()) {
         int index = m_player.currentIndex();
-        m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(index));
+        setCurrentRow(index);
         m_ui->playingEdit->setText(musicName(m_playlist[index]));
     } /* No need to warn because player emits a warning signal and it's caught by this class. */
 }
@@ -1342,7 +2701,7 @@ void MainWindow::onPlayNext()
 {
     if (m_player.playNext()) {
         int index = m_player.currentIndex();
-        m_ui->treeWidget->setCurrentItem(m_ui->treeWidget->topLevelItem(index));
+        setCurrentRow(index);
         m_ui->playingEdit->setText(musicName(m_playlist[index]));
         m_ui->playButton->setText(tr("Pause"));
         m_ui->playButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::MediaPlaybackPause));
@@ -2,16 +2,24 @@
 #define MAINWINDOW_HPP
 
 #include <QAction>
+#include <QActionGroup>
 #include <QCloseEvent>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QLabel>
 #include <QMainWindow>
 #include <QMediaDevices>
 #include <QMouseEvent>
+#include <QProgressBar>
+#include <QProgressDialog>
+#include <QPushButton>
 #include <QSettings>
 #include <QShortcut>
 #include <QShowEvent>
 #include <QStandardPaths>
 #include <QSystemTrayIcon>
+#include <QTimer>
 #include <QTreeWidgetItem>
 #ifdef ENABLE_VIDEO_PLAYER
     #include <QVideoWidget>
@@ -20,8 +28,26 @@
     #include <QDBusConnection>
 #endif // ENABLE_IPC
 
+#include "acousticanalyzer.hpp"
 #include "config.hpp"
+#include "duplicatefinder.hpp"
+#include "fileprober.hpp"
+#include "filevalidator.hpp"
+#include "library.hpp"
+#include "librarybrowser.hpp"
+#include "librarystatistics.hpp"
+#include "librarywatcher.hpp"
+#include "metadataharvester.hpp"
 #include "player.hpp"
+#include "playlist.hpp"
+#include "playlistformats.hpp"
+#include "playlistmodel.hpp"
+#include "playliststore.hpp"
+#include "scanner.hpp"
+#include "searchindex.hpp"
+#include "similarityindex.hpp"
+#include "smartplaylist.hpp"
+#include "statisticsdialog.hpp"
 #ifdef ENABLE_VIDEO_PLAYER
     #include "videoplayer.hpp"
 #endif
@@ -45,6 +71,28 @@ class MainWindow : public QMainWindow
     void setAudioOutputs();
     void resetControls();
     QString musicName(const QString &filename);
+    /* Makes row of the playlist the current one and shows it. */
+    void setCurrentRow(qsizetype row);
+    /* Puts m_playlist in the order picked in "Sort by", rows follow. */
+    void sortPlaylist();
+    void setUnsavedPlaylistName(const QString &dir);
+    void addRecentSongs(const QStringList &filenames, bool remember);
+    void startScan(const QString &dir);
+    void hideScanProgress();
+    /* Updates the playlist with files that appeared in or vanished from disk. */
+    void applyLibraryChanges(const QStringList &added, const QStringList &removed);
+    /* Removes all of them at once, from the saved playlist too. */
+    void removeFromPlaylist(const QStringList &filenames);
+    void showSimilarTracks(const QString &filename);
+    /* Makes files searchable and browsable, those already indexed keep their tags. */
+    void indexTracks(const QStringList &filenames);
+    void reindexTrack(const QString &filename, const TrackInfo &info);
+    void unindexTracks(const QStringList &filenames);
+    /* Adds those not in the playlist yet at its end, the first one is made current if it was empty. */
+    void appendToPlaylist(const QStringList &filenames);
+    void loadSmartPlaylist(const QString &name, const QString &rule);
+    /* Appends the next chunk of the saved playlist being opened, the rest on the event loop. */
+    void readPlaylist();
 
 public:
     MainWindow(QWidget *parent = nullptr);
@@ -71,14 +119,78 @@ private:
     QAction *m_showHideControlsTreeWidgetAction;
     QAction *m_addSongToPlaylist;
     QAction *m_removeSongAction;
+    QAction *m_songPlaylistsAction;
+    QActionGroup *m_sortByGroup;
+    QAction *m_findSimilarAction;
+    QAction *m_addBrowsedTracksAction;
 
     QSettings *m_settings;
+    /* Smart playlists' rules, saved playlists are in m_playlists. */
     QSettings *m_playlistSettings;
+    PlaylistStore m_playlists;
 
     Player m_player;
-    QStringList m_playlistInitState;
-    QStringList m_playlist;
+    /* Before m_scanner, whose threads read it until they're done. */
+    Library m_library;
+    Scanner m_scanner;
+    LibraryWatcher m_watcher;
+    /* Directory whose files are being streamed into the playlist, empty when there's none. */
+    QString m_scanningDirectory;
+    /* Where its files start in m_playlist. */
+    qsizetype m_scanSegmentStart;
+    QElapsedTimer m_scanTimer;
+    QProgressBar *m_scanProgressBar;
+    QLabel *m_scanLabel;
+    QPushButton *m_cancelScanButton;
+    PlaylistImporter m_importer;
+    /* Playlist file whose tracks are being streamed into the playlist, empty when there's none. */
+    QString m_importingPlaylist;
+    MetadataHarvester m_harvester;
+    /* Rows before it were already handed to the harvester or have their info. */
+    qsizetype m_harvestCursor;
+    /* Coalesces row insertions and scrolling into one pass. */
+    QTimer m_harvestTimer;
+    /* Tags of files found by the scan in progress, the library knows them once it's done. */
+    QHash<QString, TrackInfo> m_unindexedTrackInfo;
+    FileProber m_prober;
+    /* Files found broken, skipped when moving on to the next track by ourselves. */
+    QHash<QString, FileProber::VERDICT> m_suspects;
+    /* Found since the prober last went idle. */
+    qsizetype m_newSuspects;
+    FileValidator m_playlistValidator;
+    /* Playlist being validated, its missing files are reported only if it's still open. */
+    QString m_validatedPlaylistName;
+    FileValidator m_recentSongsValidator;
+    DuplicateFinder m_duplicateFinder;
+    QProgressDialog *m_duplicatesProgress;
+    /* Declared first so it outlives the analyzer's threads. */
+    SimilarityIndex m_similarityIndex;
+    AcousticAnalyzer m_analyzer;
+    /* Track whose similar ones are shown once it's been analyzed. */
+    QString m_similarPending;
+    SearchIndex m_searchIndex;
+    LibraryBrowser *m_libraryBrowser;
+    /* Whether it's been filled from the library yet, it is the first time it's shown. */
+    bool m_libraryBrowserPopulated;
+    LibraryStatistics m_statistics;
+    /* Created the first time it's asked for. */
+    StatisticsDialog *m_statisticsDialog;
+    /* Refreshes the dialog while it's shown and the library keeps changing. */
+    QTimer m_statisticsTimer;
+    bool m_statisticsStale;
+    /* Rule of the open playlist if it's a smart one. */
+    SmartPlaylist m_smartPlaylist;
+    /* Play counts the library has that aren't on disk yet. */
+    bool m_playsUnsaved;
+    /* Snapshots sharing their track ids, the player holds one too. */
+    Playlist m_playlistInitState;
+    Playlist m_playlist;
+    /* What the playlist view shows, its rows always match m_playlist. */
+    PlaylistModel m_playlistModel;
     QString m_currentPlaylistName;
+    /* Saved playlist whose tracks are still being added, nullptr when there's none. */
+    std::unique_ptr<PlaylistStore::Reader> m_playlistReader;
+    QTimer m_playlistReadTimer;
     bool m_canModifySlider;
 
     qint8 m_hours;
@@ -110,6 +222,7 @@ private:
     QShortcut *m_increaseVolumeBy10Shortcut; /* Shift + Up arrow */
     QShortcut *m_decreaseVolumeBy5Shortcut; /* Down arrow */
     QShortcut *m_decreaseVolumeBy10Shortcut; /* Shift + Down arrow */
+    QShortcut *m_searchShortcut; /* Ctrl + F */
 
     bool m_controlsHidden;
 
@@ -124,15 +237,56 @@ private slots:
     void positionChanged(qint64 position);
     void finished();
     void onChangeAudioDevice([[maybe_unused]] bool checked);
-    void onPlaylistItemDoubleClicked(QTreeWidgetItem *item);
+    void onPlaylistItemDoubleClicked(const QModelIndex &index);
     void onRemoveSongActionTriggered([[maybe_unused]] bool triggered);
-    QStringList findFiles(const QString &dir, const QStringList &filters);
+    void onSongPlaylistsActionTriggered([[maybe_unused]] bool triggered);
+    void onSortByActionTriggered(QAction *action);
     QStringList openFiles(bool justFiles = true);
+    void rescanDirectory(const QString &dir);
+    void onScanFilesFound(const QStringList &files);
+    void onScanProgress(qint64 files, qint64 directories);
+    void onScanFinished(const QStringList &files);
+    void onCancelScan();
+    void harvestMetadata();
+    void onHarvestDemand(qsizetype room);
+    void onMetadataHarvested(const QList<MetadataHarvester::Result> &results);
+    void prioritizeVisibleRows();
+    void onFilesProbed(const QList<FileProber::Result> &results);
+    void onProberIdle();
+    void onPlaylistValidated(const QStringList &missing);
+    void onRecentSongsValidated(const QStringList &missing);
+    void onLibraryChanged(const LibraryWatcher::Changes &changes);
+    void onFindDuplicatesActionRequested();
+    void onDuplicatesProgress(qint64 bytes, qint64 total);
+    void onDuplicatesFound(const QList<QStringList> &groups);
+    void onFindSimilarActionTriggered([[maybe_unused]] bool triggered);
+    void onFindSameRecordingsActionRequested();
+    void onAnalyzeAudioActionTriggered(bool checked);
+    void onAnalysisProgress(qint64 files, qint64 total);
+    void onAnalysisFinished(qint64 analyzed, qint64 failed);
+    void onSearchTextChanged(const QString &text);
+    void onSearchResultActivated(QTreeWidgetItem *item);
+    void onSearchShortcutActivated();
+    /* Plays filename, adding it to the playlist if needed. False if it no longer exists. */
+    bool playTrack(const QString &filename);
+    void onShowLibraryBrowserActionTriggered(bool checked);
+    void onLibraryStatisticsActionTriggered([[maybe_unused]] bool triggered);
+    /* Sums up the library and whatever the scan in progress found so far. */
+    void refreshStatistics();
+    void onStatisticsComputed(const LibraryStatistics::Summary &summary);
+    void onNewSmartPlaylistActionRequested();
+    void onSmartPlaylistMatched(const QStringList &filenames);
+    void onSmartPlaylistFinished(qsizetype count);
+    void onSmartPlaylistChanged(const QStringList &added, const QStringList &removed);
     void onOpenFilesActionRequested();
     void onOpenPlayListActionRequested();
     void onClosePlayListActionRequested();
     void onSavePlayListActionRequested();
     void onRemovePlayListActionRequested();
+    void onImportPlayListActionRequested();
+    void onImportTracksFound(const QStringList &files);
+    void onImportFinished(qint64 imported, qint64 missing);
+    void onExportPlayListActionRequested();
     void onOpenSettings();
     void playPauseHelper();
     void onPlayButtonClicked();
@@ -0,0 +1,274 @@
+#include "mediaformats.hpp"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+namespace {
+struct Extension
+{
+    std::string_view name;
+    QMediaFormat::FileFormat format;
+};
+
+/* Sorted by name, lower case. QuickTime files are left out on purpose, .mov is
+ * mostly video, but they're still recognized by their content. */
+constexpr Extension mediaExtensions[] = {
+    {"3gp", QMediaFormat::AAC},
+    {"aac", QMediaFormat::AAC},
+    {"avi", QMediaFormat::AVI},
+    {"flac", QMediaFormat::FLAC},
+    {"m4a", QMediaFormat::Mpeg4Audio},
+    {"mk3d", QMediaFormat::Matroska},
+    {"mka", QMediaFormat::Matroska},
+    {"mks", QMediaFormat::Matroska},
+    {"mkv", QMediaFormat::Matroska},
+    {"mp3", QMediaFormat::MP3},
+    {"mp4", QMediaFormat::MPEG4},
+    {"oga", QMediaFormat::Ogg},
+    {"ogg", QMediaFormat::Ogg},
+    {"ogm", QMediaFormat::Ogg},
+    {"ogv", QMediaFormat::Ogg},
+    {"ogx", QMediaFormat::Ogg},
+    {"opus", QMediaFormat::Ogg},
+    {"spx", QMediaFormat::Ogg},
+    {"wav", QMediaFormat::Wave},
+    {"wave", QMediaFormat::Wave},
+    {"webm", QMediaFormat::WebM},
+    {"wma", QMediaFormat::WMA},
+    {"wmv", QMediaFormat::WMV},
+};
+
+/* What usually sits next to music and isn't worth opening. Sorted too. */
+constexpr std::string_view ignoredExtensions[] = {
+    "accurip", "bmp", "cue", "db", "gif", "htm", "html", "ico", "ini", "jpeg", "jpg",
+    "json", "log", "lrc", "m3u", "m3u8", "md5", "nfo", "pdf", "pls", "png", "rtf",
+    "sfv", "tif", "tiff", "torrent", "txt", "url", "webp", "xml", "xspf", "zip",
+};
+
+constexpr std::size_t longestExtension = 8;
+
+constexpr std::string_view nameOf(const Extension &extension) { return extension.name; }
+constexpr std::string_view nameOf(std::string_view extension) { return extension; }
+
+/* std::is_sorted isn't constexpr before C++20. */
+template <typename T, std::size_t N>
+constexpr bool isSorted(const T (&table)[N])
+{
+    for (std::size_t i = 1; i < N; ++i) {
+        if (not (nameOf(table[i - 1]) < nameOf(table[i])))
+            return false;
+    }
+
+    return true;
+}
+
+static_assert(isSorted(mediaExtensions), "mediaExtensions must be sorted for the binary search.");
+static_assert(isSorted(ignoredExtensions), "ignoredExtensions must be sorted for the binary search.");
+
+template <typename T, std::size_t N>
+const T *lookup(const T (&table)[N], std::string_view name)
+{
+    const auto it = std::lower_bound(std::begin(table), std::end(table), name,
+                                     [] (const T &entry, std::string_view name) { return nameOf(entry) < name; });
+    return it != std::end(table) and nameOf(*it) == name ? it : nullptr;
+}
+
+char16_t code(QChar c) { return c.unicode(); }
+char16_t code(char c) { return static_cast<unsigned char>(c); }
+
+/* Lower cases the extension of name, if any, into buffer. False if it's too
+ * long or not ASCII, so it can't be any of ours. */
+template <typename Char>
+bool extensionOf(const Char *name, std::size_t size, char (&buffer)[longestExtension], std::string_view &extension)
+{
+    auto dot = size;
+    while (dot > 0 and code(name[dot - 1]) != '.' and code(name[dot - 1]) != '/')
+        --dot;
+
+    extension = {};
+    if (dot == 0 or code(name[dot - 1]) != '.')
+        return true;
+
+    const auto length = size - dot;
+    if (length > longestExtension)
+        return false;
+
+    for (std::size_t i = 0; i < length; ++i) {
+        const auto c = code(name[dot + i]);
+        if (c >= 0x80)
+            return false;
+
+        buffer[i] = static_cast<char>(c >= 'A' and c <= 'Z' ? c + ('a' - 'A') : c);
+    }
+
+    extension = std::string_view(buffer, length);
+    return true;
+}
+
+template <typename Char>
+QMediaFormat::FileFormat formatOf(const Char *name, std::size_t size)
+{
+    char buffer[longestExtension];
+    std::string_view extension;
+    if (not extensionOf(name, size, buffer, extension) or extension.empty())
+        return QMediaFormat::UnspecifiedFormat;
+
+    const auto *found = lookup(mediaExtensions, extension);
+    return found ? found->format : QMediaFormat::UnspecifiedFormat;
+}
+
+template <typename Char>
+bool worthSniffing(const Char *name, std::size_t size)
+{
+    char buffer[longestExtension];
+    std::string_view extension;
+    if (not extensionOf(name, size, buffer, extension) or extension.empty())
+        return true;
+
+    return not lookup(mediaExtensions, extension) and not lookup(ignoredExtensions, extension);
+}
+} // namespace
+
+MediaFormats::MediaFormats()
+    : m_supported {0}
+{
+    for (const auto format : QMediaFormat().supportedFileFormats(QMediaFormat::Decode)) {
+        if (format != QMediaFormat::UnspecifiedFormat)
+            m_supported |= 1u << format;
+    }
+}
+
+const MediaFormats &MediaFormats::instance()
+{
+    /* Asking the backend may load it, so the first call better come from the GUI thread. */
+    static const MediaFormats formats;
+    return formats;
+}
+
+bool MediaFormats::isSupported(QMediaFormat::FileFormat format) const
+{
+    return format != QMediaFormat::UnspecifiedFormat and (m_supported & (1u << format));
+}
+
+QStringList MediaFormats::extensions() const
+{
+    QStringList extensions;
+    for (const auto &extension : mediaExtensions) {
+        if (isSupported(extension.format))
+            extensions << QStringLiteral(".") + QString::fromLatin1(extension.name.data(), qsizetype(extension.name.size()));
+    }
+
+    return extensions;
+}
+
+QString MediaFormats::filter() const
+{
+    auto patterns = extensions();
+    for (auto &pattern : patterns)
+        pattern.prepend('*');
+
+    return QCoreApplication::translate("MediaFormats", "Audio files (%1)").arg(patterns.join(' '));
+}
+
+QMediaFormat::FileFormat MediaFormats::fromName(QStringView name)
+{
+    return formatOf(name.data(), static_cast<std::size_t>(name.size()));
+}
+
+QMediaFormat::FileFormat MediaFormats::fromName(const char *name)
+{
+    return formatOf(name, std::strlen(name));
+}
+
+bool MediaFormats::isWorthSniffing(QStringView name)
+{
+    return worthSniffing(name.data(), static_cast<std::size_t>(name.size()));
+}
+
+bool MediaFormats::isWorthSniffing(const char *name)
+{
+    return worthSniffing(name, std::strlen(name));
+}
+
+QMediaFormat::FileFormat MediaFormats::fromHeader(const char *data, qsizetype size)
+{
+    const auto startsWith = [data, size] (qsizetype offset, const char *magic, qsizetype length) {
+        return size >= offset + length and std::memcmp(data + offset, magic, length) == 0;
+    };
+    const auto byte = [data] (qsizetype offset) { return static_cast<unsigned char>(data[offset]); };
+
+    if (startsWith(0, "ID3", 3))
+        return QMediaFormat::MP3;
+    if (startsWith(0, "fLaC", 4))
+        return QMediaFormat::FLAC;
+    if (startsWith(0, "OggS", 4))
+        return QMediaFormat::Ogg;
+
+    if (startsWith(0, "RIFF", 4)) {
+        if (startsWith(8, "WAVE", 4))
+            return QMediaFormat::Wave;
+        if (startsWith(8, "AVI ", 4))
+            return QMediaFormat::AVI;
+        return QMediaFormat::UnspecifiedFormat;
+    }
+
+    if (startsWith(0, "\x1A\x45\xDF\xA3", 4)) {
+        /* The EBML header names its DocType right away. */
+        const std::string_view header(data, static_cast<std::size_t>(size));
+        return header.find("webm") != std::string_view::npos ? QMediaFormat::WebM : QMediaFormat::Matroska;
+    }
+
+    if (startsWith(4, "ftyp", 4)) {
+        if (startsWith(8, "M4A ", 4) or startsWith(8, "M4B ", 4) or startsWith(8, "M4P ", 4))
+            return QMediaFormat::Mpeg4Audio;
+        if (startsWith(8, "qt  ", 4))
+            return QMediaFormat::QuickTime;
+        return QMediaFormat::MPEG4;
+    }
+
+    if (startsWith(0, "ADIF", 4))
+        return QMediaFormat::AAC;
+
+    /* ASF holds both, it takes more than its header to tell audio from video. */
+    if (startsWith(0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11", 8))
+        return QMediaFormat::WMA;
+
+    /* Raw streams start right away with a frame sync: 12 bits set for ADTS, 11 for MPEG audio. */
+    if (size >= 3 and byte(0) == 0xFF) {
+        if ((byte(1) & 0xF6) == 0xF0)
+            return QMediaFormat::AAC;
+
+        const bool validVersion = (byte(1) & 0x18) != 0x08;
+        const bool validLayer = (byte(1) & 0x06) != 0;
+        const bool validBitrate = (byte(2) & 0xF0) != 0xF0;
+        const bool validSampleRate = (byte(2) & 0x0C) != 0x0C;
+        if ((byte(1) & 0xE0) == 0xE0 and validVersion and validLayer and validBitrate and validSampleRate)
+            return QMediaFormat::MP3;
+    }
+
+    return QMediaFormat::UnspecifiedFormat;
+}
+
+QMediaFormat::FileFormat MediaFormats::fromContent(const QString &path)
+{
+    QFile file(path);
+    if (not file.open(QIODevice::ReadOnly))
+        return QMediaFormat::UnspecifiedFormat;
+
+    char header[headerSize];
+    const auto size = file.read(header, headerSize);
+    return size > 0 ? fromHeader(header, size) : QMediaFormat::UnspecifiedFormat;
+}
+
+bool MediaFormats::isPlayable(const QString &path, bool sniff) const
+{
+    const auto format = fromName(path);
+    if (format != QMediaFormat::UnspecifiedFormat)
+        return isSupported(format);
+
+    return sniff and isWorthSniffing(path) and isSupported(fromContent(path));
+}
@@ -0,0 +1,49 @@
+#ifndef MEDIAFORMATS_HPP
+#define MEDIAFORMATS_HPP
+
+#include <QMediaFormat>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+/* The one place that knows which files we can play: every container Qt Multimedia may
+ * decode, the extensions it goes by and how its files begin. Extensions are looked up in
+ * a table sorted at compile time, so telling a music file from a cover or a cue sheet
+ * costs a binary search and no allocation. Files whose name says nothing, no extension or
+ * one nobody uses for media, can be told apart by their first bytes instead.
+ * What the backend decodes is asked once per process, use instance(). */
+class MediaFormats
+{
+    MediaFormats();
+
+public:
+    /* Enough of a file's beginning for fromHeader() to recognize it. */
+    static constexpr qsizetype headerSize = 64;
+
+    static const MediaFormats &instance();
+    bool isSupported(QMediaFormat::FileFormat format) const;
+    /* Lower case and with their dot, e.g. ".mp3", only for formats that are supported. */
+    QStringList extensions() const;
+    /* For file dialogs, e.g. "Audio files (*.mp3 *.flac)". */
+    QString filter() const;
+
+    /* By extension, ignoring case, UnspecifiedFormat if it isn't a media one. */
+    static QMediaFormat::FileFormat fromName(QStringView name);
+    static QMediaFormat::FileFormat fromName(const char *name);
+    /* Whether it's worth looking inside a file so named: it has no extension or
+     * one that's neither a media one nor one of the usual companions of music
+     * (covers, cue sheets, logs, playlists...). */
+    static bool isWorthSniffing(QStringView name);
+    static bool isWorthSniffing(const char *name);
+    /* By magic bytes, given at least headerSize of them if the file has that many. */
+    static QMediaFormat::FileFormat fromHeader(const char *data, qsizetype size);
+    static QMediaFormat::FileFormat fromContent(const QString &path);
+
+    /* By name, and if sniff is set and the name says nothing, by content. */
+    bool isPlayable(const QString &path, bool sniff = false) const;
+
+private:
+    quint32 m_supported;
+};
+
+#endif // MEDIAFORMATS_HPP
@@ -0,0 +1,179 @@
+#include "metadataharvester.hpp"
+
+#include <QMutexLocker>
+#include <algorithm>
+
+#include "tagreader.hpp"
+
+namespace {
+constexpr qsizetype defaultCapacity = 1024;
+constexpr int deliveryInterval = 100;
+/* Reading tags is mostly waiting for the disk, a few threads are plenty. */
+constexpr int maximumThreads = 4;
+}
+
+MetadataHarvester::MetadataHarvester(QObject *parent)
+    : QObject {parent}
+    , m_capacity {defaultCapacity}
+    , m_reading {0}
+    , m_generation {0}
+    , m_stopping {false}
+{
+    m_deliveryTimer.setInterval(deliveryInterval);
+    connect(&m_deliveryTimer, &QTimer::timeout, this, &MetadataHarvester::deliver);
+
+    const int count = qBound(1, QThread::idealThreadCount() / 2, maximumThreads);
+    for (int i = 0; i < count; ++i) {
+        auto *thread = QThread::create([this] () { work(); });
+        thread->start(QThread::LowPriority);
+        m_threads << thread;
+    }
+}
+
+MetadataHarvester::~MetadataHarvester()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_condition.wakeAll();
+    }
+
+    for (auto *thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void MetadataHarvester::setCapacity(qsizetype capacity)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = qMax<qsizetype>(1, capacity);
+}
+
+qsizetype MetadataHarvester::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capacity;
+}
+
+qsizetype MetadataHarvester::usedLocked() const
+{
+    /* Undelivered results count too, otherwise a slow GUI would let them pile up. */
+    return static_cast<qsizetype>(m_queue.size()) + m_reading + m_results.size();
+}
+
+qsizetype MetadataHarvester::room() const
+{
+    QMutexLocker locker(&m_mutex);
+    return qMax<qsizetype>(0, m_capacity - usedLocked());
+}
+
+qsizetype MetadataHarvester::enqueue(const QStringList &paths)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto taken = qMin(paths.size(), qMax<qsizetype>(0, m_capacity - usedLocked()));
+    if (taken == 0)
+        return 0;
+
+    for (qsizetype i = 0; i < taken; ++i)
+        m_queue.push_back(paths[i]);
+
+    m_condition.wakeAll();
+    locker.unlock();
+
+    if (not m_deliveryTimer.isActive())
+        m_deliveryTimer.start();
+
+    return taken;
+}
+
+void MetadataHarvester::prioritize(const QStringList &paths)
+{
+    if (paths.isEmpty())
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    for (const auto &path : paths) {
+        /* Don't read it twice if it was already waiting its turn. */
+        auto it = std::find(m_queue.begin(), m_queue.end(), path);
+        if (it != m_queue.end())
+            m_queue.erase(it);
+
+        if (std::find(m_urgent.cbegin(), m_urgent.cend(), path) == m_urgent.cend())
+            m_urgent.push_back(path);
+    }
+
+    m_condition.wakeAll();
+    locker.unlock();
+
+    if (not m_deliveryTimer.isActive())
+        m_deliveryTimer.start();
+}
+
+void MetadataHarvester::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_urgent.clear();
+    m_queue.clear();
+    m_results.clear();
+    ++m_generation;
+}
+
+void MetadataHarvester::work()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (;;) {
+        while (not m_stopping and m_urgent.empty() and m_queue.empty())
+            m_condition.wait(&m_mutex);
+
+        if (m_stopping)
+            return;
+
+        auto &source = m_urgent.empty() ? m_queue : m_urgent;
+        const auto path = std::move(source.front());
+        source.pop_front();
+        const auto generation = m_generation;
+        ++m_reading;
+
+        /* Running low, ask for more now rather than idling until the next delivery. */
+        if (static_cast<qsizetype>(m_queue.size()) == m_capacity / 4)
+            QMetaObject::invokeMethod(this, &MetadataHarvester::deliver, Qt::QueuedConnection);
+
+        locker.unlock();
+        Result result {path, {}, false};
+        result.ok = TagReader::read(path, result.info);
+        locker.relock();
+
+        --m_reading;
+        if (generation == m_generation)
+            m_results << result;
+    }
+}
+
+void MetadataHarvester::deliver()
+{
+    QList<Result> results;
+    {
+        QMutexLocker locker(&m_mutex);
+        results.swap(m_results);
+    }
+
+    if (not results.isEmpty())
+        emit harvested(results);
+
+    /* Whoever feeds us may enqueue() from here, so check whether we're done afterwards. */
+    if (const auto available = room(); available > 0)
+        emit demand(available);
+
+    bool done {};
+    {
+        QMutexLocker locker(&m_mutex);
+        done = m_urgent.empty() and m_queue.empty() and m_reading == 0 and m_results.isEmpty();
+    }
+
+    if (done and m_deliveryTimer.isActive()) {
+        m_deliveryTimer.stop();
+        emit idle();
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef METADATAHARVESTER_HPP
+#define METADATAHARVESTER_HPP
+
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QWaitCondition>
+#include <deque>
+
+#include "trackinfo.hpp"
+
+/* Reads tags with TagReader on a few low priority threads. The queue is bounded: callers
+ * enqueue() what fits and wait for demand() to offer more, so a huge import is fed bit by
+ * bit instead of being copied in whole. Urgent paths, e.g. rows on screen, jump the queue.
+ * Results are collected and handed over in batches from the GUI thread. */
+class MetadataHarvester : public QObject
+{
+    Q_OBJECT
+
+    void work();
+    qsizetype usedLocked() const;
+
+public:
+    struct Result
+    {
+        QString path;
+        TrackInfo info;
+        /* False if the file couldn't be read or its format isn't known. */
+        bool ok;
+    };
+
+    explicit MetadataHarvester(QObject *parent = nullptr);
+    ~MetadataHarvester();
+    void setCapacity(qsizetype capacity);
+    qsizetype capacity() const;
+    /* How many more paths enqueue() would take right now. */
+    qsizetype room() const;
+    /* Takes paths from the front of the list as long as there's room, returns how many. */
+    qsizetype enqueue(const QStringList &paths);
+    /* Read these before anything else. Taken even if the queue is full, keep it short. */
+    void prioritize(const QStringList &paths);
+    /* Drops whatever is queued or not delivered yet, files being read are discarded. */
+    void clear();
+
+signals:
+    void demand(qsizetype room);
+    void harvested(const QList<MetadataHarvester::Result> &results);
+    /* Nothing left to read nor to deliver. */
+    void idle();
+
+private slots:
+    void deliver();
+
+private:
+    qsizetype m_capacity;
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    std::deque<QString> m_urgent;
+    std::deque<QString> m_queue;
+    QList<Result> m_results;
+    qsizetype m_reading;
+    /* Bumped by clear() so results of files read before it are thrown away. */
+    quint64 m_generation;
+    bool m_stopping;
+    QTimer m_deliveryTimer;
+    QList<QThread *> m_threads;
+};
+
+#endif // METADATAHARVESTER_HPP
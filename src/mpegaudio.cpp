@@ -0,0 +1,79 @@
+#include "mpegaudio.hpp"
+
+#include <cstring>
+
+bool MpegAudio::parseFrame(const uchar *data, Frame &frame)
+{
+    static constexpr int bitrates[2][3][16] {
+        { /* MPEG 1 */
+            {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},
+            {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0},
+            {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0}
+        },
+        { /* MPEG 2 and 2.5 */
+            {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},
+            {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+            {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0}
+        }
+    };
+    static constexpr int sampleRates[4][3] {
+        {11025, 12000, 8000}, /* MPEG 2.5 */
+        {0, 0, 0},
+        {22050, 24000, 16000}, /* MPEG 2 */
+        {44100, 48000, 32000} /* MPEG 1 */
+    };
+
+    if (data[0] != 0xFF or (data[1] & 0xE0) != 0xE0)
+        return false;
+
+    /* 0 is MPEG-2.5, 2 MPEG-2 and 3 MPEG-1; layer 3 is I and 1 is III. */
+    const int version = (data[1] >> 3) & 0x03;
+    const int layer = (data[1] >> 1) & 0x03;
+    const int bitrateIndex = data[2] >> 4;
+    const int sampleRateIndex = (data[2] >> 2) & 0x03;
+    const int padding = (data[2] >> 1) & 0x01;
+
+    if (version == 1 or layer == 0 or bitrateIndex == 0 or bitrateIndex == 15 or sampleRateIndex == 3)
+        return false;
+
+    frame.mpeg1 = version == 3;
+    frame.layer = 4 - layer;
+    frame.bitrate = bitrates[frame.mpeg1 ? 0 : 1][frame.layer - 1][bitrateIndex];
+    frame.sampleRate = sampleRates[version][sampleRateIndex];
+    frame.channels = (data[3] >> 6) == 3 ? 1 : 2;
+
+    if (frame.layer == 1) {
+        frame.samplesPerFrame = 384;
+        frame.size = (12 * qint64(frame.bitrate) * 1'000 / frame.sampleRate + padding) * 4;
+    } else {
+        frame.samplesPerFrame = frame.layer == 3 and not frame.mpeg1 ? 576 : 1152;
+        frame.size = frame.samplesPerFrame / 8 * qint64(frame.bitrate) * 1'000 / frame.sampleRate + padding;
+    }
+
+    return frame.size > 4;
+}
+
+qint64 MpegAudio::frameSize(const char *data)
+{
+    Frame frame;
+    return parseFrame(reinterpret_cast<const uchar *>(data), frame) ? frame.size : 0;
+}
+
+qint64 MpegAudio::id3v2Size(const uchar *data, qint64 size)
+{
+    if (size < 10 or std::memcmp(data, "ID3", 3) != 0 or data[3] < 2 or data[3] > 4)
+        return 0;
+
+    for (int i = 6; i < 10; ++i)
+        if (data[i] & 0x80)
+            return 0;
+
+    const bool footer = data[5] & 0x10;
+    return 10 + qint64(syncsafe(data + 6)) + (footer ? 10 : 0);
+}
+
+quint32 MpegAudio::syncsafe(const uchar *data)
+{
+    return (quint32(data[0] & 0x7F) << 21) | (quint32(data[1] & 0x7F) << 14)
+           | (quint32(data[2] & 0x7F) << 7) | quint32(data[3] & 0x7F);
+}
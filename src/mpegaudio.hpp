@@ -0,0 +1,35 @@
+#ifndef MPEGAUDIO_HPP
+#define MPEGAUDIO_HPP
+
+#include <QtGlobal>
+
+/* Headers of MPEG audio frames and of the ID3v2 tags MP3 files usually start with,
+ * for everything that looks inside those files without decoding them. */
+class MpegAudio
+{
+public:
+    struct Frame
+    {
+        bool mpeg1;
+        /* 1 to 3, for layers I to III. */
+        int layer;
+        int bitrate; /* kbit/s */
+        int sampleRate;
+        int channels;
+        int samplesPerFrame;
+        /* Whole frame in bytes, header and padding included. */
+        qint64 size;
+    };
+
+    /* From the four bytes of the frame header at data, false if they aren't one. */
+    static bool parseFrame(const uchar *data, Frame &frame);
+    /* Size of the frame whose header is at data, 0 if it isn't one. */
+    static qint64 frameSize(const char *data);
+    /* Total size of the ID3v2 tag starting at data, footer included, 0 if there's none.
+     * size is how much of it is at hand, at least 10 bytes are needed. */
+    static qint64 id3v2Size(const uchar *data, qint64 size);
+    /* 28 bits spread over four bytes, the top bit of each unused so they never look like sync. */
+    static quint32 syncsafe(const uchar *data);
+};
+
+#endif // MPEGAUDIO_HPP
@@ -4,7 +4,7 @@
 #include <QDebug>
 #include <QUrl>
 
-Player::Player(const QStringList &playlist, QObject *parent)
+Player::Player(const Playlist &playlist, QObject *parent)
     : QObject{parent}
     , m_audioOutput(new QAudioOutput(this))
     , m_mediaPlayer(new QMediaPlayer(this))
@@ -36,17 +36,6 @@ bool Player::hasNext()
     return m_currentMusicIndex < m_playlist.size();
 }
 
-void Player::setCurrent(const QString &musicFile)
-{
-    m_mediaPlayer->setSource(QUrl::fromLocalFile(musicFile));
-    m_currentMusicFilename = musicFile;
-    if (m_playlist.contains(musicFile)) {
-        m_currentMusicIndex = m_playlist.indexOf(musicFile);
-    }
-
-    m_currentChanged = true;
-}
-
 void Player::setCurrent(qint64 index)
 {
     if (index < 0 or index >= m_playlist.size()) {
@@ -55,12 +44,17 @@ void Player::setCurrent(qint64 index)
     }
 
     m_currentMusicIndex = index;
-    m_mediaPlayer->setSource(QUrl::fromLocalFile(m_playlist[index]));
     m_currentMusicFilename = m_playlist[index];
+    m_mediaPlayer->setSource(QUrl::fromLocalFile(m_currentMusicFilename));
 
     m_currentChanged = true;
 }
 
+void Player::setCurrentMusicFilename(const QString &filename)
+{
+    m_currentMusicFilename = filename;
+}
+
 void Player::setAutoPlay(bool autoPlay)
 {
     m_autoplay = autoPlay;
@@ -71,6 +65,15 @@ void Player::setAudioDevice(QAudioDevice device)
     m_mediaPlayer->audioOutput()->setDevice(device);
 }
 
+void Player::setSuspect(const QString &filename, bool suspect)
+{
+    auto &table = TrackTable::instance();
+    if (suspect)
+        m_suspects.insert(table.intern(filename));
+    else
+        m_suspects.remove(table.find(filename));
+}
+
 #ifdef ENABLE_VIDEO_PLAYER
 void Player::setVideoOutput(QVideoWidget *videoOutput)
 {
@@ -108,9 +111,13 @@ bool Player::isPlaying() const
     return m_mediaPlayer->isPlaying();
 }
 
-void Player::setPlayList(const QStringList &playlist)
+void Player::setPlayList(const Playlist &playlist)
 {
     m_playlist = playlist;
+
+    /* Entries may have been added or removed around the current one. */
+    if (not m_currentMusicFilename.isEmpty() and m_currentMusicIndex >= 0)
+        m_currentMusicIndex = m_playlist.indexOf(m_currentMusicFilename);
 }
 
 void Player::setVolume(float volume)
@@ -159,23 +166,24 @@ bool Player::playPrevious()
         return false;
     }
 
-    --m_currentMusicIndex;
-    auto music = m_playlist[m_currentMusicIndex];
-    setCurrent(music);
+    setCurrent(m_currentMusicIndex - 1);
     play();
     return true;
 }
 
-bool Player::playNext()
+bool Player::playNext(bool skipSuspects)
 {
+    const auto current = m_currentMusicIndex;
     ++m_currentMusicIndex;
+    while (skipSuspects and hasNext() and m_suspects.contains(m_playlist.id(m_currentMusicIndex)))
+        ++m_currentMusicIndex;
+
     if (not hasNext()) {
-        --m_currentMusicIndex;
+        m_currentMusicIndex = current;
         return false;
     }
 
-    auto music = m_playlist[m_currentMusicIndex];
-    setCurrent(music);
+    setCurrent(m_currentMusicIndex);
     play();
     return true;
 }
@@ -216,7 +224,7 @@ void Player::mediaStatusChanged(QMediaPlayer::MediaStatus status)
 {
     if (status == QMediaPlayer::EndOfMedia) {
         if (m_autoplay) {
-            playNext();
+            playNext(true);
         } else {
             emit finished();
         }
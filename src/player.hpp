@@ -4,25 +4,32 @@
 #include <QAudioOutput>
 #include <QMediaPlayer>
 #include <QObject>
+#include <QSet>
 #ifdef ENABLE_VIDEO_PLAYER
     #include <QVideoWidget>
 #endif
 
+#include "playlist.hpp"
+
 class Player : public QObject
 {
     Q_OBJECT
 
     bool hasNext();
-    void setCurrent(const QString &musicFile);
 
 public:
-    explicit Player(const QStringList &playlist = QStringList(), QObject *parent = nullptr);
+    explicit Player(const Playlist &playlist = Playlist(), QObject *parent = nullptr);
     void setPlaylistName(const QString &playlistName);
-    void setPlayList(const QStringList &playlist);
+    /* Shares the caller's playlist, the current file is found again in it by id. */
+    void setPlayList(const Playlist &playlist);
     void setCurrent(qint64 index);
+    /* The current file was moved on disk, follow it without interrupting playback. */
+    void setCurrentMusicFilename(const QString &filename);
     /* Useful when in the command line. */
     void setAutoPlay(bool autoPlay);
     void setAudioDevice(QAudioDevice device);
+    /* Suspect files, e.g. truncated ones, are passed over when moving on by itself. */
+    void setSuspect(const QString &filename, bool suspect);
 #ifdef ENABLE_VIDEO_PLAYER
     void setVideoOutput(QVideoWidget *videoOutput);
 #endif
@@ -39,7 +46,8 @@ public slots:
     bool pause();
     bool play();
     bool playPrevious();
-    bool playNext();
+    /* Suspect files are skipped if skipSuspects is set. */
+    bool playNext(bool skipSuspects = false);
     void stop();
     void seek(qint64 position);
     void clearSource();
@@ -61,7 +69,8 @@ signals:
 
 private:
     QString m_playlistName;
-    QStringList m_playlist;
+    Playlist m_playlist;
+    QSet<TrackId> m_suspects;
     qint64 m_currentMusicIndex;
     QString m_currentMusicFilename;
     qint64 m_currentMusicDuration;
@@ -0,0 +1,183 @@
+#include "playlist.hpp"
+
+Playlist::Playlist(const QStringList &paths)
+    : m_ids {TrackTable::instance().intern(paths)}
+{
+}
+
+const QHash<TrackId, qsizetype> &Playlist::rows() const
+{
+    if (not m_rows) {
+        auto rows = std::make_shared<QHash<TrackId, qsizetype>>();
+        rows->reserve(m_ids.size());
+        /* From the end so a track that's in more than once keeps its first row. */
+        for (auto row = m_ids.size() - 1; row >= 0; --row)
+            rows->insert(m_ids[row], row);
+        m_rows = std::move(rows);
+    }
+
+    return *m_rows;
+}
+
+void Playlist::rowsChanged()
+{
+    /* Copies keep theirs, it's still right for them. */
+    m_rows.reset();
+}
+
+void Playlist::rowsAppended(qsizetype first)
+{
+    if (not m_rows)
+        return;
+
+    /* Grown rather than made again, big imports and scans append batch after batch.
+     * An index copies still hold is copied first, it's still right for them. */
+    auto rows = m_rows.use_count() == 1 ? std::const_pointer_cast<QHash<TrackId, qsizetype>>(m_rows)
+                                        : std::make_shared<QHash<TrackId, qsizetype>>(*m_rows);
+    for (auto row = first; row < m_ids.size(); ++row) {
+        if (not rows->contains(m_ids[row]))
+            rows->insert(m_ids[row], row);
+    }
+
+    m_rows = std::move(rows);
+}
+
+qsizetype Playlist::size() const
+{
+    return m_ids.size();
+}
+
+bool Playlist::isEmpty() const
+{
+    return m_ids.isEmpty();
+}
+
+const QList<TrackId> &Playlist::ids() const
+{
+    return m_ids;
+}
+
+TrackId Playlist::id(qsizetype index) const
+{
+    return m_ids[index];
+}
+
+QString Playlist::path(qsizetype index) const
+{
+    return TrackTable::instance().path(m_ids[index]);
+}
+
+QString Playlist::operator[](qsizetype index) const
+{
+    return path(index);
+}
+
+QString Playlist::value(qsizetype index) const
+{
+    return index >= 0 and index < m_ids.size() ? path(index) : QString();
+}
+
+QStringList Playlist::paths() const
+{
+    const auto &table = TrackTable::instance();
+    QStringList paths;
+    paths.reserve(m_ids.size());
+    for (const auto id : m_ids)
+        paths << table.path(id);
+    return paths;
+}
+
+QStringList Playlist::pathsUnder(const QString &directory) const
+{
+    const auto &table = TrackTable::instance();
+    QStringList paths;
+    for (const auto id : table.under(m_ids, directory))
+        paths << table.path(id);
+    return paths;
+}
+
+bool Playlist::contains(TrackId id) const
+{
+    return indexOf(id) >= 0;
+}
+
+bool Playlist::contains(const QString &path) const
+{
+    return indexOf(path) >= 0;
+}
+
+qsizetype Playlist::indexOf(TrackId id) const
+{
+    if (id == TrackTable::INVALID or m_ids.isEmpty())
+        return -1;
+
+    return rows().value(id, -1);
+}
+
+qsizetype Playlist::indexOf(const QString &path) const
+{
+    return indexOf(TrackTable::instance().find(path));
+}
+
+void Playlist::append(const QString &path)
+{
+    m_ids << TrackTable::instance().intern(path);
+    rowsAppended(m_ids.size() - 1);
+}
+
+void Playlist::append(const QStringList &paths)
+{
+    if (paths.isEmpty())
+        return;
+
+    const auto first = m_ids.size();
+    m_ids << TrackTable::instance().intern(paths);
+    rowsAppended(first);
+}
+
+Playlist &Playlist::operator<<(const QString &path)
+{
+    append(path);
+    return *this;
+}
+
+Playlist &Playlist::operator<<(const QStringList &paths)
+{
+    append(paths);
+    return *this;
+}
+
+void Playlist::replace(qsizetype index, const QString &path)
+{
+    m_ids[index] = TrackTable::instance().intern(path);
+    rowsChanged();
+}
+
+void Playlist::replace(const QHash<TrackId, TrackId> &tracks)
+{
+    if (tracks.isEmpty())
+        return;
+
+    bool replaced = false;
+    for (auto &id : m_ids) {
+        if (const auto it = tracks.constFind(id); it != tracks.cend()) {
+            id = *it;
+            replaced = true;
+        }
+    }
+
+    if (replaced)
+        rowsChanged();
+}
+
+void Playlist::removeAt(qsizetype index)
+{
+    m_ids.removeAt(index);
+    rowsChanged();
+}
+
+void Playlist::clear()
+{
+    m_ids.clear();
+    rowsChanged();
+}
@@ -0,0 +1,117 @@
+#ifndef PLAYLIST_HPP
+#define PLAYLIST_HPP
+
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tracktable.hpp"
+
+/* Tracks of a playlist in order, by their id in the TrackTable. Copies share the ids until
+ * one of them is changed, so the window, the player and the state last saved can all hold
+ * the same playlist for the price of one. Finding the row of a path is a hash lookup, rows
+ * are indexed when first needed and the index is shared by copies made after. */
+class Playlist
+{
+    const QHash<TrackId, qsizetype> &rows() const;
+    void rowsChanged();
+    /* Rows from first on are new, the rest didn't move. */
+    void rowsAppended(qsizetype first);
+
+public:
+    Playlist() = default;
+    explicit Playlist(const QStringList &paths);
+
+    qsizetype size() const;
+    bool isEmpty() const;
+    const QList<TrackId> &ids() const;
+    TrackId id(qsizetype index) const;
+    QString path(qsizetype index) const;
+    QString operator[](qsizetype index) const;
+    /* Empty if index is out of range. */
+    QString value(qsizetype index) const;
+    QStringList paths() const;
+    /* Paths of the tracks somewhere below directory. */
+    QStringList pathsUnder(const QString &directory) const;
+
+    bool contains(TrackId id) const;
+    bool contains(const QString &path) const;
+    /* First row of the track, -1 if it isn't in. */
+    qsizetype indexOf(TrackId id) const;
+    qsizetype indexOf(const QString &path) const;
+
+    void append(const QString &path);
+    void append(const QStringList &paths);
+    Playlist &operator<<(const QString &path);
+    Playlist &operator<<(const QStringList &paths);
+    void replace(qsizetype index, const QString &path);
+    /* Every row of a key's track gets its value instead, in one pass. */
+    void replace(const QHash<TrackId, TrackId> &tracks);
+    void removeAt(qsizetype index);
+    /* predicate is given the path of every track. Returns how many were removed. */
+    template <typename Predicate>
+    qsizetype removeIf(Predicate predicate);
+    /* Stable, by the tracks' paths. Those before first stay where they are. */
+    template <typename LessThan>
+    void sort(LessThan lessThan, qsizetype first = 0);
+    /* Same, by whatever keyOf gives for a track id, asked once per track. */
+    template <typename KeyOf, typename LessThan>
+    void sortBy(KeyOf keyOf, LessThan lessThan, qsizetype first = 0);
+    void clear();
+
+private:
+    QList<TrackId> m_ids;
+    mutable std::shared_ptr<const QHash<TrackId, qsizetype>> m_rows;
+};
+
+template <typename Predicate>
+qsizetype Playlist::removeIf(Predicate predicate)
+{
+    const auto &table = TrackTable::instance();
+    const auto removed = m_ids.removeIf([&table, &predicate] (TrackId id) {
+        return predicate(table.path(id));
+    });
+
+    if (removed > 0)
+        rowsChanged();
+    return removed;
+}
+
+template <typename LessThan>
+void Playlist::sort(LessThan lessThan, qsizetype first)
+{
+    /* Paths looked up once each rather than on every comparison. */
+    const auto &table = TrackTable::instance();
+    sortBy([&table] (TrackId id) {
+        return table.path(id);
+    }, lessThan, first);
+}
+
+template <typename KeyOf, typename LessThan>
+void Playlist::sortBy(KeyOf keyOf, LessThan lessThan, qsizetype first)
+{
+    first = qBound<qsizetype>(0, first, m_ids.size());
+    if (m_ids.size() - first < 2)
+        return;
+
+    std::vector<std::pair<decltype(keyOf(TrackId {})), TrackId>> tracks;
+    tracks.reserve(m_ids.size() - first);
+    for (auto i = first; i < m_ids.size(); ++i)
+        tracks.emplace_back(keyOf(m_ids[i]), m_ids[i]);
+
+    std::stable_sort(tracks.begin(), tracks.end(), [&lessThan] (const auto &left, const auto &right) {
+        return lessThan(left.first, right.first);
+    });
+
+    auto *ids = m_ids.data() + first;
+    for (const auto &track : tracks)
+        *ids++ = track.second;
+
+    rowsChanged();
+}
+
+#endif // PLAYLIST_HPP
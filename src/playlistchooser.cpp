@@ -1,9 +1,10 @@
 #include "playlistchooser.hpp"
 #include "ui_playlistchooser.h"
 
-PlaylistChooser::PlaylistChooser(QSettings *settings, QWidget *parent)
+PlaylistChooser::PlaylistChooser(const PlaylistStore *playlists, QSettings *settings, QWidget *parent)
     : QWidget(parent)
     , m_ui(new Ui::PlaylistChooser)
+    , m_playlists {playlists}
     , m_settings {settings}
     , m_quitShortcut {new QShortcut(QKeySequence(Qt::Key_Escape), this)}
 {
@@ -59,11 +60,23 @@ void PlaylistChooser::configureTable()
 
 void PlaylistChooser::loadPlaylists()
 {
-    m_settings->beginGroup("Playlists");
+    for (const auto &playlistName : m_playlists->names()) {
+        auto *item = new QTableWidgetItem(playlistName);
+        item->setTextAlignment(Qt::AlignCenter);
+
+        int rowCount = m_ui->tableWidget->rowCount();
+        m_ui->tableWidget->insertRow(rowCount);
+        m_ui->tableWidget->setItem(rowCount, 0, item);
+    }
+
+    /* Opened just the same, the tooltip tells what they hold. */
+    m_settings->beginGroup("SmartPlaylists");
 
     for (const auto &playlistName : m_settings->childGroups()) {
         auto *item = new QTableWidgetItem(playlistName);
         item->setTextAlignment(Qt::AlignCenter);
+        item->setToolTip(tr("Smart playlist: %1").arg(m_settings->value(playlistName + "/Rule").toString()));
+        item->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::EditFind));
 
         int rowCount = m_ui->tableWidget->rowCount();
         m_ui->tableWidget->insertRow(rowCount);
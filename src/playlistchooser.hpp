@@ -7,6 +7,8 @@
 #include <QShowEvent>
 #include <QWidget>
 
+#include "playliststore.hpp"
+
 namespace Ui {
 class PlaylistChooser;
 }
@@ -19,7 +21,8 @@ class PlaylistChooser : public QWidget
     void loadPlaylists();
 
 public:
-    explicit PlaylistChooser(QSettings *settings, QWidget *parent = nullptr);
+    /* settings holds the smart playlists. */
+    explicit PlaylistChooser(const PlaylistStore *playlists, QSettings *settings, QWidget *parent = nullptr);
     ~PlaylistChooser();
     QString playlist() const;
 
@@ -35,6 +38,7 @@ signals:
 
 private:
     Ui::PlaylistChooser *m_ui;
+    const PlaylistStore *m_playlists;
     QSettings *m_settings;
     QString m_chosenPlaylist;
     QShortcut *m_quitShortcut; /* Quit on Espace pressed */
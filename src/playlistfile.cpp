@@ -0,0 +1,189 @@
+#include "playlistfile.hpp"
+
+#include <QSaveFile>
+#include <QtEndian>
+#include <limits>
+
+namespace {
+constexpr quint32 magic = 0x5142504C; /* QBPL */
+constexpr quint32 version = 1;
+
+/* magic, version, entry count, last journal merged, then where the offsets and the strings start. */
+constexpr quint64 headerSize = 4 * sizeof(quint32) + 2 * sizeof(quint64);
+constexpr quint64 offsetSize = sizeof(quint32);
+
+quint32 read32(const uchar *data)
+{
+    return qFromLittleEndian<quint32>(data);
+}
+
+quint64 read64(const uchar *data)
+{
+    return qFromLittleEndian<quint64>(data);
+}
+
+void append32(QByteArray &data, quint32 value)
+{
+    const auto size = data.size();
+    data.resize(size + sizeof(value));
+    qToLittleEndian(value, data.data() + size);
+}
+
+void append64(QByteArray &data, quint64 value)
+{
+    const auto size = data.size();
+    data.resize(size + sizeof(value));
+    qToLittleEndian(value, data.data() + size);
+}
+}
+
+PlaylistFile::PlaylistFile(const QString &filename)
+    : m_file {filename}
+    , m_offsets {nullptr}
+    , m_strings {nullptr}
+    , m_stringsSize {}
+    , m_count {}
+    , m_journal {}
+{
+}
+
+bool PlaylistFile::open()
+{
+    if (not m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    const auto fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(headerSize)) {
+        m_errorString = tr("The file is truncated.");
+        return false;
+    }
+
+    const auto *data = m_file.map(0, fileSize);
+    if (not data) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    if (read32(data) != magic or read32(data + 4) != version) {
+        m_errorString = tr("The file was written by an incompatible version.");
+        return false;
+    }
+
+    const quint64 count = read32(data + 8);
+    const auto offsetsStart = read64(data + 16);
+    const auto stringsStart = read64(data + 24);
+
+    /* Only what's needed to never read past the end, entries are checked when read. */
+    const auto size = static_cast<quint64>(fileSize);
+    if (offsetsStart < headerSize or offsetsStart > size or (size - offsetsStart) / offsetSize < count + 1
+        or stringsStart < offsetsStart + (count + 1) * offsetSize or stringsStart > size) {
+        m_errorString = tr("The file is corrupted.");
+        return false;
+    }
+
+    m_offsets = data + offsetsStart;
+    m_strings = reinterpret_cast<const char *>(data + stringsStart);
+    m_stringsSize = size - stringsStart;
+    m_count = static_cast<qsizetype>(count);
+    m_journal = read32(data + 12);
+    return true;
+}
+
+QString PlaylistFile::errorString() const
+{
+    return m_errorString;
+}
+
+qsizetype PlaylistFile::size() const
+{
+    return m_count;
+}
+
+QByteArrayView PlaylistFile::entry(qsizetype index) const
+{
+    if (index < 0 or index >= m_count)
+        return {};
+
+    const quint64 begin = read32(m_offsets + index * offsetSize);
+    const quint64 end = read32(m_offsets + (index + 1) * offsetSize);
+    if (begin > end or end > m_stringsSize)
+        return {};
+
+    return QByteArrayView(m_strings + begin, static_cast<qsizetype>(end - begin));
+}
+
+QString PlaylistFile::path(qsizetype index) const
+{
+    return QString::fromUtf8(entry(index));
+}
+
+QStringList PlaylistFile::paths() const
+{
+    QStringList paths;
+    paths.reserve(m_count);
+    for (qsizetype i = 0; i < m_count; ++i) {
+        if (const auto path = entry(i); not path.isEmpty())
+            paths << QString::fromUtf8(path);
+    }
+
+    return paths;
+}
+
+bool PlaylistFile::contains(const QString &path) const
+{
+    const auto utf8 = path.toUtf8();
+    for (qsizetype i = 0; i < m_count; ++i) {
+        if (entry(i) == QByteArrayView(utf8))
+            return true;
+    }
+
+    return false;
+}
+
+quint32 PlaylistFile::journal() const
+{
+    return m_journal;
+}
+
+bool PlaylistFile::write(const QString &filename,
+                         const QStringList &paths,
+                         quint32 journal,
+                         QString *errorString)
+{
+    QByteArray strings;
+    QByteArray offsets;
+    offsets.reserve(static_cast<qsizetype>((paths.size() + 1) * offsetSize));
+    for (const auto &path : paths) {
+        append32(offsets, static_cast<quint32>(strings.size()));
+        strings.append(path.toUtf8());
+    }
+    append32(offsets, static_cast<quint32>(strings.size()));
+
+    if (static_cast<quint64>(strings.size()) > std::numeric_limits<quint32>::max()) {
+        if (errorString)
+            *errorString = tr("The playlist is too big.");
+        return false;
+    }
+
+    QByteArray header;
+    header.reserve(static_cast<qsizetype>(headerSize));
+    append32(header, magic);
+    append32(header, version);
+    append32(header, static_cast<quint32>(paths.size()));
+    append32(header, journal);
+    append64(header, headerSize);
+    append64(header, headerSize + offsets.size());
+
+    QSaveFile file(filename);
+    if (not file.open(QIODevice::WriteOnly) or file.write(header) != header.size()
+        or file.write(offsets) != offsets.size() or file.write(strings) != strings.size()
+        or not file.commit()) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
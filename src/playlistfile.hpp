@@ -0,0 +1,53 @@
+#ifndef PLAYLISTFILE_HPP
+#define PLAYLISTFILE_HPP
+
+#include <QByteArrayView>
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+
+/* One playlist in its binary format, read straight out of a memory mapping of the file.
+ * A fixed size header tells where the offsets array and the string table are, entry i is
+ * the UTF-8 path between offsets i and i + 1 of the table. Opening it only checks the
+ * header, so it takes the same time whatever the size, paths are decoded when asked for.
+ * All numbers are little endian. */
+class PlaylistFile
+{
+    Q_DECLARE_TR_FUNCTIONS(PlaylistFile)
+
+    QByteArrayView entry(qsizetype index) const;
+
+public:
+    explicit PlaylistFile(const QString &filename);
+
+    PlaylistFile(const PlaylistFile &) = delete;
+    PlaylistFile &operator=(const PlaylistFile &) = delete;
+
+    bool open();
+    QString errorString() const;
+    qsizetype size() const;
+    /* Empty if the entry is corrupted. */
+    QString path(qsizetype index) const;
+    QStringList paths() const;
+    /* Compared as UTF-8, nothing is decoded. */
+    bool contains(const QString &path) const;
+    /* Sequence number of the last PlaylistJournal merged into it, 0 if none was. */
+    quint32 journal() const;
+
+    /* Atomically replaces filename, paths are kept in the order given. */
+    static bool write(const QString &filename,
+                      const QStringList &paths,
+                      quint32 journal = 0,
+                      QString *errorString = nullptr);
+
+private:
+    QFile m_file;
+    QString m_errorString;
+    const uchar *m_offsets;
+    const char *m_strings;
+    quint64 m_stringsSize;
+    qsizetype m_count;
+    quint32 m_journal;
+};
+
+#endif // PLAYLISTFILE_HPP
@@ -0,0 +1,367 @@
+#include "playlistformats.hpp"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+namespace {
+/* Found files are handed over once there are this many... */
+constexpr qsizetype batchSize = 512;
+/* ...or this many milliseconds have passed, so playback can start right away. */
+constexpr qint64 batchInterval = 100;
+/* Listings kept to check entries against, playlists rarely jump back to a directory
+ * many others ago. Dropped all at once past that so memory stays bounded. */
+constexpr qsizetype cachedDirectories = 256;
+/* Written files are flushed whenever that much is waiting. */
+constexpr qsizetype writeChunk = 64 * 1'024;
+
+const QString xspfNamespace = QStringLiteral("http://xspf.org/ns/0/");
+
+/* What goes into the file for path: relative when it's below base. */
+QString entryFor(const QDir &base, const QString &path)
+{
+    const auto prefix = base.absolutePath() + '/';
+    return QDir::toNativeSeparators(path.startsWith(prefix) ? path.mid(prefix.size()) : path);
+}
+
+QString displayName(const TrackInfo &info)
+{
+    if (info.title.isEmpty())
+        return {};
+    return info.artist.isEmpty() ? info.title : QString("%1 - %2").arg(info.artist, info.title);
+}
+
+QByteArray encode(const QString &text, PlaylistFormats::FORMAT format)
+{
+    /* Plain M3U has no encoding of its own, players take it as the system's. */
+    return format == PlaylistFormats::FORMAT::M3U ? text.toLocal8Bit() : text.toUtf8();
+}
+
+bool writeLines(QSaveFile &file,
+                const QStringList &paths,
+                const std::function<TrackInfo (const QString &)> &info,
+                PlaylistFormats::FORMAT format)
+{
+    const QDir base = QFileInfo(file.fileName()).absoluteDir();
+    const bool pls = format == PlaylistFormats::FORMAT::PLS;
+
+    QByteArray data = pls ? "[playlist]\n" : "#EXTM3U\n";
+    for (qsizetype i = 0; i < paths.size(); ++i) {
+        const auto track = info ? info(paths[i]) : TrackInfo();
+        const auto name = displayName(track);
+        /* Both formats take -1 for an unknown length. */
+        const auto seconds = track.duration > 0 ? track.duration / 1'000 : -1;
+
+        if (pls) {
+            const auto number = QByteArray::number(i + 1);
+            data += "File" + number + '=' + entryFor(base, paths[i]).toUtf8() + '\n';
+            if (not name.isEmpty())
+                data += "Title" + number + '=' + name.toUtf8() + '\n';
+            data += "Length" + number + '=' + QByteArray::number(seconds) + '\n';
+        } else {
+            if (not name.isEmpty())
+                data += "#EXTINF:" + QByteArray::number(seconds) + ',' + encode(name, format) + '\n';
+            data += encode(entryFor(base, paths[i]), format) + '\n';
+        }
+
+        if (data.size() >= writeChunk) {
+            if (file.write(data) != data.size())
+                return false;
+            data.clear();
+        }
+    }
+
+    /* Most readers don't mind these coming last, and we don't have to count ahead. */
+    if (pls)
+        data += "NumberOfEntries=" + QByteArray::number(paths.size()) + "\nVersion=2\n";
+
+    return file.write(data) == data.size();
+}
+
+bool writeXspf(QSaveFile &file,
+               const QStringList &paths,
+               const std::function<TrackInfo (const QString &)> &info)
+{
+    QXmlStreamWriter writer(&file);
+    writer.setAutoFormatting(true);
+    writer.writeStartDocument();
+    writer.writeStartElement("playlist");
+    writer.writeAttribute("version", "1");
+    writer.writeDefaultNamespace(xspfNamespace);
+    writer.writeStartElement("trackList");
+
+    for (const auto &path : paths) {
+        const auto track = info ? info(path) : TrackInfo();
+        writer.writeStartElement("track");
+        writer.writeTextElement("location", QString::fromLatin1(QUrl::fromLocalFile(path).toEncoded()));
+        if (not track.title.isEmpty())
+            writer.writeTextElement("title", track.title);
+        if (not track.artist.isEmpty())
+            writer.writeTextElement("creator", track.artist);
+        if (not track.album.isEmpty())
+            writer.writeTextElement("album", track.album);
+        if (track.duration > 0)
+            writer.writeTextElement("duration", QString::number(track.duration));
+        writer.writeEndElement();
+
+        if (writer.hasError())
+            return false;
+    }
+
+    writer.writeEndElement();
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    return not writer.hasError();
+}
+}
+
+PlaylistFormats::FORMAT PlaylistFormats::fromName(const QString &filename)
+{
+    const auto suffix = QFileInfo(filename).suffix().toLower();
+    if (suffix == "m3u")
+        return FORMAT::M3U;
+    if (suffix == "m3u8")
+        return FORMAT::M3U8;
+    if (suffix == "pls")
+        return FORMAT::PLS;
+    if (suffix == "xspf")
+        return FORMAT::XSPF;
+
+    return FORMAT::UNKNOWN;
+}
+
+QString PlaylistFormats::filter()
+{
+    return tr("Playlists (*.m3u *.m3u8 *.pls *.xspf)");
+}
+
+bool PlaylistFormats::write(const QString &filename,
+                            const QStringList &paths,
+                            const std::function<TrackInfo (const QString &)> &info,
+                            QString *errorString)
+{
+    const auto format = fromName(filename);
+    if (format == FORMAT::UNKNOWN) {
+        if (errorString)
+            *errorString = tr("Unknown playlist format, use one of %1.").arg(filter());
+        return false;
+    }
+
+    QSaveFile file(filename);
+    if (not file.open(QIODevice::WriteOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    const bool written = format == FORMAT::XSPF ? writeXspf(file, paths, info) : writeLines(file, paths, info, format);
+    if (not written or not file.commit()) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+PlaylistImporter::PlaylistImporter(QObject *parent)
+    : QObject {parent}
+    , m_cancelled {false}
+    , m_imported {}
+    , m_missing {}
+{
+}
+
+PlaylistImporter::~PlaylistImporter()
+{
+    m_cancelled = true;
+    m_job.wait();
+}
+
+bool PlaylistImporter::isRunning() const
+{
+    return m_job.isRunning();
+}
+
+void PlaylistImporter::start(const QString &filename)
+{
+    m_job.wait();
+
+    m_cancelled = false;
+    m_job.start([this, filename] () {
+        read(filename);
+    }, QThread::LowPriority);
+}
+
+void PlaylistImporter::cancel()
+{
+    m_cancelled = true;
+}
+
+bool PlaylistImporter::wasCancelled() const
+{
+    return m_cancelled;
+}
+
+void PlaylistImporter::read(const QString &filename)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_base = QFileInfo(filename).absoluteDir();
+    m_pending.clear();
+    m_listings.clear();
+    m_imported = 0;
+    m_missing = 0;
+    m_batchTimer.start();
+
+    const auto format = PlaylistFormats::fromName(filename);
+    QFile file(filename);
+    if (format == PlaylistFormats::FORMAT::UNKNOWN) {
+        emit error(tr("%1 isn't a playlist we can read, use one of %2.").arg(filename, PlaylistFormats::filter()));
+    } else if (not file.open(QIODevice::ReadOnly)) {
+        emit error(tr("Unable to open %1: %2").arg(filename, file.errorString()));
+    } else if (format == PlaylistFormats::FORMAT::XSPF) {
+        readXspf(file);
+    } else {
+        readLines(file, format);
+    }
+
+    flush();
+    m_listings.clear();
+
+    qInfo().noquote() << tr("Imported %1 tracks from %2 in %3 ms, %4 missing.")
+                             .arg(m_imported)
+                             .arg(filename)
+                             .arg(timer.elapsed())
+                             .arg(m_missing);
+
+    emit finished(m_imported, m_missing);
+}
+
+void PlaylistImporter::readLines(QIODevice &device, PlaylistFormats::FORMAT format)
+{
+    const bool pls = format == PlaylistFormats::FORMAT::PLS;
+    bool first = true;
+
+    while (not device.atEnd() and not m_cancelled) {
+        auto line = device.readLine();
+        if (first and line.startsWith("\xEF\xBB\xBF")) {
+            line.remove(0, 3);
+            /* A byte order mark says UTF-8 whatever the extension. */
+            format = PlaylistFormats::FORMAT::M3U8;
+        }
+        first = false;
+
+        const auto text = (format == PlaylistFormats::FORMAT::M3U ? QString::fromLocal8Bit(line)
+                                                                  : QString::fromUtf8(line)).trimmed();
+        if (text.isEmpty())
+            continue;
+
+        if (pls) {
+            /* FileN=location, titles and lengths are read from the tags anyway. */
+            const auto equals = text.indexOf('=');
+            if (equals > 4 and text.startsWith("File", Qt::CaseInsensitive))
+                add(text.mid(equals + 1).trimmed());
+        } else if (not text.startsWith('#')) {
+            /* #EXTM3U, #EXTINF and the like only describe the next entry. */
+            add(text);
+        }
+    }
+}
+
+void PlaylistImporter::readXspf(QIODevice &device)
+{
+    QXmlStreamReader reader(&device);
+    bool inTrack = false;
+    bool located = false;
+
+    while (not reader.atEnd() and not m_cancelled) {
+        reader.readNext();
+
+        if (reader.isStartElement()) {
+            if (reader.name() == QLatin1String("track")) {
+                inTrack = true;
+                located = false;
+            } else if (inTrack and not located and reader.name() == QLatin1String("location")) {
+                /* A track may list several, the first one is the preferred. */
+                located = true;
+                const auto location = reader.readElementText().trimmed();
+                const auto url = QUrl::fromLocalFile(m_base.absolutePath() + '/').resolved(QUrl(location));
+                add(url.isLocalFile() ? url.toLocalFile() : location);
+            }
+        } else if (reader.isEndElement() and reader.name() == QLatin1String("track")) {
+            inTrack = false;
+        }
+    }
+
+    if (reader.hasError() and not m_cancelled) {
+        emit error(tr("The playlist is damaged at line %1: %2")
+                       .arg(reader.lineNumber())
+                       .arg(reader.errorString()));
+    }
+}
+
+void PlaylistImporter::add(const QString &entry)
+{
+    auto path = entry;
+    if (path.startsWith("file:", Qt::CaseInsensitive)) {
+        path = QUrl(path).toLocalFile();
+    } else if (path.contains("://")) {
+        /* Streams and other remote locations, we only play files. */
+        ++m_missing;
+        return;
+    }
+
+#ifndef Q_OS_WIN
+    /* Written on Windows. */
+    if (not path.contains('/'))
+        path.replace('\\', '/');
+#endif
+
+    if (path.isEmpty()) {
+        ++m_missing;
+        return;
+    }
+
+    m_pending << QDir::cleanPath(m_base.absoluteFilePath(QDir::fromNativeSeparators(path)));
+    if (m_pending.size() >= batchSize or m_batchTimer.elapsed() >= batchInterval)
+        flush();
+}
+
+void PlaylistImporter::flush()
+{
+    QStringList found;
+    found.reserve(m_pending.size());
+
+    for (const auto &path : std::as_const(m_pending)) {
+        const auto slash = path.lastIndexOf('/');
+        const auto directory = slash > 0 ? path.left(slash) : QStringLiteral("/");
+
+        auto it = m_listings.find(directory);
+        if (it == m_listings.end()) {
+            if (m_listings.size() >= cachedDirectories)
+                m_listings.clear();
+
+            const auto names = QDir(directory).entryList(QDir::Files | QDir::Hidden);
+            it = m_listings.insert(directory, QSet<QString>(names.cbegin(), names.cend()));
+        }
+
+        if (it->contains(path.mid(slash + 1)))
+            found << path;
+        else
+            ++m_missing;
+    }
+
+    m_pending.clear();
+    m_batchTimer.restart();
+
+    if (not found.isEmpty()) {
+        m_imported += found.size();
+        emit tracksFound(found);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef PLAYLISTFORMATS_HPP
+#define PLAYLISTFORMATS_HPP
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+#include <functional>
+
+#include "backgroundjob.hpp"
+#include "trackinfo.hpp"
+
+/* Playlist files other players read and write: M3U (M3U8 when it's UTF-8), PLS and XSPF. */
+class PlaylistFormats
+{
+    Q_DECLARE_TR_FUNCTIONS(PlaylistFormats)
+
+public:
+    enum class FORMAT { UNKNOWN = 0, M3U, M3U8, PLS, XSPF };
+
+    /* By extension, ignoring case. */
+    static FORMAT fromName(const QString &filename);
+    /* For file dialogs, e.g. "Playlists (*.m3u *.m3u8 *.pls *.xspf)". */
+    static QString filter();
+    /* Written as it goes, the whole file is never held in memory. Paths below the directory
+     * of filename are written relative to it, except in XSPF which takes URIs. info gives
+     * the title, artist and duration when known, for EXTINF lines and the like. */
+    static bool write(const QString &filename,
+                      const QStringList &paths,
+                      const std::function<TrackInfo (const QString &)> &info,
+                      QString *errorString = nullptr);
+};
+
+/* Reads a playlist file in the background, a line or an XML token at a time, so memory
+ * doesn't grow with its size. Entries are checked in batches: relative ones are resolved
+ * against the playlist's directory and every directory they're in is listed once rather
+ * than every file stat'ed. Remote locations are skipped. */
+class PlaylistImporter : public QObject
+{
+    Q_OBJECT
+
+    void read(const QString &filename);
+    void readLines(QIODevice &device, PlaylistFormats::FORMAT format);
+    void readXspf(QIODevice &device);
+    void add(const QString &entry);
+    void flush();
+
+public:
+    explicit PlaylistImporter(QObject *parent = nullptr);
+    ~PlaylistImporter();
+    bool isRunning() const;
+    /* tracksFound() is emitted batch by batch, in the playlist's order, and finished() once done. */
+    void start(const QString &filename);
+    /* finished() is still emitted with what was read so far. Safe to call from any thread. */
+    void cancel();
+    bool wasCancelled() const;
+
+signals:
+    /* Emitted from the importer's thread. */
+    void tracksFound(const QStringList &files);
+    void error(const QString &message);
+    /* missing counts entries whose file wasn't there and those that aren't local files. */
+    void finished(qint64 imported, qint64 missing);
+
+private:
+    BackgroundJob m_job;
+    std::atomic<bool> m_cancelled;
+    /* The rest is only touched by the importer's thread. */
+    QDir m_base;
+    QStringList m_pending;
+    /* File names of the directories the last batches were in. */
+    QHash<QString, QSet<QString>> m_listings;
+    QElapsedTimer m_batchTimer;
+    qint64 m_imported;
+    qint64 m_missing;
+};
+
+#endif // PLAYLISTFORMATS_HPP
@@ -0,0 +1,158 @@
+#include "playlistjournal.hpp"
+
+#include <QDebug>
+#include <QFile>
+#include <QtEndian>
+#ifdef Q_OS_UNIX
+    #include <unistd.h>
+#endif
+
+namespace {
+constexpr quint32 magic = 0x5142504A; /* QBPJ */
+constexpr quint32 version = 2;
+/* magic, version and sequence number. */
+constexpr qsizetype headerSize = 3 * sizeof(quint32);
+/* Operation and payload size before the payload, its checksum after. */
+constexpr qsizetype recordOverhead = sizeof(quint8) + sizeof(quint32) + sizeof(quint16);
+
+template <typename T>
+void appendValue(QByteArray &data, T value)
+{
+    const auto size = data.size();
+    data.resize(size + sizeof(value));
+    qToLittleEndian(value, data.data() + size);
+}
+
+bool sync(QFile &file)
+{
+    if (not file.flush())
+        return false;
+#ifdef Q_OS_UNIX
+    return ::fsync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+}
+
+bool PlaylistJournal::append(const QString &filename,
+                             const QList<Edit> &edits,
+                             quint32 sequence,
+                             QString *errorString)
+{
+    if (edits.isEmpty())
+        return true;
+
+    QFile file(filename);
+    if (not file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    const auto oldSize = file.size();
+    QByteArray data;
+    if (oldSize == 0) {
+        appendValue(data, magic);
+        appendValue(data, version);
+        appendValue(data, sequence);
+    }
+
+    for (const auto &edit : edits) {
+        auto payload = edit.path.toUtf8();
+        if (edit.operation == OPERATION::MOVE)
+            payload += '\0' + edit.to.toUtf8();
+
+        const auto start = data.size();
+        appendValue(data, static_cast<quint8>(edit.operation));
+        appendValue(data, static_cast<quint32>(payload.size()));
+        data += payload;
+        appendValue(data, qChecksum(QByteArrayView(data).sliced(start)));
+    }
+
+    if (file.write(data) != data.size() or not sync(file)) {
+        if (errorString)
+            *errorString = file.errorString();
+        /* A torn record would hide whatever comes after it. */
+        file.resize(oldSize);
+        return false;
+    }
+
+    return true;
+}
+
+QList<PlaylistJournal::Edit> PlaylistJournal::read(const QString &filename, quint32 *sequence)
+{
+    QFile file(filename);
+    if (not file.open(QIODevice::ReadOnly))
+        return {};
+
+    const auto data = file.readAll();
+    if (data.isEmpty())
+        return {};
+
+    if (data.size() < headerSize
+        or qFromLittleEndian<quint32>(data.constData()) != magic
+        or qFromLittleEndian<quint32>(data.constData() + sizeof(quint32)) != version) {
+        qWarning().noquote() << tr("Ignoring playlist journal: %1 written by an incompatible version.").arg(filename);
+        return {};
+    }
+
+    if (sequence)
+        *sequence = qFromLittleEndian<quint32>(data.constData() + 2 * sizeof(quint32));
+
+    QList<Edit> edits;
+    qsizetype position = headerSize;
+    while (position < data.size()) {
+        if (data.size() - position < recordOverhead)
+            break;
+
+        const auto operation = static_cast<OPERATION>(static_cast<quint8>(data[position]));
+        const auto size = qFromLittleEndian<quint32>(data.constData() + position + 1);
+        if (static_cast<quint64>(data.size() - position - recordOverhead) < size)
+            break;
+
+        const auto recordSize = recordOverhead + static_cast<qsizetype>(size);
+        const auto record = QByteArrayView(data).sliced(position, recordSize - sizeof(quint16));
+        const auto checksum = qFromLittleEndian<quint16>(data.constData() + position + recordSize - sizeof(quint16));
+        if (qChecksum(record) != checksum)
+            break;
+
+        const auto payload = record.sliced(recordOverhead - sizeof(quint16));
+        Edit edit {operation, {}, {}};
+        if (operation == OPERATION::MOVE) {
+            const auto separator = payload.indexOf('\0');
+            if (separator < 0)
+                break;
+            edit.path = QString::fromUtf8(payload.first(separator));
+            edit.to = QString::fromUtf8(payload.sliced(separator + 1));
+        } else if (operation == OPERATION::ADD or operation == OPERATION::REMOVE) {
+            edit.path = QString::fromUtf8(payload);
+        } else {
+            break;
+        }
+
+        edits << edit;
+        position += recordSize;
+    }
+
+    if (position < data.size())
+        qWarning().noquote() << tr("The playlist journal: %1 ends with a damaged record, edits after it are lost.").arg(filename);
+
+    return edits;
+}
+
+quint32 PlaylistJournal::sequence(const QString &filename)
+{
+    QFile file(filename);
+    if (not file.open(QIODevice::ReadOnly))
+        return 0;
+
+    const auto header = file.read(headerSize);
+    if (header.size() < headerSize
+        or qFromLittleEndian<quint32>(header.constData()) != magic
+        or qFromLittleEndian<quint32>(header.constData() + sizeof(quint32)) != version)
+        return 0;
+
+    return qFromLittleEndian<quint32>(header.constData() + 2 * sizeof(quint32));
+}
@@ -0,0 +1,39 @@
+#ifndef PLAYLISTJOURNAL_HPP
+#define PLAYLISTJOURNAL_HPP
+
+#include <QCoreApplication>
+#include <QList>
+#include <QStringList>
+
+/* Edits made to a saved playlist since its PlaylistFile was last written, appended to a
+ * file of their own so saving costs what changed rather than the whole playlist. Every
+ * record is its operation, the size of its paths and a checksum, a record cut short by
+ * a crash ends the journal there. Each journal has a sequence number, the file records
+ * the last one merged into it so none is ever applied twice. All numbers are little endian. */
+class PlaylistJournal
+{
+    Q_DECLARE_TR_FUNCTIONS(PlaylistJournal)
+
+public:
+    enum class OPERATION : quint8 { ADD = 1, REMOVE, MOVE };
+
+    struct Edit
+    {
+        OPERATION operation;
+        QString path;
+        /* Where path went, for MOVE only. */
+        QString to;
+    };
+
+    /* Synced to disk before returning, nothing is left behind on failure. sequence is only
+     * written when the journal is new, it must be above that of every journal before it. */
+    static bool append(const QString &filename,
+                       const QList<Edit> &edits,
+                       quint32 sequence,
+                       QString *errorString = nullptr);
+    static QList<Edit> read(const QString &filename, quint32 *sequence = nullptr);
+    /* Without reading its edits, 0 if there's no such journal. */
+    static quint32 sequence(const QString &filename);
+};
+
+#endif // PLAYLISTJOURNAL_HPP
@@ -0,0 +1,387 @@
+#include "playlistmodel.hpp"
+
+#include <QApplication>
+#include <QDir>
+#include <QIcon>
+#include <QPalette>
+
+PlaylistModel::PlaylistModel(QObject *parent)
+    : QAbstractTableModel {parent}
+    , m_title {tr("Playlist: Unnamed")}
+{
+}
+
+int PlaylistModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_tracks.size());
+}
+
+int PlaylistModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+QVariant PlaylistModel::data(const QModelIndex &index, int role) const
+{
+    if (not checkIndex(index, CheckIndexOption::IndexIsValid | CheckIndexOption::ParentIsInvalid))
+        return {};
+
+    const auto &track = m_tracks[index.row()];
+    const bool suspect = track.verdict != FileProber::VERDICT::OK;
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        if (index.column() == NAME)
+            return name(TrackTable::instance().path(track.id));
+
+        if (track.metadata != METADATA::KNOWN)
+            return {};
+
+        const auto info = m_infos.constFind(track.id);
+        if (info == m_infos.cend())
+            return {};
+
+        switch (index.column()) {
+        case TITLE:
+            return info->title;
+        case ARTIST:
+            return info->artist;
+        case ALBUM:
+            return info->album;
+        case DURATION:
+            return info->duration > 0 ? durationText(info->duration) : QString();
+        }
+
+        return {};
+    }
+    case Qt::ToolTipRole:
+        if (suspect and index.column() == NAME)
+            return tr("%1 It's skipped when playing on.").arg(FileProber::describe(track.verdict));
+        return {};
+    case Qt::DecorationRole:
+        if (suspect and index.column() == NAME)
+            return QIcon::fromTheme(QIcon::ThemeIcon::DialogWarning);
+        return {};
+    case Qt::ForegroundRole:
+        if (suspect)
+            return QApplication::palette().color(QPalette::Disabled, QPalette::Text);
+        return {};
+    case PATH_ROLE:
+        return TrackTable::instance().path(track.id);
+    }
+
+    return {};
+}
+
+QVariant PlaylistModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal)
+        return {};
+
+    if (role == Qt::ToolTipRole and section == NAME)
+        return m_titleToolTip;
+
+    if (role != Qt::DisplayRole)
+        return {};
+
+    switch (section) {
+    case NAME:
+        return m_title;
+    case TITLE:
+        return tr("Title");
+    case ARTIST:
+        return tr("Artist");
+    case ALBUM:
+        return tr("Album");
+    case DURATION:
+        return tr("Duration");
+    }
+
+    return {};
+}
+
+Qt::ItemFlags PlaylistModel::flags(const QModelIndex &index) const
+{
+    if (not index.isValid())
+        return Qt::NoItemFlags;
+
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren;
+}
+
+bool PlaylistModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+    if (parent.isValid() or row < 0 or count <= 0 or row + count > rowCount())
+        return false;
+
+    /* Their tags stay in m_infos, the same file may be in another row. */
+    beginRemoveRows(parent, row, row + count - 1);
+    m_tracks.erase(m_tracks.begin() + row, m_tracks.begin() + row + count);
+    endRemoveRows();
+
+    return true;
+}
+
+void PlaylistModel::setTitle(const QString &title, const QString &toolTip)
+{
+    m_title = title;
+    m_titleToolTip = toolTip;
+    emit headerDataChanged(Qt::Horizontal, NAME, NAME);
+}
+
+QString PlaylistModel::title() const
+{
+    return m_title;
+}
+
+void PlaylistModel::setPlaylist(const Playlist &playlist, const QHash<QString, FileProber::VERDICT> &verdicts)
+{
+    const auto verdictsById = byId(verdicts);
+
+    beginResetModel();
+    m_tracks.clear();
+    m_infos.clear();
+    m_tracks.reserve(playlist.size());
+    for (const auto id : playlist.ids())
+        m_tracks.push_back({id, METADATA::UNKNOWN, verdictsById.value(id, FileProber::VERDICT::OK)});
+    endResetModel();
+}
+
+void PlaylistModel::append(const QStringList &paths, const QHash<QString, FileProber::VERDICT> &verdicts)
+{
+    if (paths.isEmpty())
+        return;
+
+    const auto ids = TrackTable::instance().intern(paths);
+    const auto first = static_cast<int>(m_tracks.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(ids.size()) - 1);
+    m_tracks.reserve(m_tracks.size() + ids.size());
+    for (qsizetype i = 0; i < ids.size(); ++i)
+        m_tracks.push_back({ids[i], METADATA::UNKNOWN, verdicts.value(paths[i], FileProber::VERDICT::OK)});
+    endInsertRows();
+}
+
+void PlaylistModel::remove(const QSet<QString> &paths)
+{
+    const auto &table = TrackTable::instance();
+    QSet<TrackId> ids;
+    ids.reserve(paths.size());
+    for (const auto &path : paths) {
+        if (const auto id = table.find(path); id != TrackTable::INVALID)
+            ids.insert(id);
+    }
+
+    /* From the end so rows still to be looked at don't move. */
+    for (auto last = static_cast<int>(m_tracks.size()) - 1; last >= 0; --last) {
+        if (not ids.contains(m_tracks[last].id))
+            continue;
+
+        auto first = last;
+        while (first > 0 and ids.contains(m_tracks[first - 1].id))
+            --first;
+
+        removeRows(first, last - first + 1);
+        last = first;
+    }
+}
+
+void PlaylistModel::reorder(const Playlist &playlist)
+{
+    Q_ASSERT_X(static_cast<std::size_t>(playlist.size()) == m_tracks.size(),
+               "Must be given the model's playlist in another order.", Q_FUNC_INFO);
+    /* Release builds show it from scratch rather than lose rows. */
+    if (static_cast<std::size_t>(playlist.size()) != m_tracks.size()) {
+        setPlaylist(playlist);
+        return;
+    }
+
+    /* A list per track since a file may be in the playlist more than once. */
+    QHash<TrackId, QList<qsizetype>> oldRows;
+    oldRows.reserve(playlist.size());
+    for (std::size_t row = 0; row < m_tracks.size(); ++row)
+        oldRows[m_tracks[row].id].append(static_cast<qsizetype>(row));
+
+    std::vector<Track> tracks;
+    tracks.reserve(m_tracks.size());
+    std::vector<int> newRows(m_tracks.size());
+    for (const auto id : playlist.ids()) {
+        auto it = oldRows.find(id);
+        Q_ASSERT_X(it != oldRows.end() and not it->isEmpty(),
+                   "Must be given the model's playlist in another order.", Q_FUNC_INFO);
+        if (it == oldRows.end() or it->isEmpty()) {
+            setPlaylist(playlist);
+            return;
+        }
+
+        const auto row = it->takeFirst();
+        newRows[row] = static_cast<int>(tracks.size());
+        tracks.push_back(std::move(m_tracks[row]));
+    }
+
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    m_tracks.swap(tracks);
+
+    /* Selection and current row follow their file. */
+    const auto from = persistentIndexList();
+    QModelIndexList to;
+    to.reserve(from.size());
+    for (const auto &index : from)
+        to << this->index(newRows[index.row()], index.column());
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void PlaylistModel::clear()
+{
+    setPlaylist({});
+    m_sorter.clear();
+}
+
+TrackId PlaylistModel::id(qsizetype row) const
+{
+    return row >= 0 and static_cast<std::size_t>(row) < m_tracks.size() ? m_tracks[row].id : TrackTable::INVALID;
+}
+
+QString PlaylistModel::path(qsizetype row) const
+{
+    const auto id = this->id(row);
+    return id != TrackTable::INVALID ? TrackTable::instance().path(id) : QString();
+}
+
+void PlaylistModel::setPath(qsizetype row, const QString &path)
+{
+    auto &track = m_tracks[row];
+    const auto id = TrackTable::instance().intern(path);
+    if (const auto info = m_infos.take(track.id); track.metadata == METADATA::KNOWN)
+        m_infos.insert(id, info);
+
+    track.id = id;
+    rowsChanged(row, row);
+}
+
+PlaylistModel::METADATA PlaylistModel::metadata(qsizetype row) const
+{
+    return m_tracks[row].metadata;
+}
+
+void PlaylistModel::setMetadata(qsizetype row, METADATA metadata)
+{
+    /* UNKNOWN and QUEUED look the same, nothing to repaint. */
+    m_tracks[row].metadata = metadata;
+}
+
+void PlaylistModel::setTrackInfo(qsizetype row, const TrackInfo &info)
+{
+    auto &track = m_tracks[row];
+    track.metadata = METADATA::KNOWN;
+    m_infos.insert(track.id, info);
+    m_sorter.invalidate(track.id);
+    rowsChanged(row, row);
+}
+
+void PlaylistModel::setTrackInfos(const QHash<QString, const TrackInfo *> &infos)
+{
+    const auto infosById = byId(infos);
+    qsizetype first = -1;
+    qsizetype last = -1;
+
+    for (std::size_t row = 0; row < m_tracks.size(); ++row) {
+        auto &track = m_tracks[row];
+        if (track.metadata == METADATA::KNOWN)
+            continue;
+
+        const auto *info = infosById.value(track.id);
+        if (not info)
+            continue;
+
+        track.metadata = METADATA::KNOWN;
+        m_infos.insert(track.id, *info);
+        m_sorter.invalidate(track.id);
+        if (first < 0)
+            first = static_cast<qsizetype>(row);
+        last = static_cast<qsizetype>(row);
+    }
+
+    if (first >= 0)
+        rowsChanged(first, last);
+}
+
+void PlaylistModel::setVerdicts(const QHash<QString, FileProber::VERDICT> &verdicts)
+{
+    const auto verdictsById = byId(verdicts);
+    qsizetype first = -1;
+    qsizetype last = -1;
+
+    for (std::size_t row = 0; row < m_tracks.size(); ++row) {
+        auto &track = m_tracks[row];
+        const auto it = verdictsById.constFind(track.id);
+        if (it == verdictsById.cend() or it.value() == track.verdict)
+            continue;
+
+        track.verdict = it.value();
+        if (first < 0)
+            first = static_cast<qsizetype>(row);
+        last = static_cast<qsizetype>(row);
+    }
+
+    if (first >= 0)
+        rowsChanged(first, last);
+}
+
+QString PlaylistModel::name(const QString &path)
+{
+    auto name = path.mid(path.lastIndexOf(QDir::separator()) + 1);
+    return name.left(name.lastIndexOf('.'));
+}
+
+void PlaylistModel::setSortKeys(const QList<TrackSorter::KEY> &keys)
+{
+    m_sorter.setKeys(keys);
+}
+
+QList<TrackSorter::KEY> PlaylistModel::sortKeys() const
+{
+    return m_sorter.keys();
+}
+
+void PlaylistModel::sortPlaylist(Playlist &playlist, qsizetype first)
+{
+    m_sorter.sort(playlist, [this] (TrackId id) {
+        const auto it = m_infos.constFind(id);
+        return it != m_infos.cend() ? &it.value() : nullptr;
+    }, first);
+
+    reorder(playlist);
+}
+
+QString PlaylistModel::durationText(qint64 milliseconds)
+{
+    const auto seconds = milliseconds / 1'000;
+    if (seconds >= 3'600) {
+        return QString("%1:%2:%3")
+            .arg(seconds / 3'600)
+            .arg(seconds / 60 % 60, 2, 10, QChar('0'))
+            .arg(seconds % 60, 2, 10, QChar('0'));
+    }
+
+    return QString("%1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+template <typename T>
+QHash<TrackId, T> PlaylistModel::byId(const QHash<QString, T> &byPath)
+{
+    const auto &table = TrackTable::instance();
+    QHash<TrackId, T> byId;
+    byId.reserve(byPath.size());
+    for (auto it = byPath.cbegin(); it != byPath.cend(); ++it) {
+        if (const auto id = table.find(it.key()); id != TrackTable::INVALID)
+            byId.insert(id, it.value());
+    }
+
+    return byId;
+}
+
+void PlaylistModel::rowsChanged(qsizetype first, qsizetype last)
+{
+    emit dataChanged(index(static_cast<int>(first), 0), index(static_cast<int>(last), COLUMN_COUNT - 1));
+}
@@ -0,0 +1,98 @@
+#ifndef PLAYLISTMODEL_HPP
+#define PLAYLISTMODEL_HPP
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <vector>
+
+#include "fileprober.hpp"
+#include "playlist.hpp"
+#include "trackinfo.hpp"
+#include "tracksorter.hpp"
+
+/* Rows of the playlist, one per track in the same order as the list it's given. A row is
+ * just a track id and two small states, its texts are made up in data() so only rows on
+ * screen ever get any. Tags are kept once per track, for those whose tags are known. */
+class PlaylistModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum COLUMN { NAME = 0, TITLE, ARTIST, ALBUM, DURATION, COLUMN_COUNT };
+    /* Full path of the row's file, in every column. */
+    static constexpr int PATH_ROLE = Qt::UserRole;
+
+    enum class METADATA : qint8 { UNKNOWN = 0, QUEUED, KNOWN };
+
+private:
+    struct Track
+    {
+        TrackId id {TrackTable::INVALID};
+        METADATA metadata {METADATA::UNKNOWN};
+        FileProber::VERDICT verdict {FileProber::VERDICT::OK};
+    };
+
+    static QString durationText(qint64 milliseconds);
+    /* Keyed by id, entries of paths never interned are left out. */
+    template <typename T>
+    static QHash<TrackId, T> byId(const QHash<QString, T> &byPath);
+    /* Emits dataChanged() for the rows between first and last, all columns. */
+    void rowsChanged(qsizetype first, qsizetype last);
+
+public:
+    explicit PlaylistModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+
+    /* Shown as the header of the first column. */
+    void setTitle(const QString &title, const QString &toolTip = QString());
+    QString title() const;
+
+    /* Verdicts tell which of them are known to be broken already. */
+    void setPlaylist(const Playlist &playlist, const QHash<QString, FileProber::VERDICT> &verdicts = {});
+    /* All of them in one insertion at the end. */
+    void append(const QStringList &paths, const QHash<QString, FileProber::VERDICT> &verdicts = {});
+    /* Contiguous rows go in one removal each. */
+    void remove(const QSet<QString> &paths);
+    /* Puts the same tracks in a new order, every row keeps its tags and states. */
+    void reorder(const Playlist &playlist);
+    void clear();
+
+    TrackId id(qsizetype row) const;
+    QString path(qsizetype row) const;
+    /* The file at row moved, e.g. it was renamed. */
+    void setPath(qsizetype row, const QString &path);
+    METADATA metadata(qsizetype row) const;
+    void setMetadata(qsizetype row, METADATA metadata);
+    /* Marks the row KNOWN. */
+    void setTrackInfo(qsizetype row, const TrackInfo &info);
+    /* Every row of these files, in one pass. */
+    void setTrackInfos(const QHash<QString, const TrackInfo *> &infos);
+    void setVerdicts(const QHash<QString, FileProber::VERDICT> &verdicts);
+
+    /* Fields rows are put in order by, TrackSorter::defaultKeys() until set. */
+    void setSortKeys(const QList<TrackSorter::KEY> &keys);
+    QList<TrackSorter::KEY> sortKeys() const;
+    /* Puts playlist in that order, from first on, and the rows along with it so the
+     * view and whoever plays the playlist see the same order. */
+    void sortPlaylist(Playlist &playlist, qsizetype first = 0);
+
+    /* File name without its extension, what the first column shows. */
+    static QString name(const QString &path);
+
+private:
+    std::vector<Track> m_tracks;
+    QHash<TrackId, TrackInfo> m_infos;
+    TrackSorter m_sorter;
+    QString m_title;
+    QString m_titleToolTip;
+};
+
+#endif // PLAYLISTMODEL_HPP
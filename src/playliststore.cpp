@@ -0,0 +1,513 @@
+#include "playliststore.hpp"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QUrl>
+#include <algorithm>
+#include <limits>
+
+#include "settings.hpp"
+#include "tracksorter.hpp"
+
+namespace {
+const QString extension = QStringLiteral(".qbpl");
+/* Past this, opening the playlist would spend noticeable time replaying its journal. */
+constexpr qint64 compactionThreshold = 256 * 1'024;
+}
+
+PlaylistStore::PlaylistStore(const QString &directory)
+    : m_directory {directory}
+    , m_indexed {false}
+{
+}
+
+PlaylistStore::~PlaylistStore()
+{
+    m_compaction.wait();
+}
+
+QString PlaylistStore::defaultLocation()
+{
+    /* createEnvironment() makes sure the directory exists. */
+    auto location = QFileInfo(
+        Settings::createEnvironment(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+    ).absolutePath();
+
+    return QString("%1%2%3").arg(location, QDir::separator(), "playlists");
+}
+
+QString PlaylistStore::filename(const QString &name) const
+{
+    /* Names may hold anything, slashes included. */
+    return QString("%1/%2%3").arg(m_directory, QString::fromLatin1(QUrl::toPercentEncoding(name)), extension);
+}
+
+QString PlaylistStore::journalName(const QString &name) const
+{
+    return filename(name) + "-journal";
+}
+
+QString PlaylistStore::compactingName(const QString &name) const
+{
+    return filename(name) + "-compacting";
+}
+
+quint32 PlaylistStore::nextJournal(const QString &name) const
+{
+    PlaylistFile file(filename(name));
+    const auto merged = file.open() ? file.journal() : 0;
+    return qMax(merged, PlaylistJournal::sequence(compactingName(name))) + 1;
+}
+
+bool PlaylistStore::appendEdits(const QString &name, const QList<PlaylistJournal::Edit> &edits)
+{
+    if (edits.isEmpty())
+        return true;
+
+    /* The journal alone doesn't make a playlist, names() lists files. */
+    if (not QFile::exists(filename(name)) and not save(name, {}))
+        return false;
+
+    const auto journal = journalName(name);
+    const auto sequence = QFile::exists(journal) ? 0 : nextJournal(name);
+    QString errorString;
+    if (not PlaylistJournal::append(journal, edits, sequence, &errorString)) {
+        qCritical().noquote() << tr("Unable to save the playlist %1: %2").arg(name, errorString);
+        return false;
+    }
+
+    if (QFileInfo(journal).size() > compactionThreshold)
+        compact(name);
+
+    return true;
+}
+
+void PlaylistStore::compact(const QString &name)
+{
+    /* The next edit past the threshold tries again. */
+    if (m_compaction.isRunning())
+        return;
+
+    const auto base = filename(name);
+    const auto compacting = compactingName(name);
+    /* One left over by a compaction that failed is merged first. */
+    if (not QFile::exists(compacting) and not QFile::rename(journalName(name), compacting))
+        return;
+
+    /* The file says it has the journal's edits, so opening the playlist between writing
+     * the file and removing the journal doesn't apply them twice. */
+    m_compaction.start([name, base, compacting] () {
+        Reader reader(base, {compacting});
+        if (not reader.open()) {
+            qWarning().noquote() << tr("Unable to compact the playlist %1: %2").arg(name, reader.errorString());
+            return;
+        }
+
+        QString errorString;
+        if (not PlaylistFile::write(base, reader.readAll(), reader.journal(), &errorString)) {
+            qWarning().noquote() << tr("Unable to compact the playlist %1: %2").arg(name, errorString);
+            return;
+        }
+
+        QFile::remove(compacting);
+    }, QThread::LowPriority);
+}
+
+void PlaylistStore::buildIndex() const
+{
+    if (m_indexed)
+        return;
+
+    m_indexed = true;
+    for (const auto &name : names()) {
+        indexPaths(name, load(name));
+    }
+}
+
+void PlaylistStore::indexPaths(const QString &name, const QStringList &paths) const
+{
+    if (not m_indexed)
+        return;
+
+    for (const auto id : TrackTable::instance().intern(paths)) {
+        auto &owners = m_owners[id];
+        if (not owners.contains(name))
+            owners << name;
+    }
+}
+
+void PlaylistStore::unindexPaths(const QString &name, const QStringList &paths) const
+{
+    if (not m_indexed)
+        return;
+
+    const auto &table = TrackTable::instance();
+    for (const auto &path : paths) {
+        auto it = m_owners.find(table.find(path));
+        if (it != m_owners.end() and it->removeOne(name) and it->isEmpty())
+            m_owners.erase(it);
+    }
+}
+
+QStringList PlaylistStore::names() const
+{
+    QStringList names;
+    const auto files = QDir(m_directory).entryList({'*' + extension}, QDir::Files, QDir::Name);
+    for (const auto &file : files)
+        names << QUrl::fromPercentEncoding(file.chopped(extension.size()).toLatin1());
+
+    return names;
+}
+
+bool PlaylistStore::contains(const QString &name) const
+{
+    return QFile::exists(filename(name));
+}
+
+std::unique_ptr<PlaylistStore::Reader> PlaylistStore::open(const QString &name, QString *errorString) const
+{
+    auto reader = std::make_unique<Reader>(filename(name), QStringList {compactingName(name), journalName(name)});
+    if (not reader->open()) {
+        if (errorString)
+            *errorString = reader->errorString();
+        return nullptr;
+    }
+
+    return reader;
+}
+
+QStringList PlaylistStore::load(const QString &name) const
+{
+    if (not QFile::exists(filename(name)))
+        return {};
+
+    QString errorString;
+    const auto reader = open(name, &errorString);
+    if (not reader) {
+        qWarning().noquote() << tr("Unable to open the playlist %1: %2").arg(name, errorString);
+        return {};
+    }
+
+    return reader->readAll();
+}
+
+bool PlaylistStore::save(const QString &name, const QStringList &paths)
+{
+    m_compaction.wait();
+    QDir().mkpath(m_directory);
+    const auto previous = m_indexed ? load(name) : QStringList();
+
+    auto sorted = paths;
+    TrackSorter::sort(sorted);
+
+    QString errorString;
+    /* Journals start over from 1, every one there was is removed below. */
+    if (not PlaylistFile::write(filename(name), sorted, 0, &errorString)) {
+        qCritical().noquote() << tr("Unable to save the playlist %1: %2").arg(name, errorString);
+        return false;
+    }
+
+    /* Everything they held is in the file now. */
+    QFile::remove(journalName(name));
+    QFile::remove(compactingName(name));
+
+    if (m_indexed) {
+        unindexPaths(name, previous);
+        indexPaths(name, sorted);
+    }
+    return true;
+}
+
+bool PlaylistStore::add(const QString &name, const QStringList &paths)
+{
+    QList<PlaylistJournal::Edit> edits;
+    edits.reserve(paths.size());
+    for (const auto &path : paths)
+        edits << PlaylistJournal::Edit {PlaylistJournal::OPERATION::ADD, path, {}};
+
+    if (not appendEdits(name, edits))
+        return false;
+
+    indexPaths(name, paths);
+    return true;
+}
+
+bool PlaylistStore::removePaths(const QString &name, const QStringList &paths)
+{
+    /* Nothing to remove from a playlist that was never saved. */
+    if (not QFile::exists(filename(name)))
+        return true;
+
+    QList<PlaylistJournal::Edit> edits;
+    edits.reserve(paths.size());
+    for (const auto &path : paths)
+        edits << PlaylistJournal::Edit {PlaylistJournal::OPERATION::REMOVE, path, {}};
+
+    if (not appendEdits(name, edits))
+        return false;
+
+    unindexPaths(name, paths);
+    return true;
+}
+
+bool PlaylistStore::move(const QString &name, const QList<QPair<QString, QString>> &moves)
+{
+    if (not QFile::exists(filename(name)))
+        return true;
+
+    QList<PlaylistJournal::Edit> edits;
+    edits.reserve(moves.size());
+    for (const auto &[from, to] : moves)
+        edits << PlaylistJournal::Edit {PlaylistJournal::OPERATION::MOVE, from, to};
+
+    if (not appendEdits(name, edits))
+        return false;
+
+    if (m_indexed) {
+        const auto &table = TrackTable::instance();
+        for (const auto &[from, to] : moves) {
+            /* Like the journal, only files the playlist holds go anywhere. */
+            if (m_owners.value(table.find(from)).contains(name)) {
+                unindexPaths(name, {from});
+                indexPaths(name, {to});
+            }
+        }
+    }
+
+    return true;
+}
+
+void PlaylistStore::moveEverywhere(const QList<QPair<QString, QString>> &moves)
+{
+    buildIndex();
+
+    QHash<QString, QList<QPair<QString, QString>>> byPlaylist;
+    const auto &table = TrackTable::instance();
+    for (const auto &move : moves) {
+        for (const auto &name : m_owners.value(table.find(move.first)))
+            byPlaylist[name] << move;
+    }
+
+    for (auto it = byPlaylist.cbegin(); it != byPlaylist.cend(); ++it)
+        move(it.key(), it.value());
+}
+
+bool PlaylistStore::remove(const QString &name)
+{
+    m_compaction.wait();
+    if (m_indexed)
+        unindexPaths(name, load(name));
+
+    QFile::remove(journalName(name));
+    QFile::remove(compactingName(name));
+    return QFile::remove(filename(name));
+}
+
+QString PlaylistStore::find(const QString &path) const
+{
+    return playlistsContaining(path).value(0);
+}
+
+QStringList PlaylistStore::playlistsContaining(const QString &path) const
+{
+    buildIndex();
+
+    auto owners = m_owners.value(TrackTable::instance().find(path));
+    owners.sort();
+    return owners;
+}
+
+qsizetype PlaylistStore::size(const QString &name) const
+{
+    const auto reader = open(name);
+    return reader ? reader->size() : 0;
+}
+
+QStringList PlaylistStore::pathsUnder(const QString &directory) const
+{
+    buildIndex();
+
+    QStringList paths;
+    for (const auto id : TrackTable::instance().under(m_owners.keys(), directory))
+        paths << TrackTable::instance().path(id);
+
+    return paths;
+}
+
+void PlaylistStore::migrate(QSettings *settings)
+{
+    settings->beginGroup("Playlists");
+
+    qsizetype migrated {};
+    for (const auto &name : settings->childGroups()) {
+        settings->beginGroup(name);
+        auto paths = settings->allKeys();
+        settings->endGroup();
+
+#ifdef Q_OS_LINUX
+        /* For some reason QSettings removes the first slash. */
+        for (auto &path : paths)
+            path.prepend("/");
+#endif
+
+        /* Merged in case an earlier attempt wrote it but couldn't clean up the settings. */
+        if (contains(name) ? add(name, paths) : save(name, paths)) {
+            settings->remove(name);
+            ++migrated;
+        }
+    }
+
+    settings->endGroup();
+
+    if (migrated > 0) {
+        qInfo().noquote() << tr("Moved %1 playlists out of the settings to %2.")
+                                 .arg(migrated)
+                                 .arg(m_directory);
+    }
+}
+
+PlaylistStore::Reader::Reader(const QString &filename, const QStringList &journals)
+    : m_file {filename}
+    , m_journals {journals}
+    , m_journal {0}
+    , m_next {0}
+    , m_nextInsertion {0}
+{
+}
+
+bool PlaylistStore::Reader::open()
+{
+    /* Read before the file, a compaction finishing meanwhile leaves the file saying it
+     * has the edits of one of them. */
+    QList<QPair<quint32, QList<PlaylistJournal::Edit>>> journals;
+    for (const auto &journal : std::as_const(m_journals)) {
+        quint32 sequence {};
+        auto edits = PlaylistJournal::read(journal, &sequence);
+        if (not edits.isEmpty())
+            journals << qMakePair(sequence, std::move(edits));
+    }
+
+    if (not m_file.open())
+        return false;
+
+    m_journal = m_file.journal();
+    for (const auto &[sequence, edits] : std::as_const(journals)) {
+        if (sequence <= m_file.journal())
+            continue;
+
+        m_journal = qMax(m_journal, sequence);
+        for (const auto &edit : edits) {
+            switch (edit.operation) {
+            case PlaylistJournal::OPERATION::ADD:
+                add(edit.path);
+                break;
+            case PlaylistJournal::OPERATION::REMOVE:
+                remove(edit.path);
+                break;
+            case PlaylistJournal::OPERATION::MOVE:
+                if (holds(edit.path)) {
+                    remove(edit.path);
+                    add(edit.to);
+                }
+                break;
+            }
+        }
+    }
+
+    QStringList added(m_added.cbegin(), m_added.cend());
+    std::sort(added.begin(), added.end(), &TrackSorter::precedes);
+    for (const auto &path : std::as_const(added))
+        m_insertions << qMakePair(position(path), path);
+
+    m_added.clear();
+    return true;
+}
+
+QString PlaylistStore::Reader::errorString() const
+{
+    return m_file.errorString();
+}
+
+quint32 PlaylistStore::Reader::journal() const
+{
+    return m_journal;
+}
+
+qsizetype PlaylistStore::Reader::size() const
+{
+    return m_file.size() - m_removed.size() + m_insertions.size();
+}
+
+qsizetype PlaylistStore::Reader::position(const QString &path) const
+{
+    qsizetype first = 0;
+    qsizetype count = m_file.size();
+    while (count > 0) {
+        const auto step = count / 2;
+        if (TrackSorter::precedes(m_file.path(first + step), path)) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+bool PlaylistStore::Reader::inFile(const QString &path) const
+{
+    const auto index = position(path);
+    return index < m_file.size() and m_file.path(index) == path;
+}
+
+bool PlaylistStore::Reader::holds(const QString &path) const
+{
+    return m_added.contains(path) or (not m_removed.contains(path) and inFile(path));
+}
+
+void PlaylistStore::Reader::add(const QString &path)
+{
+    /* Only entries of the file are ever in m_removed. */
+    if (not m_removed.remove(path) and not inFile(path))
+        m_added.insert(path);
+}
+
+void PlaylistStore::Reader::remove(const QString &path)
+{
+    if (not m_added.remove(path) and inFile(path))
+        m_removed.insert(path);
+}
+
+bool PlaylistStore::Reader::atEnd() const
+{
+    return m_next >= m_file.size() and m_nextInsertion >= m_insertions.size();
+}
+
+QStringList PlaylistStore::Reader::read(qsizetype count)
+{
+    QStringList paths;
+    paths.reserve(qMin(count, m_file.size() - m_next + m_insertions.size() - m_nextInsertion));
+
+    while (paths.size() < count and not atEnd()) {
+        if (m_nextInsertion < m_insertions.size() and m_insertions[m_nextInsertion].first <= m_next) {
+            paths << m_insertions[m_nextInsertion++].second;
+            continue;
+        }
+
+        /* Empty when the entry is corrupted. */
+        const auto path = m_file.path(m_next++);
+        if (not path.isEmpty() and not m_removed.contains(path))
+            paths << path;
+    }
+
+    return paths;
+}
+
+QStringList PlaylistStore::Reader::readAll()
+{
+    return read(std::numeric_limits<qsizetype>::max());
+}
@@ -0,0 +1,126 @@
+#ifndef PLAYLISTSTORE_HPP
+#define PLAYLISTSTORE_HPP
+
+#include <QCoreApplication>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QSettings>
+#include <QStringList>
+#include <QThread>
+#include <memory>
+
+#include "backgroundjob.hpp"
+#include "playlistfile.hpp"
+#include "playlistjournal.hpp"
+#include "tracktable.hpp"
+
+/* Saved playlists, a PlaylistFile each in their own directory. Paths are kept in
+ * TrackSorter's default order so opening one needs no sorting. Edits to a saved playlist
+ * go to its PlaylistJournal, which is merged back into the file in the background
+ * once it grows big enough. Smart playlists are just a rule and stay in the settings.
+ *
+ * Which playlists hold a track is indexed the first time it's asked, every playlist is
+ * read once then and the index follows the edits made here afterwards. */
+class PlaylistStore
+{
+    Q_DECLARE_TR_FUNCTIONS(PlaylistStore)
+
+    QString filename(const QString &name) const;
+    QString journalName(const QString &name) const;
+    /* Journal being merged, edits made meanwhile go to a new one. */
+    QString compactingName(const QString &name) const;
+    /* For a journal started now, above those before it whether merged or not. */
+    quint32 nextJournal(const QString &name) const;
+    bool appendEdits(const QString &name, const QList<PlaylistJournal::Edit> &edits);
+    void compact(const QString &name);
+    void buildIndex() const;
+    void indexPaths(const QString &name, const QStringList &paths) const;
+    void unindexPaths(const QString &name, const QStringList &paths) const;
+
+public:
+    /* Tracks of a saved playlist, a few at a time in the file's order. Opening it maps the
+     * file and sums up the journals not merged into it yet: what they added is placed by
+     * binary search in the sorted file and what they removed is skipped while reading, so
+     * it costs the edits rather than the size of the playlist. */
+    class Reader
+    {
+        /* Among the file's entries, by binary search. */
+        qsizetype position(const QString &path) const;
+        bool inFile(const QString &path) const;
+        bool holds(const QString &path) const;
+        void add(const QString &path);
+        void remove(const QString &path);
+
+    public:
+        /* journals oldest first. */
+        Reader(const QString &filename, const QStringList &journals);
+        bool open();
+        QString errorString() const;
+        /* Sequence number of the last journal whose edits are in what's read. */
+        quint32 journal() const;
+        /* Tracks it holds, before any is read. */
+        qsizetype size() const;
+        bool atEnd() const;
+        /* Up to count more tracks. */
+        QStringList read(qsizetype count);
+        QStringList readAll();
+
+    private:
+        PlaylistFile m_file;
+        QStringList m_journals;
+        quint32 m_journal;
+        /* Entries of the file the edits took out. */
+        QSet<QString> m_removed;
+        /* Tracks the edits put in, then each with the entry it goes before, ascending. */
+        QSet<QString> m_added;
+        QList<QPair<qsizetype, QString>> m_insertions;
+        qsizetype m_next;
+        qsizetype m_nextInsertion;
+    };
+
+    explicit PlaylistStore(const QString &directory = defaultLocation());
+    ~PlaylistStore();
+
+    PlaylistStore(const PlaylistStore &) = delete;
+    PlaylistStore &operator=(const PlaylistStore &) = delete;
+
+    static QString defaultLocation();
+    QStringList names() const;
+    /* Whether its file is there, so names differing in case are told apart wherever
+     * the file system does. */
+    bool contains(const QString &name) const;
+    /* nullptr if it can't be read, errorString then tells why. */
+    std::unique_ptr<Reader> open(const QString &name, QString *errorString = nullptr) const;
+    /* Empty if there's no such playlist. */
+    QStringList load(const QString &name) const;
+    /* Replaces whatever the playlist held. */
+    bool save(const QString &name, const QStringList &paths);
+    /* Only journaled, it costs what's added or removed whatever the size of the playlist. */
+    bool add(const QString &name, const QStringList &paths);
+    bool removePaths(const QString &name, const QStringList &paths);
+    /* Files that were renamed or moved, from first to second. */
+    bool move(const QString &name, const QList<QPair<QString, QString>> &moves);
+    bool remove(const QString &name);
+    /* First playlist holding path, empty if none does. */
+    QString find(const QString &path) const;
+    /* Sorted by name. */
+    QStringList playlistsContaining(const QString &path) const;
+    /* Number of tracks in the playlist, from its file's header and its journals. */
+    qsizetype size(const QString &name) const;
+    /* Saved paths somewhere below directory. */
+    QStringList pathsUnder(const QString &directory) const;
+    /* move() applied to every playlist holding one of the files. */
+    void moveEverywhere(const QList<QPair<QString, QString>> &moves);
+    /* Moves the playlists older versions kept in settings, one key per path, to their
+     * own files. Does nothing once they're gone from there. */
+    void migrate(QSettings *settings);
+
+private:
+    QString m_directory;
+    BackgroundJob m_compaction;
+    mutable bool m_indexed;
+    mutable QHash<TrackId, QStringList> m_owners;
+};
+
+#endif // PLAYLISTSTORE_HPP
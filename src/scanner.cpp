@@ -0,0 +1,693 @@
+#include "scanner.hpp"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSet>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#ifdef Q_OS_LINUX
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <sys/sysmacros.h>
+    #include <unistd.h>
+#endif
+
+#include "mediaformats.hpp"
+
+namespace {
+/* A worker hands over what it found once it has this many files... */
+constexpr qsizetype batchSize = 512;
+/* ...or this many milliseconds have passed, so the first ones show up right away. */
+constexpr qint64 batchInterval = 100;
+
+/* (device, inode) pairs seen during a scan. Sharded so workers rarely wait for each other. */
+class InodeSet
+{
+    struct Shard
+    {
+        QMutex mutex;
+        QSet<QPair<quint64, quint64>> ids;
+    };
+
+    std::array<Shard, 32> m_shards;
+
+public:
+    /* Returns false if it was already there. */
+    bool insert(quint64 device, quint64 inode)
+    {
+        auto &shard = m_shards[(inode ^ device) % m_shards.size()];
+        QMutexLocker locker(&shard.mutex);
+        const auto size = shard.ids.size();
+        shard.ids.insert(qMakePair(device, inode));
+        return shard.ids.size() != size;
+    }
+};
+
+#ifdef Q_OS_LINUX
+constexpr auto directoryFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOCTTY;
+constexpr qsizetype bufferSize = 64 * 1024;
+
+/* Reads the first bytes of name, in the directory open as dirfd, to tell what it holds. */
+QMediaFormat::FileFormat sniffAt(int dirfd, const char *name, Scanner::Statistics &statistics, std::atomic<qint64> &closes)
+{
+    ++statistics.opens;
+    const int fd = ::openat(dirfd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+        return QMediaFormat::UnspecifiedFormat;
+
+    char header[MediaFormats::headerSize];
+    ++statistics.reads;
+    const auto size = ::read(fd, header, sizeof(header));
+    ::close(fd);
+    ++closes;
+
+    return size > 0 ? MediaFormats::fromHeader(header, size) : QMediaFormat::UnspecifiedFormat;
+}
+#endif
+} // namespace
+
+/* An open directory, kept alive while any of its subdirectories is still queued
+ * so they can be opened relative to it instead of resolving the full path again. */
+struct Scanner::Handle
+{
+    int fd;
+    quint64 device;
+    std::atomic<qint64> *closes;
+
+    ~Handle()
+    {
+#ifdef Q_OS_LINUX
+        ::close(fd);
+        ++*closes;
+#endif
+    }
+};
+
+struct Scanner::Directory
+{
+    QString path;
+    std::shared_ptr<Handle> parent;
+    QByteArray name;
+};
+
+struct Scanner::Worker
+{
+    QMutex mutex;
+    std::deque<Directory> directories;
+    QStringList files;
+    /* files[0, published) were already handed over through filesFound(). */
+    qsizetype published {};
+    QElapsedTimer sincePublished;
+    QList<Listing> listings;
+    Statistics statistics;
+    std::unique_ptr<char[]> buffer;
+};
+
+struct Scanner::Job
+{
+    BACKEND backend;
+    const DirectoryCache *cache;
+    const std::atomic<bool> *cancelled;
+    /* Called from the workers with each new batch of files. */
+    std::function<void(const QStringList &)> found;
+    std::atomic<qint64> foundFiles {0};
+    std::atomic<qint64> listedDirectories {0};
+    const MediaFormats *formats;
+    bool sniff;
+    std::vector<std::unique_ptr<Worker>> workers;
+    /* Directories queued or being listed. Workers leave once it reaches zero. */
+    std::atomic<qint64> pending {0};
+    /* Bumped whenever an idle worker should look again, and how many are asleep. */
+    std::atomic<qint64> wakeups {0};
+    std::atomic<int> idle {0};
+    std::atomic<qint64> closes {0};
+    InodeSet directoryIds;
+    InodeSet fileIds;
+    /* Generic backend only, it has no inodes to tell loops apart. */
+    QMutex canonicalPathsMutex;
+    QSet<QString> canonicalPaths;
+};
+
+Scanner::Scanner(QObject *parent)
+    : QObject {parent}
+    , m_threadCount {QThread::idealThreadCount()}
+#ifdef Q_OS_LINUX
+    , m_backend {BACKEND::NATIVE}
+#else
+    , m_backend {BACKEND::GENERIC}
+#endif
+    , m_cache {nullptr}
+    , m_sniffing {true}
+    , m_cancelled {false}
+{
+}
+
+Scanner::~Scanner()
+{
+    m_cancelled = true;
+    m_job.wait();
+}
+
+void Scanner::setThreadCount(int count)
+{
+    m_threadCount = qMax(1, count);
+}
+
+int Scanner::threadCount() const
+{
+    return m_threadCount;
+}
+
+void Scanner::setBackend(BACKEND backend)
+{
+#ifdef Q_OS_LINUX
+    m_backend = backend;
+#else
+    Q_UNUSED(backend);
+    m_backend = BACKEND::GENERIC;
+#endif
+}
+
+Scanner::BACKEND Scanner::backend() const
+{
+    return m_backend;
+}
+
+void Scanner::setCache(const DirectoryCache *cache)
+{
+    m_cache = cache;
+}
+
+void Scanner::setContentSniffing(bool enabled)
+{
+    m_sniffing = enabled;
+}
+
+bool Scanner::contentSniffing() const
+{
+    return m_sniffing;
+}
+
+bool Scanner::isRunning() const
+{
+    return m_job.isRunning();
+}
+
+void Scanner::start(const QString &root)
+{
+    Q_ASSERT_X(not isRunning(), "Only one scan at a time is allowed.", Q_FUNC_INFO);
+
+    m_job.wait();
+
+    m_cancelled = false;
+    m_job.start([this, root] () {
+        emit finished(walk(root));
+    });
+}
+
+QStringList Scanner::scan(const QString &root)
+{
+    m_cancelled = false;
+    return walk(root);
+}
+
+void Scanner::cancel()
+{
+    m_cancelled = true;
+
+    QMutexLocker locker(&m_idleMutex);
+    m_idle.wakeAll();
+}
+
+bool Scanner::wasCancelled() const
+{
+    return m_cancelled;
+}
+
+QStringList Scanner::walk(const QString &root)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Job job;
+    job.backend = m_backend;
+    job.cache = m_cache;
+    job.cancelled = &m_cancelled;
+    job.found = [this, &job] (const QStringList &files) {
+        job.foundFiles += files.size();
+        emit filesFound(files);
+        emit progress(job.foundFiles, job.listedDirectories);
+    };
+    job.formats = &MediaFormats::instance();
+    job.sniff = m_sniffing;
+
+    for (int i = 0; i < m_threadCount; ++i) {
+        job.workers.push_back(std::make_unique<Worker>());
+#ifdef Q_OS_LINUX
+        if (job.backend == BACKEND::NATIVE)
+            job.workers.back()->buffer = std::make_unique<char[]>(bufferSize);
+#endif
+    }
+
+    job.pending = 1;
+    job.workers[0]->directories.push_back({root, nullptr, {}});
+
+    BackgroundJob::runParallel(m_threadCount, [this, &job] (int index) { work(job, index); });
+
+    /* Directories left behind by a cancelled scan hold descriptors whose
+     * Handle counts on job.closes, which is destroyed before the workers. */
+    for (auto &worker : job.workers)
+        worker->directories.clear();
+
+    const bool cancelled = m_cancelled;
+
+    Statistics statistics;
+    QStringList files;
+    QList<Listing> listings;
+    for (const auto &worker : job.workers) {
+        files << worker->files;
+        listings << worker->listings;
+        statistics.cachedDirectories += worker->statistics.cachedDirectories;
+        statistics.directories += worker->statistics.directories;
+        statistics.opens += worker->statistics.opens;
+        statistics.reads += worker->statistics.reads;
+        statistics.stats += worker->statistics.stats;
+        statistics.skippedDirectories += worker->statistics.skippedDirectories;
+        statistics.skippedFiles += worker->statistics.skippedFiles;
+        statistics.sniffedFiles += worker->statistics.sniffedFiles;
+    }
+
+    std::sort(files.begin(), files.end(), &Scanner::lessThan);
+
+    statistics.files = files.size();
+    statistics.closes = job.closes;
+    statistics.elapsed = timer.elapsed();
+    m_statistics = statistics;
+    m_listings = cancelled ? QList<Listing>() : listings;
+
+    if (cancelled) {
+        qInfo().noquote() << tr("Scan of: %1 cancelled after %2 ms, %3 music files found in %4 directories.")
+                                 .arg(root)
+                                 .arg(statistics.elapsed)
+                                 .arg(statistics.files)
+                                 .arg(statistics.directories);
+    } else if (job.backend == BACKEND::NATIVE) {
+        qInfo().noquote() << tr("Loaded %1 music files from %2 directories under: %3 in %4 ms "
+                                "using %5 threads and %6 syscalls.")
+                                 .arg(statistics.files)
+                                 .arg(statistics.directories)
+                                 .arg(root)
+                                 .arg(statistics.elapsed)
+                                 .arg(m_threadCount)
+                                 .arg(statistics.syscalls());
+    } else {
+        qInfo().noquote() << tr("Loaded %1 music files from %2 directories under: %3 in %4 ms "
+                                "using %5 threads.")
+                                 .arg(statistics.files)
+                                 .arg(statistics.directories)
+                                 .arg(root)
+                                 .arg(statistics.elapsed)
+                                 .arg(m_threadCount);
+    }
+
+    return files;
+}
+
+Scanner::Statistics Scanner::statistics() const
+{
+    return m_statistics;
+}
+
+QList<Scanner::Listing> Scanner::listings() const
+{
+    return m_listings;
+}
+
+void Scanner::work(Job &job, int index) const
+{
+    auto &self = *job.workers[index];
+    const auto count = static_cast<int>(job.workers.size());
+
+    while (job.pending.load() > 0 and not job.cancelled->load(std::memory_order_relaxed)) {
+        /* Read before looking at the queues, a directory queued after that changes it. */
+        const auto wakeups = job.wakeups.load();
+        Directory directory;
+        bool found {false};
+
+        {
+            QMutexLocker locker(&self.mutex);
+            if (not self.directories.empty()) {
+                directory = std::move(self.directories.back());
+                self.directories.pop_back();
+                found = true;
+            }
+        }
+
+        for (int i = 1; not found and i < count; ++i) {
+            auto &victim = *job.workers[(index + i) % count];
+            QMutexLocker locker(&victim.mutex);
+            if (not victim.directories.empty()) {
+                directory = std::move(victim.directories.front());
+                victim.directories.pop_front();
+                found = true;
+            }
+        }
+
+        if (not found) {
+            /* Somebody is still listing a directory which may give us more work. */
+            QMutexLocker locker(&m_idleMutex);
+            ++job.idle;
+            if (job.wakeups.load() == wakeups and job.pending.load() > 0 and not job.cancelled->load())
+                m_idle.wait(&m_idleMutex);
+            --job.idle;
+            continue;
+        }
+
+#ifdef Q_OS_LINUX
+        if (job.backend == BACKEND::NATIVE)
+            listDirectoryNatively(job, self, directory);
+        else
+#endif
+            listDirectory(job, self, directory);
+        ++job.listedDirectories;
+        if (--job.pending == 0)
+            wakeIdle(job);
+        publish(job, self, false);
+    }
+
+    publish(job, self, true);
+}
+
+void Scanner::publish(Job &job, Worker &worker, bool force) const
+{
+    const auto unpublished = worker.files.size() - worker.published;
+    if (unpublished == 0)
+        return;
+
+    if (not force
+        and unpublished < batchSize
+        and worker.sincePublished.isValid()
+        and worker.sincePublished.elapsed() < batchInterval)
+        return;
+
+    job.found(worker.files.mid(worker.published));
+    worker.published = worker.files.size();
+    worker.sincePublished.start();
+}
+
+bool Scanner::listFromCache(Job &job,
+                            Worker &worker,
+                            const Directory &directory,
+                            qint64 modified,
+                            const std::shared_ptr<Handle> &handle,
+                            QList<Directory> &subdirs) const
+{
+    if (not job.cache)
+        return false;
+
+    QStringList files;
+    QStringList directories;
+    if (not job.cache->listing(directory.path, modified, files, directories))
+        return false;
+
+    const auto separator = QDir::separator();
+    ++worker.statistics.cachedDirectories;
+
+    for (const auto &file : files)
+        worker.files << directory.path + separator + file;
+
+    for (const auto &name : directories)
+        subdirs.push_back({directory.path + separator + name, handle, QFile::encodeName(name)});
+
+    return true;
+}
+
+void Scanner::queue(Job &job, Worker &worker, QList<Directory> &subdirs) const
+{
+    if (subdirs.isEmpty())
+        return;
+
+    /* Count them before they're visible to others so pending never drops to zero too early. */
+    job.pending += subdirs.size();
+
+    {
+        QMutexLocker locker(&worker.mutex);
+        for (auto &subdir : subdirs)
+            worker.directories.push_back(std::move(subdir));
+    }
+
+    wakeIdle(job);
+}
+
+void Scanner::wakeIdle(Job &job) const
+{
+    /* Workers count themselves idle before checking wakeups, so either they see
+     * this bump or this sees them, and then they're waiting once the lock is free. */
+    ++job.wakeups;
+    if (job.idle.load() == 0)
+        return;
+
+    QMutexLocker locker(&m_idleMutex);
+    m_idle.wakeAll();
+}
+
+void Scanner::listDirectory(Job &job, Worker &worker, Directory &directory) const
+{
+    const auto &dir = directory.path;
+    QList<Directory> subdirs;
+    ++worker.statistics.directories;
+
+    qint64 modified {};
+    if (job.cache) {
+        modified = QFileInfo(dir).lastModified().toMSecsSinceEpoch();
+        if (listFromCache(job, worker, directory, modified, nullptr, subdirs)) {
+            queue(job, worker, subdirs);
+            return;
+        }
+    }
+
+    Listing listing {dir, modified, {}, {}};
+    QDirIterator it(dir, QDir::Filter::AllEntries | QDir::Filter::NoDotAndDotDot);
+
+    while (it.hasNext()) {
+        const auto info = it.nextFileInfo();
+        const auto entry = info.fileName();
+        auto filepath = QString("%1%2%3").arg(dir, QDir::separator(), entry);
+
+        if (info.isFile()) {
+            auto format = MediaFormats::fromName(entry);
+            if (format == QMediaFormat::UnspecifiedFormat and job.sniff and MediaFormats::isWorthSniffing(entry)) {
+                ++worker.statistics.sniffedFiles;
+                format = MediaFormats::fromContent(filepath);
+            }
+
+            if (not job.formats->isSupported(format))
+                continue;
+
+            worker.files << filepath;
+            if (job.cache)
+                listing.files.append(FileStatus {entry, info.size(), info.lastModified().toMSecsSinceEpoch()});
+        } else if (info.isDir()) {
+            if (info.isSymLink()) {
+                QMutexLocker locker(&job.canonicalPathsMutex);
+                const auto size = job.canonicalPaths.size();
+                job.canonicalPaths.insert(info.canonicalFilePath());
+                if (job.canonicalPaths.size() == size) {
+                    ++worker.statistics.skippedDirectories;
+                    continue;
+                }
+            }
+
+            listing.directories << entry;
+            subdirs.push_back({filepath, nullptr, {}});
+        }
+    }
+
+    if (job.cache)
+        worker.listings << listing;
+
+    queue(job, worker, subdirs);
+}
+
+#ifdef Q_OS_LINUX
+void Scanner::listDirectoryNatively(Job &job, Worker &worker, Directory &directory) const
+{
+    auto &statistics = worker.statistics;
+    int fd = -1;
+
+    if (directory.parent) {
+        fd = ::openat(directory.parent->fd, directory.name.constData(), directoryFlags);
+        ++statistics.opens;
+    }
+
+    /* The root, or we ran out of file descriptors keeping parents open. */
+    if (fd < 0) {
+        fd = ::open(QFile::encodeName(directory.path).constData(), directoryFlags);
+        ++statistics.opens;
+    }
+
+    directory.parent.reset();
+
+    if (fd < 0) {
+        qWarning().noquote() << tr("Unable to open directory: %1: %2.")
+                                    .arg(directory.path, QString::fromLocal8Bit(std::strerror(errno)));
+        return;
+    }
+
+    struct stat status;
+    ++statistics.stats;
+    if (::fstat(fd, &status) != 0 or not job.directoryIds.insert(status.st_dev, status.st_ino)) {
+        ::close(fd);
+        ++job.closes;
+        ++statistics.skippedDirectories;
+        return;
+    }
+
+    ++statistics.directories;
+    /* Not make_shared, a temporary Handle would close the descriptor on its way out. */
+    std::shared_ptr<Handle> handle(new Handle {fd, status.st_dev, &job.closes});
+    const auto modified = qint64(status.st_mtim.tv_sec) * 1'000 + status.st_mtim.tv_nsec / 1'000'000;
+    QList<Directory> subdirs;
+
+    if (listFromCache(job, worker, directory, modified, handle, subdirs)) {
+        queue(job, worker, subdirs);
+        return;
+    }
+
+    /* Sizes and modification times are only needed to keep the cache up to date. */
+    const unsigned int mask = job.cache ? STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME
+                                        : STATX_TYPE | STATX_INO;
+    Listing listing {directory.path, modified, {}, {}};
+    auto *buffer = worker.buffer.get();
+    const auto separator = QDir::separator();
+
+    /* A single huge directory shouldn't delay cancelling. */
+    while (not job.cancelled->load(std::memory_order_relaxed)) {
+        const auto read = ::syscall(SYS_getdents64, fd, buffer, bufferSize);
+        ++statistics.reads;
+        if (read <= 0)
+            break;
+
+        for (long offset = 0; offset < read;) {
+            const auto *entry = reinterpret_cast<const struct dirent64 *>(buffer + offset);
+            offset += entry->d_reclen;
+
+            const char *name = entry->d_name;
+            /* ".", ".." and hidden entries, QDir skips them too. */
+            if (name[0] == '.')
+                continue;
+
+            auto type = entry->d_type;
+            quint64 device = handle->device;
+            quint64 inode = entry->d_ino;
+            struct statx extendedStatus;
+            bool haveStatus {false};
+
+            auto statFile = [&] () {
+                ++statistics.stats;
+                /* Follows symlinks as AT_SYMLINK_NOFOLLOW isn't given. */
+                haveStatus = ::statx(fd, name, AT_STATX_DONT_SYNC, mask, &extendedStatus) == 0;
+                return haveStatus;
+            };
+
+            /* Either the filesystem doesn't fill d_type in or we have to follow a symlink. */
+            if (type == DT_UNKNOWN or type == DT_LNK) {
+                if (not statFile())
+                    continue; // Most likely a dangling symlink.
+
+                if (S_ISDIR(extendedStatus.stx_mode))
+                    type = DT_DIR;
+                else if (S_ISREG(extendedStatus.stx_mode))
+                    type = DT_REG;
+                else
+                    continue;
+
+                device = makedev(extendedStatus.stx_dev_major, extendedStatus.stx_dev_minor);
+                inode = extendedStatus.stx_ino;
+            }
+
+            if (type == DT_REG) {
+                auto format = MediaFormats::fromName(name);
+                if (format == QMediaFormat::UnspecifiedFormat and job.sniff and MediaFormats::isWorthSniffing(name)) {
+                    ++statistics.sniffedFiles;
+                    format = sniffAt(fd, name, statistics, job.closes);
+                }
+
+                if (not job.formats->isSupported(format))
+                    continue;
+
+                if (not job.fileIds.insert(device, inode)) {
+                    ++statistics.skippedFiles;
+                    continue;
+                }
+
+                const auto filename = QFile::decodeName(name);
+                worker.files << directory.path + separator + filename;
+
+                if (job.cache and (haveStatus or statFile())) {
+                    listing.files.append(FileStatus {
+                        filename,
+                        static_cast<qint64>(extendedStatus.stx_size),
+                        qint64(extendedStatus.stx_mtime.tv_sec) * 1'000 + extendedStatus.stx_mtime.tv_nsec / 1'000'000
+                    });
+                }
+            } else if (type == DT_DIR) {
+                const auto dirname = QFile::decodeName(name);
+                listing.directories << dirname;
+                subdirs.push_back({directory.path + separator + dirname, handle, QByteArray(name)});
+            }
+        }
+    }
+
+    if (job.cache)
+        worker.listings << listing;
+
+    queue(job, worker, subdirs);
+}
+#endif // Q_OS_LINUX
+
+bool Scanner::lessThan(const QString &first, const QString &second)
+{
+    const auto separator = QDir::separator();
+    qsizetype i {};
+    qsizetype j {};
+
+    while (i < first.size() and j < second.size()) {
+        auto firstEnd = first.indexOf(separator, i);
+        auto secondEnd = second.indexOf(separator, j);
+        if (firstEnd < 0)
+            firstEnd = first.size();
+        if (secondEnd < 0)
+            secondEnd = second.size();
+
+        auto a = QStringView(first).mid(i, firstEnd - i);
+        auto b = QStringView(second).mid(j, secondEnd - j);
+
+        int result = a.compare(b, Qt::CaseInsensitive);
+        if (result == 0)
+            result = a.compare(b, Qt::CaseSensitive);
+        if (result != 0)
+            return result < 0;
+
+        i = firstEnd + 1;
+        j = secondEnd + 1;
+    }
+
+    return i >= first.size() and j < second.size();
+}
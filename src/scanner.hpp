@@ -0,0 +1,155 @@
+#ifndef SCANNER_HPP
+#define SCANNER_HPP
+
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+#include "backgroundjob.hpp"
+
+/* Lets a scan reuse what it found last time in directories that haven't changed since. */
+class DirectoryCache
+{
+public:
+    virtual ~DirectoryCache() = default;
+    /* Fills in the music files and subdirectories (just their names) dir had when its
+     * modification time was modified. Returns false if it's unknown or it changed. */
+    virtual bool listing(const QString &dir,
+                         qint64 modified,
+                         QStringList &files,
+                         QStringList &directories) const = 0;
+};
+
+/* Walks a directory tree looking for music files using a pool of worker threads.
+ * Every worker owns a queue of directories: it pops from the back of its own queue
+ * and, when it runs dry, steals from the front of somebody else's, which is where the
+ * shallowest (hence biggest) pending subtrees are. Found files go to a per-worker buffer
+ * so workers never contend on the results; buffers are merged once everyone's done. */
+class Scanner : public QObject
+{
+    Q_OBJECT
+
+    struct Directory;
+    struct Handle;
+    struct Worker;
+    struct Job;
+
+    QStringList walk(const QString &root);
+    void work(Job &job, int index) const;
+    void publish(Job &job, Worker &worker, bool force) const;
+    void queue(Job &job, Worker &worker, QList<Directory> &subdirs) const;
+    void wakeIdle(Job &job) const;
+    bool listFromCache(Job &job,
+                       Worker &worker,
+                       const Directory &directory,
+                       qint64 modified,
+                       const std::shared_ptr<Handle> &handle,
+                       QList<Directory> &subdirs) const;
+    void listDirectory(Job &job, Worker &worker, Directory &directory) const;
+#ifdef Q_OS_LINUX
+    void listDirectoryNatively(Job &job, Worker &worker, Directory &directory) const;
+#endif
+
+public:
+    enum class BACKEND {
+        /* QDirIterator, available everywhere. */
+        GENERIC = 0,
+        /* Reads directory entries with getdents64 and trusts d_type, only Linux. */
+        NATIVE
+    };
+
+    struct Statistics
+    {
+        qint64 files {};
+        qint64 directories {};
+        qint64 opens {};
+        qint64 reads {};
+        qint64 stats {};
+        qint64 closes {};
+        /* Directories already visited through another path, e.g. a symlink loop. */
+        qint64 skippedDirectories {};
+        /* Files already found through another hard link or symlink. */
+        qint64 skippedFiles {};
+        /* Directories whose listing came from the cache. */
+        qint64 cachedDirectories {};
+        /* Files whose name didn't tell and had to be opened. */
+        qint64 sniffedFiles {};
+        qint64 elapsed {};
+
+        /* Only counted by the native backend. */
+        qint64 syscalls() const { return opens + reads + stats + closes; }
+    };
+
+    struct FileStatus
+    {
+        QString name;
+        qint64 size;
+        qint64 modified; /* Milliseconds since epoch. */
+    };
+
+    /* A directory actually read from disk during a scan with a cache set. */
+    struct Listing
+    {
+        QString path;
+        qint64 modified;
+        QList<FileStatus> files;
+        QStringList directories;
+    };
+
+    explicit Scanner(QObject *parent = nullptr);
+    ~Scanner();
+    void setThreadCount(int count);
+    int threadCount() const;
+    void setBackend(BACKEND backend);
+    BACKEND backend() const;
+    /* When set, unchanged directories aren't read again and listings()
+     * reports, with sizes and modification times, those which were. */
+    void setCache(const DirectoryCache *cache);
+    /* Whether files without a media extension are recognized by their first bytes, on by default.
+     * Names that rule it out, like cover.jpg or album.cue, are never opened. */
+    void setContentSniffing(bool enabled);
+    bool contentSniffing() const;
+    bool isRunning() const;
+    /* Scans in the background for whatever MediaFormats says is playable, filesFound() is
+     * emitted as files are found and finished() with all of them, in order, when done. */
+    void start(const QString &root);
+    /* Blocks the calling thread until the whole tree is scanned.
+     * Don't call it from the GUI thread, use start() instead. */
+    QStringList scan(const QString &root);
+    /* Workers stop after the directory they're listing, finished() is still emitted
+     * with what was found so far. Safe to call from any thread. */
+    void cancel();
+    bool wasCancelled() const;
+    /* Numbers from the last finished scan. */
+    Statistics statistics() const;
+    /* Empty if the last scan was cancelled, its listings wouldn't be complete. */
+    QList<Listing> listings() const;
+    /* Same order QDir gives entries by default: by name, ignoring case, directory by directory. */
+    static bool lessThan(const QString &first, const QString &second);
+
+signals:
+    /* Emitted from the workers' threads, batches come in no particular order. */
+    void filesFound(const QStringList &files);
+    void progress(qint64 files, qint64 directories);
+    void finished(const QStringList &files);
+
+private:
+    int m_threadCount;
+    BACKEND m_backend;
+    const DirectoryCache *m_cache;
+    bool m_sniffing;
+    Statistics m_statistics;
+    QList<Listing> m_listings;
+    BackgroundJob m_job;
+    std::atomic<bool> m_cancelled;
+    /* Idle workers sleep on it until directories are queued, the scan ends or is cancelled. */
+    mutable QMutex m_idleMutex;
+    mutable QWaitCondition m_idle;
+};
+
+#endif // SCANNER_HPP
@@ -0,0 +1,394 @@
+#include "searchindex.hpp"
+
+#include <QBitArray>
+#include <QDir>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+/* Ranking looks at every word of every candidate, past this many the first ones found will do. */
+constexpr qsizetype maximumRanked = 20'000;
+/* Marks where words start and end in padded trigrams, never part of a word. */
+constexpr char16_t wordStart = u'\u0002';
+constexpr char16_t wordEnd = u'\u0003';
+
+quint64 trigramKey(QChar first, QChar second, QChar third)
+{
+    return (quint64(first.unicode()) << 32) | (quint64(second.unicode()) << 16) | third.unicode();
+}
+
+void insertSorted(QList<quint32> &list, quint32 value)
+{
+    const auto it = std::lower_bound(list.begin(), list.end(), value);
+    if (it == list.end() or *it != value)
+        list.insert(it, value);
+}
+
+void eraseSorted(QList<quint32> &list, quint32 value)
+{
+    const auto it = std::lower_bound(list.begin(), list.end(), value);
+    if (it != list.end() and *it == value)
+        list.erase(it);
+}
+}
+
+SearchIndex::SearchIndex(QObject *parent)
+    : QObject {parent}
+    , m_alive {0}
+    , m_stopping {false}
+{
+}
+
+SearchIndex::~SearchIndex()
+{
+    m_stopping = true;
+    m_job.wait();
+}
+
+void SearchIndex::build(const Library &library)
+{
+    m_job.start([this, entries = library.entries()] () {
+        for (auto it = entries.cbegin(); it != entries.cend() and not m_stopping; ++it) {
+            QWriteLocker locker(&m_lock);
+            /* Whatever was indexed meanwhile is newer than this copy of the library. */
+            if (not m_documentIds.contains(it.key()))
+                insertLocked(it.key(), it->info);
+        }
+    }, QThread::LowPriority);
+}
+
+bool SearchIndex::isBuilding() const
+{
+    return m_job.isRunning();
+}
+
+void SearchIndex::insert(const QString &path, const TrackInfo &info)
+{
+    QWriteLocker locker(&m_lock);
+    insertLocked(path, info);
+}
+
+void SearchIndex::remove(const QStringList &paths)
+{
+    QWriteLocker locker(&m_lock);
+    for (const auto &path : paths)
+        removeLocked(path);
+}
+
+bool SearchIndex::contains(const QString &path) const
+{
+    QReadLocker locker(&m_lock);
+    return m_documentIds.contains(path);
+}
+
+qsizetype SearchIndex::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_alive;
+}
+
+QStringList SearchIndex::search(const QString &query, int limit) const
+{
+    auto terms = tokenize(query);
+    if (terms.isEmpty() or limit <= 0)
+        return {};
+
+    terms.removeDuplicates();
+    /* Longer words match fewer documents, the rest is intersected with less. */
+    std::sort(terms.begin(), terms.end(), [] (const QString &a, const QString &b) {
+        return a.size() > b.size();
+    });
+
+    QReadLocker locker(&m_lock);
+
+    QList<QHash<quint32, MATCH>> matches;
+    QBitArray candidates;
+    for (const auto &term : terms) {
+        auto words = matchingWords(term);
+        if (words.isEmpty())
+            return {};
+
+        QBitArray documents(m_documents.size());
+        for (auto it = words.cbegin(); it != words.cend(); ++it) {
+            for (const auto document : m_postings.at(it.key()))
+                documents.setBit(document);
+        }
+
+        candidates = matches.isEmpty() ? documents : candidates & documents;
+        if (candidates.count(true) == 0)
+            return {};
+
+        matches << std::move(words);
+    }
+
+    struct Hit
+    {
+        quint32 document;
+        int score;
+    };
+
+    QList<Hit> hits;
+    hits.reserve(candidates.count(true));
+    for (qsizetype i = 0; i < candidates.size(); ++i) {
+        if (candidates.testBit(i))
+            hits.append(Hit {static_cast<quint32>(i), 0});
+    }
+
+    if (hits.size() <= maximumRanked) {
+        for (auto &hit : hits) {
+            for (const auto &words : matches) {
+                int best {};
+                for (const auto word : m_documents.at(hit.document).words)
+                    best = qMax(best, static_cast<int>(words.value(word, MATCH::NONE)));
+                hit.score += best;
+            }
+        }
+
+        const auto end = hits.begin() + qMin<qsizetype>(limit, hits.size());
+        std::partial_sort(hits.begin(), end, hits.end(), [] (const Hit &a, const Hit &b) {
+            return a.score != b.score ? a.score > b.score : a.document < b.document;
+        });
+    }
+
+    QStringList paths;
+    for (qsizetype i = 0; i < hits.size() and i < limit; ++i)
+        paths << m_documents.at(hits.at(i).document).path;
+
+    return paths;
+}
+
+QStringList SearchIndex::tokenize(const QString &text)
+{
+    /* Decomposed, accents are separate marks and easily dropped: "Beyoncé" is found by "beyonce". */
+    const auto decomposed = text.normalized(QString::NormalizationForm_KD);
+
+    QStringList words;
+    QString word;
+    for (const auto c : decomposed) {
+        if (c.isMark())
+            continue;
+
+        if (c.isLetterOrNumber()) {
+            word += c.toCaseFolded();
+        } else if (not word.isEmpty()) {
+            words << word;
+            word.clear();
+        }
+    }
+
+    if (not word.isEmpty())
+        words << word;
+
+    return words;
+}
+
+QList<quint64> SearchIndex::trigrams(const QString &word, bool padded)
+{
+    const auto text = padded ? QString(2, QChar(wordStart)) + word + QChar(wordEnd) : word;
+
+    QList<quint64> keys;
+    for (qsizetype i = 0; i + 2 < text.size(); ++i)
+        keys << trigramKey(text.at(i), text.at(i + 1), text.at(i + 2));
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+int SearchIndex::prefixDistance(const QString &word, const QString &candidate, int limit)
+{
+    /* Edit distance between word and the closest prefix of candidate, as it may be half typed.
+     * Gives up with limit + 1 as soon as it can't be within limit. */
+    const auto columns = qMin(candidate.size(), word.size() + limit) + 1;
+    QList<int> previous(columns);
+    QList<int> current(columns);
+    for (qsizetype j = 0; j < columns; ++j)
+        previous[j] = static_cast<int>(j);
+
+    for (qsizetype i = 1; i <= word.size(); ++i) {
+        current[0] = static_cast<int>(i);
+        int smallest = current[0];
+        for (qsizetype j = 1; j < columns; ++j) {
+            const int substitution = previous[j - 1] + (word.at(i - 1) == candidate.at(j - 1) ? 0 : 1);
+            current[j] = qMin(substitution, qMin(previous[j], current[j - 1]) + 1);
+            smallest = qMin(smallest, current[j]);
+        }
+
+        if (smallest > limit)
+            return limit + 1;
+
+        std::swap(previous, current);
+    }
+
+    int distance = limit + 1;
+    for (qsizetype j = qMax<qsizetype>(0, word.size() - limit); j < columns; ++j)
+        distance = qMin(distance, previous[j]);
+
+    return distance;
+}
+
+QHash<quint32, SearchIndex::MATCH> SearchIndex::matchingWords(const QString &term) const
+{
+    QHash<quint32, MATCH> matches;
+
+    /* Too short for inner trigrams, the padded one the word starts with finds words beginning so. */
+    if (term.size() < 3) {
+        const auto key = term.size() == 1
+                             ? trigramKey(QChar(wordStart), QChar(wordStart), term.at(0))
+                             : trigramKey(QChar(wordStart), term.at(0), term.at(1));
+        for (const auto word : m_trigrams.value(key))
+            matches.insert(word, m_words.at(word).size() == term.size() ? MATCH::EXACT : MATCH::PREFIX);
+
+        return matches;
+    }
+
+    /* Words having every trigram of term, then checked as that doesn't say they're in order. */
+    auto keys = trigrams(term, false);
+    QList<const QList<quint32> *> lists;
+    for (const auto key : keys) {
+        const auto it = m_trigrams.constFind(key);
+        if (it == m_trigrams.cend()) {
+            lists.clear();
+            break;
+        }
+        lists << &it.value();
+    }
+
+    if (not lists.isEmpty()) {
+        std::sort(lists.begin(), lists.end(), [] (const QList<quint32> *a, const QList<quint32> *b) {
+            return a->size() < b->size();
+        });
+
+        auto words = *lists.first();
+        for (qsizetype i = 1; i < lists.size() and not words.isEmpty(); ++i) {
+            QList<quint32> common;
+            std::set_intersection(words.cbegin(), words.cend(),
+                                  lists.at(i)->cbegin(), lists.at(i)->cend(),
+                                  std::back_inserter(common));
+            words = std::move(common);
+        }
+
+        for (const auto id : words) {
+            const auto &word = m_words.at(id);
+            if (word.size() == term.size() and word == term)
+                matches.insert(id, MATCH::EXACT);
+            else if (word.startsWith(term))
+                matches.insert(id, MATCH::PREFIX);
+            else if (word.contains(term))
+                matches.insert(id, MATCH::PART);
+        }
+    }
+
+    if (not matches.isEmpty() or term.size() < 4)
+        return matches;
+
+    /* Nothing has it as typed: words sharing enough trigrams are close to it. An edit spoils
+     * up to three of them, and a word it'd be a prefix of lacks the two ending ones. */
+    const int limit = term.size() >= 8 ? 2 : 1;
+    keys = trigrams(term, true);
+    const auto needed = qMax<qsizetype>(1, keys.size() - 3 * limit - 2);
+
+    QHash<quint32, int> shared;
+    for (const auto key : keys) {
+        for (const auto word : m_trigrams.value(key))
+            ++shared[word];
+    }
+
+    for (auto it = shared.cbegin(); it != shared.cend(); ++it) {
+        if (it.value() >= needed and prefixDistance(term, m_words.at(it.key()), limit) <= limit)
+            matches.insert(it.key(), MATCH::FUZZY);
+    }
+
+    return matches;
+}
+
+void SearchIndex::insertLocked(const QString &path, const TrackInfo &info)
+{
+    /* The file and the two folders above it, often named after the album and the artist. */
+    auto parts = QDir::fromNativeSeparators(path).split('/', Qt::SkipEmptyParts);
+    QString text = info.title + ' ' + info.artist + ' ' + info.album;
+    if (not parts.isEmpty()) {
+        auto name = parts.takeLast();
+        const auto dot = name.lastIndexOf('.');
+        text += ' ' + (dot > 0 ? name.left(dot) : name);
+    }
+    for (int i = 0; i < 2 and not parts.isEmpty(); ++i)
+        text += ' ' + parts.takeLast();
+
+    QList<quint32> words;
+    for (const auto &word : tokenize(text))
+        words << wordId(word);
+
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    /* Indexed again in place, so postings stay ascending without renumbering anything. */
+    quint32 id;
+    const auto existing = m_documentIds.constFind(path);
+    if (existing != m_documentIds.cend()) {
+        id = existing.value();
+        auto &document = m_documents[id];
+        for (const auto word : document.words) {
+            if (not std::binary_search(words.cbegin(), words.cend(), word))
+                eraseSorted(m_postings[word], id);
+        }
+        for (const auto word : words) {
+            if (not std::binary_search(document.words.cbegin(), document.words.cend(), word))
+                insertSorted(m_postings[word], id);
+        }
+        document.words = std::move(words);
+        return;
+    }
+
+    if (m_freeIds.isEmpty()) {
+        id = static_cast<quint32>(m_documents.size());
+        for (const auto word : words)
+            m_postings[word].append(id);
+
+        m_documents.append(Document {path, std::move(words)});
+    } else {
+        /* A removed one's place, so files coming and going don't grow the index. */
+        id = m_freeIds.takeLast();
+        for (const auto word : words)
+            insertSorted(m_postings[word], id);
+
+        m_documents[id] = Document {path, std::move(words)};
+    }
+
+    m_documentIds.insert(path, id);
+    ++m_alive;
+}
+
+void SearchIndex::removeLocked(const QString &path)
+{
+    const auto it = m_documentIds.constFind(path);
+    if (it == m_documentIds.cend())
+        return;
+
+    /* Left behind empty until another document takes it, ids of the rest stay valid. */
+    auto &document = m_documents[it.value()];
+    for (const auto word : document.words)
+        eraseSorted(m_postings[word], it.value());
+
+    document.path.clear();
+    document.words.clear();
+    m_freeIds << it.value();
+    m_documentIds.erase(it);
+    --m_alive;
+}
+
+quint32 SearchIndex::wordId(const QString &word)
+{
+    const auto it = m_wordIds.constFind(word);
+    if (it != m_wordIds.cend())
+        return it.value();
+
+    const auto id = static_cast<quint32>(m_words.size());
+    m_words << word;
+    m_wordIds.insert(word, id);
+    m_postings.emplaceBack();
+    for (const auto key : trigrams(word, true))
+        m_trigrams[key].append(id);
+
+    return id;
+}
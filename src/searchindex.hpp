@@ -0,0 +1,73 @@
+#ifndef SEARCHINDEX_HPP
+#define SEARCHINDEX_HPP
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <QThread>
+#include <atomic>
+
+#include "backgroundjob.hpp"
+#include "library.hpp"
+#include "trackinfo.hpp"
+
+/* In-memory inverted index over the title, artist and album of every track plus the names
+ * of its file and the two folders above it. Words are folded to lower case without accents.
+ * Every distinct word is also indexed by its trigrams, so a query word finds the words it's
+ * a prefix or a part of, and when nothing contains it, those one or two typos away.
+ * Updated track by track as files come and go or get their tags read. Thread safe. */
+class SearchIndex : public QObject
+{
+    Q_OBJECT
+
+    struct Document
+    {
+        QString path;
+        /* Ids of its distinct words, empty once removed. */
+        QList<quint32> words;
+    };
+
+    enum class MATCH { NONE = 0, FUZZY, PART, PREFIX, EXACT };
+
+    static QStringList tokenize(const QString &text);
+    static QList<quint64> trigrams(const QString &word, bool padded);
+    static int prefixDistance(const QString &word, const QString &candidate, int limit);
+    QHash<quint32, MATCH> matchingWords(const QString &term) const;
+    void insertLocked(const QString &path, const TrackInfo &info);
+    void removeLocked(const QString &path);
+    quint32 wordId(const QString &word);
+
+public:
+    explicit SearchIndex(QObject *parent = nullptr);
+    ~SearchIndex();
+    /* Indexes every file library knows in the background, searching meanwhile is fine. */
+    void build(const Library &library);
+    bool isBuilding() const;
+    /* Indexes path, or indexes it again with new tags. */
+    void insert(const QString &path, const TrackInfo &info = {});
+    void remove(const QStringList &paths);
+    bool contains(const QString &path) const;
+    /* Up to limit paths matching every word of query, best matches first. */
+    QStringList search(const QString &query, int limit) const;
+    qsizetype size() const;
+
+private:
+    mutable QReadWriteLock m_lock;
+    QList<Document> m_documents;
+    QHash<QString, quint32> m_documentIds;
+    /* Ids of removed documents, handed to the next ones indexed. */
+    QList<quint32> m_freeIds;
+    qsizetype m_alive;
+    QStringList m_words;
+    QHash<QString, quint32> m_wordIds;
+    /* Documents having each word, ascending. */
+    QList<QList<quint32>> m_postings;
+    /* Words having each trigram, ascending. */
+    QHash<quint64, QList<quint32>> m_trigrams;
+    BackgroundJob m_job;
+    std::atomic<bool> m_stopping;
+};
+
+#endif // SEARCHINDEX_HPP
@@ -4,12 +4,15 @@
 
 #include <QAudioDevice>
 #include <QDir>
+#include <QIcon>
 #include <QIntValidator>
 #include <QMediaDevices>
 #include <QMessageBox>
 #include <QProcess>
 #include <QStandardPaths>
 
+#include "playliststore.hpp"
+
 Settings::Settings(QWidget *parent)
     : QWidget(parent)
     , m_ui(new Ui::Settings)
@@ -48,12 +51,6 @@ Settings::Settings(QWidget *parent)
            "which can be shown again from the menu bar.")
     );
 
-    m_playlistSettings = new QSettings(
-        createEnvironment(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)),
-        QSettings::IniFormat,
-        this
-    );
-
     m_settings = new QSettings(createEnvironment(), QSettings::IniFormat, this);
     m_settings->beginGroup("WindowSettings");
 
@@ -284,14 +281,21 @@ QString Settings::createEnvironment(const QString &location)
 
 void Settings::loadPlaylists()
 {
-    m_playlistSettings->beginGroup("Playlists");
-
     m_ui->defaultPlaylistComboBox->addItem(tr("None"));
-    for (const auto &playlist : m_playlistSettings->childGroups()) {
+    for (const auto &playlist : PlaylistStore().names()) {
         m_ui->defaultPlaylistComboBox->addItem(playlist);
     }
 
-    m_playlistSettings->endGroup();
+    /* Smart playlists are kept with the playlists' settings, the window opens them just the same. */
+    QSettings playlistSettings(
+        createEnvironment(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)),
+        QSettings::IniFormat
+    );
+    playlistSettings.beginGroup("SmartPlaylists");
+    for (const auto &playlist : playlistSettings.childGroups()) {
+        m_ui->defaultPlaylistComboBox->addItem(QIcon::fromTheme(QIcon::ThemeIcon::EditFind), playlist);
+    }
+    playlistSettings.endGroup();
 
     m_settings->beginGroup("PlaylistSettings");
     auto playlistName = m_settings->value("DefaultPlaylist", "").toString();
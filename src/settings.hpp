@@ -46,7 +46,6 @@ signals:
 private:
     Ui::Settings *m_ui;
     QSettings *m_settings;
-    QSettings *m_playlistSettings;
     bool m_modified;
     bool m_changesApplied;
     /* In order to check whether has had a change. */
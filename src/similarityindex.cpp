@@ -0,0 +1,447 @@
+#include "similarityindex.hpp"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QReadLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QWriteLocker>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+#include "fingerprinter.hpp"
+#include "settings.hpp"
+
+namespace {
+constexpr quint32 magic = 0x51424D46; /* QBMF */
+constexpr quint32 version = 1;
+/* Same hyperplanes every run, not that it matters much: tables are rebuilt on load. */
+constexpr quint32 seed = 0x5EED;
+/* Bits closest to their hyperplane are the likeliest to differ for a similar track,
+ * buckets one flip away from the query's are searched too. */
+constexpr int probedBits = 3;
+/* Below this many fingerprints their mean isn't worth centering on. */
+constexpr qsizetype minimumToCenter = 32;
+
+/* Two files hold the same recording when they sound alike... */
+constexpr float minimumRecordingSimilarity = 0.9f;
+/* ...last about as long... */
+constexpr qint64 durationTolerance = 3'000;
+/* ...and their codes, lined up, differ in few bits. Unrelated ones differ in about half. */
+constexpr float maximumBitErrorRate = 0.2f;
+/* Codes are 186 ms apart, that's 3 seconds of padding or trimming either way. */
+constexpr qsizetype maximumOffset = 16;
+constexpr qsizetype minimumOverlap = 32;
+}
+
+SimilarityIndex::SimilarityIndex(const QString &filename, QObject *parent)
+    : QObject {parent}
+    , m_filename {filename}
+    , m_valid {0}
+    , m_center(Fingerprinter::profileSize, 0.0f)
+    , m_centeredCount {0}
+{
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> distribution;
+
+    m_hyperplanes.reserve(tableCount * bitsPerKey * Fingerprinter::profileSize);
+    for (int i = 0; i < tableCount * bitsPerKey * Fingerprinter::profileSize; ++i)
+        m_hyperplanes << distribution(generator);
+}
+
+QString SimilarityIndex::defaultLocation()
+{
+    /* createEnvironment() makes sure the directory exists. */
+    auto location = QFileInfo(
+        Settings::createEnvironment(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+    ).absolutePath();
+
+    return QString("%1%2%3").arg(location, QDir::separator(), "fingerprints.db");
+}
+
+bool SimilarityIndex::load()
+{
+    QFile file(m_filename);
+    if (not file.exists())
+        return true;
+
+    if (not file.open(QIODevice::ReadOnly)) {
+        emit error(tr("Unable to open the fingerprint index: %1.").arg(file.errorString()));
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 fileMagic, fileVersion;
+    stream >> fileMagic >> fileVersion;
+    if (fileMagic != magic or fileVersion != version) {
+        qWarning().noquote() << tr("Ignoring fingerprint index: %1 written by an incompatible version.")
+                                    .arg(m_filename);
+        return false;
+    }
+
+    qint64 count;
+    stream >> count;
+
+    QList<Entry> entries;
+    entries.reserve(count);
+    for (qint64 i = 0; i < count; ++i) {
+        Entry entry;
+        stream >> entry.path >> entry.size >> entry.modified >> entry.fingerprint;
+        /* Written by a build whose fingerprints had another shape. */
+        if (entry.fingerprint.isValid() and entry.fingerprint.profile.size() != Fingerprinter::profileSize)
+            continue;
+        entries << entry;
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        emit error(tr("The fingerprint index: %1 is corrupted, it'll be rebuilt.").arg(m_filename));
+        return false;
+    }
+
+    QWriteLocker locker(&m_lock);
+    m_entries = std::move(entries);
+    m_ids.clear();
+    m_ids.reserve(m_entries.size());
+    m_valid = 0;
+    for (qsizetype id = 0; id < m_entries.size(); ++id) {
+        m_ids.insert(m_entries[id].path, id);
+        if (m_entries[id].fingerprint.isValid())
+            ++m_valid;
+    }
+
+    rebuild();
+    return true;
+}
+
+bool SimilarityIndex::save() const
+{
+    QReadLocker locker(&m_lock);
+    QSaveFile file(m_filename);
+
+    if (not file.open(QIODevice::WriteOnly)) {
+        qCritical().noquote() << tr("Unable to save the fingerprint index: %1.").arg(file.errorString());
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << magic << version << qint64(m_ids.size());
+
+    for (const auto &entry : m_entries)
+        if (not entry.path.isEmpty())
+            stream << entry.path << entry.size << entry.modified << entry.fingerprint;
+
+    if (not file.commit()) {
+        qCritical().noquote() << tr("Unable to save the fingerprint index: %1.").arg(file.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+bool SimilarityIndex::contains(const QString &path, qint64 size, qint64 modified) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_ids.constFind(path);
+    if (it == m_ids.cend())
+        return false;
+
+    const auto &entry = m_entries[*it];
+    return entry.size == size and entry.modified == modified;
+}
+
+bool SimilarityIndex::hasFingerprint(const QString &path) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_ids.constFind(path);
+    return it != m_ids.cend() and m_entries[*it].fingerprint.isValid();
+}
+
+void SimilarityIndex::insert(const QString &path, qint64 size, qint64 modified, const AcousticFingerprint &fingerprint)
+{
+    QWriteLocker locker(&m_lock);
+
+    qsizetype id;
+    if (auto it = m_ids.constFind(path); it != m_ids.cend()) {
+        id = *it;
+        if (m_entries[id].fingerprint.isValid()) {
+            removeFromTables(id);
+            --m_valid;
+        }
+        m_entries[id] = Entry {path, size, modified, fingerprint};
+    } else {
+        id = m_entries.size();
+        m_entries.append(Entry {path, size, modified, fingerprint});
+        m_ids.insert(path, id);
+    }
+
+    if (not fingerprint.isValid())
+        return;
+
+    ++m_valid;
+    /* Rehashing everything each time the count doubles keeps inserts cheap on average. */
+    if (m_valid >= minimumToCenter and m_valid >= 2 * m_centeredCount)
+        rebuild();
+    else
+        addToTables(id);
+}
+
+void SimilarityIndex::remove(const QStringList &paths)
+{
+    QWriteLocker locker(&m_lock);
+    for (const auto &path : paths) {
+        auto it = m_ids.find(path);
+        if (it == m_ids.end())
+            continue;
+
+        auto &entry = m_entries[*it];
+        if (entry.fingerprint.isValid()) {
+            removeFromTables(*it);
+            --m_valid;
+        }
+
+        entry = {};
+        m_ids.erase(it);
+    }
+}
+
+qsizetype SimilarityIndex::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_valid;
+}
+
+SimilarityIndex::Projections SimilarityIndex::project(const QList<float> &profile) const
+{
+    Projections projections {};
+    const auto *hyperplane = m_hyperplanes.constData();
+
+    for (auto &projection : projections) {
+        for (int i = 0; i < Fingerprinter::profileSize; ++i)
+            projection += hyperplane[i] * (profile[i] - m_center[i]);
+        hyperplane += Fingerprinter::profileSize;
+    }
+
+    return projections;
+}
+
+quint32 SimilarityIndex::key(const Projections &projections, int table)
+{
+    quint32 key {};
+    for (int bit = 0; bit < bitsPerKey; ++bit)
+        if (projections[table * bitsPerKey + bit] > 0.0f)
+            key |= quint32(1) << bit;
+    return key;
+}
+
+float SimilarityIndex::cosine(const QList<float> &first, const QList<float> &second) const
+{
+    float dot {}, firstNorm {}, secondNorm {};
+    for (int i = 0; i < Fingerprinter::profileSize; ++i) {
+        const auto a = first[i] - m_center[i];
+        const auto b = second[i] - m_center[i];
+        dot += a * b;
+        firstNorm += a * a;
+        secondNorm += b * b;
+    }
+
+    if (firstNorm <= 0.0f or secondNorm <= 0.0f)
+        return 0.0f;
+
+    return dot / std::sqrt(firstNorm * secondNorm);
+}
+
+float SimilarityIndex::bitErrorRate(const QList<quint16> &first, const QList<quint16> &second)
+{
+    float best {1.0f};
+
+    /* Either file may start a bit earlier, try every shift within reason. */
+    for (auto offset = -maximumOffset; offset <= maximumOffset; ++offset) {
+        const auto begin = qMax<qsizetype>(0, -offset);
+        const auto end = qMin(first.size(), second.size() - offset);
+        if (end - begin < minimumOverlap)
+            continue;
+
+        qint64 errors {};
+        for (auto i = begin; i < end; ++i)
+            errors += qPopulationCount(quint32(first[i] ^ second[i + offset]));
+
+        best = qMin(best, float(errors) / float((end - begin) * Fingerprinter::bitsPerCode));
+    }
+
+    return best;
+}
+
+void SimilarityIndex::addToTables(qsizetype id)
+{
+    const auto projections = project(m_entries[id].fingerprint.profile);
+    for (int table = 0; table < tableCount; ++table)
+        m_tables[table][key(projections, table)].append(id);
+}
+
+void SimilarityIndex::removeFromTables(qsizetype id)
+{
+    const auto projections = project(m_entries[id].fingerprint.profile);
+    for (int table = 0; table < tableCount; ++table) {
+        auto it = m_tables[table].find(key(projections, table));
+        if (it == m_tables[table].end())
+            continue;
+
+        it->removeOne(id);
+        if (it->isEmpty())
+            m_tables[table].erase(it);
+    }
+}
+
+void SimilarityIndex::rebuild()
+{
+    std::fill(m_center.begin(), m_center.end(), 0.0f);
+    if (m_valid >= minimumToCenter) {
+        for (const auto &entry : std::as_const(m_entries)) {
+            if (not entry.fingerprint.isValid())
+                continue;
+
+            for (int i = 0; i < Fingerprinter::profileSize; ++i)
+                m_center[i] += entry.fingerprint.profile[i];
+        }
+
+        for (auto &value : m_center)
+            value /= float(m_valid);
+    }
+
+    m_centeredCount = m_valid;
+    for (auto &table : m_tables)
+        table.clear();
+
+    for (qsizetype id = 0; id < m_entries.size(); ++id)
+        if (m_entries[id].fingerprint.isValid())
+            addToTables(id);
+}
+
+QList<SimilarityIndex::Match> SimilarityIndex::similar(const QString &path, int count) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_ids.constFind(path);
+    if (it == m_ids.cend() or not m_entries[*it].fingerprint.isValid())
+        return {};
+
+    const auto id = *it;
+    const auto &profile = m_entries[id].fingerprint.profile;
+    const auto projections = project(profile);
+
+    QSet<qsizetype> candidates;
+    auto probe = [this, &candidates] (int table, quint32 key) {
+        auto bucket = m_tables[table].constFind(key);
+        if (bucket == m_tables[table].cend())
+            return;
+        for (auto candidate : *bucket)
+            candidates.insert(candidate);
+    };
+
+    for (int table = 0; table < tableCount; ++table) {
+        const auto base = key(projections, table);
+        probe(table, base);
+
+        std::array<int, bitsPerKey> bits;
+        std::iota(bits.begin(), bits.end(), 0);
+        std::partial_sort(bits.begin(), bits.begin() + probedBits, bits.end(), [&] (int first, int second) {
+            return std::abs(projections[table * bitsPerKey + first]) < std::abs(projections[table * bitsPerKey + second]);
+        });
+
+        for (int i = 0; i < probedBits; ++i)
+            probe(table, base ^ (quint32(1) << bits[i]));
+    }
+
+    QList<Match> matches;
+    matches.reserve(candidates.size());
+    for (auto candidate : std::as_const(candidates)) {
+        if (candidate == id)
+            continue;
+
+        const auto &entry = m_entries[candidate];
+        matches.append(Match {entry.path, (cosine(profile, entry.fingerprint.profile) + 1.0f) / 2.0f});
+    }
+
+    const auto kept = qMin<qsizetype>(count, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + kept, matches.end(), [] (const Match &first, const Match &second) {
+        return first.similarity > second.similarity;
+    });
+    matches.resize(kept);
+
+    return matches;
+}
+
+QList<QStringList> SimilarityIndex::sameRecordings() const
+{
+    QReadLocker locker(&m_lock);
+    QList<qsizetype> parents(m_entries.size());
+    std::iota(parents.begin(), parents.end(), 0);
+
+    auto find = [&parents] (qsizetype id) {
+        while (parents[id] != id)
+            id = parents[id] = parents[parents[id]];
+        return id;
+    };
+
+    for (qsizetype id = 0; id < m_entries.size(); ++id) {
+        const auto &fingerprint = m_entries[id].fingerprint;
+        if (not fingerprint.isValid())
+            continue;
+
+        /* The same recording lands in the same buckets, no need to probe around. */
+        const auto projections = project(fingerprint.profile);
+        QSet<qsizetype> seen;
+
+        for (int table = 0; table < tableCount; ++table) {
+            const auto bucket = m_tables[table].value(key(projections, table));
+            for (auto other : bucket) {
+                if (other <= id or seen.contains(other))
+                    continue;
+                seen.insert(other);
+
+                const auto &candidate = m_entries[other].fingerprint;
+                if (fingerprint.duration > 0 and candidate.duration > 0
+                    and qAbs(fingerprint.duration - candidate.duration) > durationTolerance)
+                    continue;
+
+                if (cosine(fingerprint.profile, candidate.profile) < minimumRecordingSimilarity)
+                    continue;
+
+                if (bitErrorRate(fingerprint.codes, candidate.codes) > maximumBitErrorRate)
+                    continue;
+
+                parents[find(other)] = find(id);
+            }
+        }
+    }
+
+    QHash<qsizetype, QStringList> groups;
+    for (qsizetype id = 0; id < m_entries.size(); ++id)
+        if (m_entries[id].fingerprint.isValid() and find(id) != id)
+            groups[find(id)] << m_entries[id].path;
+
+    QList<QStringList> recordings;
+    recordings.reserve(groups.size());
+    for (auto it = groups.cbegin(); it != groups.cend(); ++it) {
+        /* The root itself isn't in its group yet. */
+        auto group = *it;
+        group.prepend(m_entries[it.key()].path);
+        group.sort();
+        recordings << group;
+    }
+
+    std::sort(recordings.begin(), recordings.end(), [] (const QStringList &first, const QStringList &second) {
+        return first.first() < second.first();
+    });
+
+    return recordings;
+}
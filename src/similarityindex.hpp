@@ -0,0 +1,85 @@
+#ifndef SIMILARITYINDEX_HPP
+#define SIMILARITYINDEX_HPP
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <array>
+
+#include "acousticfingerprint.hpp"
+
+/* On-disk store of acoustic fingerprints, next to the library index. Profiles are also
+ * hashed into a few tables by which side of a set of random hyperplanes they fall on:
+ * tracks that sound alike share buckets, so a query only compares against the handful
+ * of tracks it shares one with instead of the whole library. Thread safe. */
+class SimilarityIndex : public QObject
+{
+    Q_OBJECT
+
+    static constexpr int tableCount = 8;
+    static constexpr int bitsPerKey = 14;
+
+    struct Entry
+    {
+        QString path;
+        qint64 size;
+        qint64 modified;
+        AcousticFingerprint fingerprint;
+    };
+
+    using Projections = std::array<float, tableCount * bitsPerKey>;
+
+    Projections project(const QList<float> &profile) const;
+    static quint32 key(const Projections &projections, int table);
+    float cosine(const QList<float> &first, const QList<float> &second) const;
+    static float bitErrorRate(const QList<quint16> &first, const QList<quint16> &second);
+    void addToTables(qsizetype id);
+    void removeFromTables(qsizetype id);
+    void rebuild();
+
+public:
+    struct Match
+    {
+        QString path;
+        /* From 0, opposite, to 1, alike. */
+        float similarity;
+    };
+
+    explicit SimilarityIndex(const QString &filename = defaultLocation(), QObject *parent = nullptr);
+    static QString defaultLocation();
+    bool load();
+    bool save() const;
+    /* Whether path was analyzed, successfully or not, with this size and modification time. */
+    bool contains(const QString &path, qint64 size, qint64 modified) const;
+    bool hasFingerprint(const QString &path) const;
+    void insert(const QString &path, qint64 size, qint64 modified, const AcousticFingerprint &fingerprint);
+    void remove(const QStringList &paths);
+    /* Up to count tracks sounding like path, most alike first. */
+    QList<Match> similar(const QString &path, int count) const;
+    /* Groups of files holding the same recording, whatever their encoding or bitrate. */
+    QList<QStringList> sameRecordings() const;
+    /* Files with a usable fingerprint. */
+    qsizetype size() const;
+
+signals:
+    void error(const QString &message);
+
+private:
+    QString m_filename;
+    mutable QReadWriteLock m_lock;
+    /* Removed entries leave a hole with an empty path, save() skips them. */
+    QList<Entry> m_entries;
+    QHash<QString, qsizetype> m_ids;
+    qsizetype m_valid;
+    QList<float> m_hyperplanes;
+    /* Subtracted from profiles before hashing, they all point roughly the same way
+     * otherwise and would end up in a few huge buckets. */
+    QList<float> m_center;
+    /* How many fingerprints m_center was computed from, it's redone once that doubles. */
+    qsizetype m_centeredCount;
+    std::array<QHash<quint32, QList<qsizetype>>, tableCount> m_tables;
+};
+
+#endif // SIMILARITYINDEX_HPP
@@ -0,0 +1,108 @@
+#include "similartracksdialog.hpp"
+#include "ui_similartracksdialog.h"
+
+#include <QFileInfo>
+
+SimilarTracksDialog::SimilarTracksDialog(const QString &track,
+                                         const QList<SimilarityIndex::Match> &matches,
+                                         const QHash<QString, TrackInfo> &infos,
+                                         const Playlist &playlist,
+                                         QWidget *parent)
+    : QDialog(parent)
+    , m_ui(new Ui::SimilarTracksDialog)
+    , m_playlist {playlist}
+{
+    m_ui->setupUi(this);
+    setWindowTitle(tr("Tracks Like %1").arg(QFileInfo(track).completeBaseName()));
+
+    m_addButton = m_ui->buttonBox->addButton(tr("Add to playlist"), QDialogButtonBox::AcceptRole);
+    m_addButton->setIcon(QIcon::fromTheme(QIcon::ThemeIcon::ListAdd));
+
+    configureTree();
+    populate(matches, infos);
+
+    connect(m_ui->treeWidget, &QTreeWidget::itemChanged, this, &SimilarTracksDialog::onItemChanged);
+    connect(m_ui->buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(m_ui->buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+SimilarTracksDialog::~SimilarTracksDialog()
+{
+    delete m_ui;
+}
+
+QStringList SimilarTracksDialog::checkedFiles() const
+{
+    QStringList files;
+    for (int i = 0; i < m_ui->treeWidget->topLevelItemCount(); ++i) {
+        const auto *item = m_ui->treeWidget->topLevelItem(i);
+        if (item->checkState(0) == Qt::Checked)
+            files << item->data(0, Qt::UserRole).toString();
+    }
+
+    return files;
+}
+
+void SimilarTracksDialog::onItemChanged([[maybe_unused]] QTreeWidgetItem *item, int column)
+{
+    if (column != 0)
+        return;
+
+    updateAddButton();
+}
+
+void SimilarTracksDialog::updateAddButton()
+{
+    const auto checked = checkedFiles().size();
+    m_addButton->setEnabled(checked > 0);
+    m_addButton->setText(tr("Add %n to playlist", nullptr, static_cast<int>(checked)));
+}
+
+void SimilarTracksDialog::configureTree()
+{
+    m_ui->treeWidget->setColumnCount(4);
+    m_ui->treeWidget->setHeaderLabels({tr("File"), tr("Title"), tr("Artist"), tr("Similarity")});
+    m_ui->treeWidget->setSelectionMode(QAbstractItemView::NoSelection);
+    m_ui->treeWidget->setEditTriggers(QTreeWidget::NoEditTriggers);
+    m_ui->treeWidget->setUniformRowHeights(true);
+    m_ui->treeWidget->setRootIsDecorated(false);
+}
+
+void SimilarTracksDialog::populate(const QList<SimilarityIndex::Match> &matches, const QHash<QString, TrackInfo> &infos)
+{
+    QList<QTreeWidgetItem *> items;
+    items.reserve(matches.size());
+
+    for (const auto &match : matches) {
+        const auto info = infos.value(match.path);
+        auto *item = new QTreeWidgetItem(QStringList {
+            QFileInfo(match.path).completeBaseName(),
+            info.title,
+            info.artist,
+            QString("%1%").arg(qRound(match.similarity * 100))
+        });
+        item->setData(0, Qt::UserRole, match.path);
+        item->setToolTip(0, match.path);
+
+        if (m_playlist.contains(match.path)) {
+            item->setFlags(item->flags() & ~Qt::ItemIsEnabled);
+            item->setToolTip(0, tr("Already in the current playlist."));
+        } else {
+            item->setCheckState(0, Qt::Unchecked);
+        }
+
+        items << item;
+    }
+
+    m_ui->treeWidget->addTopLevelItems(items);
+    for (int column = 0; column < m_ui->treeWidget->columnCount(); ++column)
+        m_ui->treeWidget->resizeColumnToContents(column);
+
+    m_ui->label->setText(
+        matches.isEmpty()
+            ? tr("No analyzed track sounds like this one. Analyze more of the library to find some.")
+            : tr("Check the tracks you'd like to add to the current playlist.")
+    );
+
+    updateAddButton();
+}
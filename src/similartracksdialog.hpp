@@ -0,0 +1,46 @@
+#ifndef SIMILARTRACKSDIALOG_HPP
+#define SIMILARTRACKSDIALOG_HPP
+
+#include <QDialog>
+#include <QHash>
+#include <QPushButton>
+#include <QTreeWidgetItem>
+
+#include "playlist.hpp"
+#include "similarityindex.hpp"
+#include "trackinfo.hpp"
+
+namespace Ui {
+class SimilarTracksDialog;
+}
+
+/* Lists the tracks sounding most like a given one, most alike first. Those not in
+ * the current playlist can be checked and added to it all at once. */
+class SimilarTracksDialog : public QDialog
+{
+    Q_OBJECT
+
+    void configureTree();
+    void populate(const QList<SimilarityIndex::Match> &matches, const QHash<QString, TrackInfo> &infos);
+    void updateAddButton();
+
+public:
+    /* infos holds whatever tags are known for the matches, file names are shown otherwise. */
+    explicit SimilarTracksDialog(const QString &track,
+                                 const QList<SimilarityIndex::Match> &matches,
+                                 const QHash<QString, TrackInfo> &infos,
+                                 const Playlist &playlist,
+                                 QWidget *parent = nullptr);
+    ~SimilarTracksDialog();
+    QStringList checkedFiles() const;
+
+private slots:
+    void onItemChanged(QTreeWidgetItem *item, int column);
+
+private:
+    Ui::SimilarTracksDialog *m_ui;
+    Playlist m_playlist;
+    QPushButton *m_addButton;
+};
+
+#endif // SIMILARTRACKSDIALOG_HPP
@@ -0,0 +1,484 @@
+#include "smartplaylist.hpp"
+
+#include <QDateTime>
+
+namespace {
+/* Entries matched per pass of the event loop. */
+constexpr qsizetype chunkSize = 4'096;
+
+constexpr qint64 second = 1'000;
+constexpr qint64 minute = 60 * second;
+constexpr qint64 hour = 60 * minute;
+constexpr qint64 day = 24 * hour;
+
+struct Token
+{
+    enum class TYPE { WORD = 0, STRING, OPERATOR, OPEN, CLOSE, END };
+
+    TYPE type;
+    QString text;
+    qsizetype position;
+};
+
+QList<Token> tokenize(const QString &rule)
+{
+    const QString operators("=!<>~");
+    auto isDelimiter = [&operators] (QChar c) {
+        return c.isSpace() or c == '(' or c == ')' or c == '"' or c == '\'' or operators.contains(c);
+    };
+
+    QList<Token> tokens;
+    qsizetype i = 0;
+    while (i < rule.size()) {
+        const auto c = rule.at(i);
+        if (c.isSpace()) {
+            ++i;
+        } else if (c == '(' or c == ')') {
+            tokens.append(Token {c == '(' ? Token::TYPE::OPEN : Token::TYPE::CLOSE, c, i});
+            ++i;
+        } else if (c == '"' or c == '\'') {
+            auto end = rule.indexOf(c, i + 1);
+            if (end < 0)
+                end = rule.size();
+            tokens.append(Token {Token::TYPE::STRING, rule.mid(i + 1, end - i - 1), i});
+            i = end + 1;
+        } else if (operators.contains(c)) {
+            const auto length = i + 1 < rule.size() and rule.at(i + 1) == '=' ? 2 : 1;
+            tokens.append(Token {Token::TYPE::OPERATOR, rule.mid(i, length), i});
+            i += length;
+        } else {
+            auto end = i;
+            while (end < rule.size() and not isDelimiter(rule.at(end)))
+                ++end;
+            tokens.append(Token {Token::TYPE::WORD, rule.mid(i, end - i), i});
+            i = end;
+        }
+    }
+
+    tokens.append(Token {Token::TYPE::END, {}, rule.size()});
+    return tokens;
+}
+
+/* Splits "5min" into 5 and "min". */
+bool splitQuantity(const QString &text, double &amount, QString &unit)
+{
+    qsizetype digits = 0;
+    while (digits < text.size() and (text.at(digits).isDigit() or text.at(digits) == '.'))
+        ++digits;
+
+    bool ok {};
+    amount = text.left(digits).toDouble(&ok);
+    unit = text.mid(digits).toLower();
+    return ok;
+}
+
+qint64 durationUnit(const QString &unit)
+{
+    static const QHash<QString, qint64> units {
+        {"ms", 1}, {"s", second}, {"sec", second}, {"secs", second}, {"second", second}, {"seconds", second},
+        {"m", minute}, {"min", minute}, {"mins", minute}, {"minute", minute}, {"minutes", minute},
+        {"h", hour}, {"hour", hour}, {"hours", hour}
+    };
+
+    return units.value(unit);
+}
+
+qint64 ageUnit(const QString &unit)
+{
+    static const QHash<QString, qint64> units {
+        {"h", hour}, {"hour", hour}, {"hours", hour},
+        {"d", day}, {"day", day}, {"days", day},
+        {"w", 7 * day}, {"week", 7 * day}, {"weeks", 7 * day},
+        {"month", 30 * day}, {"months", 30 * day},
+        {"y", 365 * day}, {"year", 365 * day}, {"years", 365 * day}
+    };
+
+    return units.value(unit);
+}
+}
+
+class SmartPlaylist::Parser
+{
+    const QList<Token> m_tokens;
+    qsizetype m_next;
+    QList<Node> &m_nodes;
+    QString m_error;
+
+    const Token &peek() const { return m_tokens.at(qMin(m_next, m_tokens.size() - 1)); }
+    const Token &take() { return m_tokens.at(qMin(m_next++, m_tokens.size() - 1)); }
+
+    bool isKeyword(const Token &token, const char *keyword) const
+    {
+        return token.type == Token::TYPE::WORD and token.text.compare(QLatin1String(keyword), Qt::CaseInsensitive) == 0;
+    }
+
+    bool isKeyword(const Token &token) const
+    {
+        return isKeyword(token, "and") or isKeyword(token, "or") or isKeyword(token, "not");
+    }
+
+    qsizetype fail(const QString &message)
+    {
+        if (m_error.isEmpty())
+            m_error = message;
+        return -1;
+    }
+
+    qsizetype unexpected(const Token &token)
+    {
+        if (token.type == Token::TYPE::END)
+            return fail(SmartPlaylist::tr("The rule ends too early."));
+
+        return fail(SmartPlaylist::tr("Unexpected \"%1\" at %2.").arg(token.text).arg(token.position + 1));
+    }
+
+    qsizetype add(Node node)
+    {
+        m_nodes.append(std::move(node));
+        return m_nodes.size() - 1;
+    }
+
+    qsizetype binary(NODE kind, const char *keyword, qsizetype (Parser::*operand)())
+    {
+        auto left = (this->*operand)();
+        while (left >= 0 and isKeyword(peek(), keyword)) {
+            take();
+            const auto right = (this->*operand)();
+            if (right < 0)
+                return -1;
+
+            left = add(Node {kind, {}, {}, {}, {}, left, right});
+        }
+
+        return left;
+    }
+
+    qsizetype parseOr() { return binary(NODE::OR, "or", &Parser::parseAnd); }
+    qsizetype parseAnd() { return binary(NODE::AND, "and", &Parser::parseNot); }
+
+    qsizetype parseNot()
+    {
+        if (not isKeyword(peek(), "not"))
+            return parsePrimary();
+
+        take();
+        const auto operand = parseNot();
+        if (operand < 0)
+            return -1;
+
+        return add(Node {NODE::NOT, {}, {}, {}, {}, operand, -1});
+    }
+
+    qsizetype parsePrimary()
+    {
+        const auto &token = take();
+
+        if (token.type == Token::TYPE::OPEN) {
+            const auto inner = parseOr();
+            if (inner < 0)
+                return -1;
+            if (peek().type != Token::TYPE::CLOSE)
+                return unexpected(peek());
+
+            take();
+            return inner;
+        }
+
+        if (isKeyword(token, "never")) {
+            if (not isKeyword(peek(), "played"))
+                return unexpected(peek());
+
+            take();
+            return add(Node {NODE::COMPARE, FIELD::PLAYS, OP::EQUAL, {}, 0, -1, -1});
+        }
+
+        if (isKeyword(token, "played")) {
+            if (not isKeyword(peek(), "in"))
+                return unexpected(peek());
+
+            take();
+            const auto amount = quantity(&ageUnit, day);
+            if (amount < 0)
+                return -1;
+
+            return add(Node {NODE::PLAYED_WITHIN, {}, {}, {}, amount, -1, -1});
+        }
+
+        if (token.type != Token::TYPE::WORD)
+            return unexpected(token);
+
+        static const QHash<QString, FIELD> fields {
+            {"title", FIELD::TITLE}, {"artist", FIELD::ARTIST}, {"album", FIELD::ALBUM},
+            {"genre", FIELD::GENRE}, {"path", FIELD::PATH}, {"year", FIELD::YEAR},
+            {"track", FIELD::TRACK}, {"disc", FIELD::DISC}, {"duration", FIELD::DURATION},
+            {"bitrate", FIELD::BITRATE}, {"plays", FIELD::PLAYS}
+        };
+
+        const auto field = fields.constFind(token.text.toLower());
+        if (field == fields.cend())
+            return fail(SmartPlaylist::tr("Unknown field \"%1\" at %2.").arg(token.text).arg(token.position + 1));
+
+        const auto &symbol = take();
+        static const QHash<QString, OP> operators {
+            {"=", OP::EQUAL}, {"==", OP::EQUAL}, {"!=", OP::NOT_EQUAL}, {"<", OP::LESS},
+            {"<=", OP::LESS_EQUAL}, {">", OP::GREATER}, {">=", OP::GREATER_EQUAL}, {"~", OP::CONTAINS}
+        };
+
+        const auto op = operators.constFind(symbol.text);
+        if (symbol.type != Token::TYPE::OPERATOR or op == operators.cend())
+            return unexpected(symbol);
+
+        Node node {NODE::COMPARE, *field, *op, {}, {}, -1, -1};
+        const bool isText = *field <= FIELD::PATH;
+
+        if (isText) {
+            if (*op != OP::EQUAL and *op != OP::NOT_EQUAL and *op != OP::CONTAINS)
+                return fail(SmartPlaylist::tr("Text can only be compared with =, != and ~, at %1.").arg(symbol.position + 1));
+
+            /* Unquoted, everything up to the next keyword: artist = Miles Davis and ... */
+            QStringList words;
+            if (peek().type == Token::TYPE::STRING) {
+                words << take().text;
+            } else {
+                while (peek().type == Token::TYPE::WORD and not isKeyword(peek()))
+                    words << take().text;
+            }
+
+            if (words.isEmpty())
+                return unexpected(peek());
+
+            node.text = words.join(' ').toCaseFolded();
+        } else {
+            if (*op == OP::CONTAINS)
+                return fail(SmartPlaylist::tr("Numbers can't be compared with ~, at %1.").arg(symbol.position + 1));
+
+            node.number = *field == FIELD::DURATION ? quantity(&durationUnit, second) : quantity(nullptr, 1);
+            if (node.number < 0)
+                return -1;
+        }
+
+        return add(std::move(node));
+    }
+
+    /* A number, optionally followed by a unit of units, defaultUnit if it has none. */
+    qint64 quantity(qint64 (*units)(const QString &), qint64 defaultUnit)
+    {
+        const auto &token = take();
+        double amount {};
+        QString unit;
+        if (token.type != Token::TYPE::WORD or not splitQuantity(token.text, amount, unit))
+            return unexpected(token);
+
+        if (unit.isEmpty() and units and peek().type == Token::TYPE::WORD and units(peek().text.toLower()) > 0)
+            unit = take().text.toLower();
+
+        auto scale = defaultUnit;
+        if (not unit.isEmpty()) {
+            scale = units ? units(unit) : 0;
+            if (scale == 0)
+                return fail(SmartPlaylist::tr("Unknown unit \"%1\" at %2.").arg(unit).arg(token.position + 1));
+        }
+
+        return static_cast<qint64>(amount * static_cast<double>(scale));
+    }
+
+public:
+    Parser(const QString &rule, QList<Node> &nodes)
+        : m_tokens {tokenize(rule)}
+        , m_next {0}
+        , m_nodes {nodes}
+    {
+    }
+
+    qsizetype parse()
+    {
+        if (peek().type == Token::TYPE::END)
+            return fail(SmartPlaylist::tr("The rule is empty."));
+
+        const auto root = parseOr();
+        if (root >= 0 and peek().type != Token::TYPE::END)
+            return unexpected(peek());
+
+        return root;
+    }
+
+    QString errorString() const { return m_error; }
+};
+
+SmartPlaylist::SmartPlaylist(QObject *parent)
+    : QObject {parent}
+    , m_library {nullptr}
+    , m_root {-1}
+    , m_now {0}
+{
+    m_timer.setInterval(0);
+    connect(&m_timer, &QTimer::timeout, this, &SmartPlaylist::step);
+}
+
+void SmartPlaylist::setLibrary(Library *library)
+{
+    m_library = library;
+}
+
+bool SmartPlaylist::setRule(const QString &rule)
+{
+    QList<Node> nodes;
+    Parser parser(rule, nodes);
+    const auto root = parser.parse();
+    if (root < 0) {
+        m_error = parser.errorString();
+        return false;
+    }
+
+    clear();
+    m_rule = rule;
+    m_nodes = std::move(nodes);
+    m_root = root;
+    return true;
+}
+
+QString SmartPlaylist::rule() const
+{
+    return m_rule;
+}
+
+QString SmartPlaylist::errorString() const
+{
+    return m_error;
+}
+
+bool SmartPlaylist::isValid() const
+{
+    return m_root >= 0;
+}
+
+void SmartPlaylist::clear()
+{
+    m_timer.stop();
+    m_entries.clear();
+    m_members.clear();
+    m_nodes.clear();
+    m_root = -1;
+    m_rule.clear();
+    m_error.clear();
+}
+
+bool SmartPlaylist::matches(const QString &path, const Library::Entry &entry, qint64 now) const
+{
+    return isValid() and evaluate(m_root, path, entry, now);
+}
+
+void SmartPlaylist::start()
+{
+    Q_ASSERT_X(m_library != nullptr, "A library must be set before starting.", Q_FUNC_INFO);
+
+    m_members.clear();
+    m_entries = m_library->entries();
+    m_cursor = m_entries.cbegin();
+    m_now = QDateTime::currentMSecsSinceEpoch();
+    m_timer.start();
+}
+
+bool SmartPlaylist::isRunning() const
+{
+    return m_timer.isActive();
+}
+
+void SmartPlaylist::reevaluate(const QStringList &paths)
+{
+    if (not isValid())
+        return;
+
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+    QStringList added, removed;
+
+    for (const auto &path : paths) {
+        /* Files the library doesn't know have nothing to match on. */
+        const bool match = m_library->contains(path) and matches(path, m_library->entry(path), now);
+        if (match and not m_members.contains(path)) {
+            m_members.insert(path);
+            added << path;
+        } else if (not match and m_members.remove(path)) {
+            removed << path;
+        }
+    }
+
+    if (not added.isEmpty() or not removed.isEmpty())
+        emit changed(added, removed);
+}
+
+void SmartPlaylist::step()
+{
+    QStringList paths;
+    for (qsizetype i = 0; i < chunkSize and m_cursor != m_entries.cend(); ++i, ++m_cursor) {
+        /* reevaluate() may have got to it first. */
+        if (not m_members.contains(m_cursor.key()) and evaluate(m_root, m_cursor.key(), m_cursor.value(), m_now)) {
+            m_members.insert(m_cursor.key());
+            paths << m_cursor.key();
+        }
+    }
+
+    if (not paths.isEmpty())
+        emit matched(paths);
+
+    if (m_cursor == m_entries.cend()) {
+        m_timer.stop();
+        m_entries.clear();
+        emit finished(m_members.size());
+    }
+}
+
+bool SmartPlaylist::evaluate(qsizetype index, const QString &path, const Library::Entry &entry, qint64 now) const
+{
+    const auto &node = m_nodes.at(index);
+    switch (node.kind) {
+    case NODE::AND:
+        return evaluate(node.left, path, entry, now) and evaluate(node.right, path, entry, now);
+    case NODE::OR:
+        return evaluate(node.left, path, entry, now) or evaluate(node.right, path, entry, now);
+    case NODE::NOT:
+        return not evaluate(node.left, path, entry, now);
+    case NODE::PLAYED_WITHIN:
+        return entry.plays > 0 and entry.lastPlayed >= now - node.number;
+    case NODE::COMPARE:
+        break;
+    }
+
+    const auto &info = entry.info;
+    if (node.field <= FIELD::PATH) {
+        QString value;
+        switch (node.field) {
+        case FIELD::TITLE: value = info.title; break;
+        case FIELD::ARTIST: value = info.artist; break;
+        case FIELD::ALBUM: value = info.album; break;
+        case FIELD::GENRE: value = info.genre; break;
+        default: value = path; break;
+        }
+
+        value = value.trimmed().toCaseFolded();
+        switch (node.op) {
+        case OP::EQUAL: return value == node.text;
+        case OP::NOT_EQUAL: return value != node.text;
+        default: return value.contains(node.text);
+        }
+    }
+
+    qint64 value {};
+    switch (node.field) {
+    case FIELD::YEAR: value = info.year; break;
+    case FIELD::TRACK: value = info.track; break;
+    case FIELD::DISC: value = info.disc; break;
+    case FIELD::DURATION: value = info.duration; break;
+    case FIELD::BITRATE: value = info.bitrate; break;
+    default: value = entry.plays; break;
+    }
+
+    switch (node.op) {
+    case OP::EQUAL: return value == node.number;
+    case OP::NOT_EQUAL: return value != node.number;
+    case OP::LESS: return value < node.number;
+    case OP::LESS_EQUAL: return value <= node.number;
+    case OP::GREATER: return value > node.number;
+    default: return value >= node.number;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef SMARTPLAYLIST_HPP
+#define SMARTPLAYLIST_HPP
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+#include "library.hpp"
+
+/* A playlist defined by a rule rather than a list of files, e.g.
+ *     genre = jazz and duration > 5min and not played in 30 days
+ * Conditions compare a field (title, artist, album, genre, path, year, track, disc, duration,
+ * bitrate, plays) to a value with =, !=, <, <=, >, >= or ~ (contains), or say "played in N
+ * days" or "never played"; they're combined with and, or, not and parentheses. Text is
+ * compared ignoring case. The rule is compiled once into a tree matched against library
+ * entries, which are gone over a chunk at a time so the first matches can play right away.
+ * Afterwards only files whose tags or plays changed are matched again. */
+class SmartPlaylist : public QObject
+{
+    Q_OBJECT
+
+    enum class FIELD { TITLE = 0, ARTIST, ALBUM, GENRE, PATH, YEAR, TRACK, DISC, DURATION, BITRATE, PLAYS };
+    enum class OP { EQUAL = 0, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, CONTAINS };
+    enum class NODE { AND = 0, OR, NOT, COMPARE, PLAYED_WITHIN };
+
+    struct Node
+    {
+        NODE kind;
+        FIELD field {};
+        OP op {};
+        /* Folded, for text fields. */
+        QString text;
+        /* Milliseconds for durations and PLAYED_WITHIN. */
+        qint64 number {};
+        /* Operands, NOT has just left. */
+        qsizetype left {-1};
+        qsizetype right {-1};
+    };
+
+    class Parser;
+
+    bool evaluate(qsizetype node, const QString &path, const Library::Entry &entry, qint64 now) const;
+    void step();
+
+public:
+    explicit SmartPlaylist(QObject *parent = nullptr);
+    void setLibrary(Library *library);
+    /* Compiles rule, false and errorString() tell what's wrong if it doesn't make sense. */
+    bool setRule(const QString &rule);
+    QString rule() const;
+    QString errorString() const;
+    /* Whether a rule is set. */
+    bool isValid() const;
+    /* Stops and forgets the rule and what it matched. */
+    void clear();
+    bool matches(const QString &path, const Library::Entry &entry, qint64 now) const;
+    /* Goes over the whole library from the event loop, matched() is emitted for each chunk. */
+    void start();
+    bool isRunning() const;
+    /* Matches paths again, changed() tells which ones came in or went out. */
+    void reevaluate(const QStringList &paths);
+
+signals:
+    void matched(const QStringList &paths);
+    void finished(qsizetype count);
+    void changed(const QStringList &added, const QStringList &removed);
+
+private:
+    Library *m_library;
+    QString m_rule;
+    QString m_error;
+    QList<Node> m_nodes;
+    qsizetype m_root;
+    /* Library as it was when started, gone over a chunk at a time. */
+    QHash<QString, Library::Entry> m_entries;
+    QHash<QString, Library::Entry>::const_iterator m_cursor;
+    QTimer m_timer;
+    qint64 m_now;
+    QSet<QString> m_members;
+};
+
+#endif // SMARTPLAYLIST_HPP
@@ -0,0 +1,154 @@
+#include "statisticsdialog.hpp"
+#include "ui_statisticsdialog.h"
+
+#include <QLocale>
+#include <algorithm>
+
+namespace {
+constexpr int largestDirectories = 20;
+
+/* Rows for a bucketed map, labelled "from – to" by label(bound), unknown ones last. */
+template <typename Key, typename Label>
+QList<QPair<QString, LibraryStatistics::Totals>> ranges(const QMap<Key, LibraryStatistics::Totals> &map,
+                                                        const QList<Key> &bounds,
+                                                        Label label)
+{
+    QList<QPair<QString, LibraryStatistics::Totals>> rows;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) {
+        if (it.key() < 0)
+            continue;
+
+        const auto next = std::upper_bound(bounds.cbegin(), bounds.cend(), it.key());
+        rows.append({next == bounds.cend()
+                         ? QStringLiteral("≥ %1").arg(label(it.key()))
+                         : QStringLiteral("%1 – %2").arg(label(it.key()), label(*next)),
+                     it.value()});
+    }
+
+    if (map.contains(-1))
+        rows.append({StatisticsDialog::tr("Unknown"), map.value(-1)});
+
+    return rows;
+}
+}
+
+StatisticsDialog::StatisticsDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_ui(new Ui::StatisticsDialog)
+{
+    m_ui->setupUi(this);
+    configureTree();
+
+    connect(m_ui->buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
+
+StatisticsDialog::~StatisticsDialog()
+{
+    delete m_ui;
+}
+
+void StatisticsDialog::configureTree()
+{
+    m_ui->treeWidget->setColumnCount(5);
+    m_ui->treeWidget->setHeaderLabels({tr("Name"), tr("Files"), tr("Size"), tr("Duration"), tr("Share")});
+    m_ui->treeWidget->setSelectionMode(QAbstractItemView::NoSelection);
+    m_ui->treeWidget->setEditTriggers(QTreeWidget::NoEditTriggers);
+    m_ui->treeWidget->setUniformRowHeights(true);
+
+    m_formats = new QTreeWidgetItem(m_ui->treeWidget, {tr("Formats")});
+    m_bitrates = new QTreeWidgetItem(m_ui->treeWidget, {tr("Bitrates")});
+    m_sampleRates = new QTreeWidgetItem(m_ui->treeWidget, {tr("Sample rates")});
+    m_sizes = new QTreeWidgetItem(m_ui->treeWidget, {tr("File sizes")});
+    m_durations = new QTreeWidgetItem(m_ui->treeWidget, {tr("Durations")});
+    m_directories = new QTreeWidgetItem(m_ui->treeWidget, {tr("Largest folders")});
+    m_formats->setExpanded(true);
+}
+
+void StatisticsDialog::setSummary(const LibraryStatistics::Summary &summary, bool scanning)
+{
+    m_total = summary.total;
+    const QLocale locale;
+
+    auto label = tr("%n files, %1, %2 of music.", nullptr, static_cast<int>(summary.total.files))
+                     .arg(locale.formattedDataSize(summary.total.bytes), durationText(summary.total.duration));
+    if (summary.untagged > 0)
+        label += ' ' + tr("Tags of %n of them haven't been read yet.", nullptr, static_cast<int>(summary.untagged));
+    if (scanning)
+        label += ' ' + tr("Still scanning…");
+    m_ui->label->setText(label);
+
+    QList<QPair<QString, LibraryStatistics::Totals>> formats;
+    for (auto it = summary.formats.cbegin(); it != summary.formats.cend(); ++it)
+        formats.append({it.key().isEmpty() ? tr("No extension") : it.key().toUpper(), it.value()});
+    std::sort(formats.begin(), formats.end(), [] (const auto &first, const auto &second) {
+        return first.second.files > second.second.files;
+    });
+    fill(m_formats, formats);
+
+    fill(m_bitrates, ranges(summary.bitrates, LibraryStatistics::bitrateBuckets, [] (int kbps) {
+        return tr("%1 kbit/s").arg(kbps);
+    }));
+
+    QList<QPair<QString, LibraryStatistics::Totals>> sampleRates;
+    for (auto it = summary.sampleRates.cbegin(); it != summary.sampleRates.cend(); ++it) {
+        if (it.key() > 0)
+            sampleRates.append({tr("%1 kHz").arg(locale.toString(it.key() / 1'000.0)), it.value()});
+    }
+    if (summary.sampleRates.contains(-1))
+        sampleRates.append({tr("Unknown"), summary.sampleRates.value(-1)});
+    fill(m_sampleRates, sampleRates);
+
+    fill(m_sizes, ranges(summary.sizes, LibraryStatistics::sizeBuckets, [&locale] (qint64 bytes) {
+        return locale.formattedDataSize(bytes, 0);
+    }));
+
+    fill(m_durations, ranges(summary.durations, LibraryStatistics::durationBuckets, [] (qint64 milliseconds) {
+        return tr("%1 min").arg(milliseconds / 60'000);
+    }));
+
+    fill(m_directories, summary.largestDirectories(largestDirectories));
+    for (int i = 0; i < m_directories->childCount(); ++i)
+        m_directories->child(i)->setToolTip(0, m_directories->child(i)->text(0));
+
+    for (int column = 0; column < m_ui->treeWidget->columnCount(); ++column)
+        m_ui->treeWidget->resizeColumnToContents(column);
+}
+
+void StatisticsDialog::fill(QTreeWidgetItem *section, const QList<QPair<QString, LibraryStatistics::Totals>> &rows)
+{
+    /* Rewritten in place, so refreshing every second doesn't make the view jump. */
+    for (qsizetype i = 0; i < rows.size(); ++i) {
+        auto *item = i < section->childCount() ? section->child(static_cast<int>(i)) : new QTreeWidgetItem(section);
+        const auto texts = columns(rows[i].first, rows[i].second);
+        for (int column = 0; column < texts.size(); ++column)
+            item->setText(column, texts[column]);
+        for (int column = 1; column < texts.size(); ++column)
+            item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    while (section->childCount() > rows.size())
+        delete section->takeChild(section->childCount() - 1);
+}
+
+QStringList StatisticsDialog::columns(const QString &name, const LibraryStatistics::Totals &totals) const
+{
+    const QLocale locale;
+    const auto share = m_total.files > 0 ? 100.0 * totals.files / m_total.files : 0.0;
+
+    return {
+        name,
+        locale.toString(totals.files),
+        locale.formattedDataSize(totals.bytes),
+        totals.duration > 0 ? durationText(totals.duration) : QString(),
+        QString("%1%").arg(locale.toString(share, 'f', 1))
+    };
+}
+
+QString StatisticsDialog::durationText(qint64 milliseconds) const
+{
+    const auto minutes = milliseconds / 60'000;
+    if (minutes >= 24 * 60)
+        return tr("%1 d %2 h %3 min").arg(minutes / (24 * 60)).arg(minutes / 60 % 24).arg(minutes % 60);
+
+    return tr("%1 h %2 min").arg(minutes / 60).arg(minutes % 60);
+}
@@ -0,0 +1,43 @@
+#ifndef STATISTICSDIALOG_HPP
+#define STATISTICSDIALOG_HPP
+
+#include <QDialog>
+#include <QTreeWidgetItem>
+
+#include "librarystatistics.hpp"
+
+namespace Ui {
+class StatisticsDialog;
+}
+
+/* Shows what the library is made of. Kept open, it's refreshed in place while a scan
+ * goes on, sections the user expanded or collapsed stay so. */
+class StatisticsDialog : public QDialog
+{
+    Q_OBJECT
+
+    void configureTree();
+    /* Replaces the children of section with one row per bucket. */
+    void fill(QTreeWidgetItem *section, const QList<QPair<QString, LibraryStatistics::Totals>> &rows);
+    QStringList columns(const QString &name, const LibraryStatistics::Totals &totals) const;
+    QString durationText(qint64 milliseconds) const;
+
+public:
+    explicit StatisticsDialog(QWidget *parent = nullptr);
+    ~StatisticsDialog();
+    /* scanning tells the numbers are still growing. */
+    void setSummary(const LibraryStatistics::Summary &summary, bool scanning);
+
+private:
+    Ui::StatisticsDialog *m_ui;
+    QTreeWidgetItem *m_formats;
+    QTreeWidgetItem *m_bitrates;
+    QTreeWidgetItem *m_sampleRates;
+    QTreeWidgetItem *m_sizes;
+    QTreeWidgetItem *m_durations;
+    QTreeWidgetItem *m_directories;
+    /* Of the whole library, shares are relative to it. */
+    LibraryStatistics::Totals m_total;
+};
+
+#endif // STATISTICSDIALOG_HPP
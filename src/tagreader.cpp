@@ -0,0 +1,790 @@
+#include "tagreader.hpp"
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QtEndian>
+#include <array>
+#include <cstring>
+
+#include "mpegaudio.hpp"
+
+namespace {
+/* Where the first MPEG frame is searched for after the ID3v2 tag. */
+constexpr qint64 frameSearchSize = 64 * 1024;
+/* FLAC, Ogg and MP4 don't say upfront how big their headers are. Mapping is lazy,
+ * so this is just address space: only the pages actually parsed are read. */
+constexpr qint64 headerRegionSize = 16 * 1024 * 1024;
+/* End of an Ogg file searched for the last page. */
+constexpr qint64 tailSize = 64 * 1024;
+/* Ogg comment packets may carry cover art, there's no need to stitch it all together. */
+constexpr qsizetype maximumPacketSize = 256 * 1024;
+constexpr qint64 id3v1Size = 128;
+
+constexpr std::array<const char *, 148> genres {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop", "Jazz",
+    "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap", "Reggae", "Rock", "Techno",
+    "Industrial", "Alternative", "Ska", "Death Metal", "Pranks", "Soundtrack", "Euro-Techno",
+    "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance", "Classical", "Instrumental",
+    "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise", "Alternative Rock", "Bass", "Soul",
+    "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock", "Ethnic", "Gothic",
+    "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+    "Native American", "Cabaret", "New Wave", "Psychedelic", "Rave", "Showtunes", "Trailer",
+    "Lo-Fi", "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll",
+    "Hard Rock", "Folk", "Folk-Rock", "National Folk", "Swing", "Fast Fusion", "Bebop", "Latin",
+    "Revival", "Celtic", "Bluegrass", "Avantgarde", "Gothic Rock", "Progressive Rock",
+    "Psychedelic Rock", "Symphonic Rock", "Slow Rock", "Big Band", "Chorus", "Easy Listening",
+    "Acoustic", "Humour", "Speech", "Chanson", "Opera", "Chamber Music", "Sonata", "Symphony",
+    "Booty Bass", "Primus", "Porn Groove", "Satire", "Slow Jam", "Club", "Tango", "Samba",
+    "Folklore", "Ballad", "Power Ballad", "Rhythmic Soul", "Freestyle", "Duet", "Punk Rock",
+    "Drum Solo", "A Cappella", "Euro-House", "Dance Hall", "Goa", "Drum & Bass", "Club-House",
+    "Hardcore", "Terror", "Indie", "Britpop", "Afro-Punk", "Polsk Punk", "Beat",
+    "Christian Gangsta Rap", "Heavy Metal", "Black Metal", "Crossover", "Contemporary Christian",
+    "Christian Rock", "Merengue", "Salsa", "Thrash Metal", "Anime", "J-Pop", "Synthpop"
+};
+
+/* A mapped piece of the file, offsets into it are file offsets minus start. */
+struct Region
+{
+    const uchar *data {};
+    qint64 start {};
+    qint64 size {};
+
+    bool isNull() const { return data == nullptr; }
+};
+
+Region map(QFile &file, qint64 offset, qint64 length)
+{
+    length = qMin(length, file.size() - offset);
+    if (offset < 0 or length <= 0)
+        return {};
+
+    const auto *data = file.map(offset, length);
+    if (not data)
+        return {};
+
+    return {data, offset, length};
+}
+
+int leadingNumber(QStringView text)
+{
+    int number {};
+    for (auto c : text.trimmed()) {
+        if (not c.isDigit())
+            break;
+        number = number * 10 + c.digitValue();
+    }
+
+    return number;
+}
+
+QString genreName(int index)
+{
+    if (index < 0 or index >= static_cast<int>(genres.size()))
+        return {};
+
+    return QString::fromLatin1(genres[index]);
+}
+
+/* "(17)", "17", "(17)Rock" or just "Rock". */
+QString resolveGenre(const QString &text)
+{
+    if (text.startsWith('(')) {
+        const auto close = text.indexOf(')');
+        bool ok {false};
+        const int index = close > 1 ? text.mid(1, close - 1).toInt(&ok) : -1;
+        if (ok)
+            return close + 1 < text.size() ? text.mid(close + 1) : genreName(index);
+    }
+
+    bool ok {false};
+    const int index = text.toInt(&ok);
+    return ok ? genreName(index) : text;
+}
+
+QString id3Text(const uchar *data, qint64 size)
+{
+    if (size < 1)
+        return {};
+
+    const auto encoding = data[0];
+    ++data;
+    --size;
+
+    QString text;
+    switch (encoding)
+    {
+    case 0: /* ISO-8859-1 */
+        text = QString::fromLatin1(reinterpret_cast<const char *>(data), size);
+        break;
+    case 1: /* UTF-16 with BOM */
+    case 2: /* UTF-16BE */
+    {
+        bool littleEndian {false};
+        if (encoding == 1 and size >= 2) {
+            if (data[0] == 0xFF and data[1] == 0xFE) {
+                littleEndian = true;
+                data += 2;
+                size -= 2;
+            } else if (data[0] == 0xFE and data[1] == 0xFF) {
+                data += 2;
+                size -= 2;
+            }
+        }
+
+        text.reserve(size / 2);
+        for (qint64 i = 0; i + 1 < size; i += 2) {
+            const char16_t c = littleEndian ? qFromLittleEndian<quint16>(data + i)
+                                            : qFromBigEndian<quint16>(data + i);
+            if (c == 0)
+                break;
+            text.append(QChar(c));
+        }
+        break;
+    }
+    case 3: /* UTF-8 */
+        text = QString::fromUtf8(reinterpret_cast<const char *>(data), size);
+        break;
+    default:
+        return {};
+    }
+
+    /* ID3v2.4 separates several values with a null, keep the first. */
+    const auto end = text.indexOf(QChar(u'\0'));
+    if (end >= 0)
+        text.truncate(end);
+
+    return text.trimmed();
+}
+
+/* Undoes ID3 unsynchronisation: every 0xFF 0x00 was written for a 0xFF. */
+QByteArray resynchronise(const uchar *data, qint64 size)
+{
+    QByteArray result;
+    result.reserve(size);
+    for (qint64 i = 0; i < size; ++i) {
+        result.append(char(data[i]));
+        if (data[i] == 0xFF and i + 1 < size and data[i + 1] == 0x00)
+            ++i;
+    }
+
+    return result;
+}
+
+void parseId3v2(const uchar *data, qint64 size, TrackInfo &info, qint64 &length)
+{
+    const int version = data[3];
+    const auto flags = data[5];
+    qint64 end = qMin(size, 10 + qint64(MpegAudio::syncsafe(data + 6)));
+
+    /* Whole tag unsynchronised (only before 2.4), rare enough to pay for a copy. */
+    QByteArray resynchronised;
+    if ((flags & 0x80) and version < 4) {
+        resynchronised = QByteArray(reinterpret_cast<const char *>(data), 10)
+                         + resynchronise(data + 10, end - 10);
+        data = reinterpret_cast<const uchar *>(resynchronised.constData());
+        end = resynchronised.size();
+    }
+
+    qint64 offset = 10;
+    if ((flags & 0x40) and end >= 14) {
+        if (version == 3)
+            offset += 4 + qFromBigEndian<quint32>(data + 10);
+        else if (version == 4)
+            offset += MpegAudio::syncsafe(data + 10);
+    }
+
+    const int idSize = version == 2 ? 3 : 4;
+    const int headerSize = version == 2 ? 6 : 10;
+
+    while (offset + headerSize <= end) {
+        const auto *frame = data + offset;
+        if (frame[0] == 0)
+            break; // Padding
+
+        qint64 frameSize {};
+        if (version == 2)
+            frameSize = (qint64(frame[3]) << 16) | (qint64(frame[4]) << 8) | frame[5];
+        else if (version == 3)
+            frameSize = qFromBigEndian<quint32>(frame + 4);
+        else
+            frameSize = MpegAudio::syncsafe(frame + 4);
+
+        offset += headerSize;
+        if (frameSize <= 0 or offset + frameSize > end)
+            break;
+
+        const QByteArrayView id(frame, idSize);
+        const uchar *body = data + offset;
+        qint64 bodySize = frameSize;
+        offset += frameSize;
+
+        /* Only text frames are interesting, pictures and the like are skipped untouched. */
+        if (id[0] != 'T')
+            continue;
+
+        QByteArray frameData;
+        if (version == 3) {
+            if (frame[9] & 0xC0)
+                continue; // Compressed or encrypted.
+            if (frame[9] & 0x20) {
+                ++body; // Group identifier.
+                --bodySize;
+            }
+        } else if (version == 4) {
+            if (frame[9] & 0x0C)
+                continue; // Compressed or encrypted.
+            if (frame[9] & 0x40) {
+                ++body; // Group identifier.
+                --bodySize;
+            }
+            if ((frame[9] & 0x01) and bodySize >= 4) {
+                body += 4; // Data length indicator.
+                bodySize -= 4;
+            }
+            if (frame[9] & 0x02) {
+                frameData = resynchronise(body, bodySize);
+                body = reinterpret_cast<const uchar *>(frameData.constData());
+                bodySize = frameData.size();
+            }
+        }
+
+        const auto text = id3Text(body, bodySize);
+        if (text.isEmpty())
+            continue;
+
+        if (id == "TIT2" or id == "TT2")
+            info.title = text;
+        else if (id == "TPE1" or id == "TP1")
+            info.artist = text;
+        else if (id == "TALB" or id == "TAL")
+            info.album = text;
+        else if (id == "TCON" or id == "TCO")
+            info.genre = resolveGenre(text);
+        else if (id == "TDRC" or id == "TYER" or id == "TYE")
+            info.year = leadingNumber(text);
+        else if (id == "TRCK" or id == "TRK")
+            info.track = leadingNumber(text);
+        else if (id == "TPOS" or id == "TPA")
+            info.disc = leadingNumber(text);
+        else if (id == "TLEN" or id == "TLE")
+            length = text.toLongLong();
+    }
+}
+
+void parseId3v1(const uchar *data, TrackInfo &info)
+{
+    if (std::memcmp(data, "TAG", 3) != 0)
+        return;
+
+    auto field = [data] (int offset, int size) {
+        const auto *begin = reinterpret_cast<const char *>(data + offset);
+        return QString::fromLatin1(begin, qstrnlen(begin, size)).trimmed();
+    };
+
+    /* ID3v2 wins, this only fills gaps. */
+    if (info.title.isEmpty())
+        info.title = field(3, 30);
+    if (info.artist.isEmpty())
+        info.artist = field(33, 30);
+    if (info.album.isEmpty())
+        info.album = field(63, 30);
+    if (info.year == 0)
+        info.year = leadingNumber(field(93, 4));
+    /* ID3v1.1 keeps the track number at the end of the comment. */
+    if (info.track == 0 and data[125] == 0)
+        info.track = data[126];
+    if (info.genre.isEmpty())
+        info.genre = genreName(data[127]);
+}
+
+/* Fills in the stream properties of MPEG audio starting at or shortly after start. */
+bool parseMpeg(const Region &region, qint64 start, qint64 audioEnd, TrackInfo &info)
+{
+    const auto *data = region.data - region.start;
+    const auto limit = qMin(region.start + region.size, start + frameSearchSize);
+
+    MpegAudio::Frame frame;
+    qint64 offset = start;
+    for (; offset + 4 <= limit; ++offset) {
+        if (not MpegAudio::parseFrame(data + offset, frame))
+            continue;
+
+        /* A stray 0xFF in the padding isn't a frame, the next one must follow right after. */
+        MpegAudio::Frame next;
+        const auto nextOffset = offset + frame.size;
+        if (nextOffset + 4 > region.start + region.size or MpegAudio::parseFrame(data + nextOffset, next))
+            break;
+    }
+
+    if (offset + 4 > limit)
+        return false;
+
+    info.sampleRate = frame.sampleRate;
+    info.channels = frame.channels;
+
+    const auto *header = data + offset;
+    const auto available = region.start + region.size - offset;
+    const qint64 sideInfo = frame.mpeg1 ? (frame.channels == 1 ? 17 : 32) : (frame.channels == 1 ? 9 : 17);
+
+    qint64 frames {};
+    qint64 bytes {};
+    if (available >= 4 + sideInfo + 16
+        and (std::memcmp(header + 4 + sideInfo, "Xing", 4) == 0
+             or std::memcmp(header + 4 + sideInfo, "Info", 4) == 0)) {
+        const auto *xing = header + 4 + sideInfo;
+        const auto flags = qFromBigEndian<quint32>(xing + 4);
+        qint64 field = 8;
+        if (flags & 0x01) {
+            frames = qFromBigEndian<quint32>(xing + field);
+            field += 4;
+        }
+        if (flags & 0x02)
+            bytes = qFromBigEndian<quint32>(xing + field);
+    } else if (available >= 36 + 18 and std::memcmp(header + 36, "VBRI", 4) == 0) {
+        bytes = qFromBigEndian<quint32>(header + 36 + 10);
+        frames = qFromBigEndian<quint32>(header + 36 + 14);
+    }
+
+    if (frames > 0) {
+        info.duration = frames * frame.samplesPerFrame * 1'000 / frame.sampleRate;
+        if (bytes <= 0)
+            bytes = audioEnd - offset;
+        if (info.duration > 0)
+            info.bitrate = static_cast<int>(bytes * 8 / info.duration);
+    } else {
+        /* Constant bitrate: bits divided by kbit/s gives milliseconds. */
+        info.bitrate = frame.bitrate;
+        info.duration = (audioEnd - offset) * 8 / frame.bitrate;
+    }
+
+    return true;
+}
+
+void parseVorbisComment(const uchar *data, qint64 size, TrackInfo &info)
+{
+    if (size < 8)
+        return;
+
+    qint64 offset = 4 + qint64(qFromLittleEndian<quint32>(data)); /* Vendor string */
+    if (offset + 4 > size)
+        return;
+
+    const auto count = qFromLittleEndian<quint32>(data + offset);
+    offset += 4;
+
+    for (quint32 i = 0; i < count and offset + 4 <= size; ++i) {
+        const qint64 length = qFromLittleEndian<quint32>(data + offset);
+        offset += 4;
+        if (offset + length > size)
+            break;
+
+        const QByteArrayView comment(data + offset, length);
+        offset += length;
+
+        const auto equals = comment.indexOf('=');
+        if (equals <= 0)
+            continue;
+
+        const auto key = comment.first(equals);
+        auto value = [&comment, equals] () {
+            return QString::fromUtf8(comment.sliced(equals + 1)).trimmed();
+        };
+
+        /* Keys may repeat, the first value wins. */
+        if (key.compare("TITLE", Qt::CaseInsensitive) == 0 and info.title.isEmpty())
+            info.title = value();
+        else if (key.compare("ARTIST", Qt::CaseInsensitive) == 0 and info.artist.isEmpty())
+            info.artist = value();
+        else if (key.compare("ALBUM", Qt::CaseInsensitive) == 0 and info.album.isEmpty())
+            info.album = value();
+        else if (key.compare("GENRE", Qt::CaseInsensitive) == 0 and info.genre.isEmpty())
+            info.genre = value();
+        else if (key.compare("DATE", Qt::CaseInsensitive) == 0 and info.year == 0)
+            info.year = leadingNumber(value());
+        else if (key.compare("TRACKNUMBER", Qt::CaseInsensitive) == 0 and info.track == 0)
+            info.track = leadingNumber(value());
+        else if (key.compare("DISCNUMBER", Qt::CaseInsensitive) == 0 and info.disc == 0)
+            info.disc = leadingNumber(value());
+    }
+}
+
+bool parseFlac(const Region &region, qint64 start, qint64 fileSize, TrackInfo &info)
+{
+    const auto *data = region.data - region.start;
+    const auto end = region.start + region.size;
+    qint64 offset = start + 4; /* fLaC */
+    qint64 samples {};
+    bool streamInfo {false};
+
+    while (offset + 4 <= end) {
+        const auto header = data[offset];
+        const qint64 length = (qint64(data[offset + 1]) << 16) | (qint64(data[offset + 2]) << 8) | data[offset + 3];
+        const auto *body = data + offset + 4;
+        offset += 4 + length;
+
+        const bool complete = offset <= end;
+        switch (header & 0x7F)
+        {
+        case 0: /* STREAMINFO */
+            if (not complete or length < 34)
+                return false;
+            info.sampleRate = (int(body[10]) << 12) | (int(body[11]) << 4) | (body[12] >> 4);
+            info.channels = ((body[12] >> 1) & 0x07) + 1;
+            samples = (qint64(body[13] & 0x0F) << 32) | qFromBigEndian<quint32>(body + 14);
+            streamInfo = true;
+            break;
+        case 4: /* VORBIS_COMMENT */
+            if (complete)
+                parseVorbisComment(body, length, info);
+            break;
+        default:
+            break;
+        }
+
+        if (header & 0x80)
+            break; // Last block, audio frames follow.
+    }
+
+    if (not streamInfo)
+        return false;
+
+    if (samples > 0 and info.sampleRate > 0) {
+        info.duration = samples * 1'000 / info.sampleRate;
+        if (info.duration > 0 and offset < fileSize)
+            info.bitrate = static_cast<int>((fileSize - offset) * 8 / info.duration);
+    }
+
+    return true;
+}
+
+bool parseOgg(QFile &file, const Region &head, TrackInfo &info)
+{
+    const auto *data = head.data;
+    const auto size = head.size;
+
+    /* The first two packets are the identification and comment headers. They're
+     * usually in a page each, but the comment may span several, so stitch them. */
+    QList<QByteArray> packets;
+    QByteArray packet;
+    quint32 serial {};
+    qint64 offset {};
+
+    while (offset + 27 <= size and packets.size() < 2) {
+        const auto *page = data + offset;
+        if (std::memcmp(page, "OggS", 4) != 0)
+            break;
+
+        const int segments = page[26];
+        const auto pageSerial = qFromLittleEndian<quint32>(page + 14);
+        qint64 position = offset + 27 + segments;
+        if (position > size)
+            break;
+
+        if (offset == 0)
+            serial = pageSerial;
+
+        for (int i = 0; i < segments and packets.size() < 2; ++i) {
+            const int lace = page[27 + i];
+            if (position + lace > size)
+                break;
+
+            /* Other logical streams are skipped. */
+            if (pageSerial == serial and packet.size() < maximumPacketSize)
+                packet.append(reinterpret_cast<const char *>(data + position), lace);
+            position += lace;
+
+            if (pageSerial == serial and lace < 255) {
+                packets << packet;
+                packet.clear();
+            }
+        }
+
+        offset = position;
+    }
+
+    if (packets.isEmpty())
+        return false;
+
+    const auto &identification = packets[0];
+    const auto *id = reinterpret_cast<const uchar *>(identification.constData());
+    qint64 preSkip {};
+    qint64 granuleRate {};
+    qint64 commentHeader {};
+
+    if (identification.size() >= 30 and identification.startsWith("\x01vorbis")) {
+        info.channels = id[11];
+        info.sampleRate = qFromLittleEndian<quint32>(id + 12);
+        const auto nominal = qFromLittleEndian<qint32>(id + 20);
+        if (nominal > 0)
+            info.bitrate = nominal / 1'000;
+        granuleRate = info.sampleRate;
+        commentHeader = 7; /* \x03vorbis */
+    } else if (identification.size() >= 19 and identification.startsWith("OpusHead")) {
+        info.channels = id[9];
+        preSkip = qFromLittleEndian<quint16>(id + 10);
+        info.sampleRate = qFromLittleEndian<quint32>(id + 12);
+        /* Opus always runs at 48 kHz whatever the input was. */
+        granuleRate = 48'000;
+        commentHeader = 8; /* OpusTags */
+    } else {
+        return false;
+    }
+
+    if (packets.size() > 1 and packets[1].size() > commentHeader) {
+        const auto &comment = packets[1];
+        parseVorbisComment(reinterpret_cast<const uchar *>(comment.constData()) + commentHeader,
+                           comment.size() - commentHeader,
+                           info);
+    }
+
+    /* Duration is the granule position of the last page, all of a file shorter than the tail. */
+    const auto tailStart = qMax<qint64>(0, file.size() - tailSize);
+    const auto tail = map(file, tailStart, file.size() - tailStart);
+    if (tail.isNull() or granuleRate <= 0)
+        return true;
+
+    for (qint64 i = tail.size - 27; i >= 0; --i) {
+        const auto *page = tail.data + i;
+        if (page[0] != 'O' or std::memcmp(page, "OggS", 4) != 0)
+            continue;
+        if (qFromLittleEndian<quint32>(page + 14) != serial)
+            continue;
+
+        const auto granule = qFromLittleEndian<qint64>(page + 6);
+        if (granule <= 0)
+            continue;
+
+        info.duration = qMax<qint64>(0, granule - preSkip) * 1'000 / granuleRate;
+        if (info.bitrate == 0 and info.duration > 0)
+            info.bitrate = static_cast<int>(file.size() * 8 / info.duration);
+        break;
+    }
+
+    return true;
+}
+
+/* Calls found(type, body, size) for every atom in [data, data + size). */
+template<typename Function>
+void forEachAtom(const uchar *data, qint64 size, Function found)
+{
+    qint64 offset {};
+    while (offset + 8 <= size) {
+        qint64 atomSize = qFromBigEndian<quint32>(data + offset);
+        qint64 headerSize = 8;
+
+        if (atomSize == 1) {
+            if (offset + 16 > size)
+                break;
+            atomSize = static_cast<qint64>(qFromBigEndian<quint64>(data + offset + 8));
+            headerSize = 16;
+        } else if (atomSize == 0) {
+            atomSize = size - offset; // Up to the end.
+        }
+
+        if (atomSize < headerSize or offset + atomSize > size)
+            break;
+
+        found(QByteArrayView(data + offset + 4, 4), data + offset + headerSize, atomSize - headerSize);
+        offset += atomSize;
+    }
+}
+
+void parseMp4Track(const uchar *data, qint64 size, TrackInfo &info)
+{
+    forEachAtom(data, size, [&info] (QByteArrayView type, const uchar *body, qint64 bodySize) {
+        if (type != "mdia")
+            return;
+
+        bool audio {false};
+        forEachAtom(body, bodySize, [&] (QByteArrayView type, const uchar *body, qint64 bodySize) {
+            if (type == "hdlr" and bodySize >= 12)
+                audio = QByteArrayView(body + 8, 4) == "soun";
+            if (not audio or type != "minf")
+                return;
+
+            forEachAtom(body, bodySize, [&info] (QByteArrayView type, const uchar *body, qint64 bodySize) {
+                if (type != "stbl")
+                    return;
+
+                forEachAtom(body, bodySize, [&info] (QByteArrayView type, const uchar *body, qint64 bodySize) {
+                    /* Version, flags and entry count come first, then sample entries. */
+                    if (type != "stsd" or bodySize < 8)
+                        return;
+
+                    forEachAtom(body + 8, bodySize - 8, [&info] (QByteArrayView, const uchar *entry, qint64 entrySize) {
+                        if (entrySize < 28 or info.channels != 0)
+                            return;
+                        info.channels = qFromBigEndian<quint16>(entry + 16);
+                        info.sampleRate = qFromBigEndian<quint32>(entry + 24) >> 16;
+                    });
+                });
+            });
+        });
+    });
+}
+
+void parseIlst(const uchar *data, qint64 size, TrackInfo &info)
+{
+    forEachAtom(data, size, [&info] (QByteArrayView item, const uchar *body, qint64 bodySize) {
+        forEachAtom(body, bodySize, [&] (QByteArrayView type, const uchar *value, qint64 valueSize) {
+            /* Type indicator and locale come before the value. */
+            if (type != "data" or valueSize < 8)
+                return;
+
+            const auto *payload = value + 8;
+            const auto payloadSize = valueSize - 8;
+            auto text = [payload, payloadSize] () {
+                return QString::fromUtf8(reinterpret_cast<const char *>(payload), payloadSize).trimmed();
+            };
+
+            /* Split literals, 'A', 'a' and 'd' would be taken as more hex digits. */
+            if (item == "\xA9" "nam")
+                info.title = text();
+            else if (item == "\xA9" "ART")
+                info.artist = text();
+            else if (item == "\xA9" "alb")
+                info.album = text();
+            else if (item == "\xA9" "gen")
+                info.genre = text();
+            else if (item == "gnre" and payloadSize >= 2)
+                info.genre = genreName(qFromBigEndian<quint16>(payload) - 1);
+            else if (item == "\xA9" "day")
+                info.year = leadingNumber(text());
+            else if (item == "trkn" and payloadSize >= 4)
+                info.track = qFromBigEndian<quint16>(payload + 2);
+            else if (item == "disk" and payloadSize >= 4)
+                info.disc = qFromBigEndian<quint16>(payload + 2);
+        });
+    });
+}
+
+bool parseMp4(QFile &file, TrackInfo &info)
+{
+    /* moov may be anywhere, even after the audio, so walk the top level reading just
+     * atom headers and map nothing but moov. */
+    const auto fileSize = file.size();
+    qint64 offset {};
+    Region moov;
+
+    while (offset + 8 <= fileSize) {
+        uchar header[16];
+        if (not file.seek(offset) or file.read(reinterpret_cast<char *>(header), sizeof header) < 8)
+            return false;
+
+        qint64 atomSize = qFromBigEndian<quint32>(header);
+        qint64 headerSize = 8;
+        if (atomSize == 1) {
+            atomSize = static_cast<qint64>(qFromBigEndian<quint64>(header + 8));
+            headerSize = 16;
+        } else if (atomSize == 0) {
+            atomSize = fileSize - offset;
+        }
+
+        if (atomSize < headerSize)
+            return false;
+
+        if (std::memcmp(header + 4, "moov", 4) == 0) {
+            moov = map(file, offset + headerSize, atomSize - headerSize);
+            break;
+        }
+
+        offset += atomSize;
+    }
+
+    if (moov.isNull())
+        return false;
+
+    forEachAtom(moov.data, moov.size, [&info] (QByteArrayView type, const uchar *body, qint64 size) {
+        if (type == "mvhd" and size >= 20) {
+            const bool version1 = body[0] == 1;
+            if (version1 and size < 32)
+                return;
+
+            const qint64 timescale = qFromBigEndian<quint32>(body + (version1 ? 20 : 12));
+            const qint64 duration = version1 ? static_cast<qint64>(qFromBigEndian<quint64>(body + 24))
+                                             : qint64(qFromBigEndian<quint32>(body + 16));
+            if (timescale > 0)
+                info.duration = duration * 1'000 / timescale;
+        } else if (type == "trak") {
+            parseMp4Track(body, size, info);
+        } else if (type == "udta") {
+            forEachAtom(body, size, [&info] (QByteArrayView type, const uchar *body, qint64 size) {
+                if (type != "meta" or size < 8)
+                    return;
+
+                /* ISO meta is a full atom with version and flags, QuickTime's isn't. */
+                const qint64 skip = QByteArrayView(body + 4, 4) == "hdlr" ? 0 : 4;
+                forEachAtom(body + skip, size - skip, [&info] (QByteArrayView type, const uchar *body, qint64 size) {
+                    if (type == "ilst")
+                        parseIlst(body, size, info);
+                });
+            });
+        }
+    });
+
+    if (info.duration > 0)
+        info.bitrate = static_cast<int>(fileSize * 8 / info.duration);
+
+    return true;
+}
+} // namespace
+
+bool TagReader::read(const QString &filename, TrackInfo &info)
+{
+    QFile file(filename);
+    if (not file.open(QIODevice::ReadOnly))
+        return false;
+
+    const auto fileSize = file.size();
+    uchar magic[10];
+    if (file.read(reinterpret_cast<char *>(magic), sizeof magic) != qint64(sizeof magic))
+        return false;
+
+    if (std::memcmp(magic + 4, "ftyp", 4) == 0)
+        return parseMp4(file, info);
+
+    if (std::memcmp(magic, "OggS", 4) == 0) {
+        const auto head = map(file, 0, headerRegionSize);
+        return not head.isNull() and parseOgg(file, head, info);
+    }
+
+    /* Nothing in a RIFF container would be worth reading, and its samples could pass for MPEG frames. */
+    if (std::memcmp(magic, "RIFF", 4) == 0)
+        return false;
+
+    /* FLAC files and MP3 files alike may start with an ID3v2 tag. */
+    const auto tagSize = MpegAudio::id3v2Size(magic, sizeof magic);
+    const auto head = map(file, 0, tagSize + frameSearchSize);
+    if (head.isNull())
+        return false;
+
+    qint64 length {};
+    if (tagSize > 0)
+        parseId3v2(head.data, head.size, info, length);
+
+    if (tagSize + 4 <= head.size and std::memcmp(head.data + tagSize, "fLaC", 4) == 0) {
+        /* The metadata blocks' size isn't known, map generously, only touched pages are read. */
+        const auto flac = map(file, 0, tagSize + headerRegionSize);
+        return not flac.isNull() and parseFlac(flac, tagSize, fileSize, info);
+    }
+
+    qint64 audioEnd = fileSize;
+    if (fileSize >= tagSize + id3v1Size) {
+        const auto tail = map(file, fileSize - id3v1Size, id3v1Size);
+        if (not tail.isNull() and std::memcmp(tail.data, "TAG", 3) == 0) {
+            parseId3v1(tail.data, info);
+            audioEnd -= id3v1Size;
+        }
+    }
+
+    if (not parseMpeg(head, tagSize, audioEnd, info))
+        return tagSize > 0; // Tags with something we can't decode, still worth what we got.
+
+    /* Only if there was nothing better, TLEN is often wrong. */
+    if (info.duration <= 0 and length > 0)
+        info.duration = length;
+
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef TAGREADER_HPP
+#define TAGREADER_HPP
+
+#include <QString>
+
+#include "trackinfo.hpp"
+
+/* Reads tags and stream properties straight from the file headers: ID3v2 and ID3v1, FLAC
+ * STREAMINFO and Vorbis comments, Ogg Vorbis and Opus headers and MP4 moov/ilst atoms.
+ * Only the region holding the headers is mapped and nothing is decoded, durations come
+ * from Xing/VBRI/STREAMINFO/mvhd or the last Ogg granule. Pictures and other big blocks
+ * are skipped by their length so their pages are never even read. Thread safe. */
+class TagReader
+{
+public:
+    /* Fills in whatever info has, returns false if the file can't be opened or its format
+     * isn't one we know. Fields the file doesn't have are left alone. */
+    static bool read(const QString &filename, TrackInfo &info);
+};
+
+#endif // TAGREADER_HPP
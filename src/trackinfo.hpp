@@ -0,0 +1,48 @@
+#ifndef TRACKINFO_HPP
+#define TRACKINFO_HPP
+
+#include <QDataStream>
+#include <QString>
+
+/* What we know about a music file besides its path. */
+struct TrackInfo
+{
+    QString title;
+    QString artist;
+    QString album;
+    QString genre;
+    int year {};
+    int track {};
+    int disc {};
+    qint64 duration {}; /* Milliseconds */
+    int bitrate {}; /* kbit/s */
+    int sampleRate {};
+    int channels {};
+};
+
+inline QDataStream &operator<<(QDataStream &stream, const TrackInfo &info)
+{
+    return stream << info.title << info.artist << info.album << info.genre
+                  << qint32(info.year) << qint32(info.track) << qint32(info.disc)
+                  << info.duration << qint32(info.bitrate) << qint32(info.sampleRate)
+                  << qint32(info.channels);
+}
+
+inline QDataStream &operator>>(QDataStream &stream, TrackInfo &info)
+{
+    qint32 year, track, disc, bitrate, sampleRate, channels;
+    stream >> info.title >> info.artist >> info.album >> info.genre
+           >> year >> track >> disc
+           >> info.duration >> bitrate >> sampleRate
+           >> channels;
+
+    info.year = year;
+    info.track = track;
+    info.disc = disc;
+    info.bitrate = bitrate;
+    info.sampleRate = sampleRate;
+    info.channels = channels;
+    return stream;
+}
+
+#endif // TRACKINFO_HPP
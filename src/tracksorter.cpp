@@ -0,0 +1,156 @@
+#include "tracksorter.hpp"
+
+#include "playlistmodel.hpp"
+
+bool TrackSorter::isNumeric(KEY key)
+{
+    return key == KEY::DISC or key == KEY::TRACK;
+}
+
+QCollator TrackSorter::collator()
+{
+    QCollator collator;
+    collator.setNumericMode(true);
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    return collator;
+}
+
+QList<TrackSorter::KEY> TrackSorter::defaultKeys()
+{
+    return {KEY::NAME, KEY::PATH};
+}
+
+TrackSorter::TrackSorter()
+    : m_collator {collator()}
+    , m_keys {defaultKeys()}
+{
+}
+
+void TrackSorter::setKeys(const QList<KEY> &keys)
+{
+    if (keys == m_keys)
+        return;
+
+    m_keys = keys;
+    m_cache.clear();
+}
+
+QList<TrackSorter::KEY> TrackSorter::keys() const
+{
+    return m_keys;
+}
+
+void TrackSorter::invalidate(TrackId id)
+{
+    m_cache.remove(id);
+}
+
+void TrackSorter::clear()
+{
+    m_cache.clear();
+}
+
+TrackSorter::Keys TrackSorter::makeKeys(TrackId id, const TrackInfo *info) const
+{
+    const auto path = TrackTable::instance().path(id);
+
+    Keys keys {id, {}, {}, path};
+    for (const auto key : m_keys) {
+        switch (key) {
+        case KEY::NAME:
+            keys.texts.push_back(m_collator.sortKey(PlaylistModel::name(path)));
+            break;
+        case KEY::ARTIST:
+            keys.texts.push_back(m_collator.sortKey(info ? info->artist : QString()));
+            break;
+        case KEY::ALBUM:
+            keys.texts.push_back(m_collator.sortKey(info ? info->album : QString()));
+            break;
+        case KEY::DISC:
+            keys.numbers.push_back(info ? info->disc : 0);
+            break;
+        case KEY::TRACK:
+            keys.numbers.push_back(info ? info->track : 0);
+            break;
+        case KEY::TITLE:
+            keys.texts.push_back(m_collator.sortKey(info and not info->title.isEmpty()
+                                                        ? info->title
+                                                        : PlaylistModel::name(path)));
+            break;
+        case KEY::PATH:
+            keys.texts.push_back(m_collator.sortKey(path));
+            break;
+        }
+    }
+
+    return keys;
+}
+
+bool TrackSorter::lessThan(const Keys &first, const Keys &second) const
+{
+    size_t text = 0;
+    size_t number = 0;
+    for (const auto key : m_keys) {
+        int order;
+        if (isNumeric(key)) {
+            const auto left = first.numbers[number];
+            const auto right = second.numbers[number++];
+            order = left < right ? -1 : (right < left ? 1 : 0);
+        } else {
+            order = first.texts[text].compare(second.texts[text]);
+            ++text;
+        }
+
+        if (order != 0)
+            return order < 0;
+    }
+
+    /* Collation may find different paths equal, e.g. they only differ by case. */
+    if (first.id == second.id)
+        return false;
+
+    return first.path < second.path;
+}
+
+void TrackSorter::sort(Playlist &playlist,
+                       const std::function<const TrackInfo *(TrackId)> &info,
+                       qsizetype first)
+{
+    /* All made before sorting, the cache mustn't move while pointers to it are held. */
+    for (auto row = qMax<qsizetype>(0, first); row < playlist.size(); ++row) {
+        const auto id = playlist.id(row);
+        if (not m_cache.contains(id)) {
+            m_cache.insert(id, makeKeys(id, info ? info(id) : nullptr));
+        }
+    }
+
+    playlist.sortBy([this] (TrackId id) {
+        return &m_cache.find(id).value();
+    }, [this] (const Keys *left, const Keys *right) {
+        return lessThan(*left, *right);
+    }, first);
+}
+
+void TrackSorter::sort(QStringList &paths)
+{
+    if (paths.size() < 2)
+        return;
+
+    TrackSorter sorter;
+    Playlist playlist(paths);
+    sorter.sort(playlist, {});
+    paths = playlist.paths();
+}
+
+bool TrackSorter::precedes(const QString &first, const QString &second)
+{
+    /* Making one costs far more than comparing with it. */
+    thread_local const auto sorter = collator();
+
+    if (const auto order = sorter.compare(PlaylistModel::name(first), PlaylistModel::name(second)); order != 0)
+        return order < 0;
+    if (const auto order = sorter.compare(first, second); order != 0)
+        return order < 0;
+
+    return first < second;
+}
@@ -0,0 +1,78 @@
+#ifndef TRACKSORTER_HPP
+#define TRACKSORTER_HPP
+
+#include <QCollator>
+#include <QCollatorSortKey>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <functional>
+#include <vector>
+
+#include "playlist.hpp"
+#include "trackinfo.hpp"
+
+/* Puts tracks in order by several fields in turn, the way people read them: case aside
+ * and numbers by their value, so "Track 2" comes before "Track 10". Every text field of a
+ * track gets its collation key made once and kept until its tags change, a sort then only
+ * compares those binary keys and never runs the locale's rules again. Tracks alike in
+ * every field are told apart by their path, so the order never depends on the one before. */
+class TrackSorter
+{
+public:
+    enum class KEY : quint8 {
+        /* File name without its extension, what the playlist shows. */
+        NAME = 0,
+        ARTIST,
+        ALBUM,
+        DISC,
+        TRACK,
+        /* The file name when there's no title tag. */
+        TITLE,
+        PATH
+    };
+
+private:
+    struct Keys
+    {
+        TrackId id;
+        /* One for each text field of m_keys, in the same order, and likewise numbers. */
+        std::vector<QCollatorSortKey> texts;
+        std::vector<int> numbers;
+        /* Tells apart tracks alike in every key without asking the track table again. */
+        QString path;
+    };
+
+    static bool isNumeric(KEY key);
+    static QCollator collator();
+    Keys makeKeys(TrackId id, const TrackInfo *info) const;
+    bool lessThan(const Keys &first, const Keys &second) const;
+
+public:
+    static QList<KEY> defaultKeys();
+
+    TrackSorter();
+    void setKeys(const QList<KEY> &keys);
+    QList<KEY> keys() const;
+    /* Its keys are made again next time, e.g. its tags changed. */
+    void invalidate(TrackId id);
+    void clear();
+    /* Stable, tracks before first stay where they are. info gives a track's tags,
+     * nullptr when they aren't known. */
+    void sort(Playlist &playlist,
+              const std::function<const TrackInfo *(TrackId)> &info,
+              qsizetype first = 0);
+    /* By defaultKeys(), for lists no view shows, e.g. saved playlists. Keys aren't kept,
+     * safe to call from any thread. */
+    static void sort(QStringList &paths);
+    /* Whether first goes before second by defaultKeys(), for searching lists sorted so
+     * without making keys for all of them. Safe to call from any thread. */
+    static bool precedes(const QString &first, const QString &second);
+
+private:
+    QCollator m_collator;
+    QList<KEY> m_keys;
+    QHash<TrackId, Keys> m_cache;
+};
+
+#endif // TRACKSORTER_HPP
@@ -0,0 +1,198 @@
+#include "tracktable.hpp"
+
+#include <QVarLengthArray>
+
+namespace {
+/* Parent of the top directories, and of tracks without a directory. */
+constexpr quint32 noParent = std::numeric_limits<quint32>::max();
+/* Qt's own, whatever the platform. */
+constexpr char separator = '/';
+}
+
+TrackTable &TrackTable::instance()
+{
+    static TrackTable table;
+    return table;
+}
+
+size_t TrackTable::key(NodeId parent, QByteArrayView name)
+{
+    return qHashMulti(0, parent, name);
+}
+
+QByteArrayView TrackTable::name(const Node &node) const
+{
+    return QByteArrayView(m_names.constData() + node.offset, node.length);
+}
+
+TrackTable::NodeId TrackTable::findNode(const Nodes &nodes, NodeId parent, QByteArrayView name) const
+{
+    const auto range = nodes.index.equal_range(key(parent, name));
+    for (auto it = range.first; it != range.second; ++it) {
+        const auto &node = nodes.nodes[*it];
+        if (node.parent == parent and this->name(node) == name)
+            return *it;
+    }
+
+    return INVALID;
+}
+
+TrackTable::NodeId TrackTable::addNode(Nodes &nodes, NodeId parent, QByteArrayView name)
+{
+    const auto id = static_cast<NodeId>(nodes.nodes.size());
+    nodes.nodes.push_back({parent, static_cast<quint32>(m_names.size()), static_cast<quint32>(name.size())});
+    nodes.index.insert(key(parent, name), id);
+    m_names.append(name);
+    return id;
+}
+
+TrackId TrackTable::internLocked(const QByteArray &path)
+{
+    NodeId parent = noParent;
+    qsizetype start = 0;
+    for (auto slash = path.indexOf(separator); slash >= 0; slash = path.indexOf(separator, start)) {
+        const QByteArrayView name(path.constData() + start, slash - start);
+        auto directory = findNode(m_directories, parent, name);
+        if (directory == INVALID)
+            directory = addNode(m_directories, parent, name);
+
+        parent = directory;
+        start = slash + 1;
+    }
+
+    const QByteArrayView name(path.constData() + start, path.size() - start);
+    const auto id = findNode(m_tracks, parent, name);
+    return id != INVALID ? id : addNode(m_tracks, parent, name);
+}
+
+TrackTable::NodeId TrackTable::findDirectoryLocked(const QByteArray &path) const
+{
+    /* Every component is a directory, the last one included. */
+    NodeId directory = noParent;
+    qsizetype start = 0;
+    while (start <= path.size()) {
+        auto slash = path.indexOf(separator, start);
+        if (slash < 0)
+            slash = path.size();
+
+        directory = findNode(m_directories, directory, QByteArrayView(path.constData() + start, slash - start));
+        if (directory == INVALID)
+            return INVALID;
+
+        start = slash + 1;
+    }
+
+    return directory;
+}
+
+TrackId TrackTable::findLocked(const QByteArray &path) const
+{
+    const auto slash = path.lastIndexOf(separator);
+    NodeId directory = noParent;
+    if (slash >= 0) {
+        directory = findDirectoryLocked(QByteArray::fromRawData(path.constData(), slash));
+        if (directory == INVALID)
+            return INVALID;
+    }
+
+    return findNode(m_tracks, directory, QByteArrayView(path.constData() + slash + 1, path.size() - slash - 1));
+}
+
+QString TrackTable::pathLocked(TrackId id) const
+{
+    const auto &track = m_tracks.nodes[id];
+
+    QVarLengthArray<const Node *, 16> nodes;
+    qsizetype length = track.length;
+    for (auto parent = track.parent; parent != noParent; parent = m_directories.nodes[parent].parent) {
+        nodes.append(&m_directories.nodes[parent]);
+        length += m_directories.nodes[parent].length + 1;
+    }
+
+    QByteArray path;
+    path.reserve(length);
+    for (auto i = nodes.size() - 1; i >= 0; --i) {
+        path.append(name(*nodes[i]));
+        path.append(separator);
+    }
+    path.append(name(track));
+
+    return QString::fromUtf8(path);
+}
+
+TrackId TrackTable::intern(const QString &path)
+{
+    const auto utf8 = path.toUtf8();
+    {
+        QReadLocker locker(&m_lock);
+        if (const auto id = findLocked(utf8); id != INVALID)
+            return id;
+    }
+
+    QWriteLocker locker(&m_lock);
+    /* Another thread may have added it in between, internLocked() finds it then. */
+    return internLocked(utf8);
+}
+
+QList<TrackId> TrackTable::intern(const QStringList &paths)
+{
+    QList<TrackId> ids;
+    ids.reserve(paths.size());
+
+    /* One lock for the whole batch, playlists come thousands of files at once. */
+    QWriteLocker locker(&m_lock);
+    for (const auto &path : paths)
+        ids << internLocked(path.toUtf8());
+
+    return ids;
+}
+
+TrackId TrackTable::find(const QString &path) const
+{
+    const auto utf8 = path.toUtf8();
+    QReadLocker locker(&m_lock);
+    return findLocked(utf8);
+}
+
+QString TrackTable::path(TrackId id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < m_tracks.nodes.size() ? pathLocked(id) : QString();
+}
+
+QList<TrackId> TrackTable::under(const QList<TrackId> &ids, const QString &directory) const
+{
+    if (directory.isEmpty())
+        return {};
+
+    /* The root itself ends up empty, it's the directory of "/home" too. */
+    auto utf8 = directory.toUtf8();
+    while (utf8.endsWith(separator))
+        utf8.chop(1);
+
+    QReadLocker locker(&m_lock);
+    const auto root = findDirectoryLocked(utf8);
+    if (root == INVALID)
+        return {};
+
+    QList<TrackId> under;
+    for (const auto id : ids) {
+        if (id >= m_tracks.nodes.size())
+            continue;
+
+        for (auto parent = m_tracks.nodes[id].parent; parent != noParent; parent = m_directories.nodes[parent].parent) {
+            if (parent == root) {
+                under << id;
+                break;
+            }
+        }
+    }
+
+    return under;
+}
+
+qsizetype TrackTable::size() const
+{
+    QReadLocker locker(&m_lock);
+    return static_cast<qsizetype>(m_tracks.nodes.size());
+}
@@ -0,0 +1,78 @@
+#ifndef TRACKTABLE_HPP
+#define TRACKTABLE_HPP
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <limits>
+#include <vector>
+
+using TrackId = quint32;
+
+/* Every path the player has come across, each under a 32-bit id it keeps until the
+ * application quits. Entries are never changed nor removed, so an id can be kept
+ * anywhere in place of its path and looked up from any thread. Thread safe.
+ *
+ * Paths are stored as a tree: every directory once, with a pointer to its parent, and
+ * every file as its directory plus its name. Names are UTF-8 in one contiguous arena,
+ * full paths are put back together when asked for. Tracks of a big library share most
+ * of their path, so this takes a fraction of what a QString per path would. */
+class TrackTable
+{
+    using NodeId = quint32;
+
+    struct Node
+    {
+        NodeId parent;
+        /* Name in m_names. */
+        quint32 offset;
+        quint32 length;
+    };
+
+    /* Directories and tracks each have their own nodes and index. */
+    struct Nodes
+    {
+        std::vector<Node> nodes;
+        /* By the hash of their parent and name, there may be collisions. */
+        QMultiHash<size_t, NodeId> index;
+    };
+
+    TrackTable() = default;
+    static size_t key(NodeId parent, QByteArrayView name);
+    QByteArrayView name(const Node &node) const;
+    NodeId findNode(const Nodes &nodes, NodeId parent, QByteArrayView name) const;
+    NodeId addNode(Nodes &nodes, NodeId parent, QByteArrayView name);
+    TrackId internLocked(const QByteArray &path);
+    TrackId findLocked(const QByteArray &path) const;
+    NodeId findDirectoryLocked(const QByteArray &path) const;
+    QString pathLocked(TrackId id) const;
+
+public:
+    static constexpr TrackId INVALID = std::numeric_limits<TrackId>::max();
+
+    static TrackTable &instance();
+
+    TrackTable(const TrackTable &) = delete;
+    TrackTable &operator=(const TrackTable &) = delete;
+
+    /* Adds path the first time it's seen. */
+    TrackId intern(const QString &path);
+    QList<TrackId> intern(const QStringList &paths);
+    /* INVALID if path was never interned. */
+    TrackId find(const QString &path) const;
+    QString path(TrackId id) const;
+    /* Those of ids whose file is somewhere below directory, found by walking up their
+     * parents rather than comparing paths. */
+    QList<TrackId> under(const QList<TrackId> &ids, const QString &directory) const;
+    qsizetype size() const;
+
+private:
+    mutable QReadWriteLock m_lock;
+    Nodes m_directories;
+    Nodes m_tracks;
+    QByteArray m_names;
+};
+
+#endif // TRACKTABLE_HPP